@@ -0,0 +1,410 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "liz_actor_clip.h"
+
+#include "liz_assert.h"
+#include "liz_platform_functions.h"
+
+
+
+static
+size_t
+liz_actor_clip_align(size_t const offset,
+                     size_t const alignment)
+{
+    return (offset + (alignment - 1u)) & ~(alignment - 1u);
+}
+
+
+
+static
+size_t
+liz_actor_clip_stream_alignment(size_t const stream_alignment)
+{
+    LIZ_ASSERT(0u == (stream_alignment & (stream_alignment - 1u)) && "Alignment must be a power of two.");
+    
+    return (stream_alignment > LIZ_ACTOR_CLIP_ALIGNMENT) ? stream_alignment : LIZ_ACTOR_CLIP_ALIGNMENT;
+}
+
+
+
+size_t
+liz_actor_clip_stream_slot_size(liz_shape_specification_t const spec,
+                                liz_actor_clip_stream_t const stream)
+{
+    switch (stream) {
+        case liz_actor_clip_stream_actor_headers:
+            return sizeof(liz_actor_header_t);
+        case liz_actor_clip_stream_tick_schedules:
+            return sizeof(liz_actor_tick_schedule_t);
+        case liz_actor_clip_stream_persistent_states:
+            return sizeof(liz_persistent_state_t) * spec.persistent_state_count;
+        case liz_actor_clip_stream_decider_state_shape_atom_indices:
+            return sizeof(liz_index_t) * spec.decider_state_capacity;
+        case liz_actor_clip_stream_decider_states:
+            return sizeof(liz_index_t) * spec.decider_state_capacity;
+        case liz_actor_clip_stream_action_state_shape_atom_indices:
+            return sizeof(liz_index_t) * spec.action_state_capacity;
+        case liz_actor_clip_stream_action_states:
+            return sizeof(uint8_t) * spec.action_state_capacity;
+        default:
+            LIZ_ASSERT(0 && "Unknown actor clip stream.");
+            return 0;
+    }
+}
+
+
+
+size_t
+liz_actor_clip_memory_size_requirement(liz_shape_specification_t const spec,
+                                       liz_int_t const capacity)
+{
+    return liz_actor_clip_memory_size_requirement_aligned(spec, 
+                                                          capacity,
+                                                          LIZ_ACTOR_CLIP_ALIGNMENT);
+}
+
+
+
+size_t
+liz_actor_clip_memory_size_requirement_aligned(liz_shape_specification_t const spec,
+                                               liz_int_t const capacity,
+                                               size_t const stream_alignment)
+{
+    LIZ_ASSERT(0 <= capacity);
+    
+    size_t const alignment = liz_actor_clip_stream_alignment(stream_alignment);
+    size_t size = liz_actor_clip_align(sizeof(liz_actor_clip_t), alignment);
+    
+    for (liz_int_t i = 0; i < liz_actor_clip_stream_count; ++i) {
+        size_t const slot_size = liz_actor_clip_stream_slot_size(spec, (liz_actor_clip_stream_t)i);
+        size = liz_actor_clip_align(size + slot_size * (size_t)capacity, alignment);
+    }
+    
+    return size;
+}
+
+
+
+size_t
+liz_actor_clip_memory_size(liz_actor_clip_t const *clip)
+{
+    // Streams are placed in order, the last one ends the clip's memory.
+    size_t const slot_size = liz_actor_clip_stream_slot_size(clip->spec, liz_actor_clip_stream_action_states);
+    char const *end = (char const *)clip->action_states + slot_size * clip->header.capacity;
+    
+    return (size_t)(end - (char const *)clip);
+}
+
+
+
+static
+liz_actor_clip_t*
+liz_actor_clip_create_in_memory(liz_shape_specification_t const spec,
+                                liz_int_t const capacity,
+                                liz_id_t const clip_id,
+                                liz_id_t const shape_id,
+                                size_t const alignment,
+                                void *memory,
+                                size_t const clip_size)
+{
+    liz_actor_clip_t *clip = (liz_actor_clip_t *)memory;
+    
+    LIZ_ASSERT(0u == ((uintptr_t)clip & (alignment - 1u)) 
+               && "Alignment of allocated memory less than required.");
+    
+    // Zero all slots so unused states and struct padding never leak old 
+    // memory contents into streams that are stored or compared byte-wise.
+    liz_memset(clip, 0, clip_size);
+    
+    clip->header.user_data = 0;
+    clip->header.capacity = (uint32_t)capacity;
+    clip->header.count = 0;
+    clip->header.clip_id = clip_id;
+    clip->header.shape_id = shape_id;
+    clip->spec = spec;
+    
+    char *streams[liz_actor_clip_stream_count];
+    size_t actor_size = 0;
+    char *ptr = (char *)clip + liz_actor_clip_align(sizeof(liz_actor_clip_t), alignment);
+    
+    for (liz_int_t i = 0; i < liz_actor_clip_stream_count; ++i) {
+        size_t const slot_size = liz_actor_clip_stream_slot_size(spec, (liz_actor_clip_stream_t)i);
+        
+        streams[i] = ptr;
+        actor_size += slot_size;
+        ptr += liz_actor_clip_align(slot_size * (size_t)capacity, alignment);
+    }
+    
+    clip->header.actor_size = (uint32_t)actor_size;
+    
+    clip->actor_headers = (liz_actor_header_t *)streams[liz_actor_clip_stream_actor_headers];
+    clip->tick_schedules = (liz_actor_tick_schedule_t *)streams[liz_actor_clip_stream_tick_schedules];
+    clip->persistent_states = (liz_persistent_state_t *)streams[liz_actor_clip_stream_persistent_states];
+    clip->decider_state_shape_atom_indices = (liz_index_t *)streams[liz_actor_clip_stream_decider_state_shape_atom_indices];
+    clip->decider_states = (liz_index_t *)streams[liz_actor_clip_stream_decider_states];
+    clip->action_state_shape_atom_indices = (liz_index_t *)streams[liz_actor_clip_stream_action_state_shape_atom_indices];
+    clip->action_states = (uint8_t *)streams[liz_actor_clip_stream_action_states];
+    
+    return clip;
+}
+
+
+
+liz_actor_clip_t*
+liz_actor_clip_create(liz_shape_specification_t const spec,
+                      liz_int_t const capacity,
+                      liz_id_t const clip_id,
+                      liz_id_t const shape_id,
+                      void * LIZ_RESTRICT allocator_context,
+                      liz_alloc_func_t alloc_func)
+{
+    if (0 > capacity) {
+        return NULL;
+    }
+    
+    size_t const clip_size = liz_actor_clip_memory_size_requirement(spec, capacity);
+    void *memory = alloc_func(allocator_context, clip_size);
+    
+    if (NULL == memory) {
+        return NULL;
+    }
+    
+    return liz_actor_clip_create_in_memory(spec,
+                                           capacity,
+                                           clip_id,
+                                           shape_id,
+                                           LIZ_ACTOR_CLIP_ALIGNMENT,
+                                           memory,
+                                           clip_size);
+}
+
+
+
+liz_actor_clip_t*
+liz_actor_clip_create_aligned(liz_shape_specification_t const spec,
+                              liz_int_t const capacity,
+                              liz_id_t const clip_id,
+                              liz_id_t const shape_id,
+                              size_t const stream_alignment,
+                              void * LIZ_RESTRICT allocator_context,
+                              liz_aligned_alloc_func_t aligned_alloc_func)
+{
+    if (0 > capacity) {
+        return NULL;
+    }
+    
+    size_t const alignment = liz_actor_clip_stream_alignment(stream_alignment);
+    size_t const clip_size = liz_actor_clip_memory_size_requirement_aligned(spec, capacity, alignment);
+    void *memory = aligned_alloc_func(allocator_context, clip_size, alignment);
+    
+    if (NULL == memory) {
+        return NULL;
+    }
+    
+    return liz_actor_clip_create_in_memory(spec,
+                                           capacity,
+                                           clip_id,
+                                           shape_id,
+                                           alignment,
+                                           memory,
+                                           clip_size);
+}
+
+
+
+void
+liz_actor_clip_destroy(liz_actor_clip_t *clip,
+                       void * LIZ_RESTRICT allocator_context,
+                       liz_dealloc_func_t dealloc_func)
+{
+    dealloc_func(allocator_context, clip);
+}
+
+
+
+liz_int_t
+liz_actor_clip_add_actor(liz_actor_clip_t *clip,
+                         liz_id_t const actor_id,
+                         uint64_t const user_data,
+                         liz_random_number_seed_t const random_number_seed)
+{
+    LIZ_ASSERT(clip->header.count < clip->header.capacity && "Clip must not be full.");
+    
+    liz_int_t const index = (liz_int_t)clip->header.count;
+    
+    for (liz_int_t i = 0; i < liz_actor_clip_stream_count; ++i) {
+        size_t const slot_size = liz_actor_clip_stream_slot_size(clip->spec, (liz_actor_clip_stream_t)i);
+        char *stream = (char *)liz_actor_clip_stream_data(clip, (liz_actor_clip_stream_t)i);
+        
+        liz_memset(stream + slot_size * (size_t)index, 0, slot_size);
+    }
+    
+    liz_actor_header_t *actor_header = &clip->actor_headers[index];
+    actor_header->user_data = user_data;
+    actor_header->random_number_seed = random_number_seed;
+    actor_header->actor_id = actor_id;
+    actor_header->decider_state_count = 0;
+    actor_header->action_state_count = 0;
+    
+    clip->tick_schedules[index] = (liz_actor_tick_schedule_t){1u, 0u};
+    
+    clip->header.count += 1u;
+    
+    return index;
+}
+
+
+
+bool
+liz_actor_clip_set_tick_schedule(liz_actor_clip_t *clip,
+                                 liz_int_t const index,
+                                 uint16_t const tick_interval,
+                                 uint16_t const tick_phase)
+{
+    LIZ_ASSERT(0 <= index && (uint32_t)index < clip->header.count);
+    
+    if (0u == tick_interval
+        || 0u != (tick_interval & (tick_interval - 1u))
+        || tick_interval <= tick_phase) {
+        
+        return false;
+    }
+    
+    clip->tick_schedules[index] = (liz_actor_tick_schedule_t){tick_interval, tick_phase};
+    
+    return true;
+}
+
+
+
+void
+liz_actor_clip_apply_action_state_updates(liz_actor_clip_t *clip,
+                                          liz_action_state_update_t const *action_state_updates,
+                                          liz_int_t const action_state_update_count)
+{
+    if (0 == action_state_update_count) {
+        return;
+    }
+    
+    for (uint32_t actor_index = 0; actor_index < clip->header.count; ++actor_index) {
+        liz_id_t const actor_id = clip->actor_headers[actor_index].actor_id;
+        
+        // Binary search the first update of the actor.
+        liz_int_t begin = 0;
+        liz_int_t end = action_state_update_count;
+        while (begin < end) {
+            liz_int_t const middle = begin + (end - begin) / 2;
+            
+            if (action_state_updates[middle].actor_id < actor_id) {
+                begin = middle + 1;
+            } else {
+                end = middle;
+            }
+        }
+        
+        liz_actor_header_t const *actor_header = &clip->actor_headers[actor_index];
+        liz_index_t const *shape_atom_indices = clip->action_state_shape_atom_indices + (size_t)actor_index * clip->spec.action_state_capacity;
+        uint8_t *states = clip->action_states + (size_t)actor_index * clip->spec.action_state_capacity;
+        liz_int_t cursor = 0;
+        
+        for (liz_int_t i = begin; 
+             i < action_state_update_count && actor_id == action_state_updates[i].actor_id;
+             ++i) {
+            
+            if (liz_seek_key(&cursor,
+                             action_state_updates[i].shape_atom_index,
+                             shape_atom_indices,
+                             actor_header->action_state_count)) {
+                
+                states[cursor] = action_state_updates[i].state;
+            }
+        }
+    }
+}
+
+
+
+void
+liz_actor_clip_clear(liz_actor_clip_t *clip)
+{
+    clip->header.count = 0;
+}
+
+
+
+liz_vm_actor_t
+liz_actor_clip_actor(liz_actor_clip_t *clip,
+                     liz_int_t const index)
+{
+    LIZ_ASSERT(0 <= index && (uint32_t)index < clip->header.count);
+    
+    liz_shape_specification_t const spec = clip->spec;
+    
+    liz_vm_actor_t actor;
+    actor.header = &clip->actor_headers[index];
+    actor.persistent_states = clip->persistent_states + (size_t)index * spec.persistent_state_count;
+    actor.decider_state_shape_atom_indices = clip->decider_state_shape_atom_indices + (size_t)index * spec.decider_state_capacity;
+    actor.decider_states = clip->decider_states + (size_t)index * spec.decider_state_capacity;
+    actor.action_state_shape_atom_indices = clip->action_state_shape_atom_indices + (size_t)index * spec.action_state_capacity;
+    actor.action_states = clip->action_states + (size_t)index * spec.action_state_capacity;
+    
+    return actor;
+}
+
+
+
+void*
+liz_actor_clip_stream_data(liz_actor_clip_t const *clip,
+                           liz_actor_clip_stream_t const stream)
+{
+    switch (stream) {
+        case liz_actor_clip_stream_actor_headers:
+            return clip->actor_headers;
+        case liz_actor_clip_stream_tick_schedules:
+            return clip->tick_schedules;
+        case liz_actor_clip_stream_persistent_states:
+            return clip->persistent_states;
+        case liz_actor_clip_stream_decider_state_shape_atom_indices:
+            return clip->decider_state_shape_atom_indices;
+        case liz_actor_clip_stream_decider_states:
+            return clip->decider_states;
+        case liz_actor_clip_stream_action_state_shape_atom_indices:
+            return clip->action_state_shape_atom_indices;
+        case liz_actor_clip_stream_action_states:
+            return clip->action_states;
+        default:
+            LIZ_ASSERT(0 && "Unknown actor clip stream.");
+            return NULL;
+    }
+}
+
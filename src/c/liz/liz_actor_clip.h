@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *
+ * Actor clips store all actors of one shape in a single memory block.
+ *
+ * Each kind of actor data, e.g., the actor headers or the decider states, is
+ * kept in its own stream with one fixed-size slot per actor. Slots of the
+ * first count actors are tightly packed so every stream can be processed,
+ * copied, or stored with one sequential memory access instead of walking the
+ * six pointers of each actor.
+ *
+ * Use liz_actor_clip_actor to get a liz_vm_actor_t pointing into the clip 
+ * streams for a vm update.
+ */
+
+#ifndef LIZ_liz_actor_clip_H
+#define LIZ_liz_actor_clip_H
+
+
+#include <liz/liz_platform_types.h>
+#include <liz/liz_platform_macros.h>
+#include <liz/liz_allocator.h>
+#include <liz/liz_common.h>
+#include <liz/liz_common_internal.h>
+#include <liz/liz_vm.h>
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+    
+    
+    /**
+     * Alignment of the clip and of each of its streams.
+     */
+#define LIZ_ACTOR_CLIP_ALIGNMENT sizeof(uint64_t)
+    
+    
+    
+    /**
+     * Actor data streams of a clip in the order they are placed in memory.
+     */
+    typedef enum liz_actor_clip_stream {
+        liz_actor_clip_stream_actor_headers = 0,
+        liz_actor_clip_stream_tick_schedules,
+        liz_actor_clip_stream_persistent_states,
+        liz_actor_clip_stream_decider_state_shape_atom_indices,
+        liz_actor_clip_stream_decider_states,
+        liz_actor_clip_stream_action_state_shape_atom_indices,
+        liz_actor_clip_stream_action_states,
+        liz_actor_clip_stream_count
+    } liz_actor_clip_stream_t;
+    
+    
+    
+    /**
+     * Actors of one shape. Stream slots per actor are sized by the shape 
+     * specification, e.g., each actor has spec.decider_state_capacity decider
+     * states of which its header's decider_state_count are in use.
+     *
+     * header.actor_size is the byte count of all stream slots of one actor.
+     */
+    typedef struct liz_actor_clip {
+        liz_actor_clip_header_t header;
+        liz_shape_specification_t spec;
+        
+        liz_actor_header_t *actor_headers;
+        liz_actor_tick_schedule_t *tick_schedules;
+        liz_persistent_state_t *persistent_states;
+        liz_index_t *decider_state_shape_atom_indices;
+        liz_index_t *decider_states;
+        liz_index_t *action_state_shape_atom_indices;
+        uint8_t *action_states;
+    } liz_actor_clip_t;
+    
+    
+    
+    /**
+     * Returns the number of bytes to allocate to create a clip for capacity
+     * actors of shapes with specification spec.
+     */
+    size_t
+    liz_actor_clip_memory_size_requirement(liz_shape_specification_t spec,
+                                           liz_int_t capacity);
+    
+    
+    /**
+     * Returns the number of bytes to allocate to create a clip with 
+     * liz_actor_clip_create_aligned.
+     */
+    size_t
+    liz_actor_clip_memory_size_requirement_aligned(liz_shape_specification_t spec,
+                                                   liz_int_t capacity,
+                                                   size_t stream_alignment);
+    
+    
+    /**
+     * Returns the bytes of the live clip from its start to the end of its 
+     * last stream, e.g., to report memory usage.
+     */
+    size_t
+    liz_actor_clip_memory_size(liz_actor_clip_t const *clip);
+    
+    
+    /**
+     * Allocates a clip and its streams with one call to alloc_func and 
+     * initializes it without any actors. 
+     *
+     * Returns NULL if memory could not be allocated or if capacity is 
+     * negative.
+     */
+    liz_actor_clip_t*
+    liz_actor_clip_create(liz_shape_specification_t spec,
+                          liz_int_t capacity,
+                          liz_id_t clip_id,
+                          liz_id_t shape_id,
+                          void * LIZ_RESTRICT allocator_context,
+                          liz_alloc_func_t alloc_func);
+    
+    
+    /**
+     * Like liz_actor_clip_create but aligns the clip and each of its streams
+     * to the bigger one of stream_alignment and LIZ_ACTOR_CLIP_ALIGNMENT, 
+     * e.g., 32 or 64 bytes for SIMD kernels running over the streams. 
+     * stream_alignment must be a power of two. Destroy the clip with the 
+     * dealloc function matching aligned_alloc_func.
+     */
+    liz_actor_clip_t*
+    liz_actor_clip_create_aligned(liz_shape_specification_t spec,
+                                  liz_int_t capacity,
+                                  liz_id_t clip_id,
+                                  liz_id_t shape_id,
+                                  size_t stream_alignment,
+                                  void * LIZ_RESTRICT allocator_context,
+                                  liz_aligned_alloc_func_t aligned_alloc_func);
+    
+    
+    void
+    liz_actor_clip_destroy(liz_actor_clip_t *clip,
+                           void * LIZ_RESTRICT allocator_context,
+                           liz_dealloc_func_t dealloc_func);
+    
+    
+    /**
+     * Appends an actor without decider and action states and returns its
+     * index. All stream slots of the actor are zeroed, set its persistent 
+     * states before updating it for the first time. The actor is scheduled to
+     * be updated every frame.
+     *
+     * The clip must not be full.
+     */
+    liz_int_t
+    liz_actor_clip_add_actor(liz_actor_clip_t *clip,
+                             liz_id_t actor_id,
+                             uint64_t user_data,
+                             liz_random_number_seed_t random_number_seed);
+    
+    
+    /**
+     * Sets the level of detail update rate of the actor at index.
+     *
+     * Returns false and leaves the schedule unchanged if tick_interval isn't a
+     * power of two or if tick_phase isn't less than tick_interval.
+     */
+    bool
+    liz_actor_clip_set_tick_schedule(liz_actor_clip_t *clip,
+                                     liz_int_t index,
+                                     uint16_t tick_interval,
+                                     uint16_t tick_phase);
+    
+    
+    /**
+     * Sets the state of each action state of the clip's actors that matches 
+     * an action state update. Updates for unknown actors or for actions 
+     * without an action state are ignored.
+     *
+     * action_state_updates must be sorted by liz_action_state_update_sort.
+     */
+    void
+    liz_actor_clip_apply_action_state_updates(liz_actor_clip_t *clip,
+                                              liz_action_state_update_t const *action_state_updates,
+                                              liz_int_t action_state_update_count);
+    
+    
+    /**
+     * Removes all actors from the clip.
+     */
+    void
+    liz_actor_clip_clear(liz_actor_clip_t *clip);
+    
+    
+    /**
+     * Returns a vm actor pointing to the stream slots of the actor at index.
+     */
+    liz_vm_actor_t
+    liz_actor_clip_actor(liz_actor_clip_t *clip,
+                         liz_int_t index);
+    
+    
+    /**
+     * Returns the byte count of a stream slot of one actor.
+     */
+    size_t
+    liz_actor_clip_stream_slot_size(liz_shape_specification_t spec,
+                                    liz_actor_clip_stream_t stream);
+    
+    
+    /**
+     * Returns the address of the first byte of stream in clip. The stream 
+     * slots of the first header.count actors are contiguous.
+     */
+    void*
+    liz_actor_clip_stream_data(liz_actor_clip_t const *clip,
+                               liz_actor_clip_stream_t stream);
+    
+    
+    
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+
+#endif /* LIZ_liz_actor_clip_H */
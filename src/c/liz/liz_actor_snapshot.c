@@ -0,0 +1,447 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "liz_actor_snapshot.h"
+
+#include "liz_assert.h"
+#include "liz_platform_functions.h"
+
+
+
+/**
+ * Shortest run of bytes equal to the reference that ends a literal run. 
+ * Shorter matches cost more to encode than storing the bytes as literals.
+ */
+#define LIZ_ACTOR_SNAPSHOT_MIN_MATCH_LENGTH 4u
+
+
+
+/**
+ * Stream slot sizes only depend on these specification fields.
+ */
+static
+bool
+liz_actor_snapshot_stream_layouts_are_equal(liz_shape_specification_t const lhs,
+                                            liz_shape_specification_t const rhs)
+{
+    return (lhs.persistent_state_count == rhs.persistent_state_count)
+        && (lhs.decider_state_capacity == rhs.decider_state_capacity)
+        && (lhs.action_state_capacity == rhs.action_state_capacity);
+}
+
+
+
+static
+size_t
+liz_actor_snapshot_stream_byte_count(liz_shape_specification_t const spec,
+                                     liz_actor_clip_stream_t const stream,
+                                     uint32_t const actor_count)
+{
+    return liz_actor_clip_stream_slot_size(spec, stream) * actor_count;
+}
+
+
+
+/**
+ * Appends value as a little endian base 128 varint if it fits into the 
+ * capacity, returns false otherwise.
+ */
+static
+bool
+liz_actor_snapshot_encode_length(uint8_t *buffer,
+                                 size_t *index,
+                                 size_t const capacity,
+                                 size_t value)
+{
+    do {
+        if (*index >= capacity) {
+            return false;
+        }
+        
+        uint8_t byte = (uint8_t)(value & 0x7Fu);
+        value >>= 7;
+        
+        if (0u != value) {
+            byte |= 0x80u;
+        }
+        
+        buffer[(*index)++] = byte;
+    } while (0u != value);
+    
+    return true;
+}
+
+
+
+static
+bool
+liz_actor_snapshot_decode_length(uint8_t const *buffer,
+                                 size_t *index,
+                                 size_t const byte_count,
+                                 size_t *value)
+{
+    size_t result = 0;
+    
+    for (unsigned int shift = 0; shift < 32u; shift += 7u) {
+        if (*index >= byte_count) {
+            return false;
+        }
+        
+        uint8_t const byte = buffer[(*index)++];
+        result |= (size_t)(byte & 0x7Fu) << shift;
+        
+        if (0u == (byte & 0x80u)) {
+            *value = result;
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+
+
+/**
+ * Delta encodes data against reference into the encoded buffer. Returns the
+ * encoded byte count or zero if the encoding needs capacity bytes or more.
+ */
+static
+size_t
+liz_actor_snapshot_delta_encode(uint8_t const *data,
+                                size_t const data_byte_count,
+                                uint8_t const *reference,
+                                size_t const reference_byte_count,
+                                uint8_t *encoded,
+                                size_t const capacity)
+{
+    size_t const comparable_byte_count = data_byte_count < reference_byte_count ? data_byte_count : reference_byte_count;
+    size_t encoded_index = 0;
+    size_t index = 0;
+    
+    while (index < data_byte_count) {
+        
+        size_t match_end = index;
+        while (match_end < comparable_byte_count && data[match_end] == reference[match_end]) {
+            ++match_end;
+        }
+        
+        // Literals run until a match long enough to pay for its encoding or
+        // until a match reaching the end of the data.
+        size_t literal_end = match_end;
+        while (literal_end < data_byte_count) {
+            
+            size_t run = 0;
+            while (literal_end + run < comparable_byte_count
+                   && run < LIZ_ACTOR_SNAPSHOT_MIN_MATCH_LENGTH
+                   && data[literal_end + run] == reference[literal_end + run]) {
+                ++run;
+            }
+            
+            if (LIZ_ACTOR_SNAPSHOT_MIN_MATCH_LENGTH == run 
+                || (0u != run && data_byte_count == literal_end + run)) {
+                break;
+            }
+            
+            // Swallow the short match and the differing byte following it.
+            literal_end += run + 1u;
+        }
+        
+        size_t const literal_byte_count = literal_end - match_end;
+        
+        if (!liz_actor_snapshot_encode_length(encoded, &encoded_index, capacity, match_end - index)
+            || !liz_actor_snapshot_encode_length(encoded, &encoded_index, capacity, literal_byte_count)
+            || capacity - encoded_index <= literal_byte_count) {
+            
+            return 0;
+        }
+        
+        liz_memcpy(encoded + encoded_index, data + match_end, literal_byte_count);
+        encoded_index += literal_byte_count;
+        
+        index = literal_end;
+    }
+    
+    return encoded_index;
+}
+
+
+
+/**
+ * Decodes a delta encoded stream into data. data and reference might be
+ * identical for in place decoding, otherwise they must not overlap.
+ */
+static
+bool
+liz_actor_snapshot_delta_decode(uint8_t const *encoded,
+                                size_t const encoded_byte_count,
+                                uint8_t const *reference,
+                                size_t const reference_byte_count,
+                                uint8_t *data,
+                                size_t const data_byte_count)
+{
+    size_t encoded_index = 0;
+    size_t index = 0;
+    
+    while (encoded_index < encoded_byte_count) {
+        
+        size_t match_byte_count = 0;
+        size_t literal_byte_count = 0;
+        
+        if (!liz_actor_snapshot_decode_length(encoded, &encoded_index, encoded_byte_count, &match_byte_count)
+            || !liz_actor_snapshot_decode_length(encoded, &encoded_index, encoded_byte_count, &literal_byte_count)) {
+            
+            return false;
+        }
+        
+        if (match_byte_count > reference_byte_count - (index < reference_byte_count ? index : reference_byte_count)
+            || match_byte_count > data_byte_count - index) {
+            
+            return false;
+        }
+        
+        if (data != reference) {
+            liz_memcpy(data + index, reference + index, match_byte_count);
+        }
+        index += match_byte_count;
+        
+        if (literal_byte_count > data_byte_count - index
+            || literal_byte_count > encoded_byte_count - encoded_index) {
+            
+            return false;
+        }
+        
+        liz_memcpy(data + index, encoded + encoded_index, literal_byte_count);
+        index += literal_byte_count;
+        encoded_index += literal_byte_count;
+    }
+    
+    return index == data_byte_count;
+}
+
+
+
+size_t
+liz_actor_snapshot_scratch_size_requirement(liz_shape_specification_t const spec,
+                                            liz_int_t const capacity)
+{
+    LIZ_ASSERT(0 <= capacity);
+    
+    size_t size = 0;
+    
+    for (liz_int_t i = 0; i < liz_actor_clip_stream_count; ++i) {
+        size_t const stream_size = liz_actor_snapshot_stream_byte_count(spec, 
+                                                                        (liz_actor_clip_stream_t)i,
+                                                                        (uint32_t)capacity);
+        size = stream_size > size ? stream_size : size;
+    }
+    
+    return size;
+}
+
+
+
+bool
+liz_actor_snapshot_write(liz_actor_clip_t const *clip,
+                         liz_actor_clip_t const *reference_clip,
+                         void *scratch,
+                         size_t const scratch_capacity,
+                         liz_snapshot_write_func_t write_func,
+                         void *write_context)
+{
+    LIZ_ASSERT((NULL == reference_clip 
+                || liz_actor_snapshot_stream_layouts_are_equal(clip->spec, reference_clip->spec))
+               && "Reference clip must have the same stream layout as the clip.");
+    LIZ_ASSERT((NULL == reference_clip
+                || liz_actor_snapshot_scratch_size_requirement(clip->spec, (liz_int_t)clip->header.count) <= scratch_capacity)
+               && "Scratch buffer too small for delta compression.");
+    (void)scratch_capacity;
+    
+    liz_actor_snapshot_header_t header;
+    liz_memset(&header, 0, sizeof(header));
+    header.magic = LIZ_ACTOR_SNAPSHOT_MAGIC;
+    header.version = LIZ_ACTOR_SNAPSHOT_VERSION;
+    header.header_size = (uint32_t)sizeof(liz_actor_snapshot_header_t);
+    header.stream_count = (uint32_t)liz_actor_clip_stream_count;
+    header.actor_count = clip->header.count;
+    header.reference_actor_count = (NULL != reference_clip) ? reference_clip->header.count : 0u;
+    header.has_reference = (NULL != reference_clip) ? 1u : 0u;
+    header.clip_header = clip->header;
+    header.spec = clip->spec;
+    
+    if (!write_func(write_context, &header, sizeof(header))) {
+        return false;
+    }
+    
+    for (liz_int_t i = 0; i < liz_actor_clip_stream_count; ++i) {
+        liz_actor_clip_stream_t const stream = (liz_actor_clip_stream_t)i;
+        size_t const byte_count = liz_actor_snapshot_stream_byte_count(clip->spec,
+                                                                       stream,
+                                                                       clip->header.count);
+        uint8_t const *data = (uint8_t const *)liz_actor_clip_stream_data(clip, stream);
+        
+        liz_actor_snapshot_stream_header_t stream_header = {
+            liz_actor_snapshot_encoding_raw,
+            (uint32_t)byte_count
+        };
+        void const *payload = data;
+        
+        if (NULL != reference_clip && 0u != byte_count) {
+            size_t const reference_byte_count = liz_actor_snapshot_stream_byte_count(reference_clip->spec,
+                                                                                     stream,
+                                                                                     reference_clip->header.count);
+            // Capacity of byte_count lets streams fall back to raw storage 
+            // if delta encoding does not shrink them.
+            size_t const encoded_byte_count = liz_actor_snapshot_delta_encode(data,
+                                                                              byte_count,
+                                                                              (uint8_t const *)liz_actor_clip_stream_data(reference_clip, stream),
+                                                                              reference_byte_count,
+                                                                              (uint8_t *)scratch,
+                                                                              byte_count);
+            
+            if (0u != encoded_byte_count) {
+                stream_header.encoding = liz_actor_snapshot_encoding_delta;
+                stream_header.payload_byte_count = (uint32_t)encoded_byte_count;
+                payload = scratch;
+            }
+        }
+        
+        if (!write_func(write_context, &stream_header, sizeof(stream_header))) {
+            return false;
+        }
+        
+        if (0u != stream_header.payload_byte_count
+            && !write_func(write_context, payload, stream_header.payload_byte_count)) {
+            
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+
+
+bool
+liz_actor_snapshot_read_header(liz_actor_snapshot_header_t *header,
+                               liz_snapshot_read_func_t read_func,
+                               void *read_context)
+{
+    if (!read_func(read_context, header, sizeof(*header))) {
+        return false;
+    }
+    
+    return (LIZ_ACTOR_SNAPSHOT_MAGIC == header->magic)
+        && (LIZ_ACTOR_SNAPSHOT_VERSION == header->version)
+        && (sizeof(liz_actor_snapshot_header_t) == header->header_size)
+        && ((uint32_t)liz_actor_clip_stream_count == header->stream_count);
+}
+
+
+
+bool
+liz_actor_snapshot_restore(liz_actor_snapshot_header_t const *header,
+                           liz_actor_clip_t *clip,
+                           liz_actor_clip_t const *reference_clip,
+                           void *scratch,
+                           size_t const scratch_capacity,
+                           liz_snapshot_read_func_t read_func,
+                           void *read_context)
+{
+    if (!liz_actor_snapshot_stream_layouts_are_equal(header->spec, clip->spec)
+        || header->actor_count > clip->header.capacity) {
+        
+        return false;
+    }
+    
+    if (0u != header->has_reference
+        && (NULL == reference_clip
+            || !liz_actor_snapshot_stream_layouts_are_equal(header->spec, reference_clip->spec)
+            || header->reference_actor_count != reference_clip->header.count)) {
+        
+        return false;
+    }
+    
+    for (liz_int_t i = 0; i < liz_actor_clip_stream_count; ++i) {
+        liz_actor_clip_stream_t const stream = (liz_actor_clip_stream_t)i;
+        size_t const byte_count = liz_actor_snapshot_stream_byte_count(clip->spec,
+                                                                       stream,
+                                                                       header->actor_count);
+        uint8_t *data = (uint8_t *)liz_actor_clip_stream_data(clip, stream);
+        
+        liz_actor_snapshot_stream_header_t stream_header;
+        
+        if (!read_func(read_context, &stream_header, sizeof(stream_header))) {
+            return false;
+        }
+        
+        if (liz_actor_snapshot_encoding_raw == stream_header.encoding) {
+            
+            if (byte_count != stream_header.payload_byte_count
+                || (0u != byte_count && !read_func(read_context, data, byte_count))) {
+                
+                return false;
+            }
+            
+        } else if (liz_actor_snapshot_encoding_delta == stream_header.encoding
+                   && 0u != header->has_reference) {
+            
+            if (stream_header.payload_byte_count > scratch_capacity
+                || !read_func(read_context, scratch, stream_header.payload_byte_count)) {
+                
+                return false;
+            }
+            
+            size_t const reference_byte_count = liz_actor_snapshot_stream_byte_count(reference_clip->spec,
+                                                                                     stream,
+                                                                                     reference_clip->header.count);
+            
+            if (!liz_actor_snapshot_delta_decode((uint8_t const *)scratch,
+                                                 stream_header.payload_byte_count,
+                                                 (uint8_t const *)liz_actor_clip_stream_data(reference_clip, stream),
+                                                 reference_byte_count,
+                                                 data,
+                                                 byte_count)) {
+                return false;
+            }
+            
+        } else {
+            return false;
+        }
+    }
+    
+    uint32_t const capacity = clip->header.capacity;
+    clip->header = header->clip_header;
+    clip->header.capacity = capacity;
+    clip->header.count = header->actor_count;
+    
+    return true;
+}
+
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *
+ * Streaming binary snapshots of all actors of an actor clip, e.g., for save 
+ * games, server migration, or rollback.
+ *
+ * A snapshot consists of a snapshot header followed by one record per actor
+ * clip stream. Each record is a stream header followed by the stream payload
+ * which is written with one sequential write and read with one sequential 
+ * read.
+ *
+ * Snapshots can optionally be delta compressed against a reference clip, 
+ * e.g., the clip state of the previous snapshot. Delta payloads encode the 
+ * stream bytes as alternating runs of bytes equal to the reference at the same
+ * offset and literal bytes, similar to an LZ77 encoding that only matches at
+ * the current position of the reference. Streams that would not shrink are 
+ * stored raw.
+ *
+ * Restoring a snapshot writes directly into a preallocated clip and never
+ * allocates memory. To restore a delta snapshot the reference clip must hold
+ * the same data it had while writing. Passing the target clip as the 
+ * reference decodes in place.
+ *
+ * Snapshots use the platform's byte order and type sizes, see the TODO in
+ * liz_common.h.
+ */
+
+#ifndef LIZ_liz_actor_snapshot_H
+#define LIZ_liz_actor_snapshot_H
+
+
+#include <liz/liz_platform_types.h>
+#include <liz/liz_platform_macros.h>
+#include <liz/liz_common.h>
+#include <liz/liz_actor_clip.h>
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+    
+    
+#define LIZ_ACTOR_SNAPSHOT_MAGIC 0x4C5A4153u
+#define LIZ_ACTOR_SNAPSHOT_VERSION 2u
+    
+    
+    
+    /**
+     * Writes byte_count bytes from data to the stream behind context. Returns
+     * false if the bytes could not be written.
+     */
+    typedef bool (*liz_snapshot_write_func_t)(void *context,
+                                              void const *data,
+                                              size_t byte_count);
+    
+    
+    /**
+     * Reads exactly byte_count bytes from the stream behind context into data.
+     * Returns false if not enough bytes could be read.
+     */
+    typedef bool (*liz_snapshot_read_func_t)(void *context,
+                                             void *data,
+                                             size_t byte_count);
+    
+    
+    
+    typedef enum liz_actor_snapshot_encoding {
+        liz_actor_snapshot_encoding_raw = 0,
+        liz_actor_snapshot_encoding_delta
+    } liz_actor_snapshot_encoding_t;
+    
+    
+    
+    /**
+     * reference_actor_count is the actor count of the reference clip of a 
+     * delta compressed snapshot and zero for snapshots written without
+     * a reference.
+     */
+    typedef struct liz_actor_snapshot_header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t header_size;
+        uint32_t stream_count;
+        uint32_t actor_count;
+        uint32_t reference_actor_count;
+        uint32_t has_reference;
+        uint32_t padding;
+        liz_actor_clip_header_t clip_header;
+        liz_shape_specification_t spec;
+    } liz_actor_snapshot_header_t;
+    
+    
+    
+    /**
+     * Precedes the payload of each stream. encoding is a 
+     * liz_actor_snapshot_encoding_t.
+     */
+    typedef struct liz_actor_snapshot_stream_header {
+        uint32_t encoding;
+        uint32_t payload_byte_count;
+    } liz_actor_snapshot_stream_header_t;
+    
+    
+    
+    /**
+     * Returns the byte count of the scratch buffer needed to write or restore
+     * delta compressed snapshots of clips of the given specification and 
+     * capacity.
+     */
+    size_t
+    liz_actor_snapshot_scratch_size_requirement(liz_shape_specification_t spec,
+                                                liz_int_t capacity);
+    
+    
+    /**
+     * Writes a snapshot of all actors in clip via write_func.
+     *
+     * If reference_clip is not NULL the streams are delta compressed against
+     * it, scratch must then provide at least 
+     * liz_actor_snapshot_scratch_size_requirement bytes for the clip. 
+     * reference_clip must have the same shape specification as clip. 
+     * scratch is not used without a reference clip and can be NULL.
+     *
+     * Returns false if write_func failed.
+     */
+    bool
+    liz_actor_snapshot_write(liz_actor_clip_t const *clip,
+                             liz_actor_clip_t const *reference_clip,
+                             void *scratch,
+                             size_t scratch_capacity,
+                             liz_snapshot_write_func_t write_func,
+                             void *write_context);
+    
+    
+    /**
+     * Reads a snapshot header via read_func. Returns false if it could not be
+     * read or if it does not belong to a snapshot of a supported version.
+     */
+    bool
+    liz_actor_snapshot_read_header(liz_actor_snapshot_header_t *header,
+                                   liz_snapshot_read_func_t read_func,
+                                   void *read_context);
+    
+    
+    /**
+     * Reads the stream records following a snapshot header read via 
+     * liz_actor_snapshot_read_header into clip and sets the clip's header.
+     *
+     * clip must have the same shape specification as the snapshot and must
+     * have the capacity to hold all snapshot actors. If the snapshot is delta
+     * compressed the reference clip must be passed and must contain the same 
+     * data as the reference clip passed on writing, scratch must provide at
+     * least liz_actor_snapshot_scratch_size_requirement bytes for the clip. 
+     * The reference clip can be the clip itself.
+     *
+     * Returns false if reading failed, if the clip does not fit the snapshot,
+     * or if the snapshot data is malformed. clip streams might have been 
+     * partially overwritten in that case.
+     */
+    bool
+    liz_actor_snapshot_restore(liz_actor_snapshot_header_t const *header,
+                               liz_actor_clip_t *clip,
+                               liz_actor_clip_t const *reference_clip,
+                               void *scratch,
+                               size_t scratch_capacity,
+                               liz_snapshot_read_func_t read_func,
+                               void *read_context);
+    
+    
+    
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+
+#endif /* LIZ_liz_actor_snapshot_H */
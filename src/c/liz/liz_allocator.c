@@ -29,11 +29,34 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#if defined(__linux__) && !defined(_DEFAULT_SOURCE)
+/* Exposes MAP_ANONYMOUS and MADV_HUGEPAGE in strict C99 builds. */
+#   define _DEFAULT_SOURCE
+#endif
+
 #include "liz_allocator.h"
 
 #include "liz_platform_functions.h"
 #include "liz_assert.h"
 
+#if defined(__linux__)
+#   include <sys/mman.h>
+#endif
+
+
+
+/* Huge page size mappings are rounded up to, if they are at least that big. */
+#define LIZ_HUGE_PAGE_SIZE ((size_t)2u * 1024u * 1024u)
+
+
+
+static
+size_t
+liz_arena_aligned_size(size_t const size)
+{
+    return (size + (LIZ_ARENA_ALIGNMENT - 1u)) & ~(size_t)(LIZ_ARENA_ALIGNMENT - 1u);
+}
+
 
 void*
 liz_default_alloc(void *allocator_context, size_t requested_bytes)
@@ -54,6 +77,56 @@ liz_default_dealloc(void * LIZ_RESTRICT allocator_context, void * LIZ_RESTRICT p
 
 
 
+void*
+liz_default_aligned_alloc(void *allocator_context,
+                          size_t const requested_bytes,
+                          size_t const alignment)
+{
+    (void)allocator_context;
+    
+    LIZ_ASSERT(0u < alignment && "Alignment must be a power of two.");
+    LIZ_ASSERT(0u == (alignment & (alignment - 1u)) && "Alignment must be a power of two.");
+    
+    // Over-allocate to align the returned pointer and to store the pointer
+    // returned by malloc directly in front of it.
+    size_t const size = requested_bytes + alignment + sizeof(void *);
+    
+    if (size < requested_bytes) {
+        return NULL;
+    }
+    
+    char *block = (char *)liz_malloc(size);
+    
+    if (NULL == block) {
+        return NULL;
+    }
+    
+    char *ptr = block + sizeof(void *);
+    ptr += liz_allocation_alignment_offset(ptr, alignment);
+    liz_memcpy(ptr - sizeof(void *), &block, sizeof(void *));
+    
+    return ptr;
+}
+
+
+
+void
+liz_default_aligned_dealloc(void * LIZ_RESTRICT allocator_context,
+                            void * LIZ_RESTRICT ptr)
+{
+    (void)allocator_context;
+    
+    if (NULL == ptr) {
+        return;
+    }
+    
+    void *block = NULL;
+    liz_memcpy(&block, (char *)ptr - sizeof(void *), sizeof(void *));
+    liz_free(block);
+}
+
+
+
 size_t 
 liz_allocation_size_aggregate(size_t const start_alignment, 
                               size_t const previous_size_in_bytes, 
@@ -95,3 +168,305 @@ liz_allocation_alignment_offset(void const *memory,
 
 
 
+#pragma mark Arena allocator
+
+static
+size_t
+liz_arena_start_offset(liz_arena_t const *arena)
+{
+    size_t const offset = liz_allocation_alignment_offset(arena->memory, LIZ_ARENA_ALIGNMENT);
+    
+    return (offset > arena->capacity) ? arena->capacity : offset;
+}
+
+
+
+void
+liz_arena_init(liz_arena_t *arena,
+               void *memory,
+               size_t const capacity)
+{
+    arena->memory = (char *)memory;
+    arena->capacity = capacity;
+    arena->offset = liz_arena_start_offset(arena);
+    arena->high_water_offset = arena->offset;
+}
+
+
+
+void*
+liz_arena_alloc(void *allocator_context,
+                size_t const requested_bytes)
+{
+    liz_arena_t *arena = (liz_arena_t *)allocator_context;
+    size_t const size = liz_arena_aligned_size(requested_bytes);
+    
+    if (size < requested_bytes
+        || arena->capacity - arena->offset < size) {
+        
+        return NULL;
+    }
+    
+    void *ptr = arena->memory + arena->offset;
+    arena->offset += size;
+    
+    if (arena->offset > arena->high_water_offset) {
+        arena->high_water_offset = arena->offset;
+    }
+    
+    return ptr;
+}
+
+
+
+void*
+liz_arena_aligned_alloc(void *allocator_context,
+                        size_t const requested_bytes,
+                        size_t const alignment)
+{
+    liz_arena_t *arena = (liz_arena_t *)allocator_context;
+    size_t const required_alignment = (alignment > LIZ_ARENA_ALIGNMENT) ? alignment : LIZ_ARENA_ALIGNMENT;
+    
+    // Padding is a multiple of LIZ_ARENA_ALIGNMENT as the offset is always
+    // kept aligned to it.
+    size_t const padding = liz_allocation_alignment_offset(arena->memory + arena->offset, required_alignment);
+    
+    if (arena->capacity - arena->offset < padding) {
+        return NULL;
+    }
+    
+    size_t const offset = arena->offset;
+    arena->offset += padding;
+    
+    void *ptr = liz_arena_alloc(arena, requested_bytes);
+    
+    if (NULL == ptr) {
+        arena->offset = offset;
+    }
+    
+    return ptr;
+}
+
+
+
+void
+liz_arena_dealloc(void * LIZ_RESTRICT allocator_context,
+                  void * LIZ_RESTRICT ptr)
+{
+    (void)allocator_context;
+    (void)ptr;
+}
+
+
+
+void
+liz_arena_reset(liz_arena_t *arena)
+{
+    arena->offset = liz_arena_start_offset(arena);
+}
+
+
+
+size_t
+liz_arena_used_size(liz_arena_t const *arena)
+{
+    return arena->offset - liz_arena_start_offset(arena);
+}
+
+
+
+size_t
+liz_arena_high_water_size(liz_arena_t const *arena)
+{
+    return arena->high_water_offset - liz_arena_start_offset(arena);
+}
+
+
+
+#pragma mark Pool allocator
+
+void
+liz_pool_init(liz_pool_t *pool,
+              void *memory,
+              size_t const memory_size,
+              size_t const block_size)
+{
+    size_t const aligned_block_size = liz_arena_aligned_size(block_size < sizeof(void *) ? sizeof(void *) : block_size);
+    size_t const offset = liz_allocation_alignment_offset(memory, LIZ_ARENA_ALIGNMENT);
+    size_t const block_count = (offset < memory_size) ? (memory_size - offset) / aligned_block_size : 0u;
+    
+    pool->freelist = NULL;
+    pool->memory = (char *)memory + offset;
+    pool->block_size = aligned_block_size;
+    pool->block_count = block_count;
+    pool->free_block_count = block_count;
+    
+    // Link the blocks back to front so allocation hands them out in address
+    // order.
+    for (size_t i = block_count; 0u < i; --i) {
+        void **block = (void **)(pool->memory + (i - 1u) * aligned_block_size);
+        *block = pool->freelist;
+        pool->freelist = block;
+    }
+}
+
+
+
+void*
+liz_pool_alloc(void *allocator_context,
+               size_t const requested_bytes)
+{
+    liz_pool_t *pool = (liz_pool_t *)allocator_context;
+    
+    if (NULL == pool->freelist
+        || pool->block_size < requested_bytes) {
+        
+        return NULL;
+    }
+    
+    void **block = (void **)pool->freelist;
+    pool->freelist = *block;
+    --(pool->free_block_count);
+    
+    return block;
+}
+
+
+
+void
+liz_pool_dealloc(void * LIZ_RESTRICT allocator_context,
+                 void * LIZ_RESTRICT ptr)
+{
+    liz_pool_t *pool = (liz_pool_t *)allocator_context;
+    
+    if (NULL == ptr) {
+        return;
+    }
+    
+    LIZ_ASSERT((char *)ptr >= pool->memory 
+               && (char *)ptr < pool->memory + pool->block_count * pool->block_size
+               && "Block doesn't belong to pool.");
+    
+    void **block = (void **)ptr;
+    *block = pool->freelist;
+    pool->freelist = block;
+    ++(pool->free_block_count);
+}
+
+
+
+#pragma mark Thread local arena allocator
+
+static LIZ_THREAD_LOCAL liz_arena_t *liz_thread_arena = NULL;
+
+
+
+liz_arena_t*
+liz_thread_arena_set(liz_arena_t *arena)
+{
+    liz_arena_t *previous_arena = liz_thread_arena;
+    liz_thread_arena = arena;
+    
+    return previous_arena;
+}
+
+
+
+void*
+liz_thread_arena_alloc(void *allocator_context,
+                       size_t const requested_bytes)
+{
+    (void)allocator_context;
+    
+    if (NULL == liz_thread_arena) {
+        return NULL;
+    }
+    
+    return liz_arena_alloc(liz_thread_arena, requested_bytes);
+}
+
+
+
+void
+liz_thread_arena_dealloc(void * LIZ_RESTRICT allocator_context,
+                         void * LIZ_RESTRICT ptr)
+{
+    (void)allocator_context;
+    (void)ptr;
+}
+
+
+
+#pragma mark Huge page allocator
+
+void*
+liz_huge_page_alloc(void *allocator_context,
+                    size_t const requested_bytes)
+{
+    (void)allocator_context;
+    
+    // A header in front of the returned memory stores the block size.
+    size_t size = requested_bytes + LIZ_ARENA_ALIGNMENT;
+    
+    if (size < requested_bytes) {
+        return NULL;
+    }
+    
+#if defined(__linux__)
+    if (LIZ_HUGE_PAGE_SIZE <= size) {
+        size = (size + (LIZ_HUGE_PAGE_SIZE - 1u)) & ~(LIZ_HUGE_PAGE_SIZE - 1u);
+    }
+    
+    char *block = (char *)mmap(NULL, 
+                               size, 
+                               PROT_READ | PROT_WRITE, 
+                               MAP_PRIVATE | MAP_ANONYMOUS, 
+                               -1, 
+                               0);
+    
+    if (MAP_FAILED == block) {
+        return NULL;
+    }
+    
+#   if defined(MADV_HUGEPAGE)
+    if (LIZ_HUGE_PAGE_SIZE <= size) {
+        // Only a hint, the mapping works without huge pages, too.
+        (void)madvise(block, size, MADV_HUGEPAGE);
+    }
+#   endif
+#else
+    char *block = (char *)liz_malloc(size);
+    
+    if (NULL == block) {
+        return NULL;
+    }
+    
+    LIZ_ASSERT(0u == liz_allocation_alignment_offset(block, LIZ_ARENA_ALIGNMENT)
+               && "Platform malloc alignment is less than required.");
+#endif
+    
+    *(size_t *)block = size;
+    
+    return block + LIZ_ARENA_ALIGNMENT;
+}
+
+
+
+void
+liz_huge_page_dealloc(void * LIZ_RESTRICT allocator_context,
+                      void * LIZ_RESTRICT ptr)
+{
+    (void)allocator_context;
+    
+    if (NULL == ptr) {
+        return;
+    }
+    
+    char *block = (char *)ptr - LIZ_ARENA_ALIGNMENT;
+    
+#if defined(__linux__)
+    munmap(block, *(size_t *)block);
+#else
+    liz_free(block);
+#endif
+}
@@ -54,6 +54,23 @@ extern "C" {
     typedef void (*liz_dealloc_func_t)(void * LIZ_RESTRICT context, 
                                        void * LIZ_RESTRICT ptr);
     
+    /**
+     * Allocation callback variant returning memory aligned to alignment, 
+     * which must be a power of two.
+     */
+    typedef void* (*liz_aligned_alloc_func_t)(void *context, 
+                                              size_t requested_bytes,
+                                              size_t alignment);
+    
+    
+    /**
+     * Assumed cache line size in bytes. Data written by different threads
+     * should not share a cache line to prevent false sharing.
+     */
+#if !defined(LIZ_CACHE_LINE_SIZE)
+#   define LIZ_CACHE_LINE_SIZE 64u
+#endif
+    
     
     
     /**
@@ -73,6 +90,25 @@ extern "C" {
                         void * LIZ_RESTRICT ptr);
     
     
+    /**
+     * Ignores allocator_context and returns memory from the platform's malloc
+     * function aligned to alignment. Release it with 
+     * liz_default_aligned_dealloc.
+     */
+    void*
+    liz_default_aligned_alloc(void *allocator_context,
+                              size_t requested_bytes,
+                              size_t alignment);
+    
+    
+    /**
+     * Releases memory from liz_default_aligned_alloc. Accepts NULL.
+     */
+    void
+    liz_default_aligned_dealloc(void * LIZ_RESTRICT allocator_context,
+                                void * LIZ_RESTRICT ptr);
+    
+    
     /**
      * Function to a aggregate multiple allocation requests into a single 
      * request.
@@ -106,6 +142,196 @@ extern "C" {
     
     
     
+#pragma mark Arena allocator
+    
+    /**
+     * Alignment of all arena and pool allocations, enough for any liz type.
+     */
+#define LIZ_ARENA_ALIGNMENT 16u
+    
+    
+    /**
+     * Linear allocator handing out consecutive chunks of a memory block, 
+     * e.g., per frame or per build. Individual deallocation is a no-op, 
+     * reset the arena to reclaim all its memory at once.
+     *
+     * Pass a liz_arena_t as allocator context to liz_arena_alloc and 
+     * liz_arena_dealloc.
+     *
+     * high_water_offset is the biggest offset since initialization, it 
+     * survives resets to size scratch buffers after their worst frame.
+     */
+    typedef struct liz_arena {
+        char *memory;
+        size_t capacity;
+        size_t offset;
+        size_t high_water_offset;
+    } liz_arena_t;
+    
+    
+    /**
+     * Uses capacity bytes at memory, the arena doesn't own the memory.
+     */
+    void
+    liz_arena_init(liz_arena_t *arena,
+                   void *memory,
+                   size_t capacity);
+    
+    
+    /**
+     * Returns LIZ_ARENA_ALIGNMENT aligned memory from the arena 
+     * allocator_context or NULL if the arena is exhausted.
+     */
+    void*
+    liz_arena_alloc(void *allocator_context,
+                    size_t requested_bytes);
+    
+    
+    /**
+     * Returns memory from the arena allocator_context aligned to the bigger
+     * one of alignment and LIZ_ARENA_ALIGNMENT or NULL if the arena is 
+     * exhausted.
+     */
+    void*
+    liz_arena_aligned_alloc(void *allocator_context,
+                            size_t requested_bytes,
+                            size_t alignment);
+    
+    
+    /**
+     * Does nothing, arena memory is only reclaimed by liz_arena_reset.
+     */
+    void
+    liz_arena_dealloc(void * LIZ_RESTRICT allocator_context,
+                      void * LIZ_RESTRICT ptr);
+    
+    
+    /**
+     * Reclaims all allocations of arena at once.
+     */
+    void
+    liz_arena_reset(liz_arena_t *arena);
+    
+    
+    /**
+     * Returns the bytes currently allocated from arena including alignment
+     * padding.
+     */
+    size_t
+    liz_arena_used_size(liz_arena_t const *arena);
+    
+    
+    /**
+     * Returns the most bytes allocated from arena at once since it has been
+     * initialized.
+     */
+    size_t
+    liz_arena_high_water_size(liz_arena_t const *arena);
+    
+    
+    
+#pragma mark Pool allocator
+    
+    /**
+     * Allocator for blocks of a fixed size, e.g., vms or actor clips of the
+     * same shape specification, with O(1) allocation and deallocation via an 
+     * intrusive freelist.
+     *
+     * Pass a liz_pool_t as allocator context to liz_pool_alloc and 
+     * liz_pool_dealloc.
+     */
+    typedef struct liz_pool {
+        void *freelist;
+        char *memory;
+        size_t block_size;
+        size_t block_count;
+        size_t free_block_count;
+    } liz_pool_t;
+    
+    
+    /**
+     * Splits memory_size bytes at memory into blocks of at least block_size
+     * bytes, each LIZ_ARENA_ALIGNMENT aligned. The pool doesn't own the 
+     * memory.
+     */
+    void
+    liz_pool_init(liz_pool_t *pool,
+                  void *memory,
+                  size_t memory_size,
+                  size_t block_size);
+    
+    
+    /**
+     * Returns a block of the pool allocator_context or NULL if the pool is 
+     * exhausted or requested_bytes exceeds the block size.
+     */
+    void*
+    liz_pool_alloc(void *allocator_context,
+                   size_t requested_bytes);
+    
+    
+    /**
+     * Returns the block at ptr to the pool allocator_context. Accepts NULL.
+     */
+    void
+    liz_pool_dealloc(void * LIZ_RESTRICT allocator_context,
+                     void * LIZ_RESTRICT ptr);
+    
+    
+    
+#pragma mark Thread local arena allocator
+    
+    /**
+     * Sets the calling thread's arena used by liz_thread_arena_alloc and 
+     * returns the previous one. Pass NULL to unset it.
+     */
+    liz_arena_t*
+    liz_thread_arena_set(liz_arena_t *arena);
+    
+    
+    /**
+     * Ignores allocator_context and allocates from the calling thread's 
+     * arena, so code running on many workers can share one allocator setup
+     * without contention. Returns NULL if no arena is set for the thread.
+     */
+    void*
+    liz_thread_arena_alloc(void *allocator_context,
+                           size_t requested_bytes);
+    
+    
+    /**
+     * Does nothing, reset the thread's arena to reclaim its memory.
+     */
+    void
+    liz_thread_arena_dealloc(void * LIZ_RESTRICT allocator_context,
+                             void * LIZ_RESTRICT ptr);
+    
+    
+    
+#pragma mark Huge page allocator
+    
+    /**
+     * Ignores allocator_context and maps memory backed by huge pages where 
+     * the platform supports it, otherwise falls back to the platform's 
+     * malloc. Meant for big, long lived blocks, e.g., one per worker to back
+     * an arena or a liz_vm_worker.
+     *
+     * The returned memory is LIZ_ARENA_ALIGNMENT aligned.
+     */
+    void*
+    liz_huge_page_alloc(void *allocator_context,
+                        size_t requested_bytes);
+    
+    
+    /**
+     * Releases memory from liz_huge_page_alloc. Accepts NULL.
+     */
+    void
+    liz_huge_page_dealloc(void * LIZ_RESTRICT allocator_context,
+                          void * LIZ_RESTRICT ptr);
+    
+    
+    
 #if defined(__cplusplus)
 } /* extern "C" */
 #endif
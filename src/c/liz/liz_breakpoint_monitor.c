@@ -0,0 +1,428 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "liz_breakpoint_monitor.h"
+
+#include "liz_assert.h"
+#include "liz_common_internal.h"
+
+
+
+/**
+ * Marks that no action breakpoint waits for its node being left, or that no
+ * decider breakpoint is on the guard stack.
+ */
+#define LIZ_BREAKPOINT_MONITOR_NO_SHAPE_ATOM_INDEX LIZ_VM_MONITOR_FILTER_NO_SHAPE_ATOM_INDEX
+
+/**
+ * Next shape atom index after the last breakpoint has been passed, greater
+ * than all valid shape atom indices.
+ */
+#define LIZ_BREAKPOINT_MONITOR_END_SHAPE_ATOM_INDEX LIZ_VM_MONITOR_FILTER_END_SHAPE_ATOM_INDEX
+
+
+
+static
+void
+liz_breakpoint_monitor_trigger(liz_breakpoint_monitor_t const *monitor,
+                               liz_int_t const breakpoint_index,
+                               liz_uint_t const node_shape_atom_index,
+                               liz_uint_t const traversal_mask,
+                               liz_vm_t const *vm,
+                               void const * LIZ_RESTRICT actor_blackboard,
+                               liz_time_t const time,
+                               liz_vm_actor_t const *actor,
+                               liz_vm_shape_t const *shape)
+{
+    liz_breakpoint_stream_t const *breakpoints = monitor->breakpoints;
+    
+    if (traversal_mask != (traversal_mask & breakpoints->flags[breakpoint_index])) {
+        return;
+    }
+    
+    liz_int_t const function_index = breakpoints->function_indices[breakpoint_index];
+    LIZ_ASSERT(function_index < monitor->function_count);
+    
+    monitor->functions[function_index](monitor->user_data,
+                                       node_shape_atom_index,
+                                       traversal_mask,
+                                       vm,
+                                       actor_blackboard,
+                                       time,
+                                       actor,
+                                       shape);
+}
+
+
+
+static
+void
+liz_breakpoint_monitor_set_guard_shape_atom_index(liz_breakpoint_monitor_t *monitor)
+{
+    if (0 == liz_lookaside_stack_count(&monitor->guard_breakpoint_stack_header)) {
+        monitor->filter.guard_shape_atom_index = LIZ_BREAKPOINT_MONITOR_NO_SHAPE_ATOM_INDEX;
+    } else {
+        liz_int_t const top_index = liz_lookaside_stack_top_index(&monitor->guard_breakpoint_stack_header);
+        liz_int_t const breakpoint_index = monitor->guard_breakpoint_indices[top_index];
+        monitor->filter.guard_shape_atom_index = monitor->breakpoints->shape_atom_indices[breakpoint_index];
+    }
+}
+
+
+
+static
+liz_int_t
+liz_breakpoint_monitor_guard_breakpoint_index(liz_breakpoint_monitor_t const *monitor)
+{
+    liz_int_t const top_index = liz_lookaside_stack_top_index(&monitor->guard_breakpoint_stack_header);
+    
+    return monitor->guard_breakpoint_indices[top_index];
+}
+
+
+
+/**
+ * Slow path of entering a node from the top, only called when the node's
+ * shape atom index reaches the next breakpoint's shape atom index.
+ */
+static
+void
+liz_breakpoint_monitor_enter_node(liz_breakpoint_monitor_t *monitor,
+                                  liz_uint_t const node_shape_atom_index,
+                                  liz_vm_t const *vm,
+                                  void const * LIZ_RESTRICT actor_blackboard,
+                                  liz_time_t const time,
+                                  liz_vm_actor_t const *actor,
+                                  liz_vm_shape_t const *shape)
+{
+    liz_breakpoint_stream_t const *breakpoints = monitor->breakpoints;
+    
+    bool const found = liz_seek_key(&monitor->breakpoint_index,
+                                    (liz_index_t)node_shape_atom_index,
+                                    breakpoints->shape_atom_indices,
+                                    breakpoints->count);
+    liz_int_t const breakpoint_index = monitor->breakpoint_index;
+    
+    // Nodes are entered in ascending shape atom index order, therefore the
+    // cursor moves past a found breakpoint.
+    if (found) {
+        monitor->breakpoint_index += 1;
+    }
+    
+    if (monitor->breakpoint_index < breakpoints->count) {
+        monitor->filter.next_shape_atom_index = breakpoints->shape_atom_indices[monitor->breakpoint_index];
+    } else {
+        monitor->filter.next_shape_atom_index = LIZ_BREAKPOINT_MONITOR_END_SHAPE_ATOM_INDEX;
+    }
+    
+    if (!found) {
+        return;
+    }
+    
+    liz_breakpoint_monitor_trigger(monitor,
+                                   breakpoint_index,
+                                   node_shape_atom_index,
+                                   liz_vm_monitor_node_flag_enter_from_top,
+                                   vm,
+                                   actor_blackboard,
+                                   time,
+                                   actor,
+                                   shape);
+    
+    liz_uint_t const flags = breakpoints->flags[breakpoint_index];
+    liz_int_t subtree_call_index = 0;
+    liz_shape_atom_t const *atom = liz_vm_shape_atom(shape,
+                                                     &subtree_call_index,
+                                                     (liz_int_t)node_shape_atom_index);
+    
+    if (liz_node_type_action_max_id >= atom->type_mask.type) {
+        
+        if (liz_vm_monitor_node_flag_leave_to_top & flags) {
+            monitor->filter.action_shape_atom_index = (liz_int_t)node_shape_atom_index;
+            monitor->entered_action_breakpoint_index = breakpoint_index;
+        }
+        
+    } else if ((liz_uint_t)(liz_vm_monitor_node_flag_enter_from_bottom
+                            | liz_vm_monitor_node_flag_leave_to_bottom
+                            | liz_vm_monitor_node_flag_leave_to_top) & flags) {
+        
+        LIZ_ASSERT(!liz_lookaside_stack_is_full(&monitor->guard_breakpoint_stack_header)
+                   && "Guard breakpoint capacity must match the vm's decider guard capacity.");
+        
+        if (!liz_lookaside_stack_is_full(&monitor->guard_breakpoint_stack_header)) {
+            liz_lookaside_stack_push(&monitor->guard_breakpoint_stack_header);
+            liz_int_t const top_index = liz_lookaside_stack_top_index(&monitor->guard_breakpoint_stack_header);
+            monitor->guard_breakpoint_indices[top_index] = (liz_index_t)breakpoint_index;
+            monitor->filter.guard_shape_atom_index = (liz_int_t)node_shape_atom_index;
+        }
+    }
+}
+
+
+
+/**
+ * Cancellations and errors can address nodes in any order and are rare, 
+ * therefore seek their breakpoints from the stream's beginning without
+ * disturbing the traversal cursor.
+ */
+static
+void
+liz_breakpoint_monitor_seek_and_trigger(liz_breakpoint_monitor_t const *monitor,
+                                        liz_uint_t const node_shape_atom_index,
+                                        liz_uint_t const traversal_mask,
+                                        liz_vm_t const *vm,
+                                        void const * LIZ_RESTRICT actor_blackboard,
+                                        liz_time_t const time,
+                                        liz_vm_actor_t const *actor,
+                                        liz_vm_shape_t const *shape)
+{
+    liz_breakpoint_stream_t const *breakpoints = monitor->breakpoints;
+    liz_int_t breakpoint_index = 0;
+    
+    if (liz_seek_key(&breakpoint_index,
+                     (liz_index_t)node_shape_atom_index,
+                     breakpoints->shape_atom_indices,
+                     breakpoints->count)) {
+        
+        liz_breakpoint_monitor_trigger(monitor,
+                                       breakpoint_index,
+                                       node_shape_atom_index,
+                                       traversal_mask,
+                                       vm,
+                                       actor_blackboard,
+                                       time,
+                                       actor,
+                                       shape);
+    }
+}
+
+
+
+#pragma mark Breakpoint stream
+
+bool
+liz_breakpoint_stream_is_valid(liz_breakpoint_stream_t const *stream,
+                               liz_int_t const function_count)
+{
+    for (liz_int_t i = 0; i < (liz_int_t)stream->count; ++i) {
+        
+        if (0 < i 
+            && stream->shape_atom_indices[i - 1] >= stream->shape_atom_indices[i]) {
+            return false;
+        }
+        
+        if (stream->function_indices[i] >= function_count) {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+
+
+#pragma mark Create and destroy breakpoint monitor
+
+liz_breakpoint_monitor_t*
+liz_breakpoint_monitor_create(liz_breakpoint_stream_t const *breakpoints,
+                              liz_vm_monitor_func_t const *functions,
+                              liz_int_t const function_count,
+                              liz_int_t const guard_capacity,
+                              uintptr_t const user_data,
+                              void * LIZ_RESTRICT allocator_context,
+                              liz_alloc_func_t alloc_func)
+{
+    if (0 > guard_capacity 
+        || (liz_int_t)LIZ_COUNT_MAX < guard_capacity
+        || (liz_int_t)LIZ_COUNT_MAX < function_count
+        || !liz_breakpoint_stream_is_valid(breakpoints, function_count)) {
+        
+        return NULL;
+    }
+    
+    size_t const monitor_size = sizeof(liz_breakpoint_monitor_t)
+        + sizeof(liz_index_t) * (size_t)guard_capacity;
+    liz_breakpoint_monitor_t *monitor = (liz_breakpoint_monitor_t *)alloc_func(allocator_context, 
+                                                                               monitor_size);
+    
+    if (NULL == monitor) {
+        return NULL;
+    }
+    
+    monitor->user_data = user_data;
+    monitor->functions = functions;
+    monitor->breakpoints = breakpoints;
+    monitor->guard_breakpoint_indices = (liz_index_t *)(monitor + 1);
+    monitor->guard_breakpoint_stack_header = liz_lookaside_stack_make(guard_capacity, 0);
+    monitor->function_count = (uint16_t)function_count;
+    
+    liz_breakpoint_monitor_reset(monitor);
+    
+    return monitor;
+}
+
+
+
+void
+liz_breakpoint_monitor_destroy(liz_breakpoint_monitor_t *monitor,
+                               void * LIZ_RESTRICT allocator_context,
+                               liz_dealloc_func_t dealloc_func)
+{
+    dealloc_func(allocator_context, monitor);
+}
+
+
+
+#pragma mark Monitor
+
+void
+liz_breakpoint_monitor_reset(liz_breakpoint_monitor_t *monitor)
+{
+    monitor->breakpoint_index = 0;
+    
+    if (0 < monitor->breakpoints->count) {
+        monitor->filter.next_shape_atom_index = monitor->breakpoints->shape_atom_indices[0];
+    } else {
+        monitor->filter.next_shape_atom_index = LIZ_BREAKPOINT_MONITOR_END_SHAPE_ATOM_INDEX;
+    }
+    
+    monitor->filter.action_shape_atom_index = LIZ_BREAKPOINT_MONITOR_NO_SHAPE_ATOM_INDEX;
+    monitor->entered_action_breakpoint_index = 0;
+    monitor->filter.guard_shape_atom_index = LIZ_BREAKPOINT_MONITOR_NO_SHAPE_ATOM_INDEX;
+    liz_lookaside_stack_clear(&monitor->guard_breakpoint_stack_header);
+}
+
+
+
+liz_vm_monitor_t
+liz_breakpoint_monitor_vm_monitor(liz_breakpoint_monitor_t *monitor)
+{
+    return (liz_vm_monitor_t){(uintptr_t)monitor, liz_breakpoint_monitor_func, &monitor->filter};
+}
+
+
+
+void
+liz_breakpoint_monitor_func(uintptr_t user_data,
+                            liz_uint_t const node_shape_atom_index,
+                            liz_uint_t const traversal_mask,
+                            liz_vm_t const *vm,
+                            void const * LIZ_RESTRICT actor_blackboard,
+                            liz_time_t const time,
+                            liz_vm_actor_t const *actor,
+                            liz_vm_shape_t const *shape)
+{
+    liz_breakpoint_monitor_t *monitor = (liz_breakpoint_monitor_t *)user_data;
+    liz_int_t const node_index = (liz_int_t)node_shape_atom_index;
+    
+    switch (traversal_mask) {
+        case liz_vm_monitor_node_flag_enter_from_top:
+            // The vm already filters, but the function can be called 
+            // directly, e.g., by forwarding monitors without filter.
+            if (node_index < monitor->filter.next_shape_atom_index) {
+                return;
+            }
+            
+            liz_breakpoint_monitor_enter_node(monitor,
+                                              node_shape_atom_index,
+                                              vm,
+                                              actor_blackboard,
+                                              time,
+                                              actor,
+                                              shape);
+            break;
+            
+        case liz_vm_monitor_node_flag_enter_from_bottom:
+        case liz_vm_monitor_node_flag_leave_to_bottom:
+            // Only deciders are entered from or left to the bottom, and
+            // deciders with guard breakpoints are on the guard stack.
+            if (node_index == monitor->filter.guard_shape_atom_index) {
+                liz_breakpoint_monitor_trigger(monitor,
+                                               liz_breakpoint_monitor_guard_breakpoint_index(monitor),
+                                               node_shape_atom_index,
+                                               traversal_mask,
+                                               vm,
+                                               actor_blackboard,
+                                               time,
+                                               actor,
+                                               shape);
+            }
+            break;
+            
+        case liz_vm_monitor_node_flag_leave_to_top:
+            if (node_index == monitor->filter.action_shape_atom_index) {
+                liz_breakpoint_monitor_trigger(monitor,
+                                               monitor->entered_action_breakpoint_index,
+                                               node_shape_atom_index,
+                                               traversal_mask,
+                                               vm,
+                                               actor_blackboard,
+                                               time,
+                                               actor,
+                                               shape);
+                monitor->filter.action_shape_atom_index = LIZ_BREAKPOINT_MONITOR_NO_SHAPE_ATOM_INDEX;
+                
+            } else if (node_index == monitor->filter.guard_shape_atom_index) {
+                liz_breakpoint_monitor_trigger(monitor,
+                                               liz_breakpoint_monitor_guard_breakpoint_index(monitor),
+                                               node_shape_atom_index,
+                                               traversal_mask,
+                                               vm,
+                                               actor_blackboard,
+                                               time,
+                                               actor,
+                                               shape);
+                liz_lookaside_stack_pop(&monitor->guard_breakpoint_stack_header);
+                liz_breakpoint_monitor_set_guard_shape_atom_index(monitor);
+            }
+            
+            // Leaving the root node ends the update.
+            if (0 == node_index) {
+                liz_breakpoint_monitor_reset(monitor);
+            }
+            break;
+            
+        default:
+            liz_breakpoint_monitor_seek_and_trigger(monitor,
+                                                    node_shape_atom_index,
+                                                    traversal_mask,
+                                                    vm,
+                                                    actor_blackboard,
+                                                    time,
+                                                    actor,
+                                                    shape);
+            
+            if (liz_vm_monitor_node_flag_error & traversal_mask) {
+                liz_breakpoint_monitor_reset(monitor);
+            }
+            break;
+    }
+}
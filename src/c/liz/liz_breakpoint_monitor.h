@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *
+ * Breakpoint monitor built on top of the vm monitor function to call user 
+ * functions only when the vm traverses selected nodes in selected directions.
+ *
+ * Breakpoints are stored per shape in a stream sorted by shape atom index.
+ * During an update the vm enters nodes in ascending shape atom index order,
+ * therefore the monitor keeps a cursor into the stream and caches the shape
+ * atom index of the next breakpoint in its vm monitor filter. The vm compares
+ * nodes inline against the filter and only calls the monitor on a hit, so
+ * targeted monitoring can stay enabled in live builds.
+ *
+ * Breakpoints on decider nodes that also want to monitor guard traversals
+ * (enter from bottom, leave to bottom, or leave to top) are tracked on a 
+ * breakpoint guard stack while the vm traverses the decider's children.
+ * Cancellations and errors are rare and seek the stream from its beginning.
+ *
+ * Typical usage:
+ * 1. Create a breakpoint stream per shape, or per actor to monitor an 
+ *    individual actor specially.
+ * 2. Create a breakpoint monitor per vm - when using multiple vms in parallel
+ *    use user_data to store a vm identifier.
+ * 3. Pass the monitor returned by liz_breakpoint_monitor_vm_monitor to the
+ *    vm update.
+ *
+ * Breakpoint functions are only called if LIZ_VM_MONITOR_ENABLE is defined.
+ */
+
+#ifndef LIZ_liz_breakpoint_monitor_H
+#define LIZ_liz_breakpoint_monitor_H
+
+
+#include <liz/liz_platform_types.h>
+#include <liz/liz_platform_macros.h>
+#include <liz/liz_common.h>
+#include <liz/liz_allocator.h>
+#include <liz/liz_lookaside_stack.h>
+#include <liz/liz_vm.h>
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+    
+    
+    /**
+     * Stream of breakpoints ordered for the shape atom index they monitor, 
+     * with at most one breakpoint per shape atom index.
+     *
+     * flags combine liz_vm_monitor_node_flag_t values. When the vm traverses
+     * a node with a breakpoint and the breakpoint's flags contain all bits of 
+     * the traversal mask, then the breakpoint function indexed by the 
+     * function index is called.
+     *
+     * To monitor cancellation of an action set 
+     * liz_vm_monitor_node_flag_cancel_action together with the directions to
+     * monitor during cancellation.
+     */
+    typedef struct liz_breakpoint_stream {
+        liz_index_t const *shape_atom_indices;
+        uint16_t const *function_indices;
+        uint8_t const *flags;
+        
+        liz_index_t count;
+    } liz_breakpoint_stream_t;
+    
+    
+    
+    /**
+     * user_data is passed to the breakpoint functions when called.
+     *
+     * Treat as opaque, only access via the liz_breakpoint_monitor functions.
+     */
+    typedef struct liz_breakpoint_monitor {
+        uintptr_t user_data;
+        liz_vm_monitor_func_t const *functions;
+        liz_breakpoint_stream_t const *breakpoints;
+        liz_index_t *guard_breakpoint_indices;
+        
+        liz_vm_monitor_filter_t filter;
+        liz_int_t breakpoint_index;
+        liz_int_t entered_action_breakpoint_index;
+        
+        liz_lookaside_stack_t guard_breakpoint_stack_header;
+        uint16_t function_count;
+    } liz_breakpoint_monitor_t;
+    
+    
+    
+    /**
+     * Returns true if the stream's shape atom indices are strictly ascending
+     * and all function indices are less than function_count.
+     */
+    bool
+    liz_breakpoint_stream_is_valid(liz_breakpoint_stream_t const *stream,
+                                   liz_int_t function_count);
+    
+    
+    /**
+     * Creates a breakpoint monitor for vms with a decider guard capacity of
+     * at most guard_capacity. breakpoints and functions are referenced, not
+     * copied, and must stay valid during the lifetime of the monitor.
+     *
+     * Returns NULL if memory can't be allocated or if breakpoints aren't valid.
+     */
+    liz_breakpoint_monitor_t*
+    liz_breakpoint_monitor_create(liz_breakpoint_stream_t const *breakpoints,
+                                  liz_vm_monitor_func_t const *functions,
+                                  liz_int_t function_count,
+                                  liz_int_t guard_capacity,
+                                  uintptr_t user_data,
+                                  void * LIZ_RESTRICT allocator_context,
+                                  liz_alloc_func_t alloc_func);
+    
+    
+    void
+    liz_breakpoint_monitor_destroy(liz_breakpoint_monitor_t *monitor,
+                                   void * LIZ_RESTRICT allocator_context,
+                                   liz_dealloc_func_t dealloc_func);
+    
+    
+    /**
+     * Rewinds the monitor to the beginning of its breakpoint stream.
+     *
+     * The monitor rewinds itself when the vm leaves the root node of a shape
+     * or signals an error, call this only when reusing a monitor after an 
+     * update was abandoned.
+     */
+    void
+    liz_breakpoint_monitor_reset(liz_breakpoint_monitor_t *monitor);
+    
+    
+    /**
+     * Returns a vm monitor that dispatches to monitor's breakpoints, filtered
+     * by monitor's filter.
+     */
+    liz_vm_monitor_t
+    liz_breakpoint_monitor_vm_monitor(liz_breakpoint_monitor_t *monitor);
+    
+    
+    /**
+     * Vm monitor function of the breakpoint monitor, user_data must point to
+     * a liz_breakpoint_monitor_t.
+     */
+    void
+    liz_breakpoint_monitor_func(uintptr_t user_data,
+                                liz_uint_t const node_shape_atom_index,
+                                liz_uint_t const traversal_mask,
+                                liz_vm_t const *vm,
+                                void const * LIZ_RESTRICT actor_blackboard,
+                                liz_time_t const time,
+                                liz_vm_actor_t const *actor,
+                                liz_vm_shape_t const *shape);
+    
+    
+    
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+
+#endif /* LIZ_liz_breakpoint_monitor_H */
@@ -32,12 +32,30 @@
 #include "liz_common.h"
 #include "liz_common_internal.h"
 
-
 #include "liz_platform_functions.h"
 #include "liz_assert.h"
 #include "liz_lookaside_stack.h"
 
+#if defined(LIZ_SIMD_SSE2_ENABLE)
+#   include <emmintrin.h>
+#endif
+
+
 
+/* Number of keys liz_lower_bound_key compares per block. */
+#define LIZ_LOWER_BOUND_KEY_BLOCK_SIZE (16u / sizeof(liz_index_t))
+
+
+
+/* Zeroes atom so bytes not covered by its fields, e.g., of wide atoms, don't
+ * leak memory contents into byte-wise stored or compared shapes.
+ */
+static
+void
+liz_shape_atom_clear(liz_shape_atom_t *atom)
+{
+    liz_memset(atom, 0, sizeof(*atom));
+}
 
 
 
@@ -52,6 +70,7 @@ liz_shape_atom_stream_add_immediate_action(liz_shape_atom_t *atoms,
     
     liz_int_t i = *index;
     
+    liz_shape_atom_clear(&atoms[i]);
     atoms[i].immediate_action.type = (uint8_t)liz_node_type_immediate_action;
     atoms[i].immediate_action.padding = 0u;
     atoms[i].immediate_action.function_index = immediate_action_function_index;
@@ -77,12 +96,14 @@ liz_shape_atom_stream_add_deferred_action(liz_shape_atom_t *atoms,
     
     liz_int_t i = *index;
     
+    liz_shape_atom_clear(&atoms[i]);
     atoms[i].deferred_action_first.type = (uint8_t)liz_node_type_deferred_action;
     atoms[i].deferred_action_first.padding = 0u;
     atoms[i].deferred_action_first.resource_id = resource_id;
     
     ++i;
     
+    liz_shape_atom_clear(&atoms[i]);
     atoms[i].deferred_action_second.action_id = action_id;
     
     ++i;
@@ -104,6 +125,7 @@ liz_shape_atom_stream_add_persistent_action(liz_shape_atom_t *atoms,
     
     liz_int_t i = *index;
     
+    liz_shape_atom_clear(&atoms[i]);
     atoms[i].persistent_action.type = liz_node_type_persistent_action;
     atoms[i].persistent_action.padding[0] = 0u;
     atoms[i].persistent_action.padding[1] = 0u;
@@ -122,15 +144,18 @@ void
 liz_shape_atom_stream_add_sequence_decider(liz_shape_atom_t *atoms,
                                            liz_int_t *index,
                                            liz_int_t capacity,
-                                           uint16_t end_offset)
+                                           liz_index_t end_offset)
 {
     LIZ_ASSERT(LIZ_COUNT_MAX >= capacity);
     LIZ_ASSERT(*index + LIZ_NODE_SHAPE_ATOM_COUNT_SEQUENCE_DECIDER + 0 * LIZ_NODE_SHAPE_ATOM_COUNT_SEQUENCE_DECIDER_TWO_CHILDREN <= capacity);
-    LIZ_ASSERT(*index + end_offset <= capacity);
+    // End offsets are shape atom indices of the expanded shape, they can 
+    // reach beyond the stream capacity if the decider contains subtree calls.
+    LIZ_ASSERT(*index + end_offset <= LIZ_COUNT_MAX);
     LIZ_ASSERT(1u < end_offset);
     
     liz_int_t i = *index;
     
+    liz_shape_atom_clear(&atoms[i]);
     atoms[i].sequence_decider.type = liz_node_type_sequence_decider;
     atoms[i].sequence_decider.padding = 0u;
     atoms[i].sequence_decider.end_offset = end_offset;
@@ -148,15 +173,18 @@ void
 liz_shape_atom_stream_add_dynamic_priority_decider(liz_shape_atom_t *atoms,
                                                    liz_int_t *index,
                                                    liz_int_t capacity,
-                                                   uint16_t end_offset)
+                                                   liz_index_t end_offset)
 {
     LIZ_ASSERT(LIZ_COUNT_MAX >= capacity);
     LIZ_ASSERT(*index + LIZ_NODE_SHAPE_ATOM_COUNT_DYNAMIC_PRIORITY_DECIDER + 0 * LIZ_NODE_SHAPE_ATOM_COUNT_DYNAMIC_PRIORITY_DECIDER_TWO_CHILDREN <= capacity);
-    LIZ_ASSERT(*index + end_offset <= capacity);
+    // End offsets are shape atom indices of the expanded shape, they can 
+    // reach beyond the stream capacity if the decider contains subtree calls.
+    LIZ_ASSERT(*index + end_offset <= LIZ_COUNT_MAX);
     LIZ_ASSERT(1u < end_offset);
     
     liz_int_t i = *index;
     
+    liz_shape_atom_clear(&atoms[i]);
     atoms[i].dynamic_priority_decider.type = liz_node_type_dynamic_priority_decider;
     atoms[i].dynamic_priority_decider.padding = 0u;
     atoms[i].dynamic_priority_decider.end_offset = end_offset;
@@ -174,15 +202,18 @@ void
 liz_shape_atom_stream_add_concurrent_decider(liz_shape_atom_t *atoms,
                                              liz_int_t *index,
                                              liz_int_t capacity,
-                                             uint16_t end_offset)
+                                             liz_index_t end_offset)
 {
     LIZ_ASSERT(LIZ_COUNT_MAX >= capacity);
     LIZ_ASSERT(*index + LIZ_NODE_SHAPE_ATOM_COUNT_CONCURRENT_DECIDER + 0 * LIZ_NODE_SHAPE_ATOM_COUNT_CONCURRENT_DECIDER_TWO_CHILDREN <= capacity);
-    LIZ_ASSERT(*index + end_offset <= capacity);
+    // End offsets are shape atom indices of the expanded shape, they can 
+    // reach beyond the stream capacity if the decider contains subtree calls.
+    LIZ_ASSERT(*index + end_offset <= LIZ_COUNT_MAX);
     LIZ_ASSERT(1u < end_offset);
     
     liz_int_t i = *index;
     
+    liz_shape_atom_clear(&atoms[i]);
     atoms[i].concurrent_decider.type = liz_node_type_concurrent_decider;
     atoms[i].concurrent_decider.padding = 0u;
     atoms[i].concurrent_decider.end_offset = end_offset;
@@ -196,20 +227,130 @@ liz_shape_atom_stream_add_concurrent_decider(liz_shape_atom_t *atoms,
 
 
 
+void
+liz_shape_atom_stream_add_subtree_call(liz_shape_atom_t *atoms,
+                                       liz_int_t *index,
+                                       liz_int_t capacity,
+                                       liz_index_t subtree_stream_index,
+                                       liz_index_t subtree_atom_count)
+{
+    LIZ_ASSERT(LIZ_COUNT_MAX >= capacity);
+    LIZ_ASSERT(*index + LIZ_NODE_SHAPE_ATOM_COUNT_SUBTREE_CALL + 0 * LIZ_NODE_SHAPE_ATOM_COUNT_SUBTREE_CALL_TWO_CHILDREN <= capacity);
+    LIZ_ASSERT(0u < subtree_atom_count);
+    
+    liz_int_t i = *index;
+    
+    liz_shape_atom_clear(&atoms[i]);
+    atoms[i].subtree_call_first.type = (uint8_t)liz_node_type_subtree_call;
+    atoms[i].subtree_call_first.padding = 0u;
+    atoms[i].subtree_call_first.end_offset = subtree_atom_count;
+    
+    ++i;
+    
+    liz_shape_atom_clear(&atoms[i]);
+    atoms[i].subtree_call_second.subtree_stream_index = subtree_stream_index;
+    atoms[i].subtree_call_second.padding = 0u;
+    
+    ++i;
+    
+    LIZ_ASSERT(i == *index + LIZ_NODE_SHAPE_ATOM_COUNT_SUBTREE_CALL + 0 * LIZ_NODE_SHAPE_ATOM_COUNT_SUBTREE_CALL_TWO_CHILDREN);
+    
+    *index = i;
+}
+
+
+
+liz_int_t
+liz_shape_atom_stream_collect_subtree_calls(liz_shape_subtree_call_t *calls,
+                                            liz_int_t call_capacity,
+                                            liz_int_t *shape_atom_index_count,
+                                            liz_shape_atom_t const *atoms,
+                                            liz_int_t main_tree_atom_count)
+{
+    liz_int_t call_count = 0;
+    liz_int_t shape_atom_index = 0;
+    liz_int_t stream_index = 0;
+    
+    // Pre-order flattening places all atoms of a node next to each other, 
+    // alas the main tree can be walked node by node without descending.
+    while (stream_index < main_tree_atom_count) {
+        
+        switch (atoms[stream_index].type_mask.type) {
+            case liz_node_type_immediate_action:
+                stream_index += LIZ_NODE_SHAPE_ATOM_COUNT_IMMEDIATE_ACTION;
+                shape_atom_index += LIZ_NODE_SHAPE_ATOM_COUNT_IMMEDIATE_ACTION;
+                break;
+                
+            case liz_node_type_deferred_action:
+                stream_index += LIZ_NODE_SHAPE_ATOM_COUNT_DEFERRED_ACTION;
+                shape_atom_index += LIZ_NODE_SHAPE_ATOM_COUNT_DEFERRED_ACTION;
+                break;
+                
+            case liz_node_type_persistent_action:
+                stream_index += LIZ_NODE_SHAPE_ATOM_COUNT_PERSISTENT_ACTION;
+                shape_atom_index += LIZ_NODE_SHAPE_ATOM_COUNT_PERSISTENT_ACTION;
+                break;
+                
+            case liz_node_type_sequence_decider: // Fall through.
+            case liz_node_type_dynamic_priority_decider: // Fall through.
+            case liz_node_type_concurrent_decider:
+                LIZ_ASSERT(LIZ_NODE_SHAPE_ATOM_COUNT_SEQUENCE_DECIDER == LIZ_NODE_SHAPE_ATOM_COUNT_DYNAMIC_PRIORITY_DECIDER
+                           && LIZ_NODE_SHAPE_ATOM_COUNT_SEQUENCE_DECIDER == LIZ_NODE_SHAPE_ATOM_COUNT_CONCURRENT_DECIDER);
+                stream_index += LIZ_NODE_SHAPE_ATOM_COUNT_SEQUENCE_DECIDER;
+                shape_atom_index += LIZ_NODE_SHAPE_ATOM_COUNT_SEQUENCE_DECIDER;
+                break;
+                
+            case liz_node_type_subtree_call:
+            {
+                LIZ_ASSERT(call_count < call_capacity);
+                (void)call_capacity;
+                
+                liz_int_t const subtree_atom_count = atoms[stream_index].subtree_call_first.end_offset;
+                
+                calls[call_count] = (liz_shape_subtree_call_t){
+                    (liz_index_t)shape_atom_index,
+                    (liz_index_t)(shape_atom_index + subtree_atom_count),
+                    atoms[stream_index + 1].subtree_call_second.subtree_stream_index,
+                    (liz_index_t)(stream_index + LIZ_NODE_SHAPE_ATOM_COUNT_SUBTREE_CALL)
+                };
+                ++call_count;
+                
+                stream_index += LIZ_NODE_SHAPE_ATOM_COUNT_SUBTREE_CALL;
+                shape_atom_index += subtree_atom_count;
+                break;
+            }
+                
+            default:
+                LIZ_ASSERT(0 && "Unhandled node type.");
+                stream_index = main_tree_atom_count;
+                break;
+        }
+    }
+    
+    LIZ_ASSERT(LIZ_COUNT_MAX >= shape_atom_index);
+    *shape_atom_index_count = shape_atom_index;
+    
+    return call_count;
+}
+
+
+
 liz_shape_specification_t
 liz_shape_specification_merge_max(liz_shape_specification_t lhs,
                                   liz_shape_specification_t rhs)
 {
     liz_shape_specification_t result;
     
-    result.shape_atom_count = (uint16_t)liz_max(lhs.shape_atom_count, rhs.shape_atom_count);
-    result.immediate_action_function_count = (uint16_t)liz_max(lhs.immediate_action_function_count, rhs.immediate_action_function_count);
-    result.persistent_state_count = (uint16_t)liz_max(lhs.persistent_state_count, rhs.persistent_state_count);
-    result.decider_state_capacity = (uint16_t)liz_max(lhs.decider_state_capacity, rhs.decider_state_capacity);
-    result.action_state_capacity = (uint16_t)liz_max(lhs.action_state_capacity, rhs.action_state_capacity);
-    result.persistent_state_change_capacity = (uint16_t)liz_max(lhs.persistent_state_change_capacity, rhs.persistent_state_change_capacity);
-    result.decider_guard_capacity = (uint16_t)liz_max(lhs.decider_guard_capacity, rhs.decider_guard_capacity);
-    result.action_request_capacity = (uint16_t)liz_max(lhs.action_request_capacity, rhs.action_request_capacity);
+    result.shape_atom_count = (liz_index_t)liz_max(lhs.shape_atom_count, rhs.shape_atom_count);
+    result.immediate_action_function_count = (liz_index_t)liz_max(lhs.immediate_action_function_count, rhs.immediate_action_function_count);
+    result.persistent_state_count = (liz_index_t)liz_max(lhs.persistent_state_count, rhs.persistent_state_count);
+    result.decider_state_capacity = (liz_index_t)liz_max(lhs.decider_state_capacity, rhs.decider_state_capacity);
+    result.action_state_capacity = (liz_index_t)liz_max(lhs.action_state_capacity, rhs.action_state_capacity);
+    result.persistent_state_change_capacity = (liz_index_t)liz_max(lhs.persistent_state_change_capacity, rhs.persistent_state_change_capacity);
+    result.decider_guard_capacity = (liz_index_t)liz_max(lhs.decider_guard_capacity, rhs.decider_guard_capacity);
+    result.action_request_capacity = (liz_index_t)liz_max(lhs.action_request_capacity, rhs.action_request_capacity);
+    result.subtree_call_count = (liz_index_t)liz_max(lhs.subtree_call_count, rhs.subtree_call_count);
+    result.shape_atom_index_count = (liz_index_t)liz_max(lhs.shape_atom_index_count, rhs.shape_atom_index_count);
     
     return result;
 }
@@ -218,10 +359,10 @@ liz_shape_specification_merge_max(liz_shape_specification_t lhs,
 
 void
 liz_apply_persistent_state_changes(liz_persistent_state_t * LIZ_RESTRICT persistent_states,
-                                   uint16_t const *  LIZ_RESTRICT  persistent_state_shape_atom_indices,
+                                   liz_index_t const *  LIZ_RESTRICT  persistent_state_shape_atom_indices,
                                    liz_int_t persistent_state_count,
                                    liz_persistent_state_t const * LIZ_RESTRICT persistent_state_changes,
-                                   uint16_t const * LIZ_RESTRICT persistent_state_change_shape_atom_indices,
+                                   liz_index_t const * LIZ_RESTRICT persistent_state_change_shape_atom_indices,
                                    liz_int_t persistent_state_change_count)
 {
     liz_int_t apply_index = 0;
@@ -403,9 +544,9 @@ liz_sort_values_for_keys_from_post_order_traversal(void * LIZ_RESTRICT values,
 
 bool
 liz_seek_key(liz_int_t *cursor,
-             uint16_t const key_to_find,
-             uint16_t const *keys,
-             uint16_t const key_count)
+             liz_index_t const key_to_find,
+             liz_index_t const *keys,
+             liz_index_t const key_count)
 {
     for (liz_int_t i = *cursor; i < key_count; ++i) {
         
@@ -426,3 +567,105 @@ liz_seek_key(liz_int_t *cursor,
 }
 
 
+
+#if defined(LIZ_SIMD_SSE2_ENABLE)
+
+/* SSE2 only offers signed compares, flipping the sign bit of both sides 
+ * keeps the order of unsigned keys.
+ */
+static
+bool
+liz_is_key_block_less(liz_index_t const key_to_find,
+                      liz_index_t const *keys)
+{
+    __m128i const block = _mm_loadu_si128((__m128i const *)keys);
+#   if defined(LIZ_WIDE_INDEX_ENABLE)
+    __m128i const sign = _mm_set1_epi32((int)0x80000000u);
+    __m128i const key = _mm_set1_epi32((int)(key_to_find ^ 0x80000000u));
+    __m128i const less = _mm_cmplt_epi32(_mm_xor_si128(block, sign), key);
+#   else
+    __m128i const sign = _mm_set1_epi16((short)0x8000u);
+    __m128i const key = _mm_set1_epi16((short)(key_to_find ^ 0x8000u));
+    __m128i const less = _mm_cmplt_epi16(_mm_xor_si128(block, sign), key);
+#   endif
+    
+    return 0xFFFF == _mm_movemask_epi8(less);
+}
+
+#else
+
+/* Branch-free so compilers can vectorize it. */
+static
+bool
+liz_is_key_block_less(liz_index_t const key_to_find,
+                      liz_index_t const *keys)
+{
+    liz_uint_t less_count = 0;
+    
+    for (liz_uint_t i = 0; i < LIZ_LOWER_BOUND_KEY_BLOCK_SIZE; ++i) {
+        less_count += (liz_uint_t)(keys[i] < key_to_find);
+    }
+    
+    return LIZ_LOWER_BOUND_KEY_BLOCK_SIZE == less_count;
+}
+
+#endif
+
+
+
+liz_int_t
+liz_lower_bound_key(liz_index_t const key_to_find,
+                    liz_index_t const *keys,
+                    liz_int_t const begin_index,
+                    liz_int_t const key_count)
+{
+    LIZ_ASSERT(0 <= begin_index && begin_index <= key_count);
+    
+    liz_int_t i = begin_index;
+    
+    // Skip whole blocks of lesser keys. Keys are sorted, therefore the 
+    // first block that is not entirely less contains the bound.
+    while (i + (liz_int_t)LIZ_LOWER_BOUND_KEY_BLOCK_SIZE <= key_count
+           && liz_is_key_block_less(key_to_find, keys + i)) {
+        i += (liz_int_t)LIZ_LOWER_BOUND_KEY_BLOCK_SIZE;
+    }
+    
+    while (i < key_count && keys[i] < key_to_find) {
+        ++i;
+    }
+    
+    return i;
+}
+
+
+
+static int
+liz_action_state_update_compare(void const *lhs_ptr,
+                                void const *rhs_ptr)
+{
+    liz_action_state_update_t const *lhs = (liz_action_state_update_t const *)lhs_ptr;
+    liz_action_state_update_t const *rhs = (liz_action_state_update_t const *)rhs_ptr;
+    
+    if (lhs->actor_id != rhs->actor_id) {
+        return (lhs->actor_id < rhs->actor_id) ? -1 : 1;
+    }
+    
+    return (lhs->shape_atom_index > rhs->shape_atom_index) 
+        - (lhs->shape_atom_index < rhs->shape_atom_index);
+}
+
+
+
+void
+liz_action_state_update_sort(liz_action_state_update_t *state_changes,
+                             liz_int_t count)
+{
+    LIZ_ASSERT(0 <= count);
+    
+    if (1 < count) {
+        liz_qsort(state_changes,
+                  (size_t)count,
+                  sizeof(liz_action_state_update_t),
+                  liz_action_state_update_compare);
+    }
+}
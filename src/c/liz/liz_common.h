@@ -157,28 +157,56 @@ extern "C" {
                                                                  liz_time_t time_placeholder,
                                                                  liz_execution_state_t execution_request);
     
+    
+    
+    /**
+     * Batched counterpart of liz_immediate_action_func_t to call the same
+     * immediate action for up to 64 actors in one go, e.g., to check 
+     * conditions for many actors with SIMD instructions.
+     *
+     * Only handle the lanes whose bit is set in lane_mask - lane i is handled
+     * like liz_immediate_action_func_t would handle actor_blackboards[i], 
+     * random_number_seeds[i], and execution_states[i], the request on entry
+     * and the returned state on exit. lane_count is the number of entries in 
+     * the arrays, lanes not in lane_mask must be left untouched.
+     *
+     * @attention Lane by lane results must be identical to the unbatched
+     *            function, which still handles cancellations.
+     */
+    typedef void (*liz_immediate_action_batch_func_t)(void * const *actor_blackboards,
+                                                      liz_random_number_seed_t *random_number_seeds,
+                                                      liz_time_t time,
+                                                      liz_execution_state_t *execution_states,
+                                                      uint64_t lane_mask,
+                                                      liz_int_t lane_count);
+    
 
-#define LIZ_COUNT_MAX ((uint16_t)(~((uint16_t)0u)))
+#define LIZ_COUNT_MAX LIZ_INDEX_MAX
     
     /**
      * Item counts and buffer sizes needed to store actor data and process a
      * shape.
      */
     typedef  struct liz_shape_specification {
-        uint16_t shape_atom_count;
-        uint16_t immediate_action_function_count;
+        liz_index_t shape_atom_count;
+        liz_index_t immediate_action_function_count;
         
         // Influnences shape and actor.
-        uint16_t persistent_state_count;
+        liz_index_t persistent_state_count;
         
         // Influences actor and vm.
-        uint16_t decider_state_capacity;
-        uint16_t action_state_capacity;
+        liz_index_t decider_state_capacity;
+        liz_index_t action_state_capacity;
         
         // Influences vm.
-        uint16_t persistent_state_change_capacity;
-        uint16_t decider_guard_capacity;
-        uint16_t action_request_capacity;
+        liz_index_t persistent_state_change_capacity;
+        liz_index_t decider_guard_capacity;
+        liz_index_t action_request_capacity;
+        
+        // Influences shape and vm. Shape atom index count is only read if the
+        // shape contains subtree calls, otherwise it equals shape atom count.
+        liz_index_t subtree_call_count;
+        liz_index_t shape_atom_index_count;
     } liz_shape_specification_t;
     
     
@@ -215,7 +243,7 @@ extern "C" {
         uint32_t action_id;
         uint16_t parameter;
         
-        uint16_t shape_atom_index;
+        liz_index_t shape_atom_index;
         
         uint8_t type;
     } liz_action_request_t;
@@ -246,7 +274,7 @@ extern "C" {
      */
     typedef struct liz_action_state_update {
         liz_id_t actor_id;
-        uint16_t shape_atom_index;
+        liz_index_t shape_atom_index;
         uint8_t state;
     } liz_action_state_update_t;
     
@@ -53,8 +53,8 @@ extern "C" {
 #endif
   
     
-#define LIZ_SHAPE_ATOM_INDEX_ALIGNMENT sizeof(uint16_t)
-#define LIZ_DECIDER_STATE_ALIGNMENT sizeof(uint16_t)
+#define LIZ_SHAPE_ATOM_INDEX_ALIGNMENT sizeof(liz_index_t)
+#define LIZ_DECIDER_STATE_ALIGNMENT sizeof(liz_index_t)
 #define LIZ_ACTION_STATE_ALIGNMENT sizeof(uint8_t)
     
     
@@ -69,7 +69,8 @@ extern "C" {
         liz_node_type_action_max_id = 2,
         liz_node_type_sequence_decider,
         liz_node_type_dynamic_priority_decider,
-        liz_node_type_concurrent_decider
+        liz_node_type_concurrent_decider,
+        liz_node_type_subtree_call
     } liz_node_type_t;
     
     
@@ -86,6 +87,8 @@ extern "C" {
 #define LIZ_NODE_SHAPE_ATOM_COUNT_DYNAMIC_PRIORITY_DECIDER_TWO_CHILDREN 0
 #define LIZ_NODE_SHAPE_ATOM_COUNT_CONCURRENT_DECIDER 1
 #define LIZ_NODE_SHAPE_ATOM_COUNT_CONCURRENT_DECIDER_TWO_CHILDREN 0
+#define LIZ_NODE_SHAPE_ATOM_COUNT_SUBTREE_CALL 2
+#define LIZ_NODE_SHAPE_ATOM_COUNT_SUBTREE_CALL_TWO_CHILDREN 0
 #define LIZ_NODE_SHAPE_ATOM_COUNT_PROBABILITY_DECIDER 2
 #define LIZ_NODE_SHAPE_ATOM_COUNT_PROBABILITY_DECIDER_TWO_CHILDREN 3
     
@@ -106,6 +109,16 @@ extern "C" {
      * hold the number of direct children and the offset to the first child, 
      * then the probability ranges is stored for each child, followed by 
      * atoms that hold the offsets for two children.
+     *
+     * Identical sub-behaviors can be stored once as a shared subtree behind
+     * the main tree in the shape stream and be referenced by subtree call 
+     * nodes. A subtree call occupies as many shape atom indices as the called
+     * subtree has atoms, alas shape atom indices (keys of states, action 
+     * requests, and end offsets of deciders in the main tree) are those of
+     * the expanded shape in which each call is replaced by a copy of its 
+     * subtree. Stream indices, the positions of atoms in the shape stream, 
+     * are only used to look up atoms. Shared subtrees must not contain 
+     * subtree calls.
      */
     typedef union liz_shape_atom {
         uint32_t size_and_alignment_dummy;
@@ -134,43 +147,66 @@ extern "C" {
         struct {
             uint8_t type;
             uint8_t padding;
-            uint16_t end_offset;
+            liz_index_t end_offset;
         } sequence_decider;
         struct {
             uint8_t type;
             uint8_t padding;
-            uint16_t end_offset;
+            liz_index_t end_offset;
         } dynamic_priority_decider;
         struct {
             uint8_t type;
             uint8_t padding;
-            uint16_t end_offset;
+            liz_index_t end_offset;
         } concurrent_decider;
         struct {
             uint8_t type;
             uint8_t padding;
-            uint16_t end_offset;
+            liz_index_t end_offset; // Atom count of the called subtree.
+        } subtree_call_first; // Followed by a subtree_call_second atom.
+        struct {
+            liz_index_t subtree_stream_index;
+            liz_index_t padding;
+        } subtree_call_second;
+        struct {
+            uint8_t type;
+            uint8_t padding;
+            liz_index_t end_offset;
         } probability_decider_header_first; // Followed by probability_decider_header_second
         struct {
-            uint16_t child_count;
-            uint16_t first_child_end_offset;
+            liz_index_t child_count;
+            liz_index_t first_child_end_offset;
         } probability_decider_header_second; // Followed by child_count x probability_decider_child_probability and (child_count / 2) x probability_decider_child_offsets
         struct {
             float probability;
         } probability_decider_child_probability;
         struct {
-            uint16_t end_offset0;
-            uint16_t end_offset1;
+            liz_index_t end_offset0;
+            liz_index_t end_offset1;
         } probability_decider_child_offsets;
         
     } liz_shape_atom_t;
 
     
     
-    typedef struct liz_actor_clip {
-        size_t memory_size;
-        uintptr_t memory;
-    } liz_actor_clip_t;
+    /**
+     * Maps the shape atom indices of a subtree call site to the stream 
+     * indices of the called shared subtree.
+     *
+     * begin_index          - shape atom index of the call site and of the
+     *                        called subtree root in the expanded shape.
+     * end_index            - shape atom index following the call site in the
+     *                        expanded shape.
+     * subtree_stream_index - stream index of the called subtree root.
+     * resume_stream_index  - stream index of the atom following the call 
+     *                        site atoms in the shape stream.
+     */
+    typedef struct liz_shape_subtree_call {
+        liz_index_t begin_index;
+        liz_index_t end_index;
+        liz_index_t subtree_stream_index;
+        liz_index_t resume_stream_index;
+    } liz_shape_subtree_call_t;
     
     
     
@@ -195,11 +231,23 @@ extern "C" {
         uint64_t user_data;
         liz_random_number_seed_t random_number_seed;
         liz_id_t actor_id;
-        uint16_t decider_state_count;
-        uint16_t action_state_count;
+        liz_index_t decider_state_count;
+        liz_index_t action_state_count;
     } liz_actor_header_t;
     
     
+    
+    /**
+     * Level of detail update rate of an actor, the actor is updated every
+     * tick_interval frames in frames whose number modulo tick_interval equals
+     * tick_phase. tick_interval is a power of two.
+     */
+    typedef struct liz_actor_tick_schedule {
+        uint16_t tick_interval;
+        uint16_t tick_phase;
+    } liz_actor_tick_schedule_t;
+    
+    
 
     // Assumed minimal alignment in bytes.
 #define LIZ_PERSISTENT_STATE_ALIGNMENT 2
@@ -262,7 +310,7 @@ extern "C" {
     liz_shape_atom_stream_add_sequence_decider(liz_shape_atom_t *atoms,
                                                liz_int_t *index,
                                                liz_int_t capacity,
-                                               uint16_t end_offset);
+                                               liz_index_t end_offset);
     
     
     
@@ -270,7 +318,7 @@ extern "C" {
     liz_shape_atom_stream_add_dynamic_priority_decider(liz_shape_atom_t *atoms,
                                                        liz_int_t *index,
                                                        liz_int_t capacity,
-                                                       uint16_t end_offset);
+                                                       liz_index_t end_offset);
     
     
     
@@ -278,7 +326,93 @@ extern "C" {
     liz_shape_atom_stream_add_concurrent_decider(liz_shape_atom_t *atoms,
                                                  liz_int_t *index,
                                                  liz_int_t capacity,
-                                                 uint16_t end_offset);
+                                                 liz_index_t end_offset);
+    
+    
+    
+    /**
+     * Adds a call to the shared subtree starting at subtree_stream_index with
+     * subtree_atom_count atoms.
+     */
+    void
+    liz_shape_atom_stream_add_subtree_call(liz_shape_atom_t *atoms,
+                                           liz_int_t *index,
+                                           liz_int_t capacity,
+                                           liz_index_t subtree_stream_index,
+                                           liz_index_t subtree_atom_count);
+    
+    
+    
+    /**
+     * Walks the main tree stored in the first main_tree_atom_count atoms of 
+     * the shape stream atoms and stores a call record for each subtree call
+     * node in calls, ordered by shape atom index.
+     *
+     * Returns the number of subtree calls and stores the number of shape atom
+     * indices of the expanded shape in shape_atom_index_count.
+     *
+     * calls must be able to store all subtree calls, otherwise behavior is
+     * undefined.
+     */
+    liz_int_t
+    liz_shape_atom_stream_collect_subtree_calls(liz_shape_subtree_call_t *calls,
+                                                liz_int_t call_capacity,
+                                                liz_int_t *shape_atom_index_count,
+                                                liz_shape_atom_t const *atoms,
+                                                liz_int_t main_tree_atom_count);
+    
+    
+    
+    /**
+     * Returns the stream index of the atom addressed by shape_atom_index.
+     *
+     * cursor remembers the last looked up call and speeds up lookups of 
+     * increasing shape atom indices. Initialize it with 0.
+     */
+    LIZ_INLINE static
+    liz_int_t
+    liz_shape_subtree_call_stream_index(liz_int_t *cursor,
+                                        liz_index_t const shape_atom_index,
+                                        liz_shape_subtree_call_t const *calls,
+                                        liz_int_t const call_count)
+    {
+        liz_int_t c = *cursor;
+        
+        while (0 < c && calls[c - 1].begin_index > shape_atom_index) {
+            --c;
+        }
+        
+        while (c < call_count && calls[c].begin_index <= shape_atom_index) {
+            ++c;
+        }
+        
+        *cursor = c;
+        
+        if (0 == c) {
+            return shape_atom_index;
+        }
+        
+        liz_shape_subtree_call_t const call = calls[c - 1];
+        if (shape_atom_index < call.end_index) {
+            return call.subtree_stream_index + (shape_atom_index - call.begin_index);
+        }
+        
+        return call.resume_stream_index + (shape_atom_index - call.end_index);
+    }
+    
+    
+    
+    /**
+     * Returns the number of addressable shape atom indices of the expanded
+     * shape which equals the shape atom count if the shape has no subtree 
+     * calls.
+     */
+    LIZ_INLINE static
+    liz_int_t
+    liz_shape_specification_shape_atom_index_count(liz_shape_specification_t const spec)
+    {
+        return (0 == spec.subtree_call_count) ? spec.shape_atom_count : spec.shape_atom_index_count;
+    }
     
     
     
@@ -290,10 +424,10 @@ extern "C" {
     
     void
     liz_apply_persistent_state_changes(liz_persistent_state_t * LIZ_RESTRICT persistent_states,
-                                       uint16_t const *  LIZ_RESTRICT  persistent_state_shape_atom_indices,
+                                       liz_index_t const *  LIZ_RESTRICT  persistent_state_shape_atom_indices,
                                        liz_int_t persistent_state_count,
                                        liz_persistent_state_t const * LIZ_RESTRICT persistent_state_changes,
-                                       uint16_t const * LIZ_RESTRICT persistent_state_change_shape_atom_indices,
+                                       liz_index_t const * LIZ_RESTRICT persistent_state_change_shape_atom_indices,
                                        liz_int_t persistent_state_change_count);
     
     
@@ -356,9 +490,27 @@ extern "C" {
      */
     bool
     liz_seek_key(liz_int_t *cursor,
-                 uint16_t const key_to_find,
-                 uint16_t const *keys,
-                 uint16_t const key_count);
+                 liz_index_t const key_to_find,
+                 liz_index_t const *keys,
+                 liz_index_t const key_count);
+    
+    
+    /**
+     * Returns the index of the first key in the sorted keys, starting at 
+     * begin_index, that is not less than key_to_find, or key_count if no such 
+     * key exists.
+     *
+     * In contrast to liz_seek_key keys are compared in blocks, via SIMD 
+     * compares if available, which pays off for long distances to skip, e.g., 
+     * to find the lower and upper bound of a cancellation range.
+     *
+     * begin_index must be in [0, key_count], otherwise behavior is undefined.
+     */
+    liz_int_t
+    liz_lower_bound_key(liz_index_t const key_to_find,
+                        liz_index_t const *keys,
+                        liz_int_t const begin_index,
+                        liz_int_t const key_count);
     
     
     
@@ -0,0 +1,382 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Concurrent lookup table implementation.
+ */
+
+#include "liz_concurrent_table.h"
+
+#include "liz_assert.h"
+#include "liz_platform_functions.h"
+
+
+
+#pragma mark Create and destroy table and caches
+
+liz_concurrent_table_t*
+liz_concurrent_table_create(liz_int_t const slot_capacity,
+                            liz_int_t const data_slot_size,
+                            liz_int_t const data_slot_alignment,
+                            void * LIZ_RESTRICT allocator_context,
+                            liz_alloc_func_t alloc_func)
+{
+    if (0 > slot_capacity
+        || LIZ_CONCURRENT_TABLE_CAPACITY_MAX < slot_capacity
+        || 0 >= data_slot_alignment
+        || 0 != (data_slot_alignment & (data_slot_alignment - 1))
+        || 0 > data_slot_size
+        || 0 != data_slot_size % data_slot_alignment) {
+        
+        return NULL;
+    }
+    
+    size_t const table_alignment = sizeof(void *);
+    size_t table_size = sizeof(liz_concurrent_table_t);
+    table_size = liz_allocation_size_aggregate(table_alignment,
+                                               table_size,
+                                               sizeof(uint32_t),
+                                               sizeof(liz_concurrent_table_index_t) * (size_t)slot_capacity);
+    table_size = liz_allocation_size_aggregate(table_alignment,
+                                               table_size,
+                                               sizeof(uint32_t),
+                                               sizeof(uint32_t) * (size_t)slot_capacity);
+    table_size = liz_allocation_size_aggregate(table_alignment,
+                                               table_size,
+                                               sizeof(liz_id_t),
+                                               sizeof(liz_id_t) * (size_t)slot_capacity);
+    table_size = liz_allocation_size_aggregate(table_alignment,
+                                               table_size,
+                                               (size_t)data_slot_alignment,
+                                               (size_t)data_slot_size * (size_t)slot_capacity);
+    
+    liz_concurrent_table_t *table = (liz_concurrent_table_t *)alloc_func(allocator_context, table_size);
+    
+    if (NULL == table) {
+        return NULL;
+    }
+    
+    char *ptr = (char *)(table + 1);
+    ptr += liz_allocation_alignment_offset(ptr, sizeof(uint32_t));
+    table->rooster = (liz_concurrent_table_index_t *)ptr;
+    
+    ptr += sizeof(liz_concurrent_table_index_t) * (size_t)slot_capacity;
+    ptr += liz_allocation_alignment_offset(ptr, sizeof(uint32_t));
+    table->freelist = (uint32_t *)ptr;
+    
+    ptr += sizeof(uint32_t) * (size_t)slot_capacity;
+    ptr += liz_allocation_alignment_offset(ptr, sizeof(liz_id_t));
+    table->data_ids = (liz_id_t *)ptr;
+    
+    ptr += sizeof(liz_id_t) * (size_t)slot_capacity;
+    ptr += liz_allocation_alignment_offset(ptr, (size_t)data_slot_alignment);
+    table->data_slots = ptr;
+    
+    table->count = 0u;
+    table->capacity = (uint32_t)slot_capacity;
+    table->data_slot_size = (uint32_t)data_slot_size;
+    table->freelist_dequeue_index = 0u;
+    table->freelist_count = (uint32_t)slot_capacity;
+    table->padding = 0u;
+    
+    for (uint32_t i = 0; i < table->capacity; ++i) {
+        table->rooster[i] = (liz_concurrent_table_index_t){
+            LIZ_CONCURRENT_TABLE_INVALID_ID,
+            0u,
+            (liz_id_t)i,
+            0u
+        };
+        table->freelist[i] = i;
+    }
+    
+    return table;
+}
+
+
+
+void
+liz_concurrent_table_destroy(liz_concurrent_table_t *table,
+                             void * LIZ_RESTRICT allocator_context,
+                             liz_dealloc_func_t dealloc_func)
+{
+    dealloc_func(allocator_context, table);
+}
+
+
+
+liz_concurrent_table_cache_t*
+liz_concurrent_table_cache_create(liz_int_t const add_id_capacity,
+                                  liz_int_t const remove_id_capacity,
+                                  void * LIZ_RESTRICT allocator_context,
+                                  liz_alloc_func_t alloc_func)
+{
+    if (0 > add_id_capacity
+        || 0 > remove_id_capacity) {
+        
+        return NULL;
+    }
+    
+    size_t const cache_size = sizeof(liz_concurrent_table_cache_t)
+        + sizeof(liz_id_t) * ((size_t)add_id_capacity + (size_t)remove_id_capacity);
+    liz_concurrent_table_cache_t *cache = (liz_concurrent_table_cache_t *)alloc_func(allocator_context, cache_size);
+    
+    if (NULL == cache) {
+        return NULL;
+    }
+    
+    cache->add_ids = (liz_id_t *)(cache + 1);
+    cache->remove_ids = cache->add_ids + add_id_capacity;
+    cache->add_id_count = 0u;
+    cache->add_id_capacity = (uint32_t)add_id_capacity;
+    cache->remove_id_count = 0u;
+    cache->remove_id_capacity = (uint32_t)remove_id_capacity;
+    
+    return cache;
+}
+
+
+
+void
+liz_concurrent_table_cache_destroy(liz_concurrent_table_cache_t *cache,
+                                   void * LIZ_RESTRICT allocator_context,
+                                   liz_dealloc_func_t dealloc_func)
+{
+    dealloc_func(allocator_context, cache);
+}
+
+
+
+#pragma mark Sync point
+
+void
+liz_concurrent_table_sync(liz_concurrent_table_t *table,
+                          liz_concurrent_table_cache_t * const *caches,
+                          liz_int_t const cache_count)
+{
+    liz_concurrent_table_index_t *rooster = table->rooster;
+    liz_id_t *data_ids = table->data_ids;
+    uint32_t const count = liz_atomic_load_acquire_uint32(&table->count);
+    uint32_t removed_count = 0u;
+    
+    // Unpublish removed ids, mark their data slots as holes, and enqueue their
+    // rooster slots with an incremented version.
+    for (liz_int_t c = 0; c < cache_count; ++c) {
+        liz_concurrent_table_cache_t *cache = caches[c];
+        
+        for (uint32_t i = 0; i < cache->remove_id_count; ++i) {
+            liz_id_t const id = cache->remove_ids[i];
+            uint32_t const rooster_index = id & LIZ_CONCURRENT_TABLE_ID_TO_ROOSTER_INDEX_MASK;
+            
+            if (rooster_index >= table->capacity
+                || id != rooster[rooster_index].published_id) {
+                
+                continue;
+            }
+            
+            data_ids[rooster[rooster_index].indirection_index] = LIZ_CONCURRENT_TABLE_INVALID_ID;
+            rooster[rooster_index].published_id = LIZ_CONCURRENT_TABLE_INVALID_ID;
+            rooster[rooster_index].versioned_id += LIZ_CONCURRENT_TABLE_ROOSTER_ID_VERSION_INCREMENT;
+            
+            uint32_t const enqueue_index = (table->freelist_dequeue_index + table->freelist_count) % table->capacity;
+            table->freelist[enqueue_index] = rooster_index;
+            ++(table->freelist_count);
+            ++removed_count;
+        }
+        
+        cache->remove_id_count = 0u;
+    }
+    
+    // Compact in one pass - each hole in front of the new count is filled 
+    // with the last live data slot, holes behind the new count are dropped.
+    uint32_t const compacted_count = count - removed_count;
+    uint32_t defrag_index = count;
+    uint32_t const data_slot_size = table->data_slot_size;
+    
+    for (uint32_t i = 0; i < compacted_count; ++i) {
+        if (LIZ_CONCURRENT_TABLE_INVALID_ID != data_ids[i]) {
+            continue;
+        }
+        
+        do {
+            --defrag_index;
+        } while (LIZ_CONCURRENT_TABLE_INVALID_ID == data_ids[defrag_index]);
+        
+        LIZ_ASSERT(i < defrag_index);
+        
+        liz_id_t const defrag_id = data_ids[defrag_index];
+        data_ids[i] = defrag_id;
+        rooster[defrag_id & LIZ_CONCURRENT_TABLE_ID_TO_ROOSTER_INDEX_MASK].indirection_index = i;
+        
+        liz_memcpy(table->data_slots + (size_t)i * data_slot_size,
+                   table->data_slots + (size_t)defrag_index * data_slot_size,
+                   data_slot_size);
+    }
+    
+    liz_atomic_store_release_uint32(&table->count, compacted_count);
+    
+    // Top up the caches' ids from the freelist.
+    for (liz_int_t c = 0; c < cache_count; ++c) {
+        liz_concurrent_table_cache_t *cache = caches[c];
+        
+        while (cache->add_id_count < cache->add_id_capacity
+               && 0u != table->freelist_count) {
+            
+            uint32_t const rooster_index = table->freelist[table->freelist_dequeue_index];
+            table->freelist_dequeue_index = (table->freelist_dequeue_index + 1u) % table->capacity;
+            --(table->freelist_count);
+            
+            cache->add_ids[cache->add_id_count++] = rooster[rooster_index].versioned_id;
+        }
+    }
+}
+
+
+
+liz_int_t
+liz_concurrent_table_count(liz_concurrent_table_t const *table)
+{
+    return (liz_int_t)liz_atomic_load_acquire_uint32(&table->count);
+}
+
+
+
+liz_int_t
+liz_concurrent_table_capacity(liz_concurrent_table_t const *table)
+{
+    return (liz_int_t)table->capacity;
+}
+
+
+
+void*
+liz_concurrent_table_data(liz_concurrent_table_t *table,
+                          liz_int_t const index)
+{
+    LIZ_ASSERT(index < liz_concurrent_table_count(table));
+    
+    return table->data_slots + (size_t)index * table->data_slot_size;
+}
+
+
+
+liz_id_t
+liz_concurrent_table_data_id(liz_concurrent_table_t const *table,
+                             liz_int_t const index)
+{
+    LIZ_ASSERT(index < liz_concurrent_table_count(table));
+    
+    return table->data_ids[index];
+}
+
+
+
+#pragma mark Concurrent phase
+
+bool
+liz_concurrent_table_cache_can_add(liz_concurrent_table_cache_t const *cache)
+{
+    return 0u != cache->add_id_count;
+}
+
+
+
+bool
+liz_concurrent_table_cache_can_remove(liz_concurrent_table_cache_t const *cache)
+{
+    return cache->remove_id_count < cache->remove_id_capacity;
+}
+
+
+
+liz_id_t
+liz_concurrent_table_add(liz_concurrent_table_t *table,
+                         liz_concurrent_table_cache_t *cache,
+                         void const *data)
+{
+    LIZ_ASSERT(liz_concurrent_table_cache_can_add(cache));
+    
+    liz_id_t const id = cache->add_ids[--(cache->add_id_count)];
+    liz_concurrent_table_index_t *rooster_slot = table->rooster + (id & LIZ_CONCURRENT_TABLE_ID_TO_ROOSTER_INDEX_MASK);
+    
+    // Ids in caches never outnumber the free data slots, so the reserved
+    // slot is always inside the table.
+    uint32_t const data_slot_index = liz_atomic_fetch_add_uint32(&table->count, 1u);
+    LIZ_ASSERT(data_slot_index < table->capacity);
+    
+    table->data_ids[data_slot_index] = id;
+    liz_memcpy(table->data_slots + (size_t)data_slot_index * table->data_slot_size,
+               data,
+               table->data_slot_size);
+    rooster_slot->indirection_index = data_slot_index;
+    
+    liz_atomic_store_release_uint32(&rooster_slot->published_id, id);
+    
+    return id;
+}
+
+
+
+void
+liz_concurrent_table_remove_deferred(liz_concurrent_table_cache_t *cache,
+                                     liz_id_t const id)
+{
+    LIZ_ASSERT(liz_concurrent_table_cache_can_remove(cache));
+    
+    cache->remove_ids[cache->remove_id_count++] = id;
+}
+
+
+
+bool
+liz_concurrent_table_contains(liz_concurrent_table_t const *table,
+                              liz_id_t const id)
+{
+    uint32_t const rooster_index = id & LIZ_CONCURRENT_TABLE_ID_TO_ROOSTER_INDEX_MASK;
+    
+    return rooster_index < table->capacity
+        && id == liz_atomic_load_acquire_uint32(&table->rooster[rooster_index].published_id);
+}
+
+
+
+void*
+liz_concurrent_table_lookup(liz_concurrent_table_t *table,
+                            liz_id_t const id)
+{
+    LIZ_ASSERT(liz_concurrent_table_contains(table, id));
+    
+    liz_concurrent_table_index_t const *rooster_slot = table->rooster + (id & LIZ_CONCURRENT_TABLE_ID_TO_ROOSTER_INDEX_MASK);
+    
+    return table->data_slots + (size_t)rooster_slot->indirection_index * table->data_slot_size;
+}
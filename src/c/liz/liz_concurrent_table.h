@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Concurrent variant of liz_table - maps versioned ids to tightly packed, 
+ * fixed sized data slots while many threads add, remove, and look up data.
+ *
+ * Work alternates between a concurrent phase and a sync point:
+ * - In the concurrent phase any number of threads call liz_concurrent_table_add,
+ *   liz_concurrent_table_remove_deferred, liz_concurrent_table_contains, and
+ *   liz_concurrent_table_lookup. Each adding or removing thread uses its own
+ *   liz_concurrent_table_cache_t.
+ * - At a sync point, e.g., between two job graph stages, exactly one thread 
+ *   calls liz_concurrent_table_sync while no other thread touches the table
+ *   or the caches.
+ *
+ * Adding takes a versioned id from the calling thread's cache, reserves the
+ * next packed data slot with a single atomic increment, copies the data, and 
+ * then publishes the id. Neither a lock nor a retry loop is involved, alas 
+ * adding is wait-free. Lookups compare the published id of the id's rooster 
+ * slot and are lock-free. Removals are only recorded in the cache, the data 
+ * stays in place and stays visible to lookups until the next sync point.
+ *
+ * liz_concurrent_table_sync applies all recorded removals, compacts the data
+ * in a single pass by moving live data from the end into the holes, and 
+ * refills the caches' ids from the FIFO freelist. Afterwards the data is 
+ * tightly packed again and can be iterated via liz_concurrent_table_data.
+ *
+ * Ids handed out to caches but not yet used for adding count against the 
+ * table's capacity.
+ *
+ * See liz_table.h for the single threaded original.
+ */
+
+#ifndef LIZ_liz_concurrent_table_H
+#define LIZ_liz_concurrent_table_H
+
+
+#include <liz/liz_platform_types.h>
+#include <liz/liz_allocator.h>
+#include <liz/liz_common.h>
+
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+    
+    
+    
+#define LIZ_CONCURRENT_TABLE_ID_TO_ROOSTER_INDEX_MASK 0xFFFFu
+#define LIZ_CONCURRENT_TABLE_ROOSTER_ID_VERSION_INCREMENT 0x10000u
+    
+    /* Rooster index 0xFFFF is never used so ids with it mark unpublished 
+     * rooster slots and emptied data slots.
+     */
+#define LIZ_CONCURRENT_TABLE_INVALID_ID 0xFFFFFFFFu
+#define LIZ_CONCURRENT_TABLE_CAPACITY_MAX (UINT16_MAX - 1)
+    
+    
+    
+    /**
+     * Rooster slot - published_id is only accessed atomically and is 
+     * LIZ_CONCURRENT_TABLE_INVALID_ID while no data is associated with the
+     * slot. versioned_id is the id the slot hands out next or has handed out.
+     */
+    typedef struct liz_concurrent_table_index {
+        uint32_t published_id;
+        uint32_t indirection_index;
+        liz_id_t versioned_id;
+        uint32_t padding;
+    } liz_concurrent_table_index_t;
+    
+    
+    
+    /**
+     * Treat as opaque, only access via the liz_concurrent_table functions.
+     */
+    typedef struct liz_concurrent_table {
+        liz_concurrent_table_index_t *rooster;
+        uint32_t *freelist;
+        liz_id_t *data_ids;
+        char *data_slots;
+        
+        /* Reserved data slot count, atomically incremented by adds. */
+        uint32_t count;
+        uint32_t capacity;
+        uint32_t data_slot_size;
+        
+        /* FIFO ring buffer of unused rooster indices to keep version wear off 
+         * minimal.
+         */
+        uint32_t freelist_dequeue_index;
+        uint32_t freelist_count;
+        uint32_t padding;
+    } liz_concurrent_table_t;
+    
+    
+    
+    /**
+     * Per thread stack of ids ready to add and of deferred removal ids. 
+     *
+     * Treat as opaque, only access via the liz_concurrent_table functions.
+     */
+    typedef struct liz_concurrent_table_cache {
+        liz_id_t *add_ids;
+        liz_id_t *remove_ids;
+        uint32_t add_id_count;
+        uint32_t add_id_capacity;
+        uint32_t remove_id_count;
+        uint32_t remove_id_capacity;
+    } liz_concurrent_table_cache_t;
+    
+    
+    
+    /**
+     * Creates a table for slot_capacity data slots of data_slot_size bytes 
+     * each, aligned to data_slot_alignment bytes.
+     *
+     * Returns NULL if slot_capacity exceeds LIZ_CONCURRENT_TABLE_CAPACITY_MAX,
+     * if data_slot_size isn't a multiple of the power of two 
+     * data_slot_alignment, or if memory can't be allocated.
+     */
+    liz_concurrent_table_t*
+    liz_concurrent_table_create(liz_int_t slot_capacity,
+                                liz_int_t data_slot_size,
+                                liz_int_t data_slot_alignment,
+                                void * LIZ_RESTRICT allocator_context,
+                                liz_alloc_func_t alloc_func);
+    
+    
+    void
+    liz_concurrent_table_destroy(liz_concurrent_table_t *table,
+                                 void * LIZ_RESTRICT allocator_context,
+                                 liz_dealloc_func_t dealloc_func);
+    
+    
+    /**
+     * Creates an empty cache for one thread to add up to add_id_capacity and
+     * to remove up to remove_id_capacity data slots between two sync points.
+     *
+     * Returns NULL if memory can't be allocated.
+     */
+    liz_concurrent_table_cache_t*
+    liz_concurrent_table_cache_create(liz_int_t add_id_capacity,
+                                      liz_int_t remove_id_capacity,
+                                      void * LIZ_RESTRICT allocator_context,
+                                      liz_alloc_func_t alloc_func);
+    
+    
+    /**
+     * Ids left in the cache aren't returned to a table. Only destroy caches
+     * after their last sync or together with their table.
+     */
+    void
+    liz_concurrent_table_cache_destroy(liz_concurrent_table_cache_t *cache,
+                                       void * LIZ_RESTRICT allocator_context,
+                                       liz_dealloc_func_t dealloc_func);
+    
+    
+    
+#pragma mark Sync point
+    
+    /**
+     * Applies the deferred removals recorded in caches, compacts the data 
+     * slots, and refills the caches with ids to add, in the order of caches.
+     * 
+     * Removing an id more than once before a sync point removes it once.
+     *
+     * @attention Only call while no other thread accesses table or caches.
+     */
+    void
+    liz_concurrent_table_sync(liz_concurrent_table_t *table,
+                              liz_concurrent_table_cache_t * const *caches,
+                              liz_int_t cache_count);
+    
+    
+    /**
+     * Returns the number of data slots, only exact at sync points.
+     */
+    liz_int_t
+    liz_concurrent_table_count(liz_concurrent_table_t const *table);
+    
+    
+    liz_int_t
+    liz_concurrent_table_capacity(liz_concurrent_table_t const *table);
+    
+    
+    /**
+     * Returns a pointer to the indexed data slot, only valid at sync points.
+     *
+     * index must be less than liz_concurrent_table_count.
+     */
+    void*
+    liz_concurrent_table_data(liz_concurrent_table_t *table,
+                              liz_int_t index);
+    
+    
+    /**
+     * Companion function for liz_concurrent_table_data.
+     */
+    liz_id_t
+    liz_concurrent_table_data_id(liz_concurrent_table_t const *table,
+                                 liz_int_t index);
+    
+    
+    
+#pragma mark Concurrent phase
+    
+    /**
+     * Returns true if cache holds an id for another add.
+     */
+    bool
+    liz_concurrent_table_cache_can_add(liz_concurrent_table_cache_t const *cache);
+    
+    
+    /**
+     * Returns true if cache can record another deferred removal.
+     */
+    bool
+    liz_concurrent_table_cache_can_remove(liz_concurrent_table_cache_t const *cache);
+    
+    
+    /**
+     * Copies data_slot_size bytes from data into a new data slot, publishes
+     * it for lookups, and returns its id.
+     *
+     * @attention Only call if liz_concurrent_table_cache_can_add is true.
+     */
+    liz_id_t
+    liz_concurrent_table_add(liz_concurrent_table_t *table,
+                             liz_concurrent_table_cache_t *cache,
+                             void const *data);
+    
+    
+    /**
+     * Records the removal of id for the next sync point. The data slot stays
+     * valid and contained until then.
+     *
+     * @attention Only call if liz_concurrent_table_cache_can_remove is true.
+     */
+    void
+    liz_concurrent_table_remove_deferred(liz_concurrent_table_cache_t *cache,
+                                         liz_id_t id);
+    
+    
+    /**
+     * Returns true if id is published in table.
+     */
+    bool
+    liz_concurrent_table_contains(liz_concurrent_table_t const *table,
+                                  liz_id_t id);
+    
+    
+    /**
+     * Returns a pointer to the data slot of id. The pointer is valid until 
+     * the next sync point.
+     *
+     * @attention Only call with contained ids.
+     */
+    void*
+    liz_concurrent_table_lookup(liz_concurrent_table_t *table,
+                                liz_id_t id);
+    
+    
+    
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+
+#endif /* LIZ_liz_concurrent_table_H */
@@ -0,0 +1,399 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "liz_delta.h"
+
+#include "liz_assert.h"
+#include "liz_platform_functions.h"
+#include "liz_common_internal.h"
+#include "liz_lookaside_stack.h"
+
+
+
+/**
+ * Sorted shape atom indices and their decider (liz_index_t) or action (uint8_t)
+ * states.
+ */
+typedef struct liz_delta_state_stream {
+    liz_index_t *keys;
+    void *values;
+    size_t value_size;
+    liz_int_t count;
+} liz_delta_state_stream_t;
+
+
+
+static
+liz_index_t
+liz_delta_state_stream_value(liz_delta_state_stream_t const *stream,
+                             liz_int_t const index)
+{
+    if (sizeof(liz_index_t) == stream->value_size) {
+        return ((liz_index_t const *)stream->values)[index];
+    } else {
+        return ((uint8_t const *)stream->values)[index];
+    }
+}
+
+
+
+static
+void
+liz_delta_state_stream_set_value(liz_delta_state_stream_t *stream,
+                                 liz_int_t const index,
+                                 liz_index_t const value)
+{
+    if (sizeof(liz_index_t) == stream->value_size) {
+        ((liz_index_t *)stream->values)[index] = value;
+    } else {
+        ((uint8_t *)stream->values)[index] = (uint8_t)value;
+    }
+}
+
+
+
+static
+void
+liz_delta_push_change(liz_delta_change_t *changes,
+                      liz_int_t *change_count,
+                      liz_int_t const change_capacity,
+                      liz_delta_state_type_t const state_type,
+                      liz_index_t const shape_atom_index,
+                      uint8_t const presence_mask,
+                      liz_index_t const old_state,
+                      liz_index_t const new_state)
+{
+    LIZ_ASSERT(*change_count < change_capacity && "Change capacity too small.");
+    (void)change_capacity;
+    
+    changes[(*change_count)++] = (liz_delta_change_t){
+        shape_atom_index,
+        (uint8_t)state_type,
+        presence_mask,
+        old_state,
+        new_state
+    };
+}
+
+
+
+/**
+ * Merges the sorted old and new streams and records added, removed, and
+ * changed states.
+ */
+static
+void
+liz_delta_record_state_stream(liz_delta_change_t *changes,
+                              liz_int_t *change_count,
+                              liz_int_t const change_capacity,
+                              liz_delta_state_type_t const state_type,
+                              liz_delta_state_stream_t const *old_stream,
+                              liz_delta_state_stream_t const *new_stream)
+{
+    liz_int_t old_index = 0;
+    liz_int_t new_index = 0;
+    
+    while (old_index < old_stream->count || new_index < new_stream->count) {
+        
+        if (new_index == new_stream->count
+            || (old_index < old_stream->count 
+                && old_stream->keys[old_index] < new_stream->keys[new_index])) {
+            
+            liz_delta_push_change(changes, change_count, change_capacity,
+                                  state_type,
+                                  old_stream->keys[old_index],
+                                  liz_delta_presence_old,
+                                  liz_delta_state_stream_value(old_stream, old_index),
+                                  0);
+            ++old_index;
+            
+        } else if (old_index == old_stream->count
+                   || new_stream->keys[new_index] < old_stream->keys[old_index]) {
+            
+            liz_delta_push_change(changes, change_count, change_capacity,
+                                  state_type,
+                                  new_stream->keys[new_index],
+                                  liz_delta_presence_new,
+                                  0,
+                                  liz_delta_state_stream_value(new_stream, new_index));
+            ++new_index;
+            
+        } else {
+            
+            liz_index_t const old_state = liz_delta_state_stream_value(old_stream, old_index);
+            liz_index_t const new_state = liz_delta_state_stream_value(new_stream, new_index);
+            
+            if (old_state != new_state) {
+                liz_delta_push_change(changes, change_count, change_capacity,
+                                      state_type,
+                                      old_stream->keys[old_index],
+                                      liz_delta_presence_old | liz_delta_presence_new,
+                                      old_state,
+                                      new_state);
+            }
+            
+            ++old_index;
+            ++new_index;
+        }
+    }
+}
+
+
+
+/**
+ * Changes, inserts, or removes the state for shape_atom_index to transform
+ * the stream from the from-presence to the to-presence.
+ */
+static
+void
+liz_delta_apply_state_stream_change(liz_delta_state_stream_t *stream,
+                                    liz_int_t const capacity,
+                                    liz_index_t const shape_atom_index,
+                                    bool const from_present,
+                                    bool const to_present,
+                                    liz_index_t const to_state)
+{
+    liz_int_t index = 0;
+    bool const found = liz_seek_key(&index, 
+                                    shape_atom_index, 
+                                    stream->keys, 
+                                    (liz_index_t)stream->count);
+    LIZ_ASSERT(found == from_present && "Actor state does not match the delta.");
+    (void)found;
+    (void)capacity;
+    
+    char *values = (char *)stream->values;
+    size_t const value_size = stream->value_size;
+    
+    if (from_present && to_present) {
+        
+        liz_delta_state_stream_set_value(stream, index, to_state);
+        
+    } else if (from_present) {
+        
+        liz_int_t const move_count = stream->count - index - 1;
+        liz_memmove(stream->keys + index, 
+                    stream->keys + index + 1, 
+                    sizeof(liz_index_t) * (size_t)move_count);
+        liz_memmove(values + value_size * (size_t)index,
+                    values + value_size * (size_t)(index + 1),
+                    value_size * (size_t)move_count);
+        stream->count -= 1;
+        
+    } else if (to_present) {
+        
+        LIZ_ASSERT(stream->count < capacity && "Actor state capacity too small.");
+        
+        liz_int_t const move_count = stream->count - index;
+        liz_memmove(stream->keys + index + 1, 
+                    stream->keys + index, 
+                    sizeof(liz_index_t) * (size_t)move_count);
+        liz_memmove(values + value_size * (size_t)(index + 1),
+                    values + value_size * (size_t)index,
+                    value_size * (size_t)move_count);
+        stream->keys[index] = shape_atom_index;
+        liz_delta_state_stream_set_value(stream, index, to_state);
+        stream->count += 1;
+    }
+}
+
+
+
+liz_int_t
+liz_delta_change_capacity_requirement(liz_shape_specification_t const spec)
+{
+    // Worst case all old decider and action states disappear and as many 
+    // others appear.
+    return 2 * (liz_int_t)spec.decider_state_capacity
+        + 2 * (liz_int_t)spec.action_state_capacity
+        + (liz_int_t)spec.persistent_state_count;
+}
+
+
+
+liz_int_t
+liz_delta_record(liz_delta_t *delta,
+                 liz_delta_change_t *changes,
+                 liz_int_t const change_capacity,
+                 liz_vm_t const *vm,
+                 liz_vm_actor_t const *actor,
+                 liz_vm_shape_t const *shape)
+{
+    LIZ_ASSERT(liz_vm_cmd_done == vm->cmd 
+               && "Vm update must have been cleaned up and done before recording its changes.");
+    
+    liz_int_t change_count = 0;
+    
+    liz_delta_state_stream_t const old_decider_states = {
+        actor->decider_state_shape_atom_indices,
+        actor->decider_states,
+        sizeof(liz_index_t),
+        actor->header->decider_state_count
+    };
+    liz_delta_state_stream_t const new_decider_states = {
+        vm->decider_state_shape_atom_indices,
+        vm->decider_states,
+        sizeof(liz_index_t),
+        liz_lookaside_stack_count(&vm->decider_state_stack_header)
+    };
+    liz_delta_record_state_stream(changes, &change_count, change_capacity,
+                                  liz_delta_state_type_decider,
+                                  &old_decider_states,
+                                  &new_decider_states);
+    
+    liz_delta_state_stream_t const old_action_states = {
+        actor->action_state_shape_atom_indices,
+        actor->action_states,
+        sizeof(uint8_t),
+        actor->header->action_state_count
+    };
+    liz_delta_state_stream_t const new_action_states = {
+        vm->action_state_shape_atom_indices,
+        vm->action_states,
+        sizeof(uint8_t),
+        liz_lookaside_stack_count(&vm->action_state_stack_header)
+    };
+    liz_delta_record_state_stream(changes, &change_count, change_capacity,
+                                  liz_delta_state_type_action,
+                                  &old_action_states,
+                                  &new_action_states);
+    
+    liz_int_t const persistent_state_change_count = liz_lookaside_stack_count(&vm->persistent_state_change_stack_header);
+    liz_int_t persistent_state_index = 0;
+    
+    for (liz_int_t i = 0; i < persistent_state_change_count; ++i) {
+        
+        liz_index_t const shape_atom_index = vm->persistent_state_change_shape_atom_indices[i];
+        bool const found = liz_seek_key(&persistent_state_index,
+                                        shape_atom_index,
+                                        shape->persistent_state_shape_atom_indices,
+                                        shape->spec.persistent_state_count);
+        LIZ_ASSERT(found && "Indexed persistent state must exist.");
+        (void)found;
+        
+        liz_index_t const old_state = actor->persistent_states[persistent_state_index].persistent_action.state;
+        liz_index_t const new_state = vm->persistent_state_changes[i].persistent_action.state;
+        
+        if (old_state != new_state) {
+            liz_delta_push_change(changes, &change_count, change_capacity,
+                                  liz_delta_state_type_persistent,
+                                  shape_atom_index,
+                                  liz_delta_presence_old | liz_delta_presence_new,
+                                  old_state,
+                                  new_state);
+        }
+    }
+    
+    delta->actor_id = actor->header->actor_id;
+    delta->old_random_number_seed = actor->header->random_number_seed;
+    delta->new_random_number_seed = vm->actor_random_number_seed;
+    delta->change_count = (liz_index_t)change_count;
+    delta->padding = 0;
+    
+    return change_count;
+}
+
+
+
+void
+liz_delta_apply(liz_vm_actor_t *actor,
+                liz_vm_shape_t const *shape,
+                liz_delta_t const *delta,
+                liz_delta_change_t const *changes,
+                liz_delta_direction_t const direction)
+{
+    bool const forward = (liz_delta_direction_forward == direction);
+    uint8_t const from_presence = forward ? liz_delta_presence_old : liz_delta_presence_new;
+    uint8_t const to_presence = forward ? liz_delta_presence_new : liz_delta_presence_old;
+    
+    liz_delta_state_stream_t decider_states = {
+        actor->decider_state_shape_atom_indices,
+        actor->decider_states,
+        sizeof(liz_index_t),
+        actor->header->decider_state_count
+    };
+    liz_delta_state_stream_t action_states = {
+        actor->action_state_shape_atom_indices,
+        actor->action_states,
+        sizeof(uint8_t),
+        actor->header->action_state_count
+    };
+    
+    // Persistent state changes are sorted and can share one search cursor.
+    liz_int_t persistent_state_index = 0;
+    
+    for (liz_int_t i = 0; i < delta->change_count; ++i) {
+        
+        liz_delta_change_t const change = changes[i];
+        bool const from_present = (0 != (change.presence_mask & from_presence));
+        bool const to_present = (0 != (change.presence_mask & to_presence));
+        liz_index_t const to_state = forward ? change.new_state : change.old_state;
+        
+        switch ((liz_delta_state_type_t)change.state_type) {
+            case liz_delta_state_type_decider:
+                liz_delta_apply_state_stream_change(&decider_states,
+                                                    shape->spec.decider_state_capacity,
+                                                    change.shape_atom_index,
+                                                    from_present,
+                                                    to_present,
+                                                    to_state);
+                break;
+            case liz_delta_state_type_action:
+                liz_delta_apply_state_stream_change(&action_states,
+                                                    shape->spec.action_state_capacity,
+                                                    change.shape_atom_index,
+                                                    from_present,
+                                                    to_present,
+                                                    to_state);
+                break;
+            case liz_delta_state_type_persistent:
+            {
+                bool const found = liz_seek_key(&persistent_state_index,
+                                                change.shape_atom_index,
+                                                shape->persistent_state_shape_atom_indices,
+                                                shape->spec.persistent_state_count);
+                LIZ_ASSERT(found && "Indexed persistent state must exist.");
+                (void)found;
+                
+                actor->persistent_states[persistent_state_index].persistent_action.state = (uint8_t)to_state;
+                break;
+            }
+            default:
+                LIZ_ASSERT(0 && "Unknown delta state type.");
+                break;
+        }
+    }
+    
+    actor->header->decider_state_count = (liz_index_t)decider_states.count;
+    actor->header->action_state_count = (liz_index_t)action_states.count;
+    actor->header->random_number_seed = forward ? delta->new_random_number_seed : delta->old_random_number_seed;
+}
+
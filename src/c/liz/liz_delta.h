@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *
+ * Compact per-actor change records of decider, action, and persistent states
+ * caused by a vm update, e.g., for rollback, replay, or network replication
+ * without diffing whole actor states.
+ *
+ * Typical usage:
+ * 1. Update an actor with a vm.
+ * 2. Before extracting the actor state from the vm call liz_delta_record to
+ *    collect all state changes the update causes.
+ * 3. Extract the actor state from the vm as usual.
+ * 4. Apply the record to a copy of the actor state with 
+ *    liz_delta_direction_forward to replay the update, or apply it with
+ *    liz_delta_direction_reverse to the updated state to roll it back.
+ *
+ * Changes are ordered by state type and by ascending shape atom index per 
+ * state type. Decider and action states might appear or disappear, the 
+ * presence mask of a change marks if the old and new values exist.
+ */
+
+#ifndef LIZ_liz_delta_H
+#define LIZ_liz_delta_H
+
+
+#include <liz/liz_platform_types.h>
+#include <liz/liz_platform_macros.h>
+#include <liz/liz_common.h>
+#include <liz/liz_vm.h>
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+    
+    
+    typedef enum liz_delta_state_type {
+        liz_delta_state_type_decider = 0,
+        liz_delta_state_type_action,
+        liz_delta_state_type_persistent
+    } liz_delta_state_type_t;
+    
+    
+    
+    typedef enum liz_delta_presence {
+        liz_delta_presence_old = 0x1u,
+        liz_delta_presence_new = 0x2u
+    } liz_delta_presence_t;
+    
+    
+    
+    typedef enum liz_delta_direction {
+        liz_delta_direction_forward = 0,
+        liz_delta_direction_reverse
+    } liz_delta_direction_t;
+    
+    
+    
+    /**
+     * State change of the node at shape_atom_index. state_type is a 
+     * liz_delta_state_type_t and presence_mask combines liz_delta_presence_t
+     * flags. Values of absent states are zero.
+     */
+    typedef struct liz_delta_change {
+        liz_index_t shape_atom_index;
+        uint8_t state_type;
+        uint8_t presence_mask;
+        liz_index_t old_state;
+        liz_index_t new_state;
+    } liz_delta_change_t;
+    
+    
+    
+    /**
+     * Header of the change record of one actor update.
+     */
+    typedef struct liz_delta {
+        liz_id_t actor_id;
+        liz_random_number_seed_t old_random_number_seed;
+        liz_random_number_seed_t new_random_number_seed;
+        liz_index_t change_count;
+        liz_index_t padding;
+    } liz_delta_t;
+    
+    
+    
+    /**
+     * Returns the maximum number of changes a vm update of an actor with 
+     * spec can cause.
+     */
+    liz_int_t
+    liz_delta_change_capacity_requirement(liz_shape_specification_t spec);
+    
+    
+    /**
+     * Collects the differences between the actor states and the states of a
+     * vm that is done updating the actor but before its state is extracted
+     * into the actor.
+     *
+     * changes must have a capacity of at least 
+     * liz_delta_change_capacity_requirement for the shape specification.
+     *
+     * Returns the change count which is also stored in delta.
+     */
+    liz_int_t
+    liz_delta_record(liz_delta_t *delta,
+                     liz_delta_change_t *changes,
+                     liz_int_t change_capacity,
+                     liz_vm_t const *vm,
+                     liz_vm_actor_t const *actor,
+                     liz_vm_shape_t const *shape);
+    
+    
+    /**
+     * Applies the changes of delta to actor, or reverts them for 
+     * liz_delta_direction_reverse.
+     *
+     * actor must be in the old state of the record to apply it forward and in
+     * the new state to reverse it, otherwise behavior is undefined.
+     */
+    void
+    liz_delta_apply(liz_vm_actor_t *actor,
+                    liz_vm_shape_t const *shape,
+                    liz_delta_t const *delta,
+                    liz_delta_change_t const *changes,
+                    liz_delta_direction_t direction);
+    
+    
+    
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+
+#endif /* LIZ_liz_delta_H */
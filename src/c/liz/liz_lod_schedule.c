@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "liz_lod_schedule.h"
+
+#include "liz_assert.h"
+#include "liz_platform_functions.h"
+
+
+
+static
+uint32_t
+liz_lod_schedule_level(uint16_t tick_interval)
+{
+    LIZ_ASSERT(0u != tick_interval);
+    
+    uint32_t level = 0u;
+    while (1u < tick_interval) {
+        tick_interval >>= 1u;
+        ++level;
+    }
+    
+    return level;
+}
+
+
+
+static
+uint32_t
+liz_lod_schedule_bucket(uint32_t const level,
+                        uint64_t const frame)
+{
+    uint32_t const tick_interval = 1u << level;
+    
+    return (tick_interval - 1u) + (uint32_t)(frame & (uint64_t)(tick_interval - 1u));
+}
+
+
+
+#pragma mark Create and destroy schedule
+
+liz_lod_schedule_t*
+liz_lod_schedule_create(liz_int_t const actor_capacity,
+                        uint16_t const max_tick_interval,
+                        void * LIZ_RESTRICT allocator_context,
+                        liz_alloc_func_t alloc_func)
+{
+    if (0 > actor_capacity
+        || (uint64_t)UINT32_MAX < (uint64_t)actor_capacity
+        || 0u == max_tick_interval
+        || 0u != (max_tick_interval & (max_tick_interval - 1u))) {
+        
+        return NULL;
+    }
+    
+    uint32_t const level_count = liz_lod_schedule_level(max_tick_interval) + 1u;
+    
+    if (LIZ_LOD_SCHEDULE_LEVEL_CAPACITY < level_count) {
+        return NULL;
+    }
+    
+    uint32_t const bucket_count = (1u << level_count) - 1u;
+    size_t const schedule_size = sizeof(liz_lod_schedule_t)
+        + sizeof(uint32_t) * (bucket_count + 1u)
+        + sizeof(uint32_t) * (size_t)actor_capacity;
+    liz_lod_schedule_t *schedule = (liz_lod_schedule_t *)alloc_func(allocator_context, schedule_size);
+    
+    if (NULL == schedule) {
+        return NULL;
+    }
+    
+    schedule->bucket_offsets = (uint32_t *)(schedule + 1);
+    schedule->actor_indices = schedule->bucket_offsets + bucket_count + 1u;
+    schedule->actor_capacity = (uint32_t)actor_capacity;
+    schedule->actor_count = 0u;
+    schedule->level_count = level_count;
+    schedule->bucket_count = bucket_count;
+    
+    liz_memset(schedule->bucket_offsets, 0, sizeof(uint32_t) * (bucket_count + 1u));
+    
+    return schedule;
+}
+
+
+
+void
+liz_lod_schedule_destroy(liz_lod_schedule_t *schedule,
+                         void * LIZ_RESTRICT allocator_context,
+                         liz_dealloc_func_t dealloc_func)
+{
+    dealloc_func(allocator_context, schedule);
+}
+
+
+
+#pragma mark Schedule actors
+
+bool
+liz_lod_schedule_build(liz_lod_schedule_t *schedule,
+                       liz_actor_clip_t const *clip)
+{
+    uint32_t *offsets = schedule->bucket_offsets;
+    uint32_t const max_tick_interval = 1u << (schedule->level_count - 1u);
+    
+    liz_memset(offsets, 0, sizeof(uint32_t) * (schedule->bucket_count + 1u));
+    schedule->actor_count = 0u;
+    
+    if (schedule->actor_capacity < clip->header.count) {
+        return false;
+    }
+    
+    // Count sort actor indices into their buckets - first count each 
+    // bucket's actors shifted by one bucket, then prefix sum the counts to
+    // get the bucket begin offsets, and last place each actor index while 
+    // moving its bucket's offset to the next free slot.
+    for (uint32_t i = 0; i < clip->header.count; ++i) {
+        liz_actor_tick_schedule_t const tick_schedule = clip->tick_schedules[i];
+        
+        if (max_tick_interval < tick_schedule.tick_interval) {
+            liz_memset(offsets, 0, sizeof(uint32_t) * (schedule->bucket_count + 1u));
+            return false;
+        }
+        
+        uint32_t const level = liz_lod_schedule_level(tick_schedule.tick_interval);
+        offsets[liz_lod_schedule_bucket(level, tick_schedule.tick_phase) + 1u] += 1u;
+    }
+    
+    for (uint32_t i = 1; i <= schedule->bucket_count; ++i) {
+        offsets[i] += offsets[i - 1u];
+    }
+    
+    for (uint32_t i = 0; i < clip->header.count; ++i) {
+        liz_actor_tick_schedule_t const tick_schedule = clip->tick_schedules[i];
+        uint32_t const level = liz_lod_schedule_level(tick_schedule.tick_interval);
+        uint32_t const bucket = liz_lod_schedule_bucket(level, tick_schedule.tick_phase);
+        
+        schedule->actor_indices[offsets[bucket]] = i;
+        offsets[bucket] += 1u;
+    }
+    
+    // Placing moved each offset to its bucket's end, alas to the next 
+    // bucket's begin - shift them back.
+    for (uint32_t i = schedule->bucket_count; 0u < i; --i) {
+        offsets[i] = offsets[i - 1u];
+    }
+    offsets[0] = 0u;
+    
+    schedule->actor_count = clip->header.count;
+    
+    return true;
+}
+
+
+
+liz_int_t
+liz_lod_schedule_due_actor_count(liz_lod_schedule_t const *schedule,
+                                 uint64_t const frame)
+{
+    liz_int_t count = 0;
+    
+    for (uint32_t level = 0; level < schedule->level_count; ++level) {
+        uint32_t const bucket = liz_lod_schedule_bucket(level, frame);
+        count += (liz_int_t)(schedule->bucket_offsets[bucket + 1u] - schedule->bucket_offsets[bucket]);
+    }
+    
+    return count;
+}
+
+
+
+liz_int_t
+liz_lod_schedule_collect_due_actors(liz_lod_schedule_t const *schedule,
+                                    uint64_t const frame,
+                                    uint32_t *due_actor_indices,
+                                    liz_int_t const due_actor_capacity)
+{
+    liz_int_t count = 0;
+    
+    for (uint32_t level = 0; level < schedule->level_count; ++level) {
+        uint32_t const bucket = liz_lod_schedule_bucket(level, frame);
+        
+        for (uint32_t i = schedule->bucket_offsets[bucket]; 
+             i < schedule->bucket_offsets[bucket + 1u] && count < due_actor_capacity; 
+             ++i) {
+            
+            due_actor_indices[count++] = schedule->actor_indices[i];
+        }
+    }
+    
+    return count;
+}
+
+
+
+liz_int_t
+liz_lod_schedule_update_due_actors(liz_lod_schedule_t const *schedule,
+                                   uint64_t const frame,
+                                   liz_actor_clip_t *clip,
+                                   liz_vm_t *vm,
+                                   liz_vm_monitor_t *monitor,
+                                   void * LIZ_RESTRICT user_data_lookup_context,
+                                   liz_vm_user_data_lookup_func_t user_data_lookup_func,
+                                   liz_time_t const time,
+                                   liz_action_state_update_t const *action_state_updates,
+                                   liz_int_t const action_state_update_count,
+                                   liz_action_request_t *requests,
+                                   liz_int_t const request_capacity,
+                                   liz_vm_shape_t const *shape)
+{
+    LIZ_ASSERT(schedule->actor_count == clip->header.count 
+               && "Rebuild the schedule after adding actors.");
+    
+    liz_actor_clip_apply_action_state_updates(clip,
+                                              action_state_updates,
+                                              action_state_update_count);
+    
+    liz_int_t request_count = 0;
+    
+    for (uint32_t level = 0; level < schedule->level_count; ++level) {
+        uint32_t const bucket = liz_lod_schedule_bucket(level, frame);
+        
+        for (uint32_t i = schedule->bucket_offsets[bucket]; 
+             i < schedule->bucket_offsets[bucket + 1u]; 
+             ++i) {
+            
+            liz_vm_actor_t actor = liz_actor_clip_actor(clip, (liz_int_t)schedule->actor_indices[i]);
+            
+            liz_vm_update_actor(vm,
+                                monitor,
+                                user_data_lookup_context,
+                                user_data_lookup_func,
+                                time,
+                                &actor,
+                                shape);
+            
+            LIZ_ASSERT(request_capacity - request_count >= liz_vm_action_request_count(vm)
+                       && "Request capacity must hold the requests of all due actors.");
+            
+            request_count += liz_vm_extract_action_requests(vm,
+                                                            requests + request_count,
+                                                            request_capacity - request_count,
+                                                            actor.header->actor_id);
+            liz_vm_extract_actor_state(vm, &actor, shape);
+        }
+    }
+    
+    return request_count;
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *
+ * Level of detail update scheduling for actor clips - actors far from the 
+ * player or otherwise less important are updated less often than every 
+ * frame, as set by liz_actor_clip_set_tick_schedule.
+ *
+ * The schedule buckets actor indices by tick interval level and tick phase. 
+ * For level l, with a tick interval of 2^l frames, exactly one of its 2^l
+ * buckets is due each frame, so finding the due actors of a frame costs one
+ * bucket lookup per level instead of a test per actor.
+ *
+ * Typical usage:
+ * 1. Create a schedule per actor clip.
+ * 2. Build the schedule after adding actors or changing tick schedules.
+ * 3. Each frame call liz_lod_schedule_update_due_actors to ingest the action 
+ *    state updates for all actors and to update the due actors.
+ */
+
+#ifndef LIZ_liz_lod_schedule_H
+#define LIZ_liz_lod_schedule_H
+
+
+#include <liz/liz_platform_types.h>
+#include <liz/liz_platform_macros.h>
+#include <liz/liz_allocator.h>
+#include <liz/liz_common.h>
+#include <liz/liz_vm.h>
+#include <liz/liz_actor_clip.h>
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+    
+    
+    /**
+     * Maximal number of tick interval levels, alas the maximal tick interval
+     * is 2^(LIZ_LOD_SCHEDULE_LEVEL_CAPACITY - 1) frames.
+     */
+#define LIZ_LOD_SCHEDULE_LEVEL_CAPACITY 16
+    
+    
+    
+    /**
+     * Actor indices sorted into buckets. Bucket (2^l - 1 + phase) holds the 
+     * actors with a tick interval of 2^l frames and tick phase phase. Its 
+     * actors are stored from bucket_offsets[bucket] to 
+     * bucket_offsets[bucket + 1].
+     *
+     * Treat as opaque, only access via the liz_lod_schedule functions.
+     */
+    typedef struct liz_lod_schedule {
+        uint32_t *bucket_offsets;
+        uint32_t *actor_indices;
+        uint32_t actor_capacity;
+        uint32_t actor_count;
+        uint32_t level_count;
+        uint32_t bucket_count;
+    } liz_lod_schedule_t;
+    
+    
+    
+    /**
+     * Creates an empty schedule for up to actor_capacity actors with tick
+     * intervals of up to max_tick_interval frames.
+     *
+     * Returns NULL if max_tick_interval isn't a power of two, exceeds the 
+     * maximal tick interval, or if memory can't be allocated.
+     */
+    liz_lod_schedule_t*
+    liz_lod_schedule_create(liz_int_t actor_capacity,
+                            uint16_t max_tick_interval,
+                            void * LIZ_RESTRICT allocator_context,
+                            liz_alloc_func_t alloc_func);
+    
+    
+    void
+    liz_lod_schedule_destroy(liz_lod_schedule_t *schedule,
+                             void * LIZ_RESTRICT allocator_context,
+                             liz_dealloc_func_t dealloc_func);
+    
+    
+    /**
+     * Sorts the actors of clip into the schedule buckets.
+     *
+     * Returns false and leaves the schedule empty if the clip has more actors
+     * than the schedule's capacity or if an actor's tick interval is greater
+     * than the schedule's maximal tick interval.
+     */
+    bool
+    liz_lod_schedule_build(liz_lod_schedule_t *schedule,
+                           liz_actor_clip_t const *clip);
+    
+    
+    /**
+     * Returns the number of actors due in frame.
+     */
+    liz_int_t
+    liz_lod_schedule_due_actor_count(liz_lod_schedule_t const *schedule,
+                                     uint64_t frame);
+    
+    
+    /**
+     * Copies the indices of the actors due in frame to due_actor_indices and
+     * returns their count. Copies at most due_actor_capacity indices.
+     */
+    liz_int_t
+    liz_lod_schedule_collect_due_actors(liz_lod_schedule_t const *schedule,
+                                        uint64_t frame,
+                                        uint32_t *due_actor_indices,
+                                        liz_int_t due_actor_capacity);
+    
+    
+    /**
+     * Applies the action state updates to all actors of clip, then updates 
+     * the actors due in frame with vm, extracts their action requests into 
+     * requests, and extracts their states back into the clip.
+     *
+     * action_state_updates must be sorted by liz_action_state_update_sort. 
+     * Actors not due in frame keep their updated action states until their
+     * next update.
+     *
+     * requests must have a capacity of at least the due actor count times the
+     * shape's action request capacity.
+     *
+     * Returns the number of extracted action requests.
+     */
+    liz_int_t
+    liz_lod_schedule_update_due_actors(liz_lod_schedule_t const *schedule,
+                                       uint64_t frame,
+                                       liz_actor_clip_t *clip,
+                                       liz_vm_t *vm,
+                                       liz_vm_monitor_t *monitor,
+                                       void * LIZ_RESTRICT user_data_lookup_context,
+                                       liz_vm_user_data_lookup_func_t user_data_lookup_func,
+                                       liz_time_t time,
+                                       liz_action_state_update_t const *action_state_updates,
+                                       liz_int_t action_state_update_count,
+                                       liz_action_request_t *requests,
+                                       liz_int_t request_capacity,
+                                       liz_vm_shape_t const *shape);
+    
+    
+    
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+
+#endif /* LIZ_liz_lod_schedule_H */
@@ -67,14 +67,14 @@ extern "C" {
     
     
     
-#define LIZ_LOOKASIDE_DOUBLE_STACK_CAPACITY_MAX UINT16_MAX
+#define LIZ_LOOKASIDE_DOUBLE_STACK_CAPACITY_MAX LIZ_INDEX_MAX
     
     
     
     typedef struct liz_lookaside_double_stack_s {
-        uint16_t capacity;
-        uint16_t count_low;
-        uint16_t count_high;
+        liz_index_t capacity;
+        liz_index_t count_low;
+        liz_index_t count_high;
     } liz_lookaside_double_stack_t;
     
     
@@ -97,9 +97,9 @@ extern "C" {
         LIZ_ASSERT(low_side_element_count + high_side_element_count <= capacity);
      
         return (liz_lookaside_double_stack_t){
-            (uint16_t)capacity,
-            (uint16_t)low_side_element_count,
-            (uint16_t)high_side_element_count
+            (liz_index_t)capacity,
+            (liz_index_t)low_side_element_count,
+            (liz_index_t)high_side_element_count
         };
     }
     
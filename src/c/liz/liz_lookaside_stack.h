@@ -63,7 +63,7 @@ extern "C" {
 #endif
     
     
-#define LIZ_LOOKASIDE_STACK_CAPACITY_MAX UINT16_MAX
+#define LIZ_LOOKASIDE_STACK_CAPACITY_MAX LIZ_INDEX_MAX
         
     
     /**
@@ -71,8 +71,8 @@ extern "C" {
      * Implementation might and will change without warning.
      */
     typedef struct liz_lookaside_stack {
-        uint16_t capacity;
-        uint16_t count;
+        liz_index_t capacity;
+        liz_index_t count;
     } liz_lookaside_stack_t;
     
     
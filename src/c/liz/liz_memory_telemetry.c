@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "liz_memory_telemetry.h"
+
+#include "liz_platform_functions.h"
+#include "liz_assert.h"
+
+
+
+static
+void
+liz_memory_usage_record_alloc(liz_memory_usage_t *usage,
+                              uint64_t const byte_count)
+{
+    usage->byte_count += byte_count;
+    usage->allocation_count += 1u;
+    
+    if (usage->byte_count > usage->high_water_byte_count) {
+        usage->high_water_byte_count = usage->byte_count;
+    }
+}
+
+
+
+static
+void
+liz_memory_usage_record_dealloc(liz_memory_usage_t *usage,
+                                uint64_t const byte_count)
+{
+    LIZ_ASSERT(byte_count <= usage->byte_count && "Deallocating more bytes than in use.");
+    
+    usage->byte_count -= byte_count;
+    usage->deallocation_count += 1u;
+}
+
+
+
+#pragma mark Telemetry
+
+void
+liz_memory_telemetry_init(liz_memory_telemetry_t *telemetry)
+{
+    liz_memset(telemetry, 0, sizeof(*telemetry));
+}
+
+
+
+void
+liz_memory_telemetry_record_alloc(liz_memory_telemetry_t *telemetry,
+                                  liz_memory_category_t const category,
+                                  size_t const byte_count)
+{
+    LIZ_ASSERT(0 <= category && category < liz_memory_category_count);
+    
+    liz_memory_usage_record_alloc(&telemetry->categories[category], byte_count);
+    liz_memory_usage_record_alloc(&telemetry->total, byte_count);
+}
+
+
+
+void
+liz_memory_telemetry_record_dealloc(liz_memory_telemetry_t *telemetry,
+                                    liz_memory_category_t const category,
+                                    size_t const byte_count)
+{
+    LIZ_ASSERT(0 <= category && category < liz_memory_category_count);
+    
+    liz_memory_usage_record_dealloc(&telemetry->categories[category], byte_count);
+    liz_memory_usage_record_dealloc(&telemetry->total, byte_count);
+}
+
+
+
+void
+liz_memory_telemetry_reset_high_water(liz_memory_telemetry_t *telemetry)
+{
+    for (liz_int_t i = 0; i < liz_memory_category_count; ++i) {
+        telemetry->categories[i].high_water_byte_count = telemetry->categories[i].byte_count;
+    }
+    
+    telemetry->total.high_water_byte_count = telemetry->total.byte_count;
+}
+
+
+
+liz_memory_usage_t
+liz_memory_telemetry_usage(liz_memory_telemetry_t const *telemetry,
+                           liz_memory_category_t const category)
+{
+    LIZ_ASSERT(0 <= category && category < liz_memory_category_count);
+    
+    return telemetry->categories[category];
+}
+
+
+
+liz_memory_usage_t
+liz_memory_telemetry_total(liz_memory_telemetry_t const *telemetry)
+{
+    return telemetry->total;
+}
+
+
+
+bool
+liz_memory_telemetry_is_balanced(liz_memory_telemetry_t const *telemetry)
+{
+    return (0u == telemetry->total.byte_count)
+        && (telemetry->total.allocation_count == telemetry->total.deallocation_count);
+}
+
+
+
+#pragma mark Tracking allocator
+
+void
+liz_tracking_allocator_init(liz_tracking_allocator_t *tracking_allocator,
+                            liz_memory_telemetry_t *telemetry,
+                            liz_memory_category_t const category,
+                            void *allocator_context,
+                            liz_alloc_func_t alloc_func,
+                            liz_dealloc_func_t dealloc_func)
+{
+    LIZ_ASSERT(0 <= category && category < liz_memory_category_count);
+    
+    tracking_allocator->telemetry = telemetry;
+    tracking_allocator->allocator_context = allocator_context;
+    tracking_allocator->alloc_func = alloc_func;
+    tracking_allocator->dealloc_func = dealloc_func;
+    tracking_allocator->category = category;
+}
+
+
+
+void*
+liz_tracking_alloc(void *allocator_context,
+                   size_t const requested_bytes)
+{
+    liz_tracking_allocator_t *tracking_allocator = (liz_tracking_allocator_t *)allocator_context;
+    
+    size_t const size = requested_bytes + LIZ_TRACKING_ALLOCATOR_HEADER_SIZE;
+    
+    if (size < requested_bytes) {
+        return NULL;
+    }
+    
+    char *block = (char *)tracking_allocator->alloc_func(tracking_allocator->allocator_context, 
+                                                         size);
+    
+    if (NULL == block) {
+        return NULL;
+    }
+    
+    liz_memcpy(block, &requested_bytes, sizeof(requested_bytes));
+    
+    liz_memory_telemetry_record_alloc(tracking_allocator->telemetry,
+                                      tracking_allocator->category,
+                                      requested_bytes);
+    
+    return block + LIZ_TRACKING_ALLOCATOR_HEADER_SIZE;
+}
+
+
+
+void
+liz_tracking_dealloc(void * LIZ_RESTRICT allocator_context,
+                     void * LIZ_RESTRICT ptr)
+{
+    if (NULL == ptr) {
+        return;
+    }
+    
+    liz_tracking_allocator_t *tracking_allocator = (liz_tracking_allocator_t *)allocator_context;
+    
+    char *block = (char *)ptr - LIZ_TRACKING_ALLOCATOR_HEADER_SIZE;
+    size_t requested_bytes = 0;
+    liz_memcpy(&requested_bytes, block, sizeof(requested_bytes));
+    
+    liz_memory_telemetry_record_dealloc(tracking_allocator->telemetry,
+                                        tracking_allocator->category,
+                                        requested_bytes);
+    
+    tracking_allocator->dealloc_func(tracking_allocator->allocator_context, block);
+}
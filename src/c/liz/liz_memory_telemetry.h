@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *
+ * Memory usage telemetry per category of liz objects.
+ *
+ * Wrap an allocator into a liz_tracking_allocator_t tagged with the category
+ * of the objects it creates and pass it with liz_tracking_alloc and 
+ * liz_tracking_dealloc to the create and destroy functions, e.g.,
+ * liz_vm_create or liz_builder_create. Memory not allocated via liz, e.g., 
+ * shapes loaded from a blob, can be recorded directly with the sizes 
+ * returned by liz_vm_shape_memory_size and its siblings.
+ *
+ * Telemetry isn't synchronized - use one telemetry and tracking allocator 
+ * per thread and sum the telemetries up, or synchronize externally.
+ *
+ * Typical usage:
+ * 1. Track all allocations during a long running session.
+ * 2. Compare high water marks with the configured capacities to right-size
+ *    them.
+ * 3. Check current byte counts after teardown to catch leaks.
+ */
+
+#ifndef LIZ_liz_memory_telemetry_H
+#define LIZ_liz_memory_telemetry_H
+
+
+#include <liz/liz_platform_types.h>
+#include <liz/liz_platform_macros.h>
+#include <liz/liz_allocator.h>
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+    
+    
+    typedef enum liz_memory_category {
+        liz_memory_category_shape = 0,
+        liz_memory_category_actor,
+        liz_memory_category_clip,
+        liz_memory_category_vm,
+        liz_memory_category_table,
+        liz_memory_category_builder,
+        liz_memory_category_scratch,
+        liz_memory_category_other,
+        liz_memory_category_count
+    } liz_memory_category_t;
+    
+    
+    
+    /**
+     * Bytes in use, the most bytes in use at once since the last reset of the
+     * high water mark, and the number of recorded allocations and 
+     * deallocations.
+     */
+    typedef struct liz_memory_usage {
+        uint64_t byte_count;
+        uint64_t high_water_byte_count;
+        uint64_t allocation_count;
+        uint64_t deallocation_count;
+    } liz_memory_usage_t;
+    
+    
+    
+    typedef struct liz_memory_telemetry {
+        liz_memory_usage_t categories[liz_memory_category_count];
+        liz_memory_usage_t total;
+    } liz_memory_telemetry_t;
+    
+    
+    
+    /**
+     * Adapter recording the allocations of an underlying allocator into 
+     * telemetry under category. Pass it as allocator context to 
+     * liz_tracking_alloc and liz_tracking_dealloc.
+     */
+    typedef struct liz_tracking_allocator {
+        liz_memory_telemetry_t *telemetry;
+        void *allocator_context;
+        liz_alloc_func_t alloc_func;
+        liz_dealloc_func_t dealloc_func;
+        liz_memory_category_t category;
+    } liz_tracking_allocator_t;
+    
+    
+    
+#pragma mark Telemetry
+    
+    void
+    liz_memory_telemetry_init(liz_memory_telemetry_t *telemetry);
+    
+    
+    /**
+     * Records an allocation of byte_count bytes of category.
+     */
+    void
+    liz_memory_telemetry_record_alloc(liz_memory_telemetry_t *telemetry,
+                                      liz_memory_category_t category,
+                                      size_t byte_count);
+    
+    
+    /**
+     * Records a deallocation of byte_count bytes of category. byte_count must
+     * not exceed the bytes in use of category.
+     */
+    void
+    liz_memory_telemetry_record_dealloc(liz_memory_telemetry_t *telemetry,
+                                        liz_memory_category_t category,
+                                        size_t byte_count);
+    
+    
+    /**
+     * Lowers the high water marks of all categories to their bytes in use,
+     * e.g., to measure the peak of each frame.
+     */
+    void
+    liz_memory_telemetry_reset_high_water(liz_memory_telemetry_t *telemetry);
+    
+    
+    liz_memory_usage_t
+    liz_memory_telemetry_usage(liz_memory_telemetry_t const *telemetry,
+                               liz_memory_category_t category);
+    
+    
+    liz_memory_usage_t
+    liz_memory_telemetry_total(liz_memory_telemetry_t const *telemetry);
+    
+    
+    /**
+     * Returns true if all recorded allocations are deallocated.
+     */
+    bool
+    liz_memory_telemetry_is_balanced(liz_memory_telemetry_t const *telemetry);
+    
+    
+    
+#pragma mark Tracking allocator
+    
+    /**
+     * Bytes a tracking allocator adds to each allocation to remember its size.
+     */
+#define LIZ_TRACKING_ALLOCATOR_HEADER_SIZE LIZ_ARENA_ALIGNMENT
+    
+    
+    void
+    liz_tracking_allocator_init(liz_tracking_allocator_t *tracking_allocator,
+                                liz_memory_telemetry_t *telemetry,
+                                liz_memory_category_t category,
+                                void *allocator_context,
+                                liz_alloc_func_t alloc_func,
+                                liz_dealloc_func_t dealloc_func);
+    
+    
+    /**
+     * Allocates requested_bytes via the liz_tracking_allocator_t 
+     * allocator_context and records them in its telemetry. The underlying
+     * allocator must return memory aligned to at least 
+     * LIZ_TRACKING_ALLOCATOR_HEADER_SIZE for the returned memory to be 
+     * aligned as much.
+     *
+     * Failed allocations aren't recorded.
+     */
+    void*
+    liz_tracking_alloc(void *allocator_context,
+                       size_t requested_bytes);
+    
+    
+    /**
+     * Deallocates ptr from liz_tracking_alloc and records it. Accepts NULL.
+     */
+    void
+    liz_tracking_dealloc(void * LIZ_RESTRICT allocator_context,
+                         void * LIZ_RESTRICT ptr);
+    
+    
+    
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+
+#endif /* LIZ_liz_memory_telemetry_H */
@@ -40,8 +40,14 @@
 #define LIZ_liz_platform_functions_H
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#   include <intrin.h>
+#endif
 
 #include <liz/liz_platform_macros.h>
 
@@ -122,6 +128,138 @@ extern "C" {
     }
     
     
+    LIZ_INLINE static
+    void const*
+    liz_memchr(void const *buffer,
+               int value,
+               size_t buffer_byte_count)
+    {
+        return memchr(buffer, value, buffer_byte_count);
+    }
+    
+    
+    LIZ_INLINE static
+    void
+    liz_qsort(void *base,
+              size_t element_count,
+              size_t element_size,
+              int (*compare)(void const *, void const *))
+    {
+        qsort(base, element_count, element_size, compare);
+    }
+    
+    
+    LIZ_INLINE static
+    size_t
+    liz_strlen(char const *str)
+    {
+        return strlen(str);
+    }
+    
+    
+    LIZ_INLINE static
+    int
+    liz_strcmp(char const *str0,
+               char const *str1)
+    {
+        return strcmp(str0, str1);
+    }
+    
+    
+    /**
+     * Returns the time stamp counter on x86 platforms, otherwise the processor
+     * time used by the program in clock ticks. Only differences of values 
+     * are meaningful.
+     */
+    LIZ_INLINE static
+    uint64_t
+    liz_cycle_count(void)
+    {
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__i386__) || defined(__x86_64__))
+        return (uint64_t)__builtin_ia32_rdtsc();
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+        return (uint64_t)__rdtsc();
+#else
+        return (uint64_t)clock();
+#endif
+    }
+    
+    
+    /**
+     * Atomic load with acquire semantics, pairs with 
+     * liz_atomic_store_release_uint32 to pass data between two threads.
+     */
+    LIZ_INLINE static
+    uint32_t
+    liz_atomic_load_acquire_uint32(uint32_t const volatile *source)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return __atomic_load_n(source, __ATOMIC_ACQUIRE);
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+        uint32_t const value = *source;
+        _ReadWriteBarrier();
+        return value;
+#else
+#   error Atomic load not implemented for this platform.
+#endif
+    }
+    
+    
+    LIZ_INLINE static
+    void
+    liz_atomic_store_release_uint32(uint32_t volatile *destination,
+                                    uint32_t value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __atomic_store_n(destination, value, __ATOMIC_RELEASE);
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+        _ReadWriteBarrier();
+        *destination = value;
+#else
+#   error Atomic store not implemented for this platform.
+#endif
+    }
+    
+    
+    /**
+     * Atomically adds value to destination and returns the previous value of
+     * destination. Sequentially consistent.
+     */
+    LIZ_INLINE static
+    uint32_t
+    liz_atomic_fetch_add_uint32(uint32_t volatile *destination,
+                                uint32_t value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return __atomic_fetch_add(destination, value, __ATOMIC_SEQ_CST);
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+        return (uint32_t)_InterlockedExchangeAdd((long volatile *)destination, (long)value);
+#else
+#   error Atomic fetch add not implemented for this platform.
+#endif
+    }
+    
+    
+    /**
+     * Atomically stores value in destination and returns the previous value
+     * of destination with acquire semantics, e.g., to take a spin lock that
+     * is released via liz_atomic_store_release_uint32.
+     */
+    LIZ_INLINE static
+    uint32_t
+    liz_atomic_exchange_acquire_uint32(uint32_t volatile *destination,
+                                       uint32_t value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return __atomic_exchange_n(destination, value, __ATOMIC_ACQUIRE);
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+        return (uint32_t)_InterlockedExchange((long volatile *)destination, (long)value);
+#else
+#   error Atomic exchange not implemented for this platform.
+#endif
+    }
+    
+    
     
 #if defined(__cplusplus)
 } /* extern "C" */
@@ -48,4 +48,18 @@
 #   define LIZ_RESTRICT restrict
 #endif
 
+
+#if defined(_MSC_VER)
+#   define LIZ_THREAD_LOCAL __declspec(thread)
+#else /* Assume GCC compatible */
+#   define LIZ_THREAD_LOCAL __thread
+#endif
+
+
+/* Define LIZ_SIMD_DISABLE to force the portable scalar code paths. */
+#if !defined(LIZ_SIMD_DISABLE) \
+    && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#   define LIZ_SIMD_SSE2_ENABLE
+#endif
+
 #endif /* LIZ_liz_platform_macros_H */
@@ -72,6 +72,28 @@ typedef intptr_t liz_int_t;
 typedef uintptr_t liz_uint_t;
 
 
+/**
+ * Type of shape atom indices, end offsets, and of the counts and capacities
+ * sized by a shape specification, e.g., of the vm's lookaside stacks.
+ *
+ * Defaults to 16 bit to keep shapes, actor states, and vm buffers compact 
+ * and cache friendly. Define LIZ_WIDE_INDEX_ENABLE for shapes with more than
+ * 65535 shape atoms - shape atoms, shape atom indices, and stack counters 
+ * double in size then. Shape blobs and actor snapshots can't be exchanged 
+ * between both configurations.
+ *
+ * The wide maximum stays below INT32_MAX so index arithmetic in liz_int_t
+ * never overflows on 32 bit platforms.
+ */
+#if defined(LIZ_WIDE_INDEX_ENABLE)
+typedef uint32_t liz_index_t;
+#   define LIZ_INDEX_MAX ((liz_index_t)(INT32_MAX - 1))
+#else
+typedef uint16_t liz_index_t;
+#   define LIZ_INDEX_MAX ((liz_index_t)UINT16_MAX)
+#endif
+
+
 #if defined(__cplusplus)
 } /* extern "C" */
 #endif
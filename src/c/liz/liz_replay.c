@@ -0,0 +1,710 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "liz_replay.h"
+
+#include "liz_assert.h"
+#include "liz_platform_functions.h"
+#include "liz_common_internal.h"
+#include "liz_lookaside_stack.h"
+#include "liz_lookaside_double_stack.h"
+
+
+
+/**
+ * Each immediate action call is logged as one byte, followed by the new
+ * random number seed if the call changed it.
+ */
+#define LIZ_REPLAY_CALL_REQUEST_MASK 0x07u
+#define LIZ_REPLAY_CALL_RESULT_SHIFT 3u
+#define LIZ_REPLAY_CALL_RESULT_MASK 0x07u
+#define LIZ_REPLAY_CALL_SEED_FLAG 0x40u
+
+/**
+ * Action state updates are logged as packed shape atom index and state
+ * pairs.
+ */
+#define LIZ_REPLAY_ACTION_STATE_UPDATE_BYTE_COUNT (sizeof(liz_index_t) + 1u)
+
+#define LIZ_REPLAY_FNV_OFFSET_BASIS 2166136261u
+#define LIZ_REPLAY_FNV_PRIME 16777619u
+
+
+
+/* Checksums hash values, not memory, so struct padding can't make replays
+ * diverge, and hash each value in one step instead of byte by byte.
+ */
+static
+uint32_t
+liz_replay_checksum_value(uint32_t const checksum,
+                          uint32_t const value)
+{
+    return (checksum ^ value) * LIZ_REPLAY_FNV_PRIME;
+}
+
+
+
+static
+uint32_t
+liz_replay_checksum_action_requests(uint32_t checksum,
+                                    liz_vm_action_request_t const *requests,
+                                    liz_int_t const count)
+{
+    for (liz_int_t i = 0; i < count; ++i) {
+        checksum = liz_replay_checksum_value(checksum, requests[i].action_id);
+        checksum = liz_replay_checksum_value(checksum, requests[i].resource_id);
+        checksum = liz_replay_checksum_value(checksum, requests[i].shape_atom_index);
+    }
+    
+    return checksum;
+}
+
+
+
+static
+bool
+liz_replay_recorder_append(liz_replay_recorder_t *recorder,
+                           void const *data,
+                           size_t byte_count)
+{
+    if (recorder->log_capacity - recorder->log_size < byte_count) {
+        recorder->overflowed = true;
+        return false;
+    }
+    
+    liz_memcpy(recorder->log + recorder->log_size, data, byte_count);
+    recorder->log_size += byte_count;
+    
+    return true;
+}
+
+
+
+/* Forwards monitor calls with the actor blackboard and the shape of the
+ * recorded update instead of the recorder and the trampoline shape.
+ */
+static
+void
+liz_replay_recorder_monitor_func(uintptr_t user_data,
+                                 liz_uint_t const node_shape_atom_index,
+                                 liz_uint_t const traversal_mask,
+                                 liz_vm_t const *vm,
+                                 void const * LIZ_RESTRICT actor_blackboard,
+                                 liz_time_t const time,
+                                 liz_vm_actor_t const *actor,
+                                 liz_vm_shape_t const *shape)
+{
+    (void)actor_blackboard;
+    (void)shape;
+    
+    liz_replay_recorder_t const *recorder = (liz_replay_recorder_t const *)user_data;
+    
+    recorder->monitor->func(recorder->monitor->user_data,
+                            node_shape_atom_index,
+                            traversal_mask,
+                            vm,
+                            recorder->actor_blackboard,
+                            time,
+                            actor,
+                            recorder->shape);
+}
+
+
+
+static
+void*
+liz_replay_recorder_user_data_lookup(void *context,
+                                     uintptr_t user_data)
+{
+    liz_replay_recorder_t *recorder = (liz_replay_recorder_t *)context;
+    
+    recorder->actor_blackboard = recorder->user_data_lookup_func(recorder->user_data_lookup_context,
+                                                                 user_data);
+    
+    // Recording trampolines receive the recorder as their blackboard.
+    return recorder;
+}
+
+
+
+static
+liz_execution_state_t
+liz_replay_record_immediate_action_call(liz_replay_recorder_t *recorder,
+                                        liz_int_t const function_index,
+                                        liz_random_number_seed_t *random_number_seed,
+                                        liz_time_t const time,
+                                        liz_execution_state_t const execution_request)
+{
+    liz_random_number_seed_t const seed_before_call = *random_number_seed;
+    
+    liz_execution_state_t const result = recorder->immediate_action_functions[function_index](recorder->actor_blackboard,
+                                                                                             random_number_seed,
+                                                                                             time,
+                                                                                             execution_request);
+    
+    bool const seed_changed = (seed_before_call != *random_number_seed);
+    size_t const byte_count = seed_changed ? (1u + sizeof(*random_number_seed)) : 1u;
+    
+    if (recorder->overflowed
+        || recorder->log_capacity - recorder->log_size < byte_count) {
+        
+        recorder->overflowed = true;
+        return result;
+    }
+    
+    uint8_t *call = recorder->log + recorder->log_size;
+    call[0] = (uint8_t)(((unsigned int)execution_request & LIZ_REPLAY_CALL_REQUEST_MASK)
+                        | (((unsigned int)result & LIZ_REPLAY_CALL_RESULT_MASK) << LIZ_REPLAY_CALL_RESULT_SHIFT)
+                        | (seed_changed ? LIZ_REPLAY_CALL_SEED_FLAG : 0u));
+    
+    if (seed_changed) {
+        liz_memcpy(call + 1, random_number_seed, sizeof(*random_number_seed));
+    }
+    
+    recorder->log_size += byte_count;
+    recorder->immediate_action_call_count += 1u;
+    
+    return result;
+}
+
+
+
+#define LIZ_REPLAY_RECORD_TRAMPOLINE(function_index) \
+static \
+liz_execution_state_t \
+liz_replay_record_trampoline##function_index(void *recorder, \
+                                             liz_random_number_seed_t *random_number_seed, \
+                                             liz_time_t time, \
+                                             liz_execution_state_t execution_request) \
+{ \
+    return liz_replay_record_immediate_action_call((liz_replay_recorder_t *)recorder, \
+                                                   function_index, \
+                                                   random_number_seed, \
+                                                   time, \
+                                                   execution_request); \
+}
+
+LIZ_REPLAY_RECORD_TRAMPOLINE(0)
+LIZ_REPLAY_RECORD_TRAMPOLINE(1)
+LIZ_REPLAY_RECORD_TRAMPOLINE(2)
+LIZ_REPLAY_RECORD_TRAMPOLINE(3)
+LIZ_REPLAY_RECORD_TRAMPOLINE(4)
+LIZ_REPLAY_RECORD_TRAMPOLINE(5)
+LIZ_REPLAY_RECORD_TRAMPOLINE(6)
+LIZ_REPLAY_RECORD_TRAMPOLINE(7)
+LIZ_REPLAY_RECORD_TRAMPOLINE(8)
+LIZ_REPLAY_RECORD_TRAMPOLINE(9)
+LIZ_REPLAY_RECORD_TRAMPOLINE(10)
+LIZ_REPLAY_RECORD_TRAMPOLINE(11)
+LIZ_REPLAY_RECORD_TRAMPOLINE(12)
+LIZ_REPLAY_RECORD_TRAMPOLINE(13)
+LIZ_REPLAY_RECORD_TRAMPOLINE(14)
+LIZ_REPLAY_RECORD_TRAMPOLINE(15)
+LIZ_REPLAY_RECORD_TRAMPOLINE(16)
+LIZ_REPLAY_RECORD_TRAMPOLINE(17)
+LIZ_REPLAY_RECORD_TRAMPOLINE(18)
+LIZ_REPLAY_RECORD_TRAMPOLINE(19)
+LIZ_REPLAY_RECORD_TRAMPOLINE(20)
+LIZ_REPLAY_RECORD_TRAMPOLINE(21)
+LIZ_REPLAY_RECORD_TRAMPOLINE(22)
+LIZ_REPLAY_RECORD_TRAMPOLINE(23)
+LIZ_REPLAY_RECORD_TRAMPOLINE(24)
+LIZ_REPLAY_RECORD_TRAMPOLINE(25)
+LIZ_REPLAY_RECORD_TRAMPOLINE(26)
+LIZ_REPLAY_RECORD_TRAMPOLINE(27)
+LIZ_REPLAY_RECORD_TRAMPOLINE(28)
+LIZ_REPLAY_RECORD_TRAMPOLINE(29)
+LIZ_REPLAY_RECORD_TRAMPOLINE(30)
+LIZ_REPLAY_RECORD_TRAMPOLINE(31)
+
+#undef LIZ_REPLAY_RECORD_TRAMPOLINE
+
+
+static liz_immediate_action_func_t liz_replay_record_trampolines[LIZ_REPLAY_IMMEDIATE_ACTION_FUNCTION_CAPACITY] = {
+    liz_replay_record_trampoline0,  liz_replay_record_trampoline1, 
+    liz_replay_record_trampoline2,  liz_replay_record_trampoline3,
+    liz_replay_record_trampoline4,  liz_replay_record_trampoline5, 
+    liz_replay_record_trampoline6,  liz_replay_record_trampoline7,
+    liz_replay_record_trampoline8,  liz_replay_record_trampoline9, 
+    liz_replay_record_trampoline10, liz_replay_record_trampoline11,
+    liz_replay_record_trampoline12, liz_replay_record_trampoline13, 
+    liz_replay_record_trampoline14, liz_replay_record_trampoline15,
+    liz_replay_record_trampoline16, liz_replay_record_trampoline17, 
+    liz_replay_record_trampoline18, liz_replay_record_trampoline19,
+    liz_replay_record_trampoline20, liz_replay_record_trampoline21, 
+    liz_replay_record_trampoline22, liz_replay_record_trampoline23,
+    liz_replay_record_trampoline24, liz_replay_record_trampoline25, 
+    liz_replay_record_trampoline26, liz_replay_record_trampoline27,
+    liz_replay_record_trampoline28, liz_replay_record_trampoline29, 
+    liz_replay_record_trampoline30, liz_replay_record_trampoline31
+};
+
+
+
+static
+liz_execution_state_t
+liz_replay_play_immediate_action_call(void *player_blackboard,
+                                      liz_random_number_seed_t *random_number_seed,
+                                      liz_time_t time,
+                                      liz_execution_state_t execution_request)
+{
+    liz_replay_player_t *player = (liz_replay_player_t *)player_blackboard;
+    (void)time;
+    
+    // Return a result the vm accepts for the request if the replay diverged.
+    liz_execution_state_t const fallback_result = (liz_execution_state_cancel == execution_request) ? liz_execution_state_cancel : liz_execution_state_fail;
+    
+    if (player->immediate_action_call_offset >= player->immediate_action_call_byte_count) {
+        player->diverged = true;
+        return fallback_result;
+    }
+    
+    uint8_t const call = player->immediate_action_calls[player->immediate_action_call_offset++];
+    player->immediate_action_call_count += 1u;
+    
+    if ((unsigned int)execution_request != (call & LIZ_REPLAY_CALL_REQUEST_MASK)) {
+        player->diverged = true;
+    }
+    
+    if (0u != (call & LIZ_REPLAY_CALL_SEED_FLAG)) {
+        if (player->immediate_action_call_byte_count - player->immediate_action_call_offset < sizeof(*random_number_seed)) {
+            player->diverged = true;
+        } else {
+            liz_memcpy(random_number_seed, 
+                       player->immediate_action_calls + player->immediate_action_call_offset, 
+                       sizeof(*random_number_seed));
+            player->immediate_action_call_offset += sizeof(*random_number_seed);
+        }
+    }
+    
+    if (player->diverged) {
+        return fallback_result;
+    }
+    
+    return (liz_execution_state_t)((call >> LIZ_REPLAY_CALL_RESULT_SHIFT) & LIZ_REPLAY_CALL_RESULT_MASK);
+}
+
+
+
+static liz_immediate_action_func_t liz_replay_play_functions[LIZ_REPLAY_IMMEDIATE_ACTION_FUNCTION_CAPACITY] = {
+    liz_replay_play_immediate_action_call, liz_replay_play_immediate_action_call,
+    liz_replay_play_immediate_action_call, liz_replay_play_immediate_action_call,
+    liz_replay_play_immediate_action_call, liz_replay_play_immediate_action_call,
+    liz_replay_play_immediate_action_call, liz_replay_play_immediate_action_call,
+    liz_replay_play_immediate_action_call, liz_replay_play_immediate_action_call,
+    liz_replay_play_immediate_action_call, liz_replay_play_immediate_action_call,
+    liz_replay_play_immediate_action_call, liz_replay_play_immediate_action_call,
+    liz_replay_play_immediate_action_call, liz_replay_play_immediate_action_call,
+    liz_replay_play_immediate_action_call, liz_replay_play_immediate_action_call,
+    liz_replay_play_immediate_action_call, liz_replay_play_immediate_action_call,
+    liz_replay_play_immediate_action_call, liz_replay_play_immediate_action_call,
+    liz_replay_play_immediate_action_call, liz_replay_play_immediate_action_call,
+    liz_replay_play_immediate_action_call, liz_replay_play_immediate_action_call,
+    liz_replay_play_immediate_action_call, liz_replay_play_immediate_action_call,
+    liz_replay_play_immediate_action_call, liz_replay_play_immediate_action_call,
+    liz_replay_play_immediate_action_call, liz_replay_play_immediate_action_call
+};
+
+
+
+/* Forwards monitor calls with the shape of the replayed update instead of 
+ * the playback shape, and without a blackboard instead of the player.
+ */
+static
+void
+liz_replay_player_monitor_func(uintptr_t user_data,
+                               liz_uint_t const node_shape_atom_index,
+                               liz_uint_t const traversal_mask,
+                               liz_vm_t const *vm,
+                               void const * LIZ_RESTRICT actor_blackboard,
+                               liz_time_t const time,
+                               liz_vm_actor_t const *actor,
+                               liz_vm_shape_t const *shape)
+{
+    (void)actor_blackboard;
+    (void)shape;
+    
+    liz_replay_player_t const *player = (liz_replay_player_t const *)user_data;
+    
+    player->monitor->func(player->monitor->user_data,
+                          node_shape_atom_index,
+                          traversal_mask,
+                          vm,
+                          NULL,
+                          time,
+                          actor,
+                          player->shape);
+}
+
+
+
+static
+void*
+liz_replay_player_user_data_lookup(void *context,
+                                   uintptr_t user_data)
+{
+    (void)user_data;
+    
+    // Playback functions receive the player as their blackboard.
+    return context;
+}
+
+
+
+static
+void
+liz_replay_apply_action_state_update(liz_vm_actor_t const *actor,
+                                     liz_index_t const shape_atom_index,
+                                     uint8_t const state)
+{
+    liz_int_t index = 0;
+    
+    if (liz_seek_key(&index,
+                     shape_atom_index,
+                     actor->action_state_shape_atom_indices,
+                     actor->header->action_state_count)) {
+        
+        actor->action_states[index] = state;
+    }
+}
+
+
+
+void
+liz_replay_recorder_init(liz_replay_recorder_t *recorder,
+                         void *log,
+                         size_t const log_capacity)
+{
+    liz_memset(recorder, 0, sizeof(*recorder));
+    
+    recorder->log = (uint8_t *)log;
+    recorder->log_capacity = log_capacity;
+}
+
+
+
+void
+liz_replay_recorder_clear(liz_replay_recorder_t *recorder)
+{
+    recorder->log_size = 0;
+    recorder->overflowed = false;
+}
+
+
+
+void
+liz_replay_recorder_set_checksum_enabled(liz_replay_recorder_t *recorder,
+                                         bool const enabled)
+{
+    recorder->checksum_enabled = enabled;
+}
+
+
+
+void
+liz_replay_apply_action_state_updates(liz_vm_actor_t const *actor,
+                                      liz_action_state_update_t const *action_state_updates,
+                                      liz_int_t const action_state_update_count)
+{
+    liz_id_t const actor_id = actor->header->actor_id;
+    
+    for (liz_int_t i = 0; i < action_state_update_count; ++i) {
+        
+        if (actor_id == action_state_updates[i].actor_id) {
+            liz_replay_apply_action_state_update(actor,
+                                                 action_state_updates[i].shape_atom_index,
+                                                 action_state_updates[i].state);
+        }
+    }
+}
+
+
+
+void
+liz_replay_record_update_actor(liz_replay_recorder_t *recorder,
+                               liz_vm_t *vm,
+                               liz_vm_monitor_t *monitor,
+                               void * LIZ_RESTRICT user_data_lookup_context,
+                               liz_vm_user_data_lookup_func_t user_data_lookup_func,
+                               liz_time_t const time,
+                               liz_action_state_update_t const *action_state_updates,
+                               liz_int_t const action_state_update_count,
+                               liz_vm_actor_t const *actor,
+                               liz_vm_shape_t const *shape)
+{
+    LIZ_ASSERT(LIZ_REPLAY_IMMEDIATE_ACTION_FUNCTION_CAPACITY >= shape->spec.immediate_action_function_count
+               && "Too many immediate action functions to record.");
+    
+    liz_replay_apply_action_state_updates(actor, 
+                                          action_state_updates, 
+                                          action_state_update_count);
+    
+    // Once a record has been dropped the log can't be replayed past it, 
+    // record nothing until the log is cleared.
+    if (recorder->overflowed) {
+        liz_vm_update_actor(vm,
+                            monitor,
+                            user_data_lookup_context,
+                            user_data_lookup_func,
+                            time,
+                            actor,
+                            shape);
+        return;
+    }
+    
+    liz_replay_update_record_t record;
+    liz_memset(&record, 0, sizeof(record));
+    record.time = time;
+    record.actor_id = actor->header->actor_id;
+    record.random_number_seed = actor->header->random_number_seed;
+    
+    recorder->record_offset = recorder->log_size;
+    recorder->immediate_action_call_count = 0;
+    
+    bool recorded = liz_replay_recorder_append(recorder, &record, sizeof(record));
+    
+    for (liz_int_t i = 0; recorded && i < action_state_update_count; ++i) {
+        
+        if (record.actor_id == action_state_updates[i].actor_id) {
+            uint8_t update[LIZ_REPLAY_ACTION_STATE_UPDATE_BYTE_COUNT];
+            liz_memcpy(update, &action_state_updates[i].shape_atom_index, sizeof(liz_index_t));
+            update[sizeof(liz_index_t)] = action_state_updates[i].state;
+            
+            recorded = liz_replay_recorder_append(recorder, update, sizeof(update));
+            record.action_state_update_count += 1u;
+        }
+    }
+    
+    size_t const immediate_action_calls_offset = recorder->log_size;
+    
+    liz_vm_shape_t recording_shape = *shape;
+    recording_shape.immediate_action_functions = liz_replay_record_trampolines;
+    
+    recorder->user_data_lookup_context = user_data_lookup_context;
+    recorder->user_data_lookup_func = user_data_lookup_func;
+    recorder->immediate_action_functions = shape->immediate_action_functions;
+    recorder->monitor = monitor;
+    recorder->shape = shape;
+    
+    liz_vm_monitor_t recording_monitor;
+    recording_monitor.user_data = (uintptr_t)recorder;
+    recording_monitor.func = liz_replay_recorder_monitor_func;
+    recording_monitor.filter = (NULL != monitor) ? monitor->filter : NULL;
+    
+    liz_vm_update_actor(vm,
+                        (NULL != monitor) ? &recording_monitor : NULL,
+                        recorder,
+                        liz_replay_recorder_user_data_lookup,
+                        time,
+                        actor,
+                        &recording_shape);
+    
+    // Each call takes at least one byte, so checking the byte count also
+    // catches a wrapped call count.
+    if (UINT16_MAX < recorder->log_size - immediate_action_calls_offset) {
+        recorder->overflowed = true;
+    }
+    
+    if (recorder->overflowed) {
+        recorder->log_size = recorder->record_offset;
+        return;
+    }
+    
+    record.immediate_action_call_count = recorder->immediate_action_call_count;
+    record.immediate_action_call_byte_count = (uint16_t)(recorder->log_size - immediate_action_calls_offset);
+    record.action_request_count = (liz_index_t)liz_vm_action_request_count(vm);
+    
+    if (recorder->checksum_enabled) {
+        record.result_checksum = liz_replay_vm_result_checksum(vm);
+        record.flags = LIZ_REPLAY_UPDATE_RECORD_FLAG_CHECKSUM;
+    }
+    
+    liz_memcpy(recorder->log + recorder->record_offset, &record, sizeof(record));
+}
+
+
+
+uint32_t
+liz_replay_vm_result_checksum(liz_vm_t const *vm)
+{
+    LIZ_ASSERT(liz_vm_cmd_done == vm->cmd 
+               && "Vm update must have been cleaned up and done before checksumming its result.");
+    
+    uint32_t checksum = LIZ_REPLAY_FNV_OFFSET_BASIS;
+    
+    checksum = liz_replay_checksum_value(checksum, (uint32_t)vm->actor_random_number_seed);
+    
+    liz_int_t const decider_state_count = liz_lookaside_stack_count(&vm->decider_state_stack_header);
+    checksum = liz_replay_checksum_value(checksum, (uint32_t)decider_state_count);
+    for (liz_int_t i = 0; i < decider_state_count; ++i) {
+        checksum = liz_replay_checksum_value(checksum, vm->decider_state_shape_atom_indices[i]);
+        checksum = liz_replay_checksum_value(checksum, vm->decider_states[i]);
+    }
+    
+    liz_int_t const action_state_count = liz_lookaside_stack_count(&vm->action_state_stack_header);
+    checksum = liz_replay_checksum_value(checksum, (uint32_t)action_state_count);
+    for (liz_int_t i = 0; i < action_state_count; ++i) {
+        checksum = liz_replay_checksum_value(checksum, vm->action_state_shape_atom_indices[i]);
+        checksum = liz_replay_checksum_value(checksum, vm->action_states[i]);
+    }
+    
+    // Only the state byte of persistent states is set, skip their padding.
+    liz_int_t const persistent_state_change_count = liz_lookaside_stack_count(&vm->persistent_state_change_stack_header);
+    checksum = liz_replay_checksum_value(checksum, (uint32_t)persistent_state_change_count);
+    for (liz_int_t i = 0; i < persistent_state_change_count; ++i) {
+        checksum = liz_replay_checksum_value(checksum, vm->persistent_state_change_shape_atom_indices[i]);
+        checksum = liz_replay_checksum_value(checksum, vm->persistent_state_changes[i].persistent_action.state);
+    }
+    
+    liz_lookaside_double_stack_t const *requests = &vm->action_request_stack_header;
+    liz_int_t const launch_count = liz_lookaside_double_stack_count(requests, LIZ_VM_ACTION_REQUEST_STACK_SIDE_LAUNCH);
+    liz_int_t const cancel_count = liz_lookaside_double_stack_count(requests, LIZ_VM_ACTION_REQUEST_STACK_SIDE_CANCEL);
+    checksum = liz_replay_checksum_value(checksum, (uint32_t)launch_count);
+    checksum = liz_replay_checksum_action_requests(checksum, 
+                                                   vm->action_requests, 
+                                                   launch_count);
+    checksum = liz_replay_checksum_value(checksum, (uint32_t)cancel_count);
+    checksum = liz_replay_checksum_action_requests(checksum, 
+                                                   vm->action_requests + liz_lookaside_double_stack_capacity(requests) - cancel_count, 
+                                                   cancel_count);
+    
+    return checksum;
+}
+
+
+
+void
+liz_replay_player_init(liz_replay_player_t *player,
+                       void const *log,
+                       size_t const log_size)
+{
+    liz_memset(player, 0, sizeof(*player));
+    
+    player->log = (uint8_t const *)log;
+    player->log_size = log_size;
+}
+
+
+
+bool
+liz_replay_player_peek(liz_replay_player_t const *player,
+                       liz_replay_update_record_t *record)
+{
+    if (player->log_size - player->read_offset < sizeof(*record)) {
+        return false;
+    }
+    
+    liz_memcpy(record, player->log + player->read_offset, sizeof(*record));
+    
+    return true;
+}
+
+
+
+liz_replay_status_t
+liz_replay_player_update_actor(liz_replay_player_t *player,
+                               liz_vm_t *vm,
+                               liz_vm_monitor_t *monitor,
+                               liz_vm_actor_t const *actor,
+                               liz_vm_shape_t const *shape)
+{
+    LIZ_ASSERT(LIZ_REPLAY_IMMEDIATE_ACTION_FUNCTION_CAPACITY >= shape->spec.immediate_action_function_count
+               && "Too many immediate action functions to replay.");
+    
+    if (player->read_offset == player->log_size) {
+        return liz_replay_status_end_of_log;
+    }
+    
+    liz_replay_update_record_t record;
+    
+    if (!liz_replay_player_peek(player, &record)) {
+        return liz_replay_status_malformed;
+    }
+    
+    size_t const update_byte_count = (size_t)record.action_state_update_count * LIZ_REPLAY_ACTION_STATE_UPDATE_BYTE_COUNT;
+    size_t const record_size = sizeof(record) + update_byte_count + record.immediate_action_call_byte_count;
+    
+    if (player->log_size - player->read_offset < record_size) {
+        return liz_replay_status_malformed;
+    }
+    
+    if (record.actor_id != actor->header->actor_id) {
+        return liz_replay_status_diverged;
+    }
+    
+    uint8_t const *updates = player->log + player->read_offset + sizeof(record);
+    player->read_offset += record_size;
+    
+    actor->header->random_number_seed = record.random_number_seed;
+    
+    for (liz_int_t i = 0; i < record.action_state_update_count; ++i) {
+        uint8_t const *update = updates + (size_t)i * LIZ_REPLAY_ACTION_STATE_UPDATE_BYTE_COUNT;
+        liz_index_t shape_atom_index = 0;
+        liz_memcpy(&shape_atom_index, update, sizeof(shape_atom_index));
+        
+        liz_replay_apply_action_state_update(actor, shape_atom_index, update[sizeof(liz_index_t)]);
+    }
+    
+    player->immediate_action_calls = updates + update_byte_count;
+    player->immediate_action_call_byte_count = record.immediate_action_call_byte_count;
+    player->immediate_action_call_offset = 0;
+    player->immediate_action_call_count = 0;
+    player->diverged = false;
+    
+    player->monitor = monitor;
+    player->shape = shape;
+    
+    liz_vm_shape_t playback_shape = *shape;
+    playback_shape.immediate_action_functions = liz_replay_play_functions;
+    
+    liz_vm_monitor_t playback_monitor;
+    playback_monitor.user_data = (uintptr_t)player;
+    playback_monitor.func = liz_replay_player_monitor_func;
+    playback_monitor.filter = (NULL != monitor) ? monitor->filter : NULL;
+    
+    liz_vm_update_actor(vm,
+                        (NULL != monitor) ? &playback_monitor : NULL,
+                        player,
+                        liz_replay_player_user_data_lookup,
+                        record.time,
+                        actor,
+                        &playback_shape);
+    
+    bool const matches = !player->diverged
+        && (player->immediate_action_call_offset == player->immediate_action_call_byte_count)
+        && (player->immediate_action_call_count == record.immediate_action_call_count)
+        && (liz_vm_action_request_count(vm) == record.action_request_count)
+        && (0u == (record.flags & LIZ_REPLAY_UPDATE_RECORD_FLAG_CHECKSUM)
+            || liz_replay_vm_result_checksum(vm) == record.result_checksum);
+    
+    return matches ? liz_replay_status_match : liz_replay_status_diverged;
+}
+
@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *
+ * Records the inputs of actor updates into a compact binary log and replays
+ * them bit-exactly to reproduce and verify the updates, e.g., to investigate
+ * production incidents.
+ *
+ * Recorded per actor update:
+ * - time and the actor's random number seed,
+ * - incoming action state updates for the actor,
+ * - the execution request and the return value of each immediate action 
+ *   call, and the random number seed if the call changed it,
+ * - the number of action requests, and, if enabled, a checksum of the 
+ *   resulting vm states and action requests to verify replays.
+ *
+ * Recording swaps the immediate action functions of the shape for recording
+ * trampolines that call the original functions, which costs one additional
+ * indirect call and a byte append per immediate action call. Shapes can
+ * therefore have at most LIZ_REPLAY_IMMEDIATE_ACTION_FUNCTION_CAPACITY 
+ * immediate action functions. Monitors still receive the actor blackboard
+ * and the original shape.
+ *
+ * Recording is not free: on an x86-64 test machine with an optimized 
+ * build each recorded immediate action call costs about 2 ns extra, which
+ * is about a quarter of an update whose immediate actions return 
+ * immediately. Recording only stays below 2% of the update cost if 
+ * immediate actions take more than about 100 ns on average. Checksums hash
+ * all action states, and for shapes with many running actions they double
+ * the recording cost, which is why they are disabled by default.
+ *
+ * Replaying feeds the logged immediate action return values back into the 
+ * vm instead of calling the game's immediate actions, so replays do not need
+ * the actor blackboards and monitors receive a NULL blackboard. The replayed
+ * actor must be in the state it had during recording, e.g., restored from an
+ * actor snapshot.
+ *
+ * Logs use the platform's byte order and type sizes, see the TODO in 
+ * liz_common.h.
+ */
+
+#ifndef LIZ_liz_replay_H
+#define LIZ_liz_replay_H
+
+
+#include <liz/liz_platform_types.h>
+#include <liz/liz_platform_macros.h>
+#include <liz/liz_common.h>
+#include <liz/liz_vm.h>
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+    
+    
+#define LIZ_REPLAY_IMMEDIATE_ACTION_FUNCTION_CAPACITY 32
+    
+    /**
+     * Set in the flags of update records which store a result checksum.
+     */
+#define LIZ_REPLAY_UPDATE_RECORD_FLAG_CHECKSUM 0x01u
+    
+    
+    
+    /**
+     * Header of the log record of one actor update, followed by 
+     * action_state_update_count packed shape atom index and state pairs and by
+     * immediate_action_call_byte_count bytes of immediate action calls.
+     *
+     * Records are stored unaligned, access them via memcpy.
+     */
+    typedef struct liz_replay_update_record {
+        liz_time_t time;
+        liz_id_t actor_id;
+        liz_random_number_seed_t random_number_seed;
+        uint32_t result_checksum;
+        liz_index_t action_state_update_count;
+        uint16_t immediate_action_call_count;
+        uint16_t immediate_action_call_byte_count;
+        liz_index_t action_request_count;
+        uint8_t flags;
+    } liz_replay_update_record_t;
+    
+    
+    
+    /**
+     * Appends update records to the log buffer. Treat as opaque.
+     *
+     * If a record does not fit into the remaining log capacity, or its 
+     * immediate action calls exceed the 16 bit counts of the record, it is 
+     * dropped and overflowed is set. Hand over the log content, e.g., to a 
+     * file, and clear the log before it overflows.
+     */
+    typedef struct liz_replay_recorder {
+        uint8_t *log;
+        size_t log_capacity;
+        size_t log_size;
+        
+        size_t record_offset;
+        uint16_t immediate_action_call_count;
+        bool overflowed;
+        bool checksum_enabled;
+        
+        void *user_data_lookup_context;
+        liz_vm_user_data_lookup_func_t user_data_lookup_func;
+        void *actor_blackboard;
+        liz_immediate_action_func_t const *immediate_action_functions;
+        liz_vm_monitor_t *monitor;
+        liz_vm_shape_t const *shape;
+    } liz_replay_recorder_t;
+    
+    
+    
+    typedef enum liz_replay_status {
+        liz_replay_status_match = 0, /**< Replayed update reproduced the recording. */
+        liz_replay_status_diverged, /**< Replayed update differs from the recording. */
+        liz_replay_status_end_of_log, /**< No more records to replay. */
+        liz_replay_status_malformed /**< Log data is truncated or invalid. */
+    } liz_replay_status_t;
+    
+    
+    
+    /**
+     * Reads update records from a log. Treat as opaque.
+     */
+    typedef struct liz_replay_player {
+        uint8_t const *log;
+        size_t log_size;
+        size_t read_offset;
+        
+        uint8_t const *immediate_action_calls;
+        size_t immediate_action_call_byte_count;
+        size_t immediate_action_call_offset;
+        uint16_t immediate_action_call_count;
+        bool diverged;
+        
+        liz_vm_monitor_t *monitor;
+        liz_vm_shape_t const *shape;
+    } liz_replay_player_t;
+    
+    
+    
+    void
+    liz_replay_recorder_init(liz_replay_recorder_t *recorder,
+                             void *log,
+                             size_t log_capacity);
+    
+    
+    /**
+     * Empties the log after its content has been handed over and resets the
+     * overflow flag.
+     */
+    void
+    liz_replay_recorder_clear(liz_replay_recorder_t *recorder);
+    
+    
+    /**
+     * If enabled, records also store a checksum of the resulting vm state 
+     * and action requests, which replays verify. Disabled after init, as
+     * checksumming costs about as much as recording the immediate action
+     * calls of an update.
+     */
+    void
+    liz_replay_recorder_set_checksum_enabled(liz_replay_recorder_t *recorder,
+                                             bool enabled);
+    
+    
+    /**
+     * Applies the action state updates to the actor, records them with all 
+     * other inputs of the update, and updates the actor via 
+     * liz_vm_update_actor.
+     *
+     * Updates for other actors and updates for actions without an action
+     * state, e.g., for already canceled actions, are ignored.
+     *
+     * Extract the actor state and action requests from the vm afterwards as
+     * usual.
+     */
+    void
+    liz_replay_record_update_actor(liz_replay_recorder_t *recorder,
+                                   liz_vm_t *vm,
+                                   liz_vm_monitor_t *monitor,
+                                   void * LIZ_RESTRICT user_data_lookup_context,
+                                   liz_vm_user_data_lookup_func_t user_data_lookup_func,
+                                   liz_time_t time,
+                                   liz_action_state_update_t const *action_state_updates,
+                                   liz_int_t action_state_update_count,
+                                   liz_vm_actor_t const *actor,
+                                   liz_vm_shape_t const *shape);
+    
+    
+    /**
+     * Sets the state of each actor action state that matches an action state
+     * update for the actor.
+     */
+    void
+    liz_replay_apply_action_state_updates(liz_vm_actor_t const *actor,
+                                          liz_action_state_update_t const *action_state_updates,
+                                          liz_int_t action_state_update_count);
+    
+    
+    /**
+     * Returns the checksum of the vm states and action requests a done vm
+     * update produced.
+     */
+    uint32_t
+    liz_replay_vm_result_checksum(liz_vm_t const *vm);
+    
+    
+    
+    void
+    liz_replay_player_init(liz_replay_player_t *player,
+                           void const *log,
+                           size_t log_size);
+    
+    
+    /**
+     * Reads the header of the next record without consuming it. Returns false
+     * if there is no complete record header left.
+     */
+    bool
+    liz_replay_player_peek(liz_replay_player_t const *player,
+                           liz_replay_update_record_t *record);
+    
+    
+    /**
+     * Replays the next record: sets the actor's random number seed, applies
+     * the recorded action state updates to the actor, updates it with vm, and
+     * verifies the immediate action calls, the action request count, and the
+     * result checksum.
+     *
+     * actor must belong to the recorded actor and be in its recorded state
+     * before the update. Extract the actor state and action requests from the 
+     * vm afterwards as usual.
+     */
+    liz_replay_status_t
+    liz_replay_player_update_actor(liz_replay_player_t *player,
+                                   liz_vm_t *vm,
+                                   liz_vm_monitor_t *monitor,
+                                   liz_vm_actor_t const *actor,
+                                   liz_vm_shape_t const *shape);
+    
+    
+    
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+
+#endif /* LIZ_liz_replay_H */
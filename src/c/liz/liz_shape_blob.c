@@ -0,0 +1,355 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "liz_shape_blob.h"
+
+#include "liz_assert.h"
+#include "liz_platform_functions.h"
+
+
+
+/**
+ * Byte offsets of the sections inside a blob.
+ */
+typedef struct liz_shape_blob_layout {
+    size_t atoms_offset;
+    size_t persistent_state_shape_atom_indices_offset;
+    size_t subtree_calls_offset;
+    size_t immediate_action_name_offsets_offset;
+    size_t immediate_action_names_offset;
+    size_t blob_size;
+} liz_shape_blob_layout_t;
+
+
+
+static
+size_t
+liz_shape_blob_align(size_t const offset)
+{
+    return (offset + (LIZ_SHAPE_BLOB_ALIGNMENT - 1u)) & ~((size_t)LIZ_SHAPE_BLOB_ALIGNMENT - 1u);
+}
+
+
+
+static
+liz_shape_blob_layout_t
+liz_shape_blob_layout(liz_shape_specification_t const spec,
+                      size_t const immediate_action_name_byte_count)
+{
+    liz_shape_blob_layout_t layout;
+    
+    size_t offset = liz_shape_blob_align(sizeof(liz_shape_blob_header_t));
+    
+    layout.atoms_offset = offset;
+    offset = liz_shape_blob_align(offset + sizeof(liz_shape_atom_t) * spec.shape_atom_count);
+    
+    layout.persistent_state_shape_atom_indices_offset = offset;
+    offset = liz_shape_blob_align(offset + sizeof(liz_index_t) * spec.persistent_state_count);
+    
+    layout.subtree_calls_offset = offset;
+    offset = liz_shape_blob_align(offset + sizeof(liz_shape_subtree_call_t) * spec.subtree_call_count);
+    
+    layout.immediate_action_name_offsets_offset = offset;
+    offset = liz_shape_blob_align(offset + sizeof(uint32_t) * spec.immediate_action_function_count);
+    
+    layout.immediate_action_names_offset = offset;
+    offset = liz_shape_blob_align(offset + immediate_action_name_byte_count);
+    
+    layout.blob_size = offset;
+    
+    return layout;
+}
+
+
+
+static
+size_t
+liz_shape_blob_immediate_action_name_byte_count(liz_int_t const immediate_action_function_count,
+                                                char const * const *immediate_action_names)
+{
+    size_t byte_count = 0;
+    
+    for (liz_int_t i = 0; i < immediate_action_function_count; ++i) {
+        byte_count += liz_strlen(immediate_action_names[i]) + 1u;
+    }
+    
+    return byte_count;
+}
+
+
+
+static
+liz_shape_blob_header_t const*
+liz_shape_blob_get_header(void const *blob)
+{
+    return (liz_shape_blob_header_t const *)blob;
+}
+
+
+
+static
+bool
+liz_shape_blob_section_is_valid(uint32_t const section_offset,
+                                size_t const section_size,
+                                size_t const blob_size)
+{
+    return (0u == (section_offset & (LIZ_SHAPE_BLOB_ALIGNMENT - 1u)))
+        && (sizeof(liz_shape_blob_header_t) <= section_offset)
+        && (section_offset <= blob_size)
+        && (section_size <= blob_size - section_offset);
+}
+
+
+
+liz_immediate_action_func_t
+liz_immediate_action_registry_lookup(liz_immediate_action_registry_t const *registry,
+                                     char const *name)
+{
+    for (liz_int_t i = 0; i < registry->count; ++i) {
+        if (0 == liz_strcmp(registry->names[i], name)) {
+            return registry->functions[i];
+        }
+    }
+    
+    return NULL;
+}
+
+
+
+size_t
+liz_shape_blob_memory_size_requirement(liz_vm_shape_t const *shape,
+                                       char const * const *immediate_action_names)
+{
+    size_t const name_byte_count = liz_shape_blob_immediate_action_name_byte_count(shape->spec.immediate_action_function_count,
+                                                                                   immediate_action_names);
+    
+    return liz_shape_blob_layout(shape->spec, name_byte_count).blob_size;
+}
+
+
+
+size_t
+liz_shape_blob_write(void *blob,
+                     size_t blob_capacity,
+                     liz_vm_shape_t const *shape,
+                     char const * const *immediate_action_names)
+{
+    LIZ_ASSERT(0u == ((uintptr_t)blob & (LIZ_SHAPE_BLOB_ALIGNMENT - 1u)) 
+               && "Blob must be aligned to LIZ_SHAPE_BLOB_ALIGNMENT.");
+    
+    liz_shape_specification_t const spec = shape->spec;
+    size_t const name_byte_count = liz_shape_blob_immediate_action_name_byte_count(spec.immediate_action_function_count,
+                                                                                   immediate_action_names);
+    liz_shape_blob_layout_t const layout = liz_shape_blob_layout(spec, name_byte_count);
+    
+    if (blob_capacity < layout.blob_size) {
+        return 0;
+    }
+    
+    char *bytes = (char *)blob;
+    
+    // Zero everything to not leak memory contents via padding into the blob
+    // and to allow byte-wise comparisons of blobs.
+    liz_memset(bytes, 0, layout.blob_size);
+    
+    liz_shape_blob_header_t header;
+    liz_memset(&header, 0, sizeof(header));
+    header.magic = LIZ_SHAPE_BLOB_MAGIC;
+    header.version = LIZ_SHAPE_BLOB_VERSION;
+    header.header_size = (uint16_t)sizeof(liz_shape_blob_header_t);
+    header.blob_size = (uint32_t)layout.blob_size;
+    header.atoms_offset = (uint32_t)layout.atoms_offset;
+    header.persistent_state_shape_atom_indices_offset = (uint32_t)layout.persistent_state_shape_atom_indices_offset;
+    header.subtree_calls_offset = (uint32_t)layout.subtree_calls_offset;
+    header.immediate_action_name_offsets_offset = (uint32_t)layout.immediate_action_name_offsets_offset;
+    header.spec = spec;
+    liz_memcpy(bytes, &header, sizeof(header));
+    
+    if (0 != spec.shape_atom_count) {
+        liz_memcpy(bytes + layout.atoms_offset,
+                   shape->atoms,
+                   sizeof(liz_shape_atom_t) * spec.shape_atom_count);
+    }
+    
+    if (0 != spec.persistent_state_count) {
+        liz_memcpy(bytes + layout.persistent_state_shape_atom_indices_offset,
+                   shape->persistent_state_shape_atom_indices,
+                   sizeof(liz_index_t) * spec.persistent_state_count);
+    }
+    
+    if (0 != spec.subtree_call_count) {
+        liz_memcpy(bytes + layout.subtree_calls_offset,
+                   shape->subtree_calls,
+                   sizeof(liz_shape_subtree_call_t) * spec.subtree_call_count);
+    }
+    
+    uint32_t *name_offsets = (uint32_t *)(bytes + layout.immediate_action_name_offsets_offset);
+    size_t name_offset = layout.immediate_action_names_offset;
+    
+    for (liz_int_t i = 0; i < spec.immediate_action_function_count; ++i) {
+        size_t const name_size = liz_strlen(immediate_action_names[i]) + 1u;
+        
+        name_offsets[i] = (uint32_t)name_offset;
+        liz_memcpy(bytes + name_offset, immediate_action_names[i], name_size);
+        
+        name_offset += name_size;
+    }
+    
+    return layout.blob_size;
+}
+
+
+
+bool
+liz_shape_blob_is_valid(void const *blob,
+                        size_t blob_size)
+{
+    if (NULL == blob
+        || sizeof(liz_shape_blob_header_t) > blob_size
+        || 0u != ((uintptr_t)blob & (LIZ_SHAPE_BLOB_ALIGNMENT - 1u))) {
+        
+        return false;
+    }
+    
+    liz_shape_blob_header_t const *header = liz_shape_blob_get_header(blob);
+    
+    if (LIZ_SHAPE_BLOB_MAGIC != header->magic
+        || LIZ_SHAPE_BLOB_VERSION != header->version
+        || sizeof(liz_shape_blob_header_t) != header->header_size
+        || blob_size < header->blob_size) {
+        
+        return false;
+    }
+    
+    size_t const size = header->blob_size;
+    liz_shape_specification_t const spec = header->spec;
+    
+    bool result = true;
+    result = result && liz_shape_blob_section_is_valid(header->atoms_offset, 
+                                                       sizeof(liz_shape_atom_t) * spec.shape_atom_count,
+                                                       size);
+    result = result && liz_shape_blob_section_is_valid(header->persistent_state_shape_atom_indices_offset,
+                                                       sizeof(liz_index_t) * spec.persistent_state_count,
+                                                       size);
+    result = result && liz_shape_blob_section_is_valid(header->subtree_calls_offset,
+                                                       sizeof(liz_shape_subtree_call_t) * spec.subtree_call_count,
+                                                       size);
+    result = result && liz_shape_blob_section_is_valid(header->immediate_action_name_offsets_offset,
+                                                       sizeof(uint32_t) * spec.immediate_action_function_count,
+                                                       size);
+    
+    if (!result) {
+        return false;
+    }
+    
+    // Names must be zero-terminated inside of the blob.
+    char const *bytes = (char const *)blob;
+    uint32_t const *name_offsets = (uint32_t const *)(bytes + header->immediate_action_name_offsets_offset);
+    
+    for (liz_int_t i = 0; i < spec.immediate_action_function_count; ++i) {
+        if (size <= name_offsets[i]
+            || NULL == liz_memchr(bytes + name_offsets[i], '\0', size - name_offsets[i])) {
+            
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+
+
+liz_shape_specification_t
+liz_shape_blob_specification(void const *blob)
+{
+    return liz_shape_blob_get_header(blob)->spec;
+}
+
+
+
+char const*
+liz_shape_blob_immediate_action_name(void const *blob,
+                                     liz_int_t index)
+{
+    liz_shape_blob_header_t const *header = liz_shape_blob_get_header(blob);
+    
+    LIZ_ASSERT(0 <= index && index < header->spec.immediate_action_function_count);
+    
+    char const *bytes = (char const *)blob;
+    uint32_t const *name_offsets = (uint32_t const *)(bytes + header->immediate_action_name_offsets_offset);
+    
+    return bytes + name_offsets[index];
+}
+
+
+
+bool
+liz_shape_blob_resolve_immediate_action_functions(void const *blob,
+                                                  liz_immediate_action_registry_t const *registry,
+                                                  liz_immediate_action_func_t *functions,
+                                                  liz_int_t function_capacity)
+{
+    liz_int_t const function_count = liz_shape_blob_get_header(blob)->spec.immediate_action_function_count;
+    
+    LIZ_ASSERT(function_count <= function_capacity);
+    (void)function_capacity;
+    
+    bool result = true;
+    
+    for (liz_int_t i = 0; i < function_count; ++i) {
+        functions[i] = liz_immediate_action_registry_lookup(registry,
+                                                            liz_shape_blob_immediate_action_name(blob, i));
+        
+        result = result && (NULL != functions[i]);
+    }
+    
+    return result;
+}
+
+
+
+void
+liz_shape_blob_get_shape(void const *blob,
+                         liz_immediate_action_func_t *immediate_action_functions,
+                         liz_vm_shape_t *shape)
+{
+    liz_shape_blob_header_t const *header = liz_shape_blob_get_header(blob);
+    char const *bytes = (char const *)blob;
+    
+    // The vm never writes through the shape pointers, casting away const 
+    // keeps read-only mapped blobs usable.
+    shape->atoms = (liz_shape_atom_t *)(bytes + header->atoms_offset);
+    shape->persistent_state_shape_atom_indices = (liz_index_t *)(bytes + header->persistent_state_shape_atom_indices_offset);
+    shape->subtree_calls = (liz_shape_subtree_call_t *)(bytes + header->subtree_calls_offset);
+    shape->immediate_action_functions = immediate_action_functions;
+    shape->spec = header->spec;
+}
+
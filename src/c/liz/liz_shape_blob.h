@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *
+ * Versioned binary shape format which stores all shape data relative to the
+ * start of the blob, alas is relocatable and can be memory mapped read-only 
+ * and shared between processes.
+ *
+ * Immediate action functions are stored by name and resolved via an 
+ * immediate action registry when loading a blob.
+ *
+ * Typical usage:
+ * 1. Write a shape and the names of its immediate action functions into a
+ *    buffer of liz_shape_blob_memory_size_requirement bytes via 
+ *    liz_shape_blob_write and store the buffer.
+ * 2. Load or map the blob and check it with liz_shape_blob_is_valid.
+ * 3. Resolve the immediate action functions via 
+ *    liz_shape_blob_resolve_immediate_action_functions.
+ * 4. Set up a vm shape pointing into the blob via liz_shape_blob_get_shape.
+ *    No data is copied or parsed.
+ *
+ * Blobs use the platform's byte order and type sizes and are only portable
+ * between processes of the same platform, see the TODO in liz_common.h.
+ */
+
+#ifndef LIZ_liz_shape_blob_H
+#define LIZ_liz_shape_blob_H
+
+
+#include <liz/liz_platform_types.h>
+#include <liz/liz_platform_macros.h>
+#include <liz/liz_common.h>
+#include <liz/liz_common_internal.h>
+#include <liz/liz_vm.h>
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+    
+    
+#define LIZ_SHAPE_BLOB_MAGIC 0x4C5A5348u
+#define LIZ_SHAPE_BLOB_VERSION 1u
+    
+    /**
+     * Alignment of the blob start and of all sections inside the blob.
+     */
+#define LIZ_SHAPE_BLOB_ALIGNMENT 8u
+    
+    
+    
+    /**
+     * Starts every shape blob. Offsets are in bytes from the blob start. 
+     *
+     * immediate_action_name_offsets_offset points to an array of 
+     * spec.immediate_action_function_count offsets of zero-terminated 
+     * immediate action function names.
+     */
+    typedef struct liz_shape_blob_header {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t header_size;
+        uint32_t blob_size;
+        
+        uint32_t atoms_offset;
+        uint32_t persistent_state_shape_atom_indices_offset;
+        uint32_t subtree_calls_offset;
+        uint32_t immediate_action_name_offsets_offset;
+        
+        liz_shape_specification_t spec;
+    } liz_shape_blob_header_t;
+    
+    
+    
+    /**
+     * Maps immediate action function names to functions.
+     *
+     * Names and functions are not owned by the registry.
+     */
+    typedef struct liz_immediate_action_registry {
+        char const * const *names;
+        liz_immediate_action_func_t const *functions;
+        liz_int_t count;
+    } liz_immediate_action_registry_t;
+    
+    
+    
+    /**
+     * Returns the function registered for name or NULL if name is not 
+     * registered.
+     */
+    liz_immediate_action_func_t
+    liz_immediate_action_registry_lookup(liz_immediate_action_registry_t const *registry,
+                                         char const *name);
+    
+    
+    
+    /**
+     * Returns the number of bytes needed to store shape and the names of its 
+     * immediate action functions in a blob.
+     *
+     * immediate_action_names must contain a name for each of the shape's 
+     * immediate action functions, otherwise behavior is undefined.
+     */
+    size_t
+    liz_shape_blob_memory_size_requirement(liz_vm_shape_t const *shape,
+                                           char const * const *immediate_action_names);
+    
+    
+    
+    /**
+     * Writes shape and its immediate action names into blob and returns the 
+     * number of bytes written.
+     *
+     * Returns 0 and writes nothing if blob_capacity is smaller than 
+     * liz_shape_blob_memory_size_requirement.
+     *
+     * blob must be aligned to LIZ_SHAPE_BLOB_ALIGNMENT, otherwise behavior is
+     * undefined.
+     */
+    size_t
+    liz_shape_blob_write(void *blob,
+                         size_t blob_capacity,
+                         liz_vm_shape_t const *shape,
+                         char const * const *immediate_action_names);
+    
+    
+    
+    /**
+     * Returns true if blob starts with a shape blob header of the supported 
+     * version and all sections lie aligned inside of blob_size bytes, 
+     * otherwise returns false.
+     *
+     * Call before interpreting loaded data as a shape blob.
+     */
+    bool
+    liz_shape_blob_is_valid(void const *blob,
+                            size_t blob_size);
+    
+    
+    
+    liz_shape_specification_t
+    liz_shape_blob_specification(void const *blob);
+    
+    
+    
+    /**
+     * Returns the zero-terminated name of the indexed immediate action 
+     * function stored in blob.
+     */
+    char const*
+    liz_shape_blob_immediate_action_name(void const *blob,
+                                         liz_int_t index);
+    
+    
+    
+    /**
+     * Looks up the immediate action functions named in blob in registry and
+     * stores them in the order expected by the shape atoms in functions.
+     *
+     * Returns false if a name isn't registered, otherwise returns true.
+     *
+     * function_capacity must be at least the immediate action function count
+     * of the blob's shape specification, otherwise behavior is undefined.
+     */
+    bool
+    liz_shape_blob_resolve_immediate_action_functions(void const *blob,
+                                                      liz_immediate_action_registry_t const *registry,
+                                                      liz_immediate_action_func_t *functions,
+                                                      liz_int_t function_capacity);
+    
+    
+    
+    /**
+     * Sets up shape to point into blob and to use the resolved immediate 
+     * action functions.
+     *
+     * The vm only reads shape data, alas the blob can be mapped read-only.
+     * blob must stay valid and in place as long as shape is used.
+     */
+    void
+    liz_shape_blob_get_shape(void const *blob,
+                             liz_immediate_action_func_t *immediate_action_functions,
+                             liz_vm_shape_t *shape);
+    
+    
+    
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+
+#endif /* LIZ_liz_shape_blob_H */
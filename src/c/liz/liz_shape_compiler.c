@@ -0,0 +1,503 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *
+ * Implementation of the shape to C compiler.
+ */
+
+#include "liz_shape_compiler.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "liz_assert.h"
+#include "liz_common_internal.h"
+
+
+
+/**
+ * Appends formatted text to source, counts the full length even if source
+ * is exhausted.
+ */
+typedef struct liz_source_writer {
+    char *source;
+    liz_int_t capacity;
+    liz_int_t length;
+} liz_source_writer_t;
+
+
+
+static
+void
+liz_source_writer_append_va(liz_source_writer_t *writer,
+                            char const *format,
+                            va_list args)
+{
+    char *free_source = NULL;
+    size_t free_capacity = 0u;
+    
+    if (NULL != writer->source && writer->length < writer->capacity) {
+        free_source = writer->source + writer->length;
+        free_capacity = (size_t)(writer->capacity - writer->length);
+    }
+    
+    int const appended_length = vsnprintf(free_source, free_capacity, format, args);
+    
+    LIZ_ASSERT(0 <= appended_length);
+    
+    writer->length += (liz_int_t)appended_length;
+}
+
+
+
+static
+void
+liz_source_writer_append(liz_source_writer_t *writer,
+                         char const *format,
+                         ...)
+{
+    va_list args;
+    va_start(args, format);
+    liz_source_writer_append_va(writer, format, args);
+    va_end(args);
+}
+
+
+
+/**
+ * Appends a line indented by indentation spaces.
+ */
+static
+void
+liz_source_writer_append_line(liz_source_writer_t *writer,
+                              int const indentation,
+                              char const *format,
+                              ...)
+{
+    liz_source_writer_append(writer, "%*s", indentation, "");
+    
+    va_list args;
+    va_start(args, format);
+    liz_source_writer_append_va(writer, format, args);
+    va_end(args);
+    
+    liz_source_writer_append(writer, "\n");
+}
+
+
+
+/**
+ * Returns the number of spaces to align parameters behind the opening 
+ * parenthesis following name.
+ */
+static
+int
+liz_shape_compiler_indentation(char const *name)
+{
+    return (int)strlen(name) + 1;
+}
+
+
+
+static
+char const*
+liz_shape_compiler_function_name(char const * const *immediate_action_function_names,
+                                 liz_int_t const function_index)
+{
+    if (NULL == immediate_action_function_names) {
+        return NULL;
+    }
+    
+    return immediate_action_function_names[function_index];
+}
+
+
+
+/**
+ * Returns the index of the persistent state of the persistent action at 
+ * shape_atom_index or -1 if shape has none for it.
+ */
+static
+liz_int_t
+liz_shape_compiler_persistent_state_index(liz_vm_shape_t const *shape,
+                                          liz_int_t const shape_atom_index)
+{
+    for (liz_int_t i = 0; i < (liz_int_t)shape->spec.persistent_state_count; ++i) {
+        if ((liz_index_t)shape_atom_index == shape->persistent_state_shape_atom_indices[i]) {
+            return i;
+        }
+    }
+    
+    return -1;
+}
+
+
+
+static
+void
+liz_shape_compiler_write_monitor_node(liz_source_writer_t *writer,
+                                      int const indentation,
+                                      liz_int_t const shape_atom_index,
+                                      char const *traversal_flag)
+{
+    liz_source_writer_append_line(writer,
+                                  indentation,
+                                  "LIZ_VM_MONITOR_NODE(monitor, %ld, liz_vm_monitor_node_flag_%s, vm, actor_blackboard, time, actor, shape);",
+                                  (long)shape_atom_index,
+                                  traversal_flag);
+}
+
+
+
+static
+void
+liz_shape_compiler_write_immediate_action(liz_source_writer_t *writer,
+                                          int const indentation,
+                                          liz_int_t const shape_atom_index,
+                                          liz_int_t const function_index,
+                                          char const *function_name)
+{
+    liz_source_writer_append_line(writer, indentation, "// Immediate action %ld.", (long)shape_atom_index);
+    liz_source_writer_append_line(writer, indentation, "liz_execution_state_t execution_state = liz_vm_step_begin_immediate_action(vm, monitor, actor_blackboard, time, actor, shape);");
+    liz_source_writer_append_line(writer, indentation, "LIZ_VM_COUNT_CYCLES_BEGIN(tick_begin_cycles);");
+    
+    if (NULL != function_name) {
+        liz_source_writer_append_line(writer, 
+                                      indentation, 
+                                      "execution_state = %s(actor_blackboard, &vm->actor_random_number_seed, time, execution_state);",
+                                      function_name);
+    } else {
+        liz_source_writer_append_line(writer, 
+                                      indentation, 
+                                      "execution_state = shape->immediate_action_functions[%ld](actor_blackboard, &vm->actor_random_number_seed, time, execution_state);",
+                                      (long)function_index);
+    }
+    
+    liz_source_writer_append_line(writer, indentation, "LIZ_VM_COUNT_CYCLES_END(tick_begin_cycles, vm, %ld);", (long)shape_atom_index);
+    liz_source_writer_append_line(writer, indentation, "liz_vm_step_end_immediate_action(vm, monitor, actor_blackboard, time, actor, shape, execution_state);");
+}
+
+
+
+static
+void
+liz_shape_compiler_write_deferred_action(liz_source_writer_t *writer,
+                                         int const indentation,
+                                         liz_int_t const shape_atom_index,
+                                         liz_int_t const stream_index)
+{
+    liz_source_writer_append_line(writer, indentation, "// Deferred action %ld.", (long)shape_atom_index);
+    liz_shape_compiler_write_monitor_node(writer, indentation, shape_atom_index, "enter_from_top");
+    liz_source_writer_append_line(writer, indentation, "liz_vm_invoke_deferred_action(vm, actor, &shape->atoms[%ld]);", (long)stream_index);
+    liz_source_writer_append_line(writer, indentation, "vm->cmd = liz_vm_cmd_guard_decider;");
+    liz_shape_compiler_write_monitor_node(writer, indentation, shape_atom_index, "leave_to_top");
+}
+
+
+
+static
+void
+liz_shape_compiler_write_persistent_action(liz_source_writer_t *writer,
+                                           int const indentation,
+                                           liz_int_t const shape_atom_index,
+                                           liz_int_t const persistent_state_index)
+{
+    liz_source_writer_append_line(writer, indentation, "// Persistent action %ld.", (long)shape_atom_index);
+    liz_shape_compiler_write_monitor_node(writer, indentation, shape_atom_index, "enter_from_top");
+    liz_source_writer_append_line(writer, indentation, "liz_execution_state_t execution_state = (liz_execution_state_t)(actor->persistent_states[%ld].persistent_action.state);", (long)persistent_state_index);
+    liz_source_writer_append_line(writer, indentation, "LIZ_VM_CATCH_INVALID_PERSISTENT_AND_IMMEDIATE_ACTION_STATE(&execution_state);");
+    liz_source_writer_append_line(writer, indentation, "vm->actor_persistent_state_index = %ld;", (long)(persistent_state_index + 1));
+    liz_source_writer_append_line(writer, indentation, "vm->shape_atom_index = %ld;", (long)(shape_atom_index + LIZ_NODE_SHAPE_ATOM_COUNT_PERSISTENT_ACTION));
+    liz_source_writer_append_line(writer, indentation, "vm->execution_state = execution_state;");
+    liz_source_writer_append_line(writer, indentation, "vm->cmd = liz_vm_cmd_guard_decider;");
+    liz_shape_compiler_write_monitor_node(writer, indentation, shape_atom_index, "leave_to_top");
+}
+
+
+
+/**
+ * Writes the block of the node at shape_atom_index and of its children and
+ * returns the shape atom index following the node, or -1 if the node or one
+ * of its children can't be compiled.
+ *
+ * The vm enters a decider child if the decider or its guard chose it,
+ * alas if the vm's shape atom index is the child's one. Otherwise the child
+ * is skipped like the interpreting vm skips it.
+ */
+static
+liz_int_t
+liz_shape_compiler_write_node(liz_source_writer_t *writer,
+                              int const indentation,
+                              liz_vm_shape_t const *shape,
+                              char const * const *immediate_action_function_names,
+                              liz_int_t *subtree_call_index,
+                              liz_int_t const shape_atom_index)
+{
+    liz_int_t const shape_atom_index_count = liz_shape_specification_shape_atom_index_count(shape->spec);
+    
+    if (shape_atom_index >= shape_atom_index_count) {
+        return -1;
+    }
+    
+    liz_shape_atom_t const *atom = liz_vm_shape_atom(shape, subtree_call_index, shape_atom_index);
+    liz_int_t const stream_index = (liz_int_t)(atom - shape->atoms);
+    
+    char const *decider_name = NULL;
+    char const *decider_function_suffix = NULL;
+    liz_int_t end_index = -1;
+    
+    switch ((liz_node_type_t)atom->type_mask.type) {
+        case liz_node_type_immediate_action: {
+            liz_int_t const function_index = (liz_int_t)atom->immediate_action.function_index;
+            
+            if (function_index >= (liz_int_t)shape->spec.immediate_action_function_count) {
+                return -1;
+            }
+            
+            liz_shape_compiler_write_immediate_action(writer,
+                                                      indentation,
+                                                      shape_atom_index,
+                                                      function_index,
+                                                      liz_shape_compiler_function_name(immediate_action_function_names, function_index));
+            
+            return shape_atom_index + LIZ_NODE_SHAPE_ATOM_COUNT_IMMEDIATE_ACTION;
+        }
+            
+        case liz_node_type_deferred_action:
+            liz_shape_compiler_write_deferred_action(writer,
+                                                     indentation,
+                                                     shape_atom_index,
+                                                     stream_index);
+            
+            return shape_atom_index + LIZ_NODE_SHAPE_ATOM_COUNT_DEFERRED_ACTION;
+            
+        case liz_node_type_persistent_action: {
+            liz_int_t const persistent_state_index = liz_shape_compiler_persistent_state_index(shape, shape_atom_index);
+            
+            if (0 > persistent_state_index) {
+                return -1;
+            }
+            
+            liz_shape_compiler_write_persistent_action(writer,
+                                                       indentation,
+                                                       shape_atom_index,
+                                                       persistent_state_index);
+            
+            return shape_atom_index + LIZ_NODE_SHAPE_ATOM_COUNT_PERSISTENT_ACTION;
+        }
+            
+        case liz_node_type_sequence_decider:
+            decider_name = "Sequence decider";
+            decider_function_suffix = "sequence_decider";
+            end_index = shape_atom_index + (liz_int_t)atom->sequence_decider.end_offset;
+            break;
+            
+        case liz_node_type_dynamic_priority_decider:
+            decider_name = "Dynamic priority decider";
+            decider_function_suffix = "dynamic_priority_decider";
+            end_index = shape_atom_index + (liz_int_t)atom->dynamic_priority_decider.end_offset;
+            break;
+            
+        case liz_node_type_concurrent_decider:
+            decider_name = "Concurrent decider";
+            decider_function_suffix = "concurrent_decider";
+            end_index = shape_atom_index + (liz_int_t)atom->concurrent_decider.end_offset;
+            break;
+            
+        default:
+            // Subtree calls are resolved by liz_vm_shape_atom, other types 
+            // aren't invoked by the vm.
+            return -1;
+    }
+    
+    // Childless deciders are malformed.
+    liz_int_t child_shape_atom_index = shape_atom_index + 1;
+    
+    if (child_shape_atom_index >= end_index || end_index > shape_atom_index_count) {
+        return -1;
+    }
+    
+    liz_source_writer_append_line(writer, indentation, "// %s %ld.", decider_name, (long)shape_atom_index);
+    liz_shape_compiler_write_monitor_node(writer, indentation, shape_atom_index, "enter_from_top");
+    liz_source_writer_append_line(writer, indentation, "liz_vm_invoke_%s(vm, actor, &shape->atoms[%ld]);", decider_function_suffix, (long)stream_index);
+    liz_shape_compiler_write_monitor_node(writer, indentation, shape_atom_index, "leave_to_bottom");
+    
+    while (child_shape_atom_index < end_index) {
+        liz_source_writer_append_line(writer, indentation, "");
+        liz_source_writer_append_line(writer, indentation, "if (%ld == vm->shape_atom_index) {", (long)child_shape_atom_index);
+        
+        child_shape_atom_index = liz_shape_compiler_write_node(writer,
+                                                               indentation + 4,
+                                                               shape,
+                                                               immediate_action_function_names,
+                                                               subtree_call_index,
+                                                               child_shape_atom_index);
+        
+        if (0 > child_shape_atom_index) {
+            return -1;
+        }
+        
+        // Guard the decider after each child it entered.
+        liz_source_writer_append_line(writer, indentation + 4, "");
+        liz_shape_compiler_write_monitor_node(writer, indentation + 4, shape_atom_index, "enter_from_bottom");
+        liz_source_writer_append_line(writer, indentation + 4, "liz_vm_guard_%s(vm);", decider_function_suffix);
+        liz_source_writer_append_line(writer, indentation + 4, "liz_vm_leave_decider_guard(vm, monitor, actor_blackboard, time, actor, shape);");
+        liz_source_writer_append_line(writer, indentation, "}");
+    }
+    
+    // The last child must end where the decider ends.
+    if (child_shape_atom_index != end_index) {
+        return -1;
+    }
+    
+    return end_index;
+}
+
+
+
+liz_int_t
+liz_shape_compile_to_c(char *source,
+                       liz_int_t const source_capacity,
+                       char const *function_name,
+                       liz_vm_shape_t const *shape,
+                       char const * const *immediate_action_function_names)
+{
+    LIZ_ASSERT(0 <= source_capacity);
+    
+    if (NULL == function_name) {
+        return -1;
+    }
+    
+    liz_source_writer_t writer = {source, source_capacity, 0};
+    
+    if (NULL != source && 0 < source_capacity) {
+        source[0] = '\0';
+    }
+    
+    liz_int_t const shape_atom_index_count = liz_shape_specification_shape_atom_index_count(shape->spec);
+    liz_int_t const function_count = (liz_int_t)shape->spec.immediate_action_function_count;
+    
+    if (0 == shape_atom_index_count) {
+        return -1;
+    }
+    
+    liz_source_writer_append(&writer,
+                             "/*\n"
+                             " * Generated by liz_shape_compile_to_c - do not edit, regenerate when the\n"
+                             " * shape changes.\n"
+                             " */\n"
+                             "\n"
+                             "#include <liz/liz_assert.h>\n"
+                             "#include <liz/liz_vm.h>\n"
+                             "\n\n\n");
+    
+    // Declare the directly called immediate action functions.
+    for (liz_int_t i = 0; i < function_count; ++i) {
+        char const *name = liz_shape_compiler_function_name(immediate_action_function_names, i);
+        
+        if (NULL != name) {
+            liz_source_writer_append(&writer,
+                                     "liz_execution_state_t\n"
+                                     "%s(void *actor_blackboard,\n"
+                                     "%*sliz_random_number_seed_t *random_number_seed,\n"
+                                     "%*sliz_time_t time,\n"
+                                     "%*sliz_execution_state_t execution_request);\n"
+                                     "\n\n\n",
+                                     name,
+                                     liz_shape_compiler_indentation(name), "",
+                                     liz_shape_compiler_indentation(name), "",
+                                     liz_shape_compiler_indentation(name), "");
+        }
+    }
+    
+    liz_source_writer_append(&writer,
+                             "static\n"
+                             "void\n"
+                             "%s(liz_vm_t *vm,\n"
+                             "%*sliz_vm_monitor_t *monitor,\n"
+                             "%*svoid * LIZ_RESTRICT user_data_lookup_context,\n"
+                             "%*sliz_vm_user_data_lookup_func_t user_data_lookup_func,\n"
+                             "%*sliz_time_t const time,\n"
+                             "%*sliz_vm_actor_t const *actor,\n"
+                             "%*sliz_vm_shape_t const *shape)\n"
+                             "{\n"
+                             "    LIZ_ASSERT(%ld == liz_shape_specification_shape_atom_index_count(shape->spec)\n"
+                             "               && %ld == shape->spec.immediate_action_function_count\n"
+                             "               && \"Shape differs from the compiled one.\");\n"
+                             "    LIZ_ASSERT(liz_vm_fulfills_shape_specification(vm, shape->spec));\n"
+                             "    \n"
+                             "    if (!liz_vm_begin_update_actor(vm, actor, shape)) {\n"
+                             "        return;\n"
+                             "    }\n"
+                             "    \n"
+                             "    void *actor_blackboard = user_data_lookup_func(user_data_lookup_context,\n"
+                             "                                                   actor->header->user_data);\n"
+                             "    \n"
+                             "    LIZ_VM_STATS_CYCLES_BEGIN(update_begin_cycles);\n"
+                             "    {\n",
+                             function_name,
+                             liz_shape_compiler_indentation(function_name), "",
+                             liz_shape_compiler_indentation(function_name), "",
+                             liz_shape_compiler_indentation(function_name), "",
+                             liz_shape_compiler_indentation(function_name), "",
+                             liz_shape_compiler_indentation(function_name), "",
+                             liz_shape_compiler_indentation(function_name), "",
+                             (long)shape_atom_index_count,
+                             (long)function_count);
+    
+    // The root is the only node without a decider, it always runs and its 
+    // end is the end of the shape.
+    liz_int_t subtree_call_index = 0;
+    liz_int_t const root_end_index = liz_shape_compiler_write_node(&writer,
+                                                                   8,
+                                                                   shape,
+                                                                   immediate_action_function_names,
+                                                                   &subtree_call_index,
+                                                                   0);
+    
+    if (root_end_index != shape_atom_index_count) {
+        return -1;
+    }
+    
+    liz_source_writer_append(&writer,
+                             "    }\n"
+                             "    \n"
+                             "    // The root has been left to its top.\n"
+                             "    vm->cmd = liz_vm_cmd_cleanup;\n"
+                             "    liz_vm_step_cleanup(vm, monitor, actor_blackboard, time, actor, shape);\n"
+                             "    LIZ_VM_STATS_CYCLES_END(update_begin_cycles, vm);\n"
+                             "}\n");
+    
+    return writer.length;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *
+ * Ahead of time compilation of a finalized shape into C source of a shape
+ * specific update function.
+ *
+ * The generated function has the signature of liz_vm_update_actor and 
+ * leaves vm exactly like liz_vm_update_actor would for the shape it was 
+ * compiled from. Instead of stepping through the shape atom stream it 
+ * traverses the shape with structured control flow - one nested block per 
+ * node, decider children are entered if their decider or its guard chose
+ * them, and each child is followed by the guard of its decider type. Shape 
+ * atoms and persistent states are accessed at the constant offsets of their
+ * nodes, immediate actions are called directly by name so the C compiler 
+ * can inline them.
+ *
+ * Decider and action states of the actor are sparse, they are still sought
+ * by the invocations of the vm which the generated code calls per node.
+ *
+ * Typical usage:
+ * 1. Compile the hottest shapes offline and include each generated source, 
+ *    it defines a static function, into the translation unit updating the
+ *    actors of its shape.
+ * 2. Call the generated function instead of liz_vm_update_actor for actors 
+ *    of the compiled shape.
+ * 3. Regenerate the sources whenever a compiled shape changes.
+ */
+
+#ifndef LIZ_liz_shape_compiler_H
+#define LIZ_liz_shape_compiler_H
+
+
+#include <liz/liz_platform_types.h>
+#include <liz/liz_platform_macros.h>
+#include <liz/liz_common.h>
+#include <liz/liz_vm.h>
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+    
+    
+    /**
+     * Writes the C source of an update function named function_name for 
+     * shape into source, at most source_capacity characters including the 
+     * terminating null character.
+     *
+     * immediate_action_function_names holds the name of the C function for
+     * each immediate action function of shape. Immediate actions without
+     * name, or all if immediate_action_function_names is NULL, are called
+     * through the shape's immediate action functions. Names are not checked
+     * to be valid C identifiers.
+     *
+     * Returns the length of the complete source without the terminating null
+     * character - if it isn't less than source_capacity the source has been
+     * truncated, call with NULL and 0 to query the length. Returns -1 if
+     * function_name is NULL or shape contains nodes the vm can't invoke,
+     * childless deciders, or persistent actions without persistent state.
+     */
+    liz_int_t
+    liz_shape_compile_to_c(char *source,
+                           liz_int_t source_capacity,
+                           char const *function_name,
+                           liz_vm_shape_t const *shape,
+                           char const * const *immediate_action_function_names);
+    
+    
+    
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+
+#endif /* LIZ_liz_shape_compiler_H */
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "liz_sliced_update.h"
+
+#include "liz_assert.h"
+#include "liz_platform_functions.h"
+
+
+
+static
+bool
+liz_update_budget_is_exhausted(liz_update_budget_t const budget,
+                               liz_int_t const step_count,
+                               uint64_t const begin_cycles)
+{
+    if (0 != budget.max_step_count 
+        && budget.max_step_count <= step_count) {
+        return true;
+    }
+    
+    if (0u != budget.max_cycle_count 
+        && budget.max_cycle_count <= liz_cycle_count() - begin_cycles) {
+        return true;
+    }
+    
+    return false;
+}
+
+
+
+static
+void*
+liz_sliced_update_placement_alloc(void *vm_memory,
+                                  size_t const requested_bytes)
+{
+    (void)requested_bytes;
+    
+    return vm_memory;
+}
+
+
+
+#pragma mark Create and destroy sliced update
+
+liz_sliced_update_t*
+liz_sliced_update_create(liz_shape_specification_t const spec,
+                         void * LIZ_RESTRICT allocator_context,
+                         liz_alloc_func_t alloc_func)
+{
+    // Place the vm behind the sliced update in one allocation.
+    size_t const sliced_update_size = liz_allocation_size_aggregate(LIZ_VM_ALIGNMENT,
+                                                                    sizeof(liz_sliced_update_t),
+                                                                    LIZ_VM_ALIGNMENT,
+                                                                    liz_vm_memory_size_requirement(spec));
+    liz_sliced_update_t *sliced_update = (liz_sliced_update_t *)alloc_func(allocator_context, 
+                                                                           sliced_update_size);
+    
+    if (NULL == sliced_update) {
+        return NULL;
+    }
+    
+    char *vm_memory = (char *)(sliced_update + 1);
+    vm_memory += liz_allocation_alignment_offset(vm_memory, LIZ_VM_ALIGNMENT);
+    
+    sliced_update->vm = liz_vm_create(spec, vm_memory, liz_sliced_update_placement_alloc);
+    sliced_update->parked_time = 0;
+    sliced_update->action_request_capacity = (liz_int_t)spec.action_request_capacity;
+    
+    liz_sliced_update_reset(sliced_update);
+    
+    return sliced_update;
+}
+
+
+
+void
+liz_sliced_update_destroy(liz_sliced_update_t *sliced_update,
+                          void * LIZ_RESTRICT allocator_context,
+                          liz_dealloc_func_t dealloc_func)
+{
+    dealloc_func(allocator_context, sliced_update);
+}
+
+
+
+void
+liz_sliced_update_reset(liz_sliced_update_t *sliced_update)
+{
+    sliced_update->batch_index = 0;
+    sliced_update->last_step_count = 0;
+    sliced_update->batch_pending = false;
+    sliced_update->actor_parked = false;
+}
+
+
+
+#pragma mark Run sliced update
+
+liz_int_t
+liz_sliced_update_run(liz_sliced_update_t *sliced_update,
+                      liz_update_budget_t const budget,
+                      liz_actor_clip_t *clip,
+                      uint32_t const *actor_indices,
+                      liz_int_t const actor_index_count,
+                      liz_vm_monitor_t *monitor,
+                      void * LIZ_RESTRICT user_data_lookup_context,
+                      liz_vm_user_data_lookup_func_t user_data_lookup_func,
+                      liz_time_t const time,
+                      liz_action_request_t *requests,
+                      liz_int_t const request_capacity,
+                      liz_vm_shape_t const *shape)
+{
+    LIZ_ASSERT(0 <= budget.max_step_count);
+    LIZ_ASSERT(sliced_update->batch_index <= actor_index_count 
+               && "Pass the same batch until the sliced update isn't pending anymore.");
+    
+    liz_vm_t *vm = sliced_update->vm;
+    uint64_t const begin_cycles = (0u != budget.max_cycle_count) ? liz_cycle_count() : 0u;
+    liz_int_t step_count = 0;
+    liz_int_t request_count = 0;
+    
+    sliced_update->batch_pending = true;
+    
+    while (sliced_update->batch_index < actor_index_count) {
+        
+        if (liz_update_budget_is_exhausted(budget, step_count, begin_cycles)
+            || request_capacity - request_count < sliced_update->action_request_capacity) {
+            
+            break;
+        }
+        
+        liz_int_t const actor_index = (NULL != actor_indices) ? (liz_int_t)actor_indices[sliced_update->batch_index] : sliced_update->batch_index;
+        liz_vm_actor_t actor = liz_actor_clip_actor(clip, actor_index);
+        
+        if (!sliced_update->actor_parked) {
+            if (!liz_vm_begin_update_actor(vm, &actor, shape)) {
+                ++(sliced_update->batch_index);
+                continue;
+            }
+            
+            sliced_update->parked_time = time;
+            sliced_update->actor_parked = true;
+        }
+        
+        void *actor_blackboard = user_data_lookup_func(user_data_lookup_context,
+                                                       actor.header->user_data);
+        
+        // Step in chunks to only read the cycle counter every few steps.
+        while (liz_vm_is_running(vm)
+               && !liz_update_budget_is_exhausted(budget, step_count, begin_cycles)) {
+            
+            liz_int_t max_chunk_step_count = LIZ_SLICED_UPDATE_CYCLE_CHECK_STEP_COUNT;
+            
+            if (0 != budget.max_step_count
+                && budget.max_step_count - step_count < max_chunk_step_count) {
+                
+                max_chunk_step_count = budget.max_step_count - step_count;
+            }
+            
+            step_count += liz_vm_step_update_actor(vm,
+                                                   monitor,
+                                                   actor_blackboard,
+                                                   sliced_update->parked_time,
+                                                   &actor,
+                                                   shape,
+                                                   max_chunk_step_count);
+        }
+        
+        if (liz_vm_is_running(vm)) {
+            // Budget exhausted - the actor stays parked in vm.
+            break;
+        }
+        
+        request_count += liz_vm_extract_action_requests(vm,
+                                                        requests + request_count,
+                                                        request_capacity - request_count,
+                                                        actor.header->actor_id);
+        liz_vm_extract_actor_state(vm, &actor, shape);
+        
+        sliced_update->actor_parked = false;
+        ++(sliced_update->batch_index);
+    }
+    
+    if (actor_index_count == sliced_update->batch_index) {
+        sliced_update->batch_index = 0;
+        sliced_update->batch_pending = false;
+    }
+    
+    sliced_update->last_step_count = step_count;
+    
+    return request_count;
+}
+
+
+
+bool
+liz_sliced_update_is_pending(liz_sliced_update_t const *sliced_update)
+{
+    return sliced_update->batch_pending;
+}
+
+
+
+liz_int_t
+liz_sliced_update_last_step_count(liz_sliced_update_t const *sliced_update)
+{
+    return sliced_update->last_step_count;
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *
+ * Time sliced actor updates - updates a batch of clip actors within a step
+ * and cycle budget per call and parks the actor whose update exhausts the
+ * budget inside its vm to resume it with the next call.
+ *
+ * liz_vm_update_actor runs an actor's behavior tree to completion, so a
+ * single pathological tree can blow a frame. A sliced update caps the vm 
+ * work per call instead, alas caps the worst case latency per frame, at the
+ * price of spreading the batch update over multiple calls.
+ *
+ * Typical usage:
+ * 1. Create a sliced update per actor clip and shape.
+ * 2. Each frame call liz_sliced_update_run with the frame's budget.
+ * 3. While liz_sliced_update_is_pending returns true pass the same batch 
+ *    again, otherwise the next call begins a new batch.
+ */
+
+#ifndef LIZ_liz_sliced_update_H
+#define LIZ_liz_sliced_update_H
+
+
+#include <liz/liz_platform_types.h>
+#include <liz/liz_platform_macros.h>
+#include <liz/liz_allocator.h>
+#include <liz/liz_common.h>
+#include <liz/liz_vm.h>
+#include <liz/liz_actor_clip.h>
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+    
+    
+    /**
+     * Number of vm steps between two checks of the cycle budget - reading the
+     * cycle counter costs about as much as a cheap step.
+     */
+#define LIZ_SLICED_UPDATE_CYCLE_CHECK_STEP_COUNT 16
+    
+    
+    
+    /**
+     * Work a liz_sliced_update_run call may do.
+     *
+     * max_step_count limits the summed vm steps, max_cycle_count limits the
+     * liz_cycle_count ticks spent. Zero disables a limit. The cycle budget is
+     * checked every LIZ_SLICED_UPDATE_CYCLE_CHECK_STEP_COUNT steps, so it 
+     * can be overrun by that many steps.
+     */
+    typedef struct liz_update_budget {
+        liz_int_t max_step_count;
+        uint64_t max_cycle_count;
+    } liz_update_budget_t;
+    
+    
+    
+    /**
+     * Treat as opaque, only access via the liz_sliced_update functions.
+     */
+    typedef struct liz_sliced_update {
+        liz_vm_t *vm;
+        
+        liz_time_t parked_time;
+        
+        liz_int_t batch_index;
+        liz_int_t action_request_capacity;
+        liz_int_t last_step_count;
+        
+        bool batch_pending;
+        bool actor_parked;
+    } liz_sliced_update_t;
+    
+    
+    
+    /**
+     * Creates a sliced update with its own vm for shapes fitting spec.
+     *
+     * Returns NULL if memory can't be allocated.
+     */
+    liz_sliced_update_t*
+    liz_sliced_update_create(liz_shape_specification_t spec,
+                             void * LIZ_RESTRICT allocator_context,
+                             liz_alloc_func_t alloc_func);
+    
+    
+    void
+    liz_sliced_update_destroy(liz_sliced_update_t *sliced_update,
+                              void * LIZ_RESTRICT allocator_context,
+                              liz_dealloc_func_t dealloc_func);
+    
+    
+    /**
+     * Drops the pending batch and the parked actor update - the parked actor
+     * keeps the state of its last complete update.
+     */
+    void
+    liz_sliced_update_reset(liz_sliced_update_t *sliced_update);
+    
+    
+    /**
+     * Updates the batch's actors of clip in order until all are updated or 
+     * budget is exhausted, extracts their action requests into requests, and
+     * extracts their states back into the clip.
+     *
+     * The batch is made up of the actors at the actor_index_count indices in 
+     * actor_indices, e.g., collected by liz_lod_schedule_collect_due_actors,
+     * or of the first actor_index_count clip actors if actor_indices is NULL.
+     *
+     * A parked actor is resumed first and finishes its update with the time
+     * its update begun with. Actors only begin or resume their update while 
+     * requests can hold the shape's action request capacity.
+     *
+     * @attention Don't change the clip, and don't apply action state updates
+     *            to it, while liz_sliced_update_is_pending returns true.
+     *
+     * Returns the number of extracted action requests.
+     */
+    liz_int_t
+    liz_sliced_update_run(liz_sliced_update_t *sliced_update,
+                          liz_update_budget_t budget,
+                          liz_actor_clip_t *clip,
+                          uint32_t const *actor_indices,
+                          liz_int_t actor_index_count,
+                          liz_vm_monitor_t *monitor,
+                          void * LIZ_RESTRICT user_data_lookup_context,
+                          liz_vm_user_data_lookup_func_t user_data_lookup_func,
+                          liz_time_t time,
+                          liz_action_request_t *requests,
+                          liz_int_t request_capacity,
+                          liz_vm_shape_t const *shape);
+    
+    
+    /**
+     * Returns true if the last batch isn't completely updated yet and the 
+     * next liz_sliced_update_run call continues it.
+     */
+    bool
+    liz_sliced_update_is_pending(liz_sliced_update_t const *sliced_update);
+    
+    
+    /**
+     * Returns the number of vm steps run by the last liz_sliced_update_run.
+     */
+    liz_int_t
+    liz_sliced_update_last_step_count(liz_sliced_update_t const *sliced_update);
+    
+    
+    
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+
+#endif /* LIZ_liz_sliced_update_H */
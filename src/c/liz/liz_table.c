@@ -40,6 +40,141 @@
 
 #include "liz_assert.h"
 #include "liz_allocator.h"
+#include "liz_platform_functions.h"
+
+
+/* Rooster index 0xFFFF is never used, ids with it mark data slot holes while
+ * batch removing.
+ */
+#define LIZ_TABLE_INVALID_ID 0xFFFFFFFFu
+
+/* Data slots are swapped chunk-wise through a stack buffer while sorting. */
+#define LIZ_TABLE_SWAP_CHUNK_SIZE 64u
+
+
+
+static
+void
+liz_table_swap_data(liz_table_t *table,
+                    liz_uint_t const lhs_index,
+                    liz_uint_t const rhs_index,
+                    uint32_t *keys)
+{
+    liz_id_t *data_ids = (liz_id_t *)(((char *)table) + table->data_ids_offset);
+    liz_id_t const id = data_ids[lhs_index];
+    data_ids[lhs_index] = data_ids[rhs_index];
+    data_ids[rhs_index] = id;
+    
+    if (NULL != keys) {
+        uint32_t const key = keys[lhs_index];
+        keys[lhs_index] = keys[rhs_index];
+        keys[rhs_index] = key;
+    }
+    
+    liz_uint_t const data_slot_size = table->data_slot_size;
+    char *data = ((char *)table) + table->data_slots_offset;
+    char *lhs_slot = data + lhs_index * data_slot_size;
+    char *rhs_slot = data + rhs_index * data_slot_size;
+    char chunk[LIZ_TABLE_SWAP_CHUNK_SIZE];
+    
+    for (liz_uint_t offset = 0; offset < data_slot_size; offset += LIZ_TABLE_SWAP_CHUNK_SIZE) {
+        liz_uint_t const chunk_size = (data_slot_size - offset < LIZ_TABLE_SWAP_CHUNK_SIZE) ? (data_slot_size - offset) : LIZ_TABLE_SWAP_CHUNK_SIZE;
+        
+        liz_memcpy(chunk, lhs_slot + offset, chunk_size);
+        liz_memcpy(lhs_slot + offset, rhs_slot + offset, chunk_size);
+        liz_memcpy(rhs_slot + offset, chunk, chunk_size);
+    }
+}
+
+
+
+/* Moves the id and data of a data slot and redirects the id's rooster slot. */
+static
+void
+liz_table_move_data(liz_table_t *table,
+                    liz_uint_t const from_index,
+                    liz_uint_t const to_index)
+{
+    liz_table_index_t *rooster = (liz_table_index_t *)(((char *)table) + table->rooster_offset);
+    liz_id_t *data_ids = (liz_id_t *)(((char *)table) + table->data_ids_offset);
+    liz_id_t const id = data_ids[from_index];
+    
+    data_ids[to_index] = id;
+    rooster[id & LIZ_TABLE_ID_TO_ROOSTER_INDEX_MASK].indirection_index = (uint32_t)to_index;
+    
+    liz_uint_t const data_slot_size = table->data_slot_size;
+    char *data = ((char *)table) + table->data_slots_offset;
+    
+    liz_memcpy(data + to_index * data_slot_size,
+               data + from_index * data_slot_size,
+               data_slot_size);
+}
+
+
+
+static
+uint32_t
+liz_table_sort_key(liz_id_t const *data_ids,
+                   uint32_t const *keys,
+                   liz_uint_t const index)
+{
+    return (NULL != keys) ? keys[index] : (data_ids[index] & LIZ_TABLE_ID_TO_ROOSTER_INDEX_MASK);
+}
+
+
+
+/* Heapsort of the data slots by keys, or by their ids' rooster indices if 
+ * keys is NULL. Rooster indirections are fixed afterwards in one pass.
+ */
+static
+void
+liz_table_sort(liz_table_t *table,
+               uint32_t *keys)
+{
+    liz_table_index_t *rooster = (liz_table_index_t *)(((char *)table) + table->rooster_offset);
+    liz_id_t *data_ids = (liz_id_t *)(((char *)table) + table->data_ids_offset);
+    liz_uint_t const count = table->count;
+    
+    for (liz_uint_t heap_count = count, i = count / 2u; 0u < heap_count; ) {
+        
+        liz_uint_t parent = 0u;
+        
+        if (0u < i) {
+            // Build the heap.
+            parent = --i;
+        } else {
+            // Move the max to the end and restore the heap.
+            --heap_count;
+            
+            if (0u == heap_count) {
+                break;
+            }
+            
+            liz_table_swap_data(table, 0u, heap_count, keys);
+        }
+        
+        for (liz_uint_t child = 2u * parent + 1u; child < heap_count; child = 2u * parent + 1u) {
+            
+            if (child + 1u < heap_count
+                && liz_table_sort_key(data_ids, keys, child) < liz_table_sort_key(data_ids, keys, child + 1u)) {
+                
+                ++child;
+            }
+            
+            if (liz_table_sort_key(data_ids, keys, parent) >= liz_table_sort_key(data_ids, keys, child)) {
+                break;
+            }
+            
+            liz_table_swap_data(table, parent, child, keys);
+            parent = child;
+        }
+    }
+    
+    for (liz_uint_t i = 0; i < count; ++i) {
+        rooster[data_ids[i] & LIZ_TABLE_ID_TO_ROOSTER_INDEX_MASK].indirection_index = (uint32_t)i;
+    }
+}
+
 
 
 
@@ -243,6 +378,19 @@ liz_table_capacity(liz_table_t const *table)
 
 
 
+size_t
+liz_table_memory_size(liz_table_t const *table)
+{
+    size_t const capacity = table->capacity;
+    
+    return sizeof(liz_table_t)
+        + (capacity + LIZ_TABLE_ROOSTER_SENTINEL_COUNT) * sizeof(liz_table_index_t)
+        + capacity * sizeof(liz_id_t)
+        + capacity * table->data_slot_size;
+}
+
+
+
 liz_id_t
 liz_table_add(liz_table_t *table)
 {
@@ -317,6 +465,225 @@ liz_table_remove(liz_table_t *table,
 
 
 
+liz_id_t
+liz_table_add_to_partition(liz_table_t *table,
+                           uint32_t *partition_offsets,
+                           liz_int_t const partition_count,
+                           liz_int_t const partition)
+{
+    LIZ_ASSERT(0 <= partition && partition < partition_count);
+    LIZ_ASSERT(partition_offsets[partition_count] == table->count);
+    
+    liz_id_t const id = liz_table_add(table);
+    
+    /* The new slot starts behind the last partition. Shift each following 
+     * partition back by moving its first slot behind its last one to open
+     * a hole at the end of partition.
+     */
+    liz_uint_t hole_index = table->count - 1u;
+    
+    for (liz_int_t p = partition_count - 1; p > partition; --p) {
+        liz_uint_t const first_index = partition_offsets[p];
+        
+        if (first_index != hole_index) {
+            liz_table_move_data(table, first_index, hole_index);
+        }
+        
+        hole_index = first_index;
+        partition_offsets[p + 1] += 1u;
+    }
+    partition_offsets[partition + 1] += 1u;
+    
+    liz_table_index_t *rooster = (liz_table_index_t *)(((char *)table) + table->rooster_offset);
+    liz_id_t *data_ids = (liz_id_t *)(((char *)table) + table->data_ids_offset);
+    
+    data_ids[hole_index] = id;
+    rooster[id & LIZ_TABLE_ID_TO_ROOSTER_INDEX_MASK].indirection_index = (uint32_t)hole_index;
+    
+    return id;
+}
+
+
+
+void
+liz_table_remove_from_partition(liz_table_t *table,
+                                uint32_t *partition_offsets,
+                                liz_int_t const partition_count,
+                                liz_id_t const id)
+{
+    LIZ_ASSERT(0u != liz_table_count(table));
+    LIZ_ASSERT(true == liz_table_contains(table, id));
+    LIZ_ASSERT(partition_offsets[partition_count] == table->count);
+    
+    liz_table_index_t *rooster = (liz_table_index_t *)(((char *)table) + table->rooster_offset);
+    
+    liz_uint_t const rooster_index = id & LIZ_TABLE_ID_TO_ROOSTER_INDEX_MASK;
+    liz_uint_t const data_slot_index = rooster[rooster_index].indirection_index;
+    liz_int_t const partition = liz_table_data_partition(partition_offsets,
+                                                         partition_count,
+                                                         (liz_int_t)data_slot_index);
+    
+    /* Update freelist and increase the versioning to invalidate the id. */
+    rooster[table->freelist_enqueue_index].indirection_index = (uint32_t)rooster_index;
+    table->freelist_enqueue_index = (uint32_t)rooster_index;
+    rooster[rooster_index].versioned_id += LIZ_TABLE_ROOSTER_ID_VERSION_INCREMENT;
+    
+    /* Fill the hole with the last slot of the partition, then shift each 
+     * following partition forward by moving its last slot in front of its 
+     * first one.
+     */
+    liz_uint_t hole_index = data_slot_index;
+    
+    for (liz_int_t p = partition; p < partition_count; ++p) {
+        liz_uint_t const last_index = partition_offsets[p + 1] - 1u;
+        
+        if (last_index != hole_index) {
+            liz_table_move_data(table, last_index, hole_index);
+        }
+        
+        hole_index = last_index;
+        partition_offsets[p + 1] -= 1u;
+    }
+    
+    --(table->count);
+}
+
+
+
+liz_int_t
+liz_table_data_partition(uint32_t const *partition_offsets,
+                         liz_int_t const partition_count,
+                         liz_int_t const index)
+{
+    LIZ_ASSERT(index < (liz_int_t)partition_offsets[partition_count]);
+    
+    /* Find the last partition beginning at or before index, skipping empty 
+     * partitions with the same offset.
+     */
+    liz_int_t low = 0;
+    liz_int_t high = partition_count;
+    
+    while (low + 1 < high) {
+        liz_int_t const middle = low + (high - low) / 2;
+        
+        if ((liz_int_t)partition_offsets[middle] <= index) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    
+    return low;
+}
+
+
+
+liz_int_t
+liz_table_add_batch(liz_table_t *table,
+                    liz_id_t *ids,
+                    liz_int_t const count)
+{
+    LIZ_ASSERT(0 <= count);
+    LIZ_ASSERT(count <= liz_table_capacity(table) - liz_table_count(table));
+    
+    liz_table_index_t *rooster = (liz_table_index_t *)(((char *)table) + table->rooster_offset);
+    liz_id_t *data_ids = (liz_id_t *)(((char *)table) + table->data_ids_offset);
+    uint32_t const first_data_index = table->count;
+    uint32_t freelist_dequeue_index = table->freelist_dequeue_index;
+    
+    for (liz_int_t i = 0; i < count; ++i) {
+        liz_table_index_t *rooster_slot = rooster + freelist_dequeue_index;
+        uint32_t const data_index = first_data_index + (uint32_t)i;
+        
+        freelist_dequeue_index = rooster_slot->indirection_index;
+        rooster_slot->indirection_index = data_index;
+        data_ids[data_index] = rooster_slot->versioned_id;
+        ids[i] = rooster_slot->versioned_id;
+    }
+    
+    table->freelist_dequeue_index = freelist_dequeue_index;
+    table->count = first_data_index + (uint32_t)count;
+    
+    return (liz_int_t)first_data_index;
+}
+
+
+
+void
+liz_table_remove_batch(liz_table_t *table,
+                       liz_id_t const *ids,
+                       liz_int_t const count)
+{
+    LIZ_ASSERT(0 <= count);
+    LIZ_ASSERT(count <= liz_table_count(table));
+    
+    liz_table_index_t *rooster = (liz_table_index_t *)(((char *)table) + table->rooster_offset);
+    liz_id_t *data_ids = (liz_id_t *)(((char *)table) + table->data_ids_offset);
+    
+    /* Invalidate the ids, enqueue their rooster slots, and mark their data 
+     * slots as holes.
+     */
+    for (liz_int_t i = 0; i < count; ++i) {
+        liz_id_t const id = ids[i];
+        LIZ_ASSERT(true == liz_table_contains(table, id));
+        
+        liz_uint_t const rooster_index = id & LIZ_TABLE_ID_TO_ROOSTER_INDEX_MASK;
+        
+        data_ids[rooster[rooster_index].indirection_index] = LIZ_TABLE_INVALID_ID;
+        
+        rooster[table->freelist_enqueue_index].indirection_index = (uint32_t)rooster_index;
+        table->freelist_enqueue_index = (uint32_t)rooster_index;
+        rooster[rooster_index].versioned_id += LIZ_TABLE_ROOSTER_ID_VERSION_INCREMENT;
+    }
+    
+    /* Fill the holes in front of the new count with the last live data slots,
+     * holes behind it are dropped.
+     */
+    uint32_t const compacted_count = table->count - (uint32_t)count;
+    uint32_t defrag_data_slot_index = table->count;
+    liz_uint_t const data_slot_size = table->data_slot_size;
+    char *data = ((char *)table) + table->data_slots_offset;
+    
+    for (uint32_t i = 0; i < compacted_count; ++i) {
+        if (LIZ_TABLE_INVALID_ID != data_ids[i]) {
+            continue;
+        }
+        
+        do {
+            --defrag_data_slot_index;
+        } while (LIZ_TABLE_INVALID_ID == data_ids[defrag_data_slot_index]);
+        
+        liz_id_t const defrag_data_id = data_ids[defrag_data_slot_index];
+        data_ids[i] = defrag_data_id;
+        rooster[defrag_data_id & LIZ_TABLE_ID_TO_ROOSTER_INDEX_MASK].indirection_index = i;
+        
+        liz_memcpy(data + i * data_slot_size, 
+                   data + defrag_data_slot_index * data_slot_size, 
+                   data_slot_size);
+    }
+    
+    table->count = compacted_count;
+}
+
+
+
+void
+liz_table_sort_by_id(liz_table_t *table)
+{
+    liz_table_sort(table, NULL);
+}
+
+
+
+void
+liz_table_sort_by_key(liz_table_t *table,
+                      uint32_t *keys)
+{
+    liz_table_sort(table, keys);
+}
+
+
+
 bool
 liz_table_contains(liz_table_t const *table,
                    liz_id_t const id)
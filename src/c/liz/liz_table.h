@@ -277,6 +277,14 @@ extern "C" {
     liz_int_t
     liz_table_capacity(liz_table_t const *table);
     
+    /**
+     * Returns the bytes of the table struct, rooster, data ids, and data 
+     * slots of table, not counting padding between them, e.g., to report
+     * memory usage of tables placed via liz_table_init.
+     */
+    size_t
+    liz_table_memory_size(liz_table_t const *table);
+    
     /**
      * Registers a data slot on table and returns the slot id.
      *
@@ -288,6 +296,23 @@ extern "C" {
     liz_id_t
     liz_table_add(liz_table_t *table);
     
+    /**
+     * Registers count data slots on table, stores their ids in ids, and 
+     * returns the data index of the first registered slot.
+     *
+     * The registered data slots are contiguous, from the returned index to 
+     * the returned index plus count, so they can be filled via 
+     * liz_table_data without looking up each id. On a fresh table the ids'
+     * rooster indices are contiguous, too.
+     *
+     * @attention Don't call if count exceeds the free capacity, otherwise 
+     *            behavior is undefined.
+     */
+    liz_int_t
+    liz_table_add_batch(liz_table_t *table,
+                        liz_id_t *ids,
+                        liz_int_t count);
+    
     /**
      * Unregisters the data slot associated with id and reshuffles data behind
      * the scene to keep it packed tightly.
@@ -301,6 +326,45 @@ extern "C" {
     liz_table_remove(liz_table_t *table,
                      liz_id_t id);
     
+    /**
+     * Unregisters the data slots associated with ids and compacts data in a
+     * single pass - each hole in front of the new count is filled with the 
+     * last remaining data slot. Moves at most count data slots.
+     *
+     * @attention Don't pass in invalid or duplicate ids, otherwise behavior
+     *            is undefined.
+     */
+    void
+    liz_table_remove_batch(liz_table_t *table,
+                           liz_id_t const *ids,
+                           liz_int_t count);
+    
+    /**
+     * Sorts the data slots in ascending order of their ids' rooster indices,
+     * e.g., to restore the add order of a table filled by 
+     * liz_table_add_batch after removals shuffled it.
+     *
+     * Sorts in place without allocating. Invalidates data slot pointers and
+     * data indices, but not ids.
+     */
+    void
+    liz_table_sort_by_id(liz_table_t *table);
+    
+    /**
+     * Sorts the data slots in ascending order of keys, e.g., a spatial cell
+     * or a shape id per slot, so linear iteration visits grouped data 
+     * together.
+     *
+     * keys holds one key per data index and is permuted along with the data
+     * slots. The order of slots with equal keys is unspecified.
+     *
+     * Sorts in place without allocating. Invalidates data slot pointers and
+     * data indices, but not ids.
+     */
+    void
+    liz_table_sort_by_key(liz_table_t *table,
+                          uint32_t *keys);
+    
     /**
      * Returns true of the table contains the id, otherwise returns false.
      */
@@ -350,6 +414,60 @@ extern "C" {
     
     
     
+    /* Partitioned mode
+     *
+     * Groups data slots into partition_count contiguous runs by a user key, 
+     * e.g., by shape id, so iterating a partition walks one behavior tree 
+     * shape at a time instead of alternating shape atom streams.
+     *
+     * partition_offsets holds partition_count + 1 data indices, partition p
+     * spans the data slots from partition_offsets[p] to 
+     * partition_offsets[p + 1], and the last offset equals the table count.
+     * Zero all offsets for an empty table.
+     *
+     * Adding and removing moves at most one data slot per following 
+     * partition to keep the runs contiguous and tightly packed. Don't mix 
+     * with liz_table_add, liz_table_remove, their batch variants, or sorting
+     * on the same table, otherwise the partitions break apart.
+     */
+    
+    /**
+     * Registers a data slot at the end of partition and returns its id.
+     *
+     * @attention Don't call when table is full, otherwise behavior is
+     *            undefined.
+     */
+    liz_id_t
+    liz_table_add_to_partition(liz_table_t *table,
+                               uint32_t *partition_offsets,
+                               liz_int_t partition_count,
+                               liz_int_t partition);
+    
+    /**
+     * Unregisters the data slot associated with id, moves the last data slot
+     * of its partition into it, and closes the gap behind the partition.
+     *
+     * @attention Don't pass in an invalid, e.g., not contained, id, otherwise
+     *            behavior is undefined.
+     */
+    void
+    liz_table_remove_from_partition(liz_table_t *table,
+                                    uint32_t *partition_offsets,
+                                    liz_int_t partition_count,
+                                    liz_id_t id);
+    
+    /**
+     * Returns the partition of the data slot at index.
+     *
+     * index must be less than liz_table_count, otherwise behavior is undefined.
+     */
+    liz_int_t
+    liz_table_data_partition(uint32_t const *partition_offsets,
+                             liz_int_t partition_count,
+                             liz_int_t index);
+    
+    
+    
 #if defined(__cplusplus)
 } /* extern "C" */
 #endif
@@ -0,0 +1,378 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "liz_trace_monitor.h"
+
+#include "liz_assert.h"
+#include "liz_common_internal.h"
+#include "liz_platform_functions.h"
+
+
+
+/**
+ * Large enough for the longest formatted event.
+ */
+#define LIZ_TRACE_EVENT_TEXT_CAPACITY 256
+
+
+
+static
+uint64_t
+liz_trace_default_clock(void *context)
+{
+    (void)context;
+    
+    return liz_cycle_count();
+}
+
+
+
+static
+bool
+liz_trace_monitor_is_actor_sampled(liz_trace_monitor_t *monitor,
+                                   liz_vm_actor_t const *actor)
+{
+    // Sampling is decided once per actor id, consecutive events nearly
+    // always stem from the same actor. Actor structs are often reused for
+    // different actors so their address can't identify the actor.
+    liz_id_t const actor_id = actor->header->actor_id;
+    
+    if (actor_id != monitor->last_actor_id) {
+        monitor->last_actor_id = actor_id;
+        monitor->last_actor_is_sampled = (0u != monitor->actor_sample_period)
+            && (0u == actor_id % monitor->actor_sample_period);
+    }
+    
+    return monitor->last_actor_is_sampled;
+}
+
+
+
+static
+void
+liz_trace_monitor_push(liz_trace_monitor_t *monitor,
+                       liz_trace_event_t const *event)
+{
+    uint32_t const head = monitor->head;
+    uint32_t const tail = liz_atomic_load_acquire_uint32(&monitor->tail);
+    
+    if (monitor->capacity == head - tail) {
+        ++(monitor->dropped_event_count);
+        return;
+    }
+    
+    monitor->events[head & (monitor->capacity - 1u)] = *event;
+    liz_atomic_store_release_uint32(&monitor->head, head + 1u);
+}
+
+
+
+static
+void
+liz_trace_append_string(char *text,
+                        size_t *length,
+                        char const *str)
+{
+    size_t const str_length = liz_strlen(str);
+    LIZ_ASSERT(*length + str_length < LIZ_TRACE_EVENT_TEXT_CAPACITY);
+    
+    liz_memcpy(text + *length, str, str_length);
+    *length += str_length;
+}
+
+
+
+static
+void
+liz_trace_append_uint(char *text,
+                      size_t *length,
+                      uint64_t value,
+                      liz_int_t const min_digit_count)
+{
+    char digits[20];
+    liz_int_t digit_count = 0;
+    
+    do {
+        digits[digit_count++] = (char)('0' + (value % 10u));
+        value /= 10u;
+    } while (0u != value || digit_count < min_digit_count);
+    
+    LIZ_ASSERT(*length + (size_t)digit_count < LIZ_TRACE_EVENT_TEXT_CAPACITY);
+    
+    while (0 < digit_count) {
+        text[(*length)++] = digits[--digit_count];
+    }
+}
+
+
+
+static
+bool
+liz_trace_writer_write(liz_trace_writer_t *writer,
+                       void const *data,
+                       size_t const byte_count)
+{
+    if (!writer->failed 
+        && !writer->write_func(writer->write_context, data, byte_count)) {
+        
+        writer->failed = true;
+    }
+    
+    return !writer->failed;
+}
+
+
+
+static
+bool
+liz_trace_writer_write_event(liz_trace_writer_t *writer,
+                             liz_trace_event_t const *event,
+                             uint32_t const thread_id)
+{
+    static char const phase_names[][2] = {"B", "E", "i"};
+    LIZ_ASSERT(liz_trace_event_phase_instant >= event->phase);
+    
+    uint64_t const ticks = (event->timestamp > writer->base_timestamp) ? (event->timestamp - writer->base_timestamp) : 0u;
+    uint64_t const nanoseconds = (ticks * 1000u) / writer->ticks_per_microsecond;
+    
+    char text[LIZ_TRACE_EVENT_TEXT_CAPACITY];
+    size_t length = 0;
+    
+    if (0u != writer->written_event_count) {
+        liz_trace_append_string(text, &length, ",\n");
+    }
+    
+    liz_trace_append_string(text, &length, "{\"name\":\"");
+    if (liz_vm_monitor_node_flag_cancel_action & event->traversal_mask) {
+        liz_trace_append_string(text, &length, "cancel ");
+    } else if (liz_vm_monitor_node_flag_error & event->traversal_mask) {
+        liz_trace_append_string(text, &length, "error ");
+    }
+    liz_trace_append_string(text, &length, "node ");
+    liz_trace_append_uint(text, &length, event->shape_atom_index, 1);
+    liz_trace_append_string(text, &length, "\",\"cat\":\"liz\",\"ph\":\"");
+    liz_trace_append_string(text, &length, phase_names[event->phase]);
+    if (liz_trace_event_phase_instant == event->phase) {
+        liz_trace_append_string(text, &length, "\",\"s\":\"t");
+    }
+    liz_trace_append_string(text, &length, "\",\"ts\":");
+    liz_trace_append_uint(text, &length, nanoseconds / 1000u, 1);
+    liz_trace_append_string(text, &length, ".");
+    liz_trace_append_uint(text, &length, nanoseconds % 1000u, 3);
+    liz_trace_append_string(text, &length, ",\"pid\":1,\"tid\":");
+    liz_trace_append_uint(text, &length, thread_id, 1);
+    liz_trace_append_string(text, &length, ",\"args\":{\"actor\":");
+    liz_trace_append_uint(text, &length, event->actor_id, 1);
+    liz_trace_append_string(text, &length, "}}");
+    
+    writer->written_event_count += 1u;
+    
+    return liz_trace_writer_write(writer, text, length);
+}
+
+
+
+#pragma mark Create and destroy trace monitor
+
+liz_trace_monitor_t*
+liz_trace_monitor_create(uint32_t const event_capacity,
+                         uint32_t const actor_sample_period,
+                         uint32_t const thread_id,
+                         void *clock_context,
+                         liz_trace_clock_func_t clock_func,
+                         void * LIZ_RESTRICT allocator_context,
+                         liz_alloc_func_t alloc_func)
+{
+    if (0u == event_capacity 
+        || 0u != (event_capacity & (event_capacity - 1u))) {
+        
+        return NULL;
+    }
+    
+    size_t const header_size = liz_allocation_size_aggregate(sizeof(uint64_t),
+                                                             sizeof(liz_trace_monitor_t),
+                                                             sizeof(uint64_t),
+                                                             0);
+    size_t const monitor_size = header_size + sizeof(liz_trace_event_t) * event_capacity;
+    liz_trace_monitor_t *monitor = (liz_trace_monitor_t *)alloc_func(allocator_context, monitor_size);
+    
+    if (NULL == monitor) {
+        return NULL;
+    }
+    
+    monitor->events = (liz_trace_event_t *)((char *)monitor + header_size);
+    monitor->capacity = event_capacity;
+    monitor->actor_sample_period = actor_sample_period;
+    monitor->thread_id = thread_id;
+    monitor->dropped_event_count = 0u;
+    monitor->clock_func = (NULL != clock_func) ? clock_func : liz_trace_default_clock;
+    monitor->clock_context = clock_context;
+    // Start as if actor id 0 was sampled last.
+    monitor->last_actor_id = 0u;
+    monitor->last_actor_is_sampled = (0u != actor_sample_period);
+    monitor->head = 0u;
+    monitor->tail = 0u;
+    
+    return monitor;
+}
+
+
+
+void
+liz_trace_monitor_destroy(liz_trace_monitor_t *monitor,
+                          void * LIZ_RESTRICT allocator_context,
+                          liz_dealloc_func_t dealloc_func)
+{
+    dealloc_func(allocator_context, monitor);
+}
+
+
+
+#pragma mark Record events
+
+liz_vm_monitor_t
+liz_trace_monitor_vm_monitor(liz_trace_monitor_t *monitor)
+{
+    return (liz_vm_monitor_t){(uintptr_t)monitor, liz_trace_monitor_func, NULL};
+}
+
+
+
+void
+liz_trace_monitor_func(uintptr_t user_data,
+                       liz_uint_t const node_shape_atom_index,
+                       liz_uint_t const traversal_mask,
+                       liz_vm_t const *vm,
+                       void const * LIZ_RESTRICT actor_blackboard,
+                       liz_time_t const time,
+                       liz_vm_actor_t const *actor,
+                       liz_vm_shape_t const *shape)
+{
+    (void)vm;
+    (void)actor_blackboard;
+    (void)time;
+    (void)shape;
+    
+    liz_trace_monitor_t *monitor = (liz_trace_monitor_t *)user_data;
+    liz_trace_event_phase_t phase = liz_trace_event_phase_instant;
+    
+    if (liz_vm_monitor_node_flag_enter_from_top & traversal_mask) {
+        phase = liz_trace_event_phase_begin;
+    } else if (liz_vm_monitor_node_flag_leave_to_top & traversal_mask) {
+        phase = liz_trace_event_phase_end;
+    } else if (0u == (liz_vm_monitor_node_flag_error & traversal_mask)) {
+        return;
+    }
+    
+    if (!liz_trace_monitor_is_actor_sampled(monitor, actor)) {
+        return;
+    }
+    
+    liz_trace_event_t const event = {
+        monitor->clock_func(monitor->clock_context),
+        actor->header->actor_id,
+        (liz_index_t)node_shape_atom_index,
+        (uint8_t)phase,
+        (uint8_t)traversal_mask
+    };
+    
+    liz_trace_monitor_push(monitor, &event);
+}
+
+
+
+uint32_t
+liz_trace_monitor_event_count(liz_trace_monitor_t const *monitor)
+{
+    return liz_atomic_load_acquire_uint32(&monitor->head) - monitor->tail;
+}
+
+
+
+uint32_t
+liz_trace_monitor_dropped_event_count(liz_trace_monitor_t const *monitor)
+{
+    return monitor->dropped_event_count;
+}
+
+
+
+#pragma mark Write trace
+
+bool
+liz_trace_writer_begin(liz_trace_writer_t *writer,
+                       void *write_context,
+                       liz_trace_write_func_t write_func,
+                       uint64_t const base_timestamp,
+                       uint64_t const ticks_per_microsecond)
+{
+    LIZ_ASSERT(0u != ticks_per_microsecond);
+    
+    writer->write_func = write_func;
+    writer->write_context = write_context;
+    writer->base_timestamp = base_timestamp;
+    writer->ticks_per_microsecond = ticks_per_microsecond;
+    writer->written_event_count = 0u;
+    writer->failed = false;
+    
+    static char const header[] = "{\"traceEvents\":[\n";
+    
+    return liz_trace_writer_write(writer, header, sizeof(header) - 1u);
+}
+
+
+
+bool
+liz_trace_monitor_flush(liz_trace_monitor_t *monitor,
+                        liz_trace_writer_t *writer)
+{
+    uint32_t tail = monitor->tail;
+    uint32_t const head = liz_atomic_load_acquire_uint32(&monitor->head);
+    
+    for (; tail != head; ++tail) {
+        liz_trace_event_t const *event = &monitor->events[tail & (monitor->capacity - 1u)];
+        liz_trace_writer_write_event(writer, event, monitor->thread_id);
+    }
+    
+    liz_atomic_store_release_uint32(&monitor->tail, tail);
+    
+    return !writer->failed;
+}
+
+
+
+bool
+liz_trace_writer_end(liz_trace_writer_t *writer)
+{
+    static char const footer[] = "\n],\"displayTimeUnit\":\"ns\"}\n";
+    
+    return liz_trace_writer_write(writer, footer, sizeof(footer) - 1u);
+}
@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *
+ * Vm monitor recording node enter and leave events of sampled actors into a 
+ * per thread ring buffer, and a writer exporting the recorded events as 
+ * Chrome Trace Event JSON to show vm traversals on a timeline, e.g., in 
+ * chrome://tracing or in the Perfetto UI.
+ *
+ * Each trace monitor has one producer, the vm it is passed to, and one 
+ * consumer that flushes its events, e.g., a background thread or the main
+ * thread at frame end. Producer and consumer can run concurrently without 
+ * locks. When the ring buffer is full new events are dropped and counted.
+ *
+ * Typical usage:
+ * 1. Create a trace monitor per vm alas per thread and set thread_id to tell
+ *    the threads apart on the timeline.
+ * 2. Pass the monitor returned by liz_trace_monitor_vm_monitor to the vm 
+ *    updates of the thread.
+ * 3. Begin a trace writer, flush all trace monitors into it when convenient,
+ *    and end it to finish the trace file.
+ *
+ * Only actors whose id is a multiple of the actor sample period are recorded
+ * to bound the overhead. Events are only recorded if LIZ_VM_MONITOR_ENABLE is
+ * defined.
+ */
+
+#ifndef LIZ_liz_trace_monitor_H
+#define LIZ_liz_trace_monitor_H
+
+
+#include <liz/liz_platform_types.h>
+#include <liz/liz_platform_macros.h>
+#include <liz/liz_common.h>
+#include <liz/liz_allocator.h>
+#include <liz/liz_vm.h>
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+    
+    
+#define LIZ_TRACE_MONITOR_CACHE_LINE_SIZE 64
+    
+    
+    typedef enum liz_trace_event_phase {
+        liz_trace_event_phase_begin = 0,
+        liz_trace_event_phase_end,
+        liz_trace_event_phase_instant
+    } liz_trace_event_phase_t;
+    
+    
+    
+    /**
+     * traversal_mask is the liz_vm_monitor_node_flag_t combination that
+     * caused the event.
+     */
+    typedef struct liz_trace_event {
+        uint64_t timestamp;
+        liz_id_t actor_id;
+        liz_index_t shape_atom_index;
+        uint8_t phase;
+        uint8_t traversal_mask;
+    } liz_trace_event_t;
+    
+    
+    
+    /**
+     * Returns a monotonically increasing timestamp in ticks.
+     */
+    typedef uint64_t (*liz_trace_clock_func_t)(void *context);
+    
+    
+    /**
+     * Writes byte_count bytes from data, returns false on failure.
+     */
+    typedef bool (*liz_trace_write_func_t)(void *context,
+                                           void const *data,
+                                           size_t byte_count);
+    
+    
+    
+    /**
+     * Treat as opaque, only access via the liz_trace_monitor functions.
+     *
+     * head is only written by the producer and tail only by the consumer.
+     */
+    typedef struct liz_trace_monitor {
+        liz_trace_event_t *events;
+        uint32_t capacity;
+        uint32_t actor_sample_period;
+        uint32_t thread_id;
+        uint32_t dropped_event_count;
+        
+        liz_trace_clock_func_t clock_func;
+        void *clock_context;
+        
+        liz_id_t last_actor_id;
+        bool last_actor_is_sampled;
+        
+        // Separate producer and consumer owned indices to keep them from
+        // sharing a cache line.
+        uint32_t volatile head;
+        char head_padding[LIZ_TRACE_MONITOR_CACHE_LINE_SIZE - sizeof(uint32_t)];
+        uint32_t volatile tail;
+    } liz_trace_monitor_t;
+    
+    
+    
+    /**
+     * Treat as opaque, only access via the liz_trace_writer functions.
+     */
+    typedef struct liz_trace_writer {
+        liz_trace_write_func_t write_func;
+        void *write_context;
+        uint64_t base_timestamp;
+        uint64_t ticks_per_microsecond;
+        uint64_t written_event_count;
+        bool failed;
+    } liz_trace_writer_t;
+    
+    
+    
+#pragma mark Create and destroy trace monitor
+    
+    /**
+     * Creates a trace monitor with a ring buffer for event_capacity events.
+     *
+     * event_capacity must be a power of two. An actor_sample_period of one 
+     * records all actors, zero records none. Pass NULL for clock_func to use
+     * liz_cycle_count.
+     *
+     * Returns NULL if event_capacity isn't a power of two or if memory can't 
+     * be allocated.
+     */
+    liz_trace_monitor_t*
+    liz_trace_monitor_create(uint32_t event_capacity,
+                             uint32_t actor_sample_period,
+                             uint32_t thread_id,
+                             void *clock_context,
+                             liz_trace_clock_func_t clock_func,
+                             void * LIZ_RESTRICT allocator_context,
+                             liz_alloc_func_t alloc_func);
+    
+    
+    void
+    liz_trace_monitor_destroy(liz_trace_monitor_t *monitor,
+                              void * LIZ_RESTRICT allocator_context,
+                              liz_dealloc_func_t dealloc_func);
+    
+    
+    
+#pragma mark Record events
+    
+    /**
+     * Returns a vm monitor that records into monitor.
+     */
+    liz_vm_monitor_t
+    liz_trace_monitor_vm_monitor(liz_trace_monitor_t *monitor);
+    
+    
+    /**
+     * Vm monitor function of the trace monitor, user_data must point to a 
+     * liz_trace_monitor_t.
+     *
+     * Records entering a node from the top as begin, leaving it to the top as 
+     * end, and errors as instant events. Guard traversals are part of the 
+     * decider's span and are not recorded.
+     */
+    void
+    liz_trace_monitor_func(uintptr_t user_data,
+                           liz_uint_t const node_shape_atom_index,
+                           liz_uint_t const traversal_mask,
+                           liz_vm_t const *vm,
+                           void const * LIZ_RESTRICT actor_blackboard,
+                           liz_time_t const time,
+                           liz_vm_actor_t const *actor,
+                           liz_vm_shape_t const *shape);
+    
+    
+    /**
+     * Number of recorded and not yet flushed events, only call from the 
+     * consumer thread.
+     */
+    uint32_t
+    liz_trace_monitor_event_count(liz_trace_monitor_t const *monitor);
+    
+    
+    /**
+     * Number of events dropped because the ring buffer was full, only call 
+     * from the producer thread or after it stopped recording.
+     */
+    uint32_t
+    liz_trace_monitor_dropped_event_count(liz_trace_monitor_t const *monitor);
+    
+    
+    
+#pragma mark Write trace
+    
+    /**
+     * Writes the trace file header. Timestamps are written relative to 
+     * base_timestamp and converted with ticks_per_microsecond which must not
+     * be zero.
+     *
+     * Returns false if writing fails.
+     */
+    bool
+    liz_trace_writer_begin(liz_trace_writer_t *writer,
+                           void *write_context,
+                           liz_trace_write_func_t write_func,
+                           uint64_t base_timestamp,
+                           uint64_t ticks_per_microsecond);
+    
+    
+    /**
+     * Consumes all events recorded by monitor and writes them. Only call from
+     * the monitor's consumer thread.
+     *
+     * Returns false if writing fails - the consumed events are lost then.
+     */
+    bool
+    liz_trace_monitor_flush(liz_trace_monitor_t *monitor,
+                            liz_trace_writer_t *writer);
+    
+    
+    /**
+     * Writes the trace file footer, returns false if this or any write since
+     * begin failed.
+     */
+    bool
+    liz_trace_writer_end(liz_trace_writer_t *writer);
+    
+    
+    
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+
+#endif /* LIZ_liz_trace_monitor_H */
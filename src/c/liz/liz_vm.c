@@ -34,6 +34,7 @@
 #include "liz_assert.h"
 #include "liz_common.h"
 #include "liz_common_internal.h"
+#include "liz_platform_functions.h"
 
 
 
@@ -51,15 +52,15 @@ liz_vm_memory_size_requirement(liz_shape_specification_t const spec)
     vm_size = liz_allocation_size_aggregate(LIZ_VM_ALIGNMENT, 
                                             vm_size,
                                             LIZ_SHAPE_ATOM_INDEX_ALIGNMENT,
-                                            sizeof(uint16_t) * spec.persistent_state_change_capacity);
+                                            sizeof(liz_index_t) * spec.persistent_state_change_capacity);
     vm_size = liz_allocation_size_aggregate(LIZ_VM_ALIGNMENT,
                                             vm_size,
                                             LIZ_SHAPE_ATOM_INDEX_ALIGNMENT, 
-                                            sizeof(uint16_t) * spec.decider_state_capacity);
+                                            sizeof(liz_index_t) * spec.decider_state_capacity);
     vm_size = liz_allocation_size_aggregate(LIZ_VM_ALIGNMENT,
                                             vm_size,
                                             LIZ_SHAPE_ATOM_INDEX_ALIGNMENT,
-                                            sizeof(uint16_t) * spec.action_state_capacity);
+                                            sizeof(liz_index_t) * spec.action_state_capacity);
     
     // Size of states.
     vm_size = liz_allocation_size_aggregate(LIZ_VM_ALIGNMENT,
@@ -69,7 +70,7 @@ liz_vm_memory_size_requirement(liz_shape_specification_t const spec)
     vm_size = liz_allocation_size_aggregate(LIZ_VM_ALIGNMENT,
                                             vm_size,
                                             LIZ_DECIDER_STATE_ALIGNMENT,
-                                            sizeof(uint16_t) * spec.decider_state_capacity);
+                                            sizeof(liz_index_t) * spec.decider_state_capacity);
     vm_size = liz_allocation_size_aggregate(LIZ_VM_ALIGNMENT,
                                             vm_size,
                                             LIZ_ACTION_STATE_ALIGNMENT,
@@ -96,17 +97,53 @@ liz_vm_memory_size_requirement(liz_shape_specification_t const spec)
 
 
 
-liz_vm_t*
-liz_vm_create(liz_shape_specification_t const spec,
-              void * LIZ_RESTRICT allocator_context,
-              liz_alloc_func_t alloc_func)
+size_t
+liz_vm_memory_size(liz_vm_t const *vm)
 {
-    size_t const vm_size = liz_vm_memory_size_requirement(spec);
-    liz_vm_t *vm = (liz_vm_t *)alloc_func(allocator_context, vm_size);
+    liz_shape_specification_t spec;
+    liz_memset(&spec, 0, sizeof(spec));
     
-    if (!vm) {
-        return NULL;
-    }
+    spec.persistent_state_change_capacity = (liz_index_t)liz_lookaside_stack_capacity(&vm->persistent_state_change_stack_header);
+    spec.decider_state_capacity = (liz_index_t)liz_lookaside_stack_capacity(&vm->decider_state_stack_header);
+    spec.action_state_capacity = (liz_index_t)liz_lookaside_stack_capacity(&vm->action_state_stack_header);
+    spec.decider_guard_capacity = (liz_index_t)liz_lookaside_stack_capacity(&vm->decider_guard_stack_header);
+    spec.action_request_capacity = (liz_index_t)liz_lookaside_double_stack_capacity(&vm->action_request_stack_header);
+    
+    return liz_vm_memory_size_requirement(spec);
+}
+
+
+
+size_t
+liz_vm_shape_memory_size(liz_vm_shape_t const *shape)
+{
+    liz_shape_specification_t const spec = shape->spec;
+    
+    return sizeof(liz_shape_atom_t) * spec.shape_atom_count
+        + sizeof(liz_index_t) * spec.persistent_state_count
+        + sizeof(liz_shape_subtree_call_t) * spec.subtree_call_count
+        + sizeof(liz_immediate_action_func_t) * spec.immediate_action_function_count;
+}
+
+
+
+size_t
+liz_vm_actor_memory_size_requirement(liz_shape_specification_t const spec)
+{
+    return sizeof(liz_actor_header_t)
+        + sizeof(liz_persistent_state_t) * spec.persistent_state_count
+        + (sizeof(liz_index_t) + sizeof(liz_index_t)) * spec.decider_state_capacity
+        + (sizeof(liz_index_t) + sizeof(uint8_t)) * spec.action_state_capacity;
+}
+
+
+
+static
+liz_vm_t*
+liz_vm_create_in_memory(liz_shape_specification_t const spec,
+                        void *memory)
+{
+    liz_vm_t *vm = (liz_vm_t *)memory;
     
     // Initialize memory to zero as one step to enable memcmp on vm.
     // Uncommented because it would need to be called for each reset otherwise
@@ -116,25 +153,25 @@ liz_vm_create(liz_shape_specification_t const spec,
     // Calculate aligned state addresses.
     char *ptr = (char *)vm + sizeof(liz_vm_t);
     ptr += liz_allocation_alignment_offset(ptr, LIZ_SHAPE_ATOM_INDEX_ALIGNMENT);
-    uint16_t *persistent_state_change_shape_atom_indices = spec.persistent_state_change_capacity ? (uint16_t *)ptr : NULL;
+    liz_index_t *persistent_state_change_shape_atom_indices = spec.persistent_state_change_capacity ? (liz_index_t *)ptr : NULL;
     
-    ptr += sizeof(uint16_t) * spec.persistent_state_change_capacity;
+    ptr += sizeof(liz_index_t) * spec.persistent_state_change_capacity;
     ptr += liz_allocation_alignment_offset(ptr, LIZ_SHAPE_ATOM_INDEX_ALIGNMENT);
-    uint16_t *decider_state_shape_atom_indices = spec.decider_state_capacity ? (uint16_t *)ptr : NULL;
+    liz_index_t *decider_state_shape_atom_indices = spec.decider_state_capacity ? (liz_index_t *)ptr : NULL;
     
-    ptr += sizeof(uint16_t) * spec.decider_state_capacity;
+    ptr += sizeof(liz_index_t) * spec.decider_state_capacity;
     ptr += liz_allocation_alignment_offset(ptr, LIZ_SHAPE_ATOM_INDEX_ALIGNMENT);
-    uint16_t *action_state_shape_atom_indices = spec.action_state_capacity ? (uint16_t *)ptr : NULL;
+    liz_index_t *action_state_shape_atom_indices = spec.action_state_capacity ? (liz_index_t *)ptr : NULL;
     
-    ptr += sizeof(uint16_t) * spec.action_state_capacity;
+    ptr += sizeof(liz_index_t) * spec.action_state_capacity;
     ptr += liz_allocation_alignment_offset(ptr, LIZ_PERSISTENT_STATE_ALIGNMENT);
     liz_persistent_state_t *persistent_state_changes = spec.persistent_state_change_capacity ? (liz_persistent_state_t *)ptr : NULL;
     
     ptr += sizeof(liz_persistent_state_t) * spec.persistent_state_change_capacity;
     ptr += liz_allocation_alignment_offset(ptr, LIZ_DECIDER_STATE_ALIGNMENT);
-    uint16_t *decider_states = spec.decider_state_capacity ? (uint16_t *)ptr : NULL;
+    liz_index_t *decider_states = spec.decider_state_capacity ? (liz_index_t *)ptr : NULL;
     
-    ptr += sizeof(uint16_t) * spec.decider_state_capacity;
+    ptr += sizeof(liz_index_t) * spec.decider_state_capacity;
     ptr += liz_allocation_alignment_offset(ptr, LIZ_ACTION_STATE_ALIGNMENT);
     uint8_t *action_states = spec.action_state_capacity ? (uint8_t *)ptr : NULL;
     
@@ -162,6 +199,59 @@ liz_vm_create(liz_shape_specification_t const spec,
 
 
 
+liz_vm_t*
+liz_vm_create(liz_shape_specification_t const spec,
+              void * LIZ_RESTRICT allocator_context,
+              liz_alloc_func_t alloc_func)
+{
+    size_t const vm_size = liz_vm_memory_size_requirement(spec);
+    void *memory = alloc_func(allocator_context, vm_size);
+    
+    if (!memory) {
+        return NULL;
+    }
+    
+    return liz_vm_create_in_memory(spec, memory);
+}
+
+
+
+size_t
+liz_vm_memory_size_requirement_aligned(liz_shape_specification_t const spec,
+                                       size_t const alignment)
+{
+    size_t const required_alignment = (alignment > LIZ_VM_ALIGNMENT) ? alignment : LIZ_VM_ALIGNMENT;
+    
+    return liz_allocation_size_aggregate(required_alignment,
+                                         liz_vm_memory_size_requirement(spec),
+                                         required_alignment,
+                                         0u);
+}
+
+
+
+liz_vm_t*
+liz_vm_create_aligned(liz_shape_specification_t const spec,
+                      size_t const alignment,
+                      void * LIZ_RESTRICT allocator_context,
+                      liz_aligned_alloc_func_t aligned_alloc_func)
+{
+    size_t const required_alignment = (alignment > LIZ_VM_ALIGNMENT) ? alignment : LIZ_VM_ALIGNMENT;
+    size_t const vm_size = liz_vm_memory_size_requirement_aligned(spec, required_alignment);
+    void *memory = aligned_alloc_func(allocator_context, vm_size, required_alignment);
+    
+    if (!memory) {
+        return NULL;
+    }
+    
+    LIZ_ASSERT(0u == liz_allocation_alignment_offset(memory, required_alignment)
+               && "Alignment of allocated memory less than required.");
+    
+    return liz_vm_create_in_memory(spec, memory);
+}
+
+
+
 void
 liz_vm_destroy(liz_vm_t *vm,
                void * LIZ_RESTRICT allocator_context,
@@ -203,17 +293,14 @@ liz_vm_update_actor(liz_vm_t *vm,
 {
     LIZ_ASSERT(liz_vm_fulfills_shape_specification(vm, shape->spec));
     
-    liz_vm_reset(vm);
-    
-    if (0u == shape->spec.shape_atom_count) {
+    if (!liz_vm_begin_update_actor(vm, actor, shape)) {
         return;
     }
     
     void *actor_blackboard = user_data_lookup_func(user_data_lookup_context,
                                                    actor->header->user_data);
-
-    vm->actor_random_number_seed = actor->header->random_number_seed;
     
+    LIZ_VM_STATS_CYCLES_BEGIN(update_begin_cycles);
     while (liz_vm_is_running(vm)) {
         liz_vm_step(vm,
                     monitor,
@@ -222,6 +309,7 @@ liz_vm_update_actor(liz_vm_t *vm,
                     actor,
                     shape);
     }
+    LIZ_VM_STATS_CYCLES_END(update_begin_cycles, vm);
 }
 
 
@@ -245,16 +333,18 @@ liz_vm_cancel_actor(liz_vm_t *vm,
     vm->actor_random_number_seed = actor->header->random_number_seed;
     vm->cancellation_range = (liz_vm_cancellation_range_t){
         0,
-        shape->spec.shape_atom_count
+        (liz_index_t)liz_shape_specification_shape_atom_index_count(shape->spec)
     };
     vm->cmd = liz_vm_cmd_cleanup;
     
+    LIZ_VM_STATS_CYCLES_BEGIN(cancel_begin_cycles);
     liz_vm_step(vm,
                 monitor,
                 actor_blackboard,
                 time,
                 actor,
                 shape);
+    LIZ_VM_STATS_CYCLES_END(cancel_begin_cycles, vm);
     LIZ_ASSERT(liz_vm_cmd_done == vm->cmd);
 }
 
@@ -269,7 +359,7 @@ liz_vm_extract_actor_state(liz_vm_t const *vm,
                && "Vm update must have been cleaned up and done before transmitting states to actor.");
     
     target_actor->header->random_number_seed = vm->actor_random_number_seed;
-    target_actor->header->decider_state_count = liz_lookaside_stack_count(&vm->decider_guard_stack_header);
+    target_actor->header->decider_state_count = liz_lookaside_stack_count(&vm->decider_state_stack_header);
     target_actor->header->action_state_count = liz_lookaside_stack_count(&vm->action_state_stack_header);
     
     liz_actor_header_t const actor_header = *(target_actor->header);
@@ -310,6 +400,20 @@ liz_vm_action_request_count(liz_vm_t const *vm)
 
 
 
+liz_vm_update_stats_t
+liz_vm_update_stats(liz_vm_t const *vm)
+{
+    liz_vm_update_stats_t stats = vm->update_stats;
+    stats.launch_request_count = (uint32_t)liz_lookaside_double_stack_count(&vm->action_request_stack_header,
+                                                                            LIZ_VM_ACTION_REQUEST_STACK_SIDE_LAUNCH);
+    stats.cancel_request_count = (uint32_t)liz_lookaside_double_stack_count(&vm->action_request_stack_header,
+                                                                            LIZ_VM_ACTION_REQUEST_STACK_SIDE_CANCEL);
+    
+    return stats;
+}
+
+
+
 liz_int_t
 liz_vm_extract_action_requests(liz_vm_t const *vm,
                                liz_action_request_t *external_requests,
@@ -374,6 +478,7 @@ liz_vm_reset(liz_vm_t *vm)
     vm->actor_decider_state_index = 0;
     vm->actor_action_state_index = 0;
     vm->actor_persistent_state_index = 0;
+    vm->subtree_call_index = 0;
     
     vm->actor_random_number_seed = 0;
     
@@ -385,6 +490,12 @@ liz_vm_reset(liz_vm_t *vm)
     
     vm->cancellation_range = (liz_vm_cancellation_range_t){0u, 0u};
     
+    if (NULL != vm->cancellation_batch) {
+        liz_vm_cancellation_batch_clear(vm->cancellation_batch);
+    }
+    
+    vm->update_stats = (liz_vm_update_stats_t){0u, 0u, 0u, 0u, 0u, 0u, 0u};
+    
     vm->cmd = liz_vm_cmd_invoke_node;
     vm->execution_state = liz_execution_state_launch;
 }
@@ -394,6 +505,145 @@ liz_vm_reset(liz_vm_t *vm)
 #pragma mark Step actor update by hand
 
 
+bool
+liz_vm_begin_update_actor(liz_vm_t *vm,
+                          liz_vm_actor_t const *actor,
+                          liz_vm_shape_t const *shape)
+{
+    LIZ_ASSERT(liz_vm_fulfills_shape_specification(vm, shape->spec));
+    
+    liz_vm_reset(vm);
+    
+    if (0u == shape->spec.shape_atom_count) {
+        return false;
+    }
+    
+    vm->actor_random_number_seed = actor->header->random_number_seed;
+    
+    return true;
+}
+
+
+
+liz_int_t
+liz_vm_step_update_actor(liz_vm_t *vm,
+                         liz_vm_monitor_t *monitor,
+                         void * LIZ_RESTRICT actor_blackboard,
+                         liz_time_t const time,
+                         liz_vm_actor_t const *actor,
+                         liz_vm_shape_t const *shape,
+                         liz_int_t const max_step_count)
+{
+    LIZ_ASSERT(0 <= max_step_count);
+    
+    liz_int_t step_count = 0;
+    
+    LIZ_VM_STATS_CYCLES_BEGIN(step_begin_cycles);
+    while (step_count < max_step_count && liz_vm_is_running(vm)) {
+        liz_vm_step(vm,
+                    monitor,
+                    actor_blackboard,
+                    time,
+                    actor,
+                    shape);
+        ++step_count;
+    }
+    LIZ_VM_STATS_CYCLES_END(step_begin_cycles, vm);
+    
+    return step_count;
+}
+
+
+
+liz_int_t
+liz_vm_pending_immediate_action_function_index(liz_vm_t const *vm,
+                                               liz_vm_shape_t const *shape)
+{
+    if (liz_vm_cmd_invoke_node != vm->cmd) {
+        return -1;
+    }
+    
+    // Look ahead with a copy of the subtree call cursor to leave vm as is.
+    liz_int_t subtree_call_index = vm->subtree_call_index;
+    liz_shape_atom_t const *atom = liz_vm_shape_atom(shape, &subtree_call_index, vm->shape_atom_index);
+    
+    if (liz_node_type_immediate_action != (liz_node_type_t)(atom->type_mask.type)) {
+        return -1;
+    }
+    
+    return (liz_int_t)atom->immediate_action.function_index;
+}
+
+
+
+liz_execution_state_t
+liz_vm_step_begin_immediate_action(liz_vm_t *vm,
+                                   liz_vm_monitor_t *monitor,
+                                   void * LIZ_RESTRICT actor_blackboard,
+                                   liz_time_t const time,
+                                   liz_vm_actor_t const *actor,
+                                   liz_vm_shape_t const *shape)
+{
+    LIZ_ASSERT(0 <= liz_vm_pending_immediate_action_function_index(vm, shape));
+    
+    LIZ_VM_MONITOR_NODE(monitor,
+                        vm->shape_atom_index,
+                        liz_vm_monitor_node_flag_enter_from_top,
+                        vm,
+                        actor_blackboard, 
+                        time,
+                        actor,
+                        shape);
+    
+    liz_vm_resolve_cancellation_batch_before_immediate_action(vm,
+                                                              monitor,
+                                                              actor_blackboard,
+                                                              time,
+                                                              actor,
+                                                              shape);
+    
+    // Keep the subtree call cursor in step with liz_vm_step_invoke_node.
+    (void)liz_vm_shape_atom(shape, &vm->subtree_call_index, vm->shape_atom_index);
+    
+    return liz_vm_request_immediate_action(vm,
+                                           actor);
+}
+
+
+
+void
+liz_vm_step_end_immediate_action(liz_vm_t *vm,
+                                 liz_vm_monitor_t *monitor,
+                                 void * LIZ_RESTRICT actor_blackboard,
+                                 liz_time_t const time,
+                                 liz_vm_actor_t const *actor,
+                                 liz_vm_shape_t const *shape,
+                                 liz_execution_state_t const execution_state)
+{
+    LIZ_ASSERT(liz_vm_cmd_invoke_node == vm->cmd);
+    LIZ_ASSERT(liz_execution_state_launch != execution_state && "Immediate actions must not return a launch statel, return running instead.");
+    
+    liz_int_t const monitored_shape_atom_index = vm->shape_atom_index;
+    
+    LIZ_VM_STATS_COUNT_IMMEDIATE_ACTION(vm);
+    liz_vm_store_immediate_action(vm,
+                                  execution_state);
+    
+    LIZ_VM_MONITOR_NODE(monitor,
+                        monitored_shape_atom_index,
+                        liz_vm_monitor_node_flag_leave_to_top,
+                        vm,
+                        actor_blackboard, 
+                        time,
+                        actor,
+                        shape);
+    
+    // Traverse up to decider, alas its associated guard.
+    vm->cmd = liz_vm_cmd_guard_decider;
+}
+
+
+
 void
 liz_vm_step(liz_vm_t *vm,
             liz_vm_monitor_t *monitor,
@@ -458,7 +708,7 @@ liz_vm_step_invoke_node(liz_vm_t *vm,
                         liz_vm_actor_t const *actor,
                         liz_vm_shape_t const *shape)
 {
-    LIZ_ASSERT(shape->spec.shape_atom_count > vm->shape_atom_index);
+    LIZ_ASSERT(liz_shape_specification_shape_atom_index_count(shape->spec) > vm->shape_atom_index);
     LIZ_ASSERT(liz_vm_cmd_invoke_node == vm->cmd);
     
     liz_int_t const monitored_shape_atom_index = vm->shape_atom_index;
@@ -474,14 +724,25 @@ liz_vm_step_invoke_node(liz_vm_t *vm,
     
     liz_vm_cmd_t next_cmd = liz_vm_cmd_error;
     
-    switch (shape->atoms[vm->shape_atom_index].type_mask.type) {
+    // Decode the node once and hand it to the invocation.
+    liz_shape_atom_t const *node_atom = liz_vm_shape_atom(shape, &vm->subtree_call_index, vm->shape_atom_index);
+    
+    switch (node_atom->type_mask.type) {
         case liz_node_type_immediate_action:
+            liz_vm_resolve_cancellation_batch_before_immediate_action(vm,
+                                                                      monitor,
+                                                                      actor_blackboard,
+                                                                      time,
+                                                                      actor,
+                                                                      shape);
+            
             // Checks for invalid execution states internally.
             liz_vm_invoke_immediate_action(vm,
                                            actor_blackboard,
                                            time,
                                            actor,
-                                           shape);
+                                           shape,
+                                           node_atom);
             
             // Traverse up to decider, alas its associated guard.
             next_cmd = liz_vm_cmd_guard_decider;
@@ -493,7 +754,7 @@ liz_vm_step_invoke_node(liz_vm_t *vm,
             // Checks for invalid execution states internally.
             liz_vm_invoke_deferred_action(vm,
                                           actor,
-                                          shape);
+                                          node_atom);
             
             // Traverse up to decider, alas its associated guard.
             next_cmd = liz_vm_cmd_guard_decider;
@@ -516,7 +777,7 @@ liz_vm_step_invoke_node(liz_vm_t *vm,
         case liz_node_type_sequence_decider:
             liz_vm_invoke_sequence_decider(vm,
                                            actor,
-                                           shape);
+                                           node_atom);
             
             // Traverse down to a decider child.
             next_cmd = liz_vm_cmd_invoke_node;
@@ -529,7 +790,7 @@ liz_vm_step_invoke_node(liz_vm_t *vm,
         case liz_node_type_dynamic_priority_decider:
             liz_vm_invoke_dynamic_priority_decider(vm,
                                                    actor,
-                                                   shape);
+                                                   node_atom);
             
             // Traverse down to a decider child.
             next_cmd = liz_vm_cmd_invoke_node;
@@ -542,7 +803,7 @@ liz_vm_step_invoke_node(liz_vm_t *vm,
         case liz_node_type_concurrent_decider:
             liz_vm_invoke_concurrent_decider(vm,
                                              actor,
-                                             shape);
+                                             node_atom);
             
             // Traverse down to a decider child.
             next_cmd = liz_vm_cmd_invoke_node;
@@ -552,6 +813,11 @@ liz_vm_step_invoke_node(liz_vm_t *vm,
             
             break;
             
+        case liz_node_type_subtree_call:
+            // Subtree call atoms are resolved via the shape's subtree calls
+            // and are never invoked - fall through to signal a malformed
+            // shape or a missing subtree call table.
+            
         default:
             assert(0 && "Unhandled node type.");
             next_cmd = liz_vm_cmd_error;
@@ -592,7 +858,7 @@ liz_vm_step_guard_decider(liz_vm_t *vm,
     
     // Process decider node's child execution state, alas guard how to react.
     liz_vm_decider_guard_t const *top_guard = liz_vm_current_top_decider_guard(vm);
-    liz_vm_monitor_node_flag_t traversal_direction = liz_vm_monitor_node_flag_enter_from_bottom;
+    liz_vm_monitor_node_flag_t const traversal_direction = liz_vm_monitor_node_flag_enter_from_bottom;
     liz_int_t const monitored_shape_atom_index = top_guard->shape_atom_index;
     LIZ_VM_MONITOR_NODE(monitor,
                         monitored_shape_atom_index,
@@ -621,6 +887,29 @@ liz_vm_step_guard_decider(liz_vm_t *vm,
             break;
     }
     
+    liz_vm_leave_decider_guard(vm,
+                               monitor,
+                               actor_blackboard,
+                               time,
+                               actor,
+                               shape);
+}
+
+
+
+void
+liz_vm_leave_decider_guard(liz_vm_t *vm,
+                           liz_vm_monitor_t *monitor,
+                           void * LIZ_RESTRICT actor_blackboard,
+                           liz_time_t const time,
+                           liz_vm_actor_t const *actor,
+                           liz_vm_shape_t const *shape)
+{
+    LIZ_ASSERT(liz_vm_cmd_guard_decider == vm->cmd);
+    
+    liz_vm_decider_guard_t const *top_guard = liz_vm_current_top_decider_guard(vm);
+    liz_vm_monitor_node_flag_t traversal_direction = liz_vm_monitor_node_flag_leave_to_top;
+    liz_int_t const monitored_shape_atom_index = top_guard->shape_atom_index;
     
     // Determine traversal direction and which cmd to run next.
     bool const traversing_up = top_guard->end_index <= vm->shape_atom_index;
@@ -683,6 +972,15 @@ liz_vm_step_cleanup(liz_vm_t *vm,
                                                 actor,
                                                 shape);
     
+    if (NULL != vm->cancellation_batch) {
+        liz_vm_resolve_cancellation_batch(vm,
+                                          monitor,
+                                          actor_blackboard,
+                                          time,
+                                          actor,
+                                          shape);
+    }
+    
     // Reorder vm decider states.
     liz_vm_sort_values_for_keys_from_post_order_traversal(vm->decider_states,
                                                           vm->decider_state_shape_atom_indices,
@@ -717,16 +1015,10 @@ liz_vm_step_cleanup(liz_vm_t *vm,
 
 
 
-void
-liz_vm_invoke_immediate_action(liz_vm_t *vm,
-                               void * LIZ_RESTRICT actor_blackboard,
-                               liz_time_t const time,
-                               liz_vm_actor_t const *actor,
-                               liz_vm_shape_t const *shape)
+liz_execution_state_t
+liz_vm_request_immediate_action(liz_vm_t *vm,
+                                liz_vm_actor_t const *actor)
 {
-    LIZ_ASSERT(liz_node_type_immediate_action == (liz_node_type_t)(shape->atoms[vm->shape_atom_index].type_mask.type));
-    
-    // Determine the action state.
     liz_execution_state_t exec_state = liz_execution_state_launch;
     if (liz_seek_key(&vm->actor_action_state_index,
                      vm->shape_atom_index,
@@ -745,14 +1037,16 @@ liz_vm_invoke_immediate_action(liz_vm_t *vm,
                              actor->header->action_state_count);
     }
     
-    // Call the immediate action.
-    exec_state = liz_vm_tick_immediate_action(actor_blackboard,
-                                              &vm->actor_random_number_seed,
-                                              time,
-                                              exec_state,
-                                              &shape->atoms[vm->shape_atom_index],
-                                              shape->immediate_action_functions,
-                                              shape->spec.immediate_action_function_count);
+    return exec_state;
+}
+
+
+
+void
+liz_vm_store_immediate_action(liz_vm_t *vm,
+                              liz_execution_state_t const execution_state)
+{
+    liz_execution_state_t exec_state = execution_state;
     
     // Catch invalid user supplied immediate action function return values.
     LIZ_VM_CATCH_INVALID_PERSISTENT_AND_IMMEDIATE_ACTION_STATE(&exec_state);
@@ -772,12 +1066,48 @@ liz_vm_invoke_immediate_action(liz_vm_t *vm,
 
 
 
+void
+liz_vm_invoke_immediate_action(liz_vm_t *vm,
+                               void * LIZ_RESTRICT actor_blackboard,
+                               liz_time_t const time,
+                               liz_vm_actor_t const *actor,
+                               liz_vm_shape_t const *shape,
+                               liz_shape_atom_t const *node_atom)
+{
+    liz_shape_atom_t const *action_atom = node_atom;
+    
+    LIZ_ASSERT(liz_node_type_immediate_action == (liz_node_type_t)(action_atom->type_mask.type));
+    
+    // Determine the action state.
+    liz_execution_state_t exec_state = liz_vm_request_immediate_action(vm,
+                                                                       actor);
+    
+    // Call the immediate action.
+    LIZ_VM_COUNT_CYCLES_BEGIN(tick_begin_cycles);
+    exec_state = liz_vm_tick_immediate_action(actor_blackboard,
+                                              &vm->actor_random_number_seed,
+                                              time,
+                                              exec_state,
+                                              action_atom,
+                                              shape->immediate_action_functions,
+                                              shape->spec.immediate_action_function_count);
+    LIZ_VM_COUNT_CYCLES_END(tick_begin_cycles, vm, vm->shape_atom_index);
+    LIZ_VM_STATS_COUNT_IMMEDIATE_ACTION(vm);
+    
+    liz_vm_store_immediate_action(vm,
+                                  exec_state);
+}
+
+
+
 void
 liz_vm_invoke_deferred_action(liz_vm_t *vm,
                               liz_vm_actor_t const *actor,
-                              liz_vm_shape_t const *shape)
+                              liz_shape_atom_t const *node_atom)
 {
-    LIZ_ASSERT(liz_node_type_deferred_action == (liz_node_type_t)(shape->atoms[vm->shape_atom_index].type_mask.type));
+    liz_shape_atom_t const *action_atom = node_atom;
+    
+    LIZ_ASSERT(liz_node_type_deferred_action == (liz_node_type_t)(action_atom->type_mask.type));
     
     liz_execution_state_t exec_state = liz_execution_state_launch;
     
@@ -816,7 +1146,7 @@ liz_vm_invoke_deferred_action(liz_vm_t *vm,
         liz_vm_launch_or_cancel_deferred_action(vm->action_requests,
                                                 &vm->action_request_stack_header, 
                                                 liz_execution_state_launch, 
-                                                shape->atoms, 
+                                                action_atom, 
                                                 vm->shape_atom_index);
         /*
         liz_shape_atom_t const first_atom = shape->atoms[vm->shape_atom_index];
@@ -826,7 +1156,7 @@ liz_vm_invoke_deferred_action(liz_vm_t *vm,
         vm->action_requests[action_request_top_index] = (liz_vm_action_request_t){
             second_atom.deferred_action_second.action_id,
             first_atom.deferred_action_first.resource_id,
-            (uint16_t)vm->shape_atom_index
+            (liz_index_t)vm->shape_atom_index
         };
          */
         
@@ -854,7 +1184,7 @@ liz_vm_invoke_persistent_action(liz_vm_t *vm,
                                 liz_vm_actor_t const *actor,
                                 liz_vm_shape_t const *shape)
 {
-    LIZ_ASSERT(liz_node_type_persistent_action == (liz_node_type_t)(shape->atoms[vm->shape_atom_index].type_mask.type));
+    LIZ_ASSERT(liz_node_type_persistent_action == (liz_node_type_t)(liz_vm_shape_atom(shape, &vm->subtree_call_index, vm->shape_atom_index)->type_mask.type));
     
     // Fetch state
     bool const state_found = liz_seek_key(&vm->actor_persistent_state_index,
@@ -886,9 +1216,9 @@ liz_vm_invoke_persistent_action(liz_vm_t *vm,
 void
 liz_vm_invoke_sequence_decider(liz_vm_t *vm,
                                liz_vm_actor_t const *actor,
-                               liz_vm_shape_t const *shape)
+                               liz_shape_atom_t const *node_atom)
 {
-    liz_shape_atom_t const decider_atom = shape->atoms[vm->shape_atom_index];
+    liz_shape_atom_t const decider_atom = *node_atom;
     
     LIZ_ASSERT(liz_node_type_sequence_decider == (liz_node_type_t)(decider_atom.type_mask.type));
 
@@ -897,7 +1227,7 @@ liz_vm_invoke_sequence_decider(liz_vm_t *vm,
     // Fetch state - in case of a sequence decider.
     LIZ_ASSERT(0u == LIZ_NODE_SHAPE_ATOM_COUNT_SEQUENCE_DECIDER_TWO_CHILDREN 
                && "Invalid assumption that the shape atom count per sequence decider child is zero. This is assumed because there is no efficient way to determine the number of children of a sequence decider.");
-    uint16_t reached_child = vm->shape_atom_index + LIZ_NODE_SHAPE_ATOM_COUNT_SEQUENCE_DECIDER + 0 * LIZ_NODE_SHAPE_ATOM_COUNT_SEQUENCE_DECIDER_TWO_CHILDREN;
+    liz_index_t reached_child = vm->shape_atom_index + LIZ_NODE_SHAPE_ATOM_COUNT_SEQUENCE_DECIDER + 0 * LIZ_NODE_SHAPE_ATOM_COUNT_SEQUENCE_DECIDER_TWO_CHILDREN;
     
     if (liz_seek_key(&vm->actor_decider_state_index,
                      vm->shape_atom_index,
@@ -920,8 +1250,8 @@ liz_vm_invoke_sequence_decider(liz_vm_t *vm,
     vm->decider_guards[liz_lookaside_stack_top_index(&vm->decider_guard_stack_header)] = (liz_vm_decider_guard_t){
         vm->shape_atom_index,
         vm->shape_atom_index + decider_atom.sequence_decider.end_offset,
-        (uint16_t)liz_lookaside_stack_count(&vm->decider_state_stack_header),
-        (uint16_t)liz_lookaside_double_stack_count(&vm->action_request_stack_header, LIZ_VM_ACTION_REQUEST_STACK_SIDE_LAUNCH),
+        (liz_index_t)liz_lookaside_stack_count(&vm->decider_state_stack_header),
+        (liz_index_t)liz_lookaside_double_stack_count(&vm->action_request_stack_header, LIZ_VM_ACTION_REQUEST_STACK_SIDE_LAUNCH),
         reached_child,
         0,
         decider_atom.sequence_decider.type,
@@ -942,11 +1272,11 @@ liz_vm_invoke_sequence_decider(liz_vm_t *vm,
 void
 liz_vm_invoke_dynamic_priority_decider(liz_vm_t *vm,
                                        liz_vm_actor_t const *actor,
-                                       liz_vm_shape_t const *shape)
+                                       liz_shape_atom_t const *node_atom)
 {
     (void)actor;
     
-    liz_shape_atom_t const decider_atom = shape->atoms[vm->shape_atom_index];
+    liz_shape_atom_t const decider_atom = *node_atom;
     
     LIZ_ASSERT(liz_node_type_dynamic_priority_decider == (liz_node_type_t)(decider_atom.type_mask.type));
     
@@ -960,8 +1290,8 @@ liz_vm_invoke_dynamic_priority_decider(liz_vm_t *vm,
     vm->decider_guards[liz_lookaside_stack_top_index(&vm->decider_guard_stack_header)] = (liz_vm_decider_guard_t){
         vm->shape_atom_index,
         vm->shape_atom_index + decider_atom.dynamic_priority_decider.end_offset,
-        (uint16_t)liz_lookaside_stack_count(&vm->decider_state_stack_header),
-        (uint16_t)liz_lookaside_double_stack_count(&vm->action_request_stack_header, LIZ_VM_ACTION_REQUEST_STACK_SIDE_LAUNCH),
+        (liz_index_t)liz_lookaside_stack_count(&vm->decider_state_stack_header),
+        (liz_index_t)liz_lookaside_double_stack_count(&vm->action_request_stack_header, LIZ_VM_ACTION_REQUEST_STACK_SIDE_LAUNCH),
         0,
         0,
         decider_atom.dynamic_priority_decider.type,
@@ -984,11 +1314,11 @@ liz_vm_invoke_dynamic_priority_decider(liz_vm_t *vm,
 void
 liz_vm_invoke_concurrent_decider(liz_vm_t *vm,
                                  liz_vm_actor_t const *actor,
-                                 liz_vm_shape_t const *shape)
+                                 liz_shape_atom_t const *node_atom)
 {
     (void)actor;
     
-    liz_shape_atom_t const decider_atom = shape->atoms[vm->shape_atom_index];
+    liz_shape_atom_t const decider_atom = *node_atom;
     
     LIZ_ASSERT(liz_node_type_concurrent_decider == (liz_node_type_t)(decider_atom.type_mask.type));
     
@@ -1002,8 +1332,8 @@ liz_vm_invoke_concurrent_decider(liz_vm_t *vm,
     vm->decider_guards[liz_lookaside_stack_top_index(&vm->decider_guard_stack_header)] = (liz_vm_decider_guard_t){
         vm->shape_atom_index,
         vm->shape_atom_index + decider_atom.concurrent_decider.end_offset,
-        (uint16_t)liz_lookaside_stack_count(&vm->decider_state_stack_header),
-        (uint16_t)liz_lookaside_double_stack_count(&vm->action_request_stack_header, LIZ_VM_ACTION_REQUEST_STACK_SIDE_LAUNCH),
+        (liz_index_t)liz_lookaside_stack_count(&vm->decider_state_stack_header),
+        (liz_index_t)liz_lookaside_double_stack_count(&vm->action_request_stack_header, LIZ_VM_ACTION_REQUEST_STACK_SIDE_LAUNCH),
         0,
         (uint8_t)liz_execution_state_success,
         decider_atom.concurrent_decider.type,
@@ -1047,13 +1377,13 @@ liz_vm_guard_sequence_decider(liz_vm_t *vm)
             vm->decider_states[top_index] = guard->sequence_reached_child_index;
             vm->decider_state_shape_atom_indices[top_index] = guard->shape_atom_index;
             
-            vm->shape_atom_index = (uint16_t)guard->end_index;
+            vm->shape_atom_index = (liz_index_t)guard->end_index;
             break;
         }
             
         case liz_execution_state_success:
             // Child succeeded, on to the next child, remember reached child.
-            guard->sequence_reached_child_index = (uint16_t)vm->shape_atom_index; 
+            guard->sequence_reached_child_index = (liz_index_t)vm->shape_atom_index; 
             LIZ_ASSERT(vm->decider_state_stack_header.count == guard->decider_state_rollback_marker);
             break;
             
@@ -1157,11 +1487,11 @@ liz_vm_guard_dynamic_priority_decider(liz_vm_t *vm)
 void
 liz_vm_init(liz_vm_t *vm,
             liz_shape_specification_t const spec,
-            uint16_t *persistent_state_change_shape_atom_indices,
-            uint16_t *decider_state_shape_atom_indices,
-            uint16_t *action_state_shape_atom_indices,
+            liz_index_t *persistent_state_change_shape_atom_indices,
+            liz_index_t *decider_state_shape_atom_indices,
+            liz_index_t *action_state_shape_atom_indices,
             liz_persistent_state_t *persistent_state_changes,
-            uint16_t *decider_states,
+            liz_index_t *decider_states,
             uint8_t *action_states,
             liz_vm_decider_guard_t *decider_guards,
             liz_vm_action_request_t *action_requests)
@@ -1177,6 +1507,9 @@ liz_vm_init(liz_vm_t *vm,
     vm->decider_guards = decider_guards;
     vm->action_requests = action_requests;
     
+    vm->counters = NULL;
+    vm->cancellation_batch = NULL;
+    
     vm->actor_random_number_seed = 0;
     
     vm->persistent_state_change_stack_header = liz_lookaside_stack_make(spec.persistent_state_change_capacity, 0);
@@ -1191,6 +1524,29 @@ liz_vm_init(liz_vm_t *vm,
 
 
 
+static
+bool
+liz_vm_has_running_actions_in_cancellation_range(liz_vm_t const *vm)
+{
+    liz_int_t const action_state_count = liz_lookaside_stack_count(&vm->action_state_stack_header);
+    
+    for (liz_int_t i = liz_lower_bound_key(vm->cancellation_range.begin_index,
+                                           vm->action_state_shape_atom_indices,
+                                           0,
+                                           action_state_count); 
+         i < action_state_count; 
+         ++i) {
+        
+        if (liz_execution_state_running == (liz_execution_state_t)(vm->action_states[i])) {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+
+
 void
 liz_vm_cancel_actions_in_cancellation_range(liz_vm_t *vm,
                                             liz_vm_monitor_t *monitor,
@@ -1202,6 +1558,21 @@ liz_vm_cancel_actions_in_cancellation_range(liz_vm_t *vm,
     if (liz_vm_cancellation_range_is_empty(vm->cancellation_range)) {
         return;
     }
+    
+    liz_vm_cancellation_batch_t *batch = vm->cancellation_batch;
+    
+    // Batched actions precede the running vm actions in cancellation order.
+    if (NULL != batch
+        && !liz_vm_cancellation_batch_is_empty(batch)
+        && liz_vm_has_running_actions_in_cancellation_range(vm)) {
+        
+        liz_vm_resolve_cancellation_batch(vm,
+                                          monitor,
+                                          actor_blackboard,
+                                          time,
+                                          actor,
+                                          shape);
+    }
    
     liz_vm_cancel_running_actions_from_current_update(vm,
                                                       monitor,
@@ -1210,14 +1581,29 @@ liz_vm_cancel_actions_in_cancellation_range(liz_vm_t *vm,
                                                       actor,
                                                       shape);
     
-    // Running this after the jump back to have linear shape atom stream 
-    // iteration during cancellation.
-    liz_vm_cancel_launched_and_running_actions_from_previous_update(vm,
-                                                                    monitor,
-                                                                    actor_blackboard,
-                                                                    time,
-                                                                    actor,
-                                                                    shape);
+    if (NULL == batch) {
+        // Running this after the jump back to have linear shape atom stream 
+        // iteration during cancellation.
+        liz_vm_cancel_launched_and_running_actions_from_previous_update(vm,
+                                                                        monitor,
+                                                                        actor_blackboard,
+                                                                        time,
+                                                                        actor,
+                                                                        shape);
+    } else {
+        
+        while (!liz_vm_cancellation_batch_push(batch,
+                                               vm->cancellation_range.begin_index,
+                                               vm->cancellation_range.end_index,
+                                               vm->actor_action_state_index)) {
+            liz_vm_resolve_cancellation_batch(vm,
+                                              monitor,
+                                              actor_blackboard,
+                                              time,
+                                              actor,
+                                              shape);
+        }
+    }
     
     // Clear alas empty the cancellation range.
     vm->cancellation_range = (liz_vm_cancellation_range_t){
@@ -1228,121 +1614,10 @@ liz_vm_cancel_actions_in_cancellation_range(liz_vm_t *vm,
 
 
 
-/**
- * TODO: @todo Extract and complete to create a breakpoint monitor on top of the 
- *             simpler monitor concept.
- */
-/*
-void
-liz_vm_monitor_node(uintptr_t user_data,
-                    uint16_t const node_shape_atom_index,
-                    liz_uint_t const traversal_direction,
-                    liz_vm_t const *vm,
-                    void const * LIZ_RESTRICT actor_blackboard,
-                    liz_vm_actor_t const *actor,
-                    liz_vm_shape_t const *shape)
-{
-    liz_vm_breakpoint_monitor_t *monitor = (liz_vm_breakpoint_monitor_t *)user_data;
-    
-    LIZ_ASSERT(0 < monitor->breakpoint_function_count);
-    
-    liz_vm_monitor_breakpoint_stream_t const *breakpoints = monitor->node_breakpoints;
-    
-    if (NULL == monitor
-        || NULL == breakpoints) {
-        
-        return;
-    }
-
-    
-    if (liz_vm_monitor_node_flag_cancel_action & traversal_direction) {
-        
-        liz_uint_t const cancel_mask = traversal_direction - liz_vm_monitor_node_flag_cancel_action;
-        
-        // Cancellation will lead to the end of the cancelled sub-stream, 
-        // reusing the breakpoint index to enable an efficient cancellation 
-        // treatment.
-        monitor->breakpoint_index = 0;
-        if (!liz_seek_key(&monitor->breakpoint_index, 
-                          node_shape_atom_index,
-                          breakpoints->shape_atom_indices,
-                          breakpoints->count)) {
-         
-            return;
-        }
-        
-        // Introduce a helper function for this and reuse it below!
-        if (traversal_direction & breakpoints->flags[monitor->breakpoint_index]) {
-            liz_int_t const func_index = breakpoints->function_indices[monitor->breakpoint_index];
-            LIZ_ASSERT(func_index < monitor->breakpoint_function_count);
-            
-            monitor->breakpoint_functions[func_index]((uintptr_t)monitor,
-                                                      node_shape_atom_index,
-                                                      traversal_direction,
-                                                      vm,
-                                                      actor_blackboard,
-                                                      actor,
-                                                      shape);
-        }
-        
-        
-        return;
-    }
-
-
-    switch (traversal_direction) {
-        case liz_vm_monitor_node_flag_enter_from_top:
-            // Invoke a node, all vm data identify the node.
-            
-            if (liz_seek_key(&monitor->breakpoint_index,
-                             node_shape_atom_index,
-                             breakpoints->shape_atom_indices,
-                             breakpoints->count)) {
-                
-                liz_vm_breakpoint_monitor_trigger_breakpoint(monitor,
-                                                             node_shape_atom_index,
-                                                             traversal_direction,
-                                                             vm,
-                                                             actor_blackboard,
-                                                             actor,
-                                                             shape);
-                
-                if (shape->atoms[node_shape_atom_index].type_mask.type > liz_node_type_action_max_id
-                    && ~((liz_uint_t)(liz_vm_monitor_node_flag_cancel_action | liz_vm_monitor_node_flag_enter_from_top)) & breakpoints->flags[monitor->breakppoint_index]) {
-                    
-                    // Push breakpoint guard onto breakpoint guard stack.
-                    
-                }
-                
-                
-            }
-            
-            break;
-        case liz_vm_monitor_node_flag_enter_from_bottom:
-            // Entering a guard from the bottom - see vm stack. Check if guarding this shape atom index.
-            break;
-        case liz_vm_monitor_node_flag_leave_to_top:
-            // Leaving an node or a guard. Pop monitor stack if it matches the shape atom index.
-            break;
-        case liz_vm_monitor_node_flag_leave_to_bottom:
-            // Leaving decider node or its guard. In both cases guard is on stack.
-            break;
-        default:
-            LIZ_ASSERT(0 && "Unhandled traversal direction.");
-            break;
-    }
-    
-    
-#error Only push a guard breakpoint to the stack if the stack isn't full!
-}
-*/
-
-
-
 void
 liz_vm_cancellation_range_adapt(liz_vm_cancellation_range_t *cancellation_range,
-                                uint16_t const new_begin_index,
-                                uint16_t const new_end_index)
+                                liz_index_t const new_begin_index,
+                                liz_index_t const new_end_index)
 {
     LIZ_ASSERT(new_begin_index <= new_end_index);
     
@@ -1355,8 +1630,8 @@ liz_vm_cancellation_range_adapt(liz_vm_cancellation_range_t *cancellation_range,
         
     } else if (new_begin_index < new_end_index) {
         // Only non-empty new begin/end pairs adapt a non-empty range.
-        range.begin_index = (uint16_t)liz_min(range.begin_index, new_begin_index);
-        range.end_index = (uint16_t)liz_max(range.end_index, new_end_index);
+        range.begin_index = (liz_index_t)liz_min(range.begin_index, new_begin_index);
+        range.end_index = (liz_index_t)liz_max(range.end_index, new_end_index);
     }
     
     *cancellation_range = range;
@@ -1370,20 +1645,20 @@ liz_vm_cancel_immediate_or_deferred_action(void * LIZ_RESTRICT actor_blackboard,
                                            liz_vm_action_request_t *deferred_action_requests,
                                            liz_lookaside_double_stack_t *deferred_action_request_stack_header,
                                            liz_time_t const time,
-                                           liz_shape_atom_t const *shape_atoms,
+                                           liz_shape_atom_t const *first_shape_atom_of_node_in_stream,
                                            liz_int_t const shape_atom_index,
                                            liz_immediate_action_func_t const *immediate_action_functions,
                                            liz_int_t const immediate_action_function_count)
 {
     liz_execution_state_t exec_state = liz_execution_state_fail;
     
-    switch (shape_atoms[shape_atom_index].type_mask.type) {
+    switch (first_shape_atom_of_node_in_stream->type_mask.type) {
         case liz_node_type_immediate_action:
             exec_state = liz_vm_tick_immediate_action(actor_blackboard,
                                                       rnd_seed,
                                                       time,
                                                       liz_execution_state_cancel,
-                                                      &shape_atoms[shape_atom_index],
+                                                      first_shape_atom_of_node_in_stream,
                                                       immediate_action_functions,
                                                       immediate_action_function_count);
             
@@ -1393,7 +1668,7 @@ liz_vm_cancel_immediate_or_deferred_action(void * LIZ_RESTRICT actor_blackboard,
             exec_state = liz_vm_launch_or_cancel_deferred_action(deferred_action_requests,
                                                                  deferred_action_request_stack_header,
                                                                  liz_execution_state_cancel,
-                                                                 shape_atoms,
+                                                                 first_shape_atom_of_node_in_stream,
                                                                  shape_atom_index);
             
             break;
@@ -1436,14 +1711,14 @@ liz_execution_state_t
 liz_vm_launch_or_cancel_deferred_action(liz_vm_action_request_t *action_requests,
                                         liz_lookaside_double_stack_t *action_request_stack_header,
                                         liz_execution_state_t const execution_request,
-                                        liz_shape_atom_t const *shape_atoms,
+                                        liz_shape_atom_t const *first_shape_atom_of_node_in_stream,
                                         liz_int_t const shape_atom_index)
 {
     LIZ_ASSERT(liz_execution_state_launch == execution_request 
                || liz_execution_state_cancel == execution_request);
     
     // Consume two shape atoms per deferred action;
-    liz_shape_atom_t const *first_atom = shape_atoms + shape_atom_index;
+    liz_shape_atom_t const *first_atom = first_shape_atom_of_node_in_stream;
     liz_shape_atom_t const *second_atom = first_atom + 1;
     
     liz_lookaside_double_stack_side_t launch_or_cancel_side = LIZ_VM_ACTION_REQUEST_STACK_SIDE_LAUNCH;
@@ -1459,7 +1734,7 @@ liz_vm_launch_or_cancel_deferred_action(liz_vm_action_request_t *action_requests
     action_requests[top_index] = (liz_vm_action_request_t){
         second_atom->deferred_action_second.action_id,
         first_atom->deferred_action_first.resource_id,
-        shape_atom_index
+        (liz_index_t)shape_atom_index
     };
     
     return execution_request;
@@ -1477,13 +1752,14 @@ liz_vm_cancel_running_actions_from_current_update(liz_vm_t *vm,
                                                   liz_vm_shape_t const *shape)
 {
     liz_vm_cancellation_range_t const range = vm->cancellation_range;
-    liz_int_t first_action_index = 0;
+    liz_int_t subtree_call_index = 0;
     
-    // If this shows up as a hotspot implement and test a backward key search.
-    (void)liz_seek_key(&first_action_index,
-                       range.begin_index,
-                       vm->action_state_shape_atom_indices,
-                       liz_lookaside_stack_count(&vm->action_state_stack_header));
+    // Earlier cancellations truncated the action state stack, so the stack
+    // ends inside the range and only its lower bound needs to be searched.
+    liz_int_t const first_action_index = liz_lower_bound_key(range.begin_index,
+                                                             vm->action_state_shape_atom_indices,
+                                                             0,
+                                                             liz_lookaside_stack_count(&vm->action_state_stack_header));
     
     for (liz_int_t i = first_action_index; i < liz_lookaside_stack_count(&vm->action_state_stack_header); ++i) {
         LIZ_ASSERT(range.begin_index <= vm->action_state_shape_atom_indices[i] 
@@ -1511,7 +1787,7 @@ liz_vm_cancel_running_actions_from_current_update(liz_vm_t *vm,
                                                        vm->action_requests,
                                                        &vm->action_request_stack_header,
                                                        time,
-                                                       shape->atoms,
+                                                       liz_vm_shape_atom(shape, &subtree_call_index, vm->action_state_shape_atom_indices[i]),
                                                        vm->action_state_shape_atom_indices[i],
                                                        shape->immediate_action_functions,
                                                        shape->spec.immediate_action_function_count);
@@ -1544,28 +1820,26 @@ liz_vm_cancel_running_actions_from_current_update(liz_vm_t *vm,
 
 
 
+/**
+ * Cancels the running and launched actions of the actor's action states in
+ * [begin_action_index, end_action_index).
+ */
+static
 void
-liz_vm_cancel_launched_and_running_actions_from_previous_update(liz_vm_t *vm,
-                                                                liz_vm_monitor_t *monitor,
-                                                                void * LIZ_RESTRICT actor_blackboard,
-                                                                liz_time_t const time,
-                                                                liz_vm_actor_t const *actor,
-                                                                liz_vm_shape_t const *shape)
+liz_vm_cancel_actor_actions(liz_vm_t *vm,
+                            liz_vm_monitor_t *monitor,
+                            void * LIZ_RESTRICT actor_blackboard,
+                            liz_time_t const time,
+                            liz_vm_actor_t const *actor,
+                            liz_vm_shape_t const *shape,
+                            liz_int_t const begin_action_index,
+                            liz_int_t const end_action_index)
 {
-    liz_vm_cancellation_range_t const range = vm->cancellation_range;
-    liz_int_t actor_action_index = vm->actor_action_state_index;
-    liz_int_t const actor_action_state_count = actor->header->action_state_count;
-    (void)liz_seek_key(&actor_action_index, 
-                       range.begin_index,
-                       actor->action_state_shape_atom_indices, 
-                       actor_action_state_count);
+    liz_int_t subtree_call_index = 0;
     
-    for (; actor_action_index < actor_action_state_count; ++actor_action_index) {
+    for (liz_int_t actor_action_index = begin_action_index; actor_action_index < end_action_index; ++actor_action_index) {
         
         liz_int_t const shape_atom_index = actor->action_state_shape_atom_indices[actor_action_index];
-        if (range.end_index <= shape_atom_index) {
-            break;
-        }
         
         liz_execution_state_t const action_state = (liz_execution_state_t)(actor->action_states[actor_action_index]);
         if (liz_execution_state_launch == action_state
@@ -1588,7 +1862,7 @@ liz_vm_cancel_launched_and_running_actions_from_previous_update(liz_vm_t *vm,
                                                        vm->action_requests,
                                                        &vm->action_request_stack_header,
                                                        time,
-                                                       shape->atoms,
+                                                       liz_vm_shape_atom(shape, &subtree_call_index, shape_atom_index),
                                                        shape_atom_index,
                                                        shape->immediate_action_functions,
                                                        shape->spec.immediate_action_function_count);
@@ -1604,17 +1878,119 @@ liz_vm_cancel_launched_and_running_actions_from_previous_update(liz_vm_t *vm,
                                 shape);
         }
     }
+}
+
+
+
+void
+liz_vm_cancel_launched_and_running_actions_from_previous_update(liz_vm_t *vm,
+                                                                liz_vm_monitor_t *monitor,
+                                                                void * LIZ_RESTRICT actor_blackboard,
+                                                                liz_time_t const time,
+                                                                liz_vm_actor_t const *actor,
+                                                                liz_vm_shape_t const *shape)
+{
+    liz_vm_cancellation_range_t const range = vm->cancellation_range;
+    liz_int_t const actor_action_state_count = actor->header->action_state_count;
+    
+    // The vm's actor action state index is the cursor that persists across
+    // the cancellation ranges of an update. Ranges are cancelled in 
+    // ascending shape atom order, so the bounds of each range are searched 
+    // from where the previous range ended.
+    liz_int_t const begin_action_index = liz_lower_bound_key(range.begin_index,
+                                                             actor->action_state_shape_atom_indices,
+                                                             vm->actor_action_state_index,
+                                                             actor_action_state_count);
+    liz_int_t const end_action_index = liz_lower_bound_key(range.end_index,
+                                                           actor->action_state_shape_atom_indices,
+                                                           begin_action_index,
+                                                           actor_action_state_count);
+    
+    liz_vm_cancel_actor_actions(vm,
+                                monitor,
+                                actor_blackboard,
+                                time,
+                                actor,
+                                shape,
+                                begin_action_index,
+                                end_action_index);
     
     // Set the vm's actor action state index forward to not read the cancelled
     // action states again during the current update.
-    vm->actor_action_state_index = actor_action_index;
+    vm->actor_action_state_index = end_action_index;
+}
+
+
+
+void
+liz_vm_resolve_cancellation_batch(liz_vm_t *vm,
+                                  liz_vm_monitor_t *monitor,
+                                  void * LIZ_RESTRICT actor_blackboard,
+                                  liz_time_t const time,
+                                  liz_vm_actor_t const *actor,
+                                  liz_vm_shape_t const *shape)
+{
+    liz_vm_cancellation_batch_t *batch = vm->cancellation_batch;
+    liz_int_t const actor_action_state_count = actor->header->action_state_count;
+    liz_int_t end_action_index = 0;
+    
+    // Without batching the cursor would have been moved behind each 
+    // cancelled interval, therefore start each interval behind its 
+    // predecessor or at the cursor's position when batched.
+    for (liz_int_t i = 0; i < batch->count; ++i) {
+        
+        liz_vm_cancellation_interval_t const interval = batch->intervals[i];
+        liz_int_t const begin_action_index = liz_lower_bound_key(interval.begin_index,
+                                                                 actor->action_state_shape_atom_indices,
+                                                                 liz_max(interval.actor_action_state_index, end_action_index),
+                                                                 actor_action_state_count);
+        end_action_index = liz_lower_bound_key(interval.end_index,
+                                               actor->action_state_shape_atom_indices,
+                                               begin_action_index,
+                                               actor_action_state_count);
+        
+        liz_vm_cancel_actor_actions(vm,
+                                    monitor,
+                                    actor_blackboard,
+                                    time,
+                                    actor,
+                                    shape,
+                                    begin_action_index,
+                                    end_action_index);
+    }
+    
+    vm->actor_action_state_index = liz_max(vm->actor_action_state_index, end_action_index);
+    
+    liz_vm_cancellation_batch_clear(batch);
+}
+
+
+
+void
+liz_vm_resolve_cancellation_batch_before_immediate_action(liz_vm_t *vm,
+                                                          liz_vm_monitor_t *monitor,
+                                                          void * LIZ_RESTRICT actor_blackboard,
+                                                          liz_time_t const time,
+                                                          liz_vm_actor_t const *actor,
+                                                          liz_vm_shape_t const *shape)
+{
+    if (NULL != vm->cancellation_batch
+        && !liz_vm_cancellation_batch_is_empty(vm->cancellation_batch)) {
+        
+        liz_vm_resolve_cancellation_batch(vm,
+                                          monitor,
+                                          actor_blackboard,
+                                          time,
+                                          actor,
+                                          shape);
+    }
 }
 
 
 
 void
 liz_vm_sort_values_for_keys_from_post_order_traversal(void * LIZ_RESTRICT values,
-                                                      uint16_t * LIZ_RESTRICT keys,
+                                                      liz_index_t * LIZ_RESTRICT keys,
                                                       size_t const value_size_in_bytes,
                                                       size_t const value_alignment_in_bytes,
                                                       liz_int_t const key_value_count,
@@ -1623,11 +1999,11 @@ liz_vm_sort_values_for_keys_from_post_order_traversal(void * LIZ_RESTRICT values
 {
     LIZ_ASSERT(0 == liz_lookaside_stack_count(decider_guard_stack_header) && "Decider guard stack must not be in use when sorting.");
     LIZ_ASSERT((0 == ((uintptr_t)decider_guard_stack_buffer & (LIZ_VM_DECIDER_GUARD_ALIGNMENT - 1))) 
-               && "Invalid assumption that decider guard stack is 16bit aligned.");
+               && "Invalid assumption that decider guard stack is aligned for shape atom indices.");
     LIZ_ASSERT(LIZ_VM_DECIDER_GUARD_ALIGNMENT >= LIZ_SHAPE_ATOM_INDEX_ALIGNMENT);
     
-    uint16_t *key_reorder_stack = (uint16_t *)decider_guard_stack_buffer;
-    void *value_reorder_stack = ((char *)decider_guard_stack_buffer) + liz_lookaside_stack_capacity(decider_guard_stack_header) * sizeof(uint16_t);
+    liz_index_t *key_reorder_stack = (liz_index_t *)decider_guard_stack_buffer;
+    void *value_reorder_stack = ((char *)decider_guard_stack_buffer) + liz_lookaside_stack_capacity(decider_guard_stack_header) * sizeof(liz_index_t);
     value_reorder_stack = ((char *)value_reorder_stack) + liz_allocation_alignment_offset(value_reorder_stack,
                                                                                           value_alignment_in_bytes);
     
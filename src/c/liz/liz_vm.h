@@ -59,6 +59,15 @@
  * Pass NULL for monitor to ignore traversal monitoring at runtime even with
  * defined LIZ_VM_MONITOR_ENABLE.
  *
+ * Define LIZ_VM_COUNTERS_ENABLE to compile with per node counters which are
+ * incremented at the monitor points without calling a function, and 
+ * additionally define LIZ_VM_COUNTERS_CYCLES_ENABLE to also sample the cycles
+ * spent in immediate actions. Assign counters to a vm to count at runtime,
+ * see liz_vm_counters.h.
+ *
+ * Define LIZ_VM_STATS_ENABLE to compile with per update cost statistics, see
+ * liz_vm_update_stats and liz_vm_stats.h.
+ *
  *
  * TODO: @todo Add a shape validation function to stop malformed behavior trees
  *             from being interpreted by the vm.
@@ -93,6 +102,9 @@
 #include <liz/liz_common_internal.h>
 #include <liz/liz_lookaside_stack.h>
 #include <liz/liz_lookaside_double_stack.h>
+#include <liz/liz_vm_counters.h>
+#include <liz/liz_vm_stats.h>
+#include <liz/liz_vm_cancellation_batch.h>
 
 
 #if defined(__cplusplus)
@@ -124,10 +136,10 @@ extern "C" {
         
         liz_persistent_state_t *persistent_states;
         
-        uint16_t *decider_state_shape_atom_indices;
-        uint16_t *decider_states;
+        liz_index_t *decider_state_shape_atom_indices;
+        liz_index_t *decider_states;
         
-        uint16_t *action_state_shape_atom_indices;
+        liz_index_t *action_state_shape_atom_indices;
         uint8_t *action_states;
     } liz_vm_actor_t;
     
@@ -135,10 +147,16 @@ extern "C" {
     
     /**
      * Provides direct access to shape data that might be stored in a data blob.
+     *
+     * subtree_calls maps shape atom indices inside subtree call sites to the
+     * stream indices of shared subtrees, see 
+     * liz_shape_atom_stream_collect_subtree_calls. It is only read if 
+     * spec.subtree_call_count is not zero.
      */
     typedef struct liz_vm_shape {
         liz_shape_atom_t *atoms;
-        uint16_t *persistent_state_shape_atom_indices;
+        liz_index_t *persistent_state_shape_atom_indices;
+        liz_shape_subtree_call_t *subtree_calls;
         
         liz_immediate_action_func_t *immediate_action_functions;
         
@@ -168,7 +186,7 @@ extern "C" {
     typedef struct liz_vm_action_request {
         uint32_t action_id;
         uint16_t resource_id;
-        uint16_t shape_atom_index;
+        liz_index_t shape_atom_index;
     } liz_vm_action_request_t;
     
     
@@ -176,7 +194,16 @@ extern "C" {
     /**
      * Assumed minimal alignment in bytes.
      */
-#define LIZ_VM_DECIDER_GUARD_ALIGNMENT sizeof(uint16_t)
+#define LIZ_VM_DECIDER_GUARD_ALIGNMENT sizeof(liz_index_t)
+    
+    /**
+     * Pads liz_vm_decider_guard_t to a multiple of 16 bytes.
+     */
+#if defined(LIZ_WIDE_INDEX_ENABLE)
+#   define LIZ_VM_DECIDER_GUARD_PADDING_SIZE 10
+#else
+#   define LIZ_VM_DECIDER_GUARD_PADDING_SIZE 4
+#endif
     
     
     
@@ -195,23 +222,23 @@ extern "C" {
      * liz_vm_cancel_immediately_by_guard.
      */
     typedef struct liz_vm_decider_guard {
-        uint16_t shape_atom_index;
-        uint16_t end_index;
+        liz_index_t shape_atom_index;
+        liz_index_t end_index;
         
-        uint16_t decider_state_rollback_marker;
-        uint16_t action_launch_request_rollback_marker;
+        liz_index_t decider_state_rollback_marker;
+        liz_index_t action_launch_request_rollback_marker;
         
         // Next two fields are guard type dependent. Storing them in a union
         // complicates initialization so no union as long as there is enough
         // space.
-        uint16_t sequence_reached_child_index;
+        liz_index_t sequence_reached_child_index;
         uint8_t concurrent_execution_state;
 
         uint8_t type;
         
-        // 128 bit alas 16 byte padding to be usable as a reorder stack with
-        // the right alignment for persistent state changes.
-        char padding_to_16_bytes[4];
+        // Padding to a multiple of 128 bit alas 16 byte to be usable as a 
+        // reorder stack with the right alignment for persistent state changes.
+        char padding[LIZ_VM_DECIDER_GUARD_PADDING_SIZE];
     } liz_vm_decider_guard_t;
     
     
@@ -221,8 +248,8 @@ extern "C" {
      * cancel.
      */
     typedef struct liz_vm_cancellation_range {
-        uint16_t begin_index;
-        uint16_t end_index;
+        liz_index_t begin_index;
+        liz_index_t end_index;
     } liz_vm_cancellation_range_t;
     
     
@@ -247,18 +274,28 @@ extern "C" {
         liz_int_t actor_decider_state_index;
         liz_int_t actor_action_state_index;
         liz_int_t actor_persistent_state_index;
+        liz_int_t subtree_call_index;
         
-        uint16_t *persistent_state_change_shape_atom_indices;
-        uint16_t *decider_state_shape_atom_indices;
-        uint16_t *action_state_shape_atom_indices;
+        liz_index_t *persistent_state_change_shape_atom_indices;
+        liz_index_t *decider_state_shape_atom_indices;
+        liz_index_t *action_state_shape_atom_indices;
         
         liz_persistent_state_t *persistent_state_changes;
-        uint16_t *decider_states;
+        liz_index_t *decider_states;
         uint8_t *action_states;
         
         liz_vm_decider_guard_t *decider_guards;
         liz_vm_action_request_t *action_requests;
         
+        // Only used with defined LIZ_VM_COUNTERS_ENABLE, NULL to not count.
+        liz_vm_counters_t *counters;
+        
+        // NULL to cancel immediately, see liz_vm_cancellation_batch.h.
+        liz_vm_cancellation_batch_t *cancellation_batch;
+        
+        // Only collected with defined LIZ_VM_STATS_ENABLE.
+        liz_vm_update_stats_t update_stats;
+        
         liz_random_number_seed_t actor_random_number_seed;
         
         liz_lookaside_stack_t persistent_state_change_stack_header;
@@ -311,72 +348,51 @@ extern "C" {
     
     
     
-    typedef struct liz_vm_monitor {
-        uintptr_t user_data;
-        liz_vm_monitor_func_t func;
-    } liz_vm_monitor_t;
+    /**
+     * Filter index matching no node in equality comparisons.
+     */
+#define LIZ_VM_MONITOR_FILTER_NO_SHAPE_ATOM_INDEX ((liz_int_t)-1)
+    
+    /**
+     * Filter next index greater than all valid shape atom indices.
+     */
+#define LIZ_VM_MONITOR_FILTER_END_SHAPE_ATOM_INDEX (((liz_int_t)LIZ_COUNT_MAX) + 1)
     
     
     
     /**
-     * Stream of monitor breakpoints.
-     *
-     * Breakpoints are ordered for the shape atom index they monitor.
-     * 
-     * When the vm visits a node and monitoring is enabled and a breakpoint is
-     * set for the node the flag is matched against the traversal direction
-     * and if they match then the indexed breakpoint function is called.
+     * Shape atom indices a monitor is interested in, compared inline by the 
+     * vm to only call the monitor function on a hit:
+     * - enter from top of nodes at or behind next_shape_atom_index,
+     * - leave to top of action_shape_atom_index, of guard_shape_atom_index,
+     *   or of the root node,
+     * - enter from bottom and leave to bottom of guard_shape_atom_index,
+     * - all cancellation and error traversal steps.
      *
-     * TODO: @todo Extract into a breakpoint monitor system.
+     * The monitor keeps the indices up to date from within its function. Set
+     * next_shape_atom_index to LIZ_VM_MONITOR_FILTER_END_SHAPE_ATOM_INDEX and
+     * the other indices to LIZ_VM_MONITOR_FILTER_NO_SHAPE_ATOM_INDEX to only
+     * match leaving the root node and cancellation and error steps. Do not set
+     * next_shape_atom_index to -1, it matches entering every node.
      */
-    /* Commented out - too complex and can be implemented on top of the simpler
-     * monitoring scheme.
-    typedef struct liz_vm_monitor_breakpoint_stream {
-        uint16_t const *shape_atom_indices;
-        uint16_t const *function_indices;
-        liz_vm_monitor_node_flag_t const *flags;
-        char const * const *labels;
-        
-        uint16_t count;
-    } liz_vm_monitor_breakpoint_stream_t;
-    
-    
+    typedef struct liz_vm_monitor_filter {
+        liz_int_t next_shape_atom_index;
+        liz_int_t action_shape_atom_index;
+        liz_int_t guard_shape_atom_index;
+    } liz_vm_monitor_filter_t;
     
-    typedef struct liz_vm_monitor_decider_guard_breakpoint {
-        char const *label;
-        uint16_t shape_atom_index;
-        uint16_t end_index;
-        uint16_t function_index;
-        uint8_t flag;
-    } liz_vm_monitor_decider_guard_breakpoint_t;
-    */
     
     
-    /** 
-     * 
-     *
-     * user_data is passed to the breakpoint function when called.
-     *
-     * Create a monitor breakpoint stream per shape or, to monitor an individual
-     * actor specially, per actor.
-     *
-     * When using multiple liz vms (in parallel) then create a monitor per vm.
-     * Use user_data to store a vm identifier.
-     *
-     * TODO: @todo Extract into a breakpoint monitor system.
+    /**
+     * filter is optional, monitors without filter are called during each
+     * traversal step.
      */
-    /* Commented out - too complex and can be implemented on top of the simpler
-     * monitoring scheme.
-    struct liz_vm_monitor {
+    typedef struct liz_vm_monitor {
         uintptr_t user_data;
-        liz_vm_monitor_breakpoint_func_t const *breakpoint_functions;
-        liz_vm_monitor_breakpoint_stream_t const *node_breakpoints;
-        liz_vm_monitor_decider_guard_breakpoint_t *guard_breakpoints;
-        liz_int_t breakpoint_index;
-        liz_lookaside_stack_t guard_breakpoints_stack_header;
-        uint16_t breakpoint_function_count;
-    };
-    */
+        liz_vm_monitor_func_t func;
+        liz_vm_monitor_filter_t const *filter;
+    } liz_vm_monitor_t;
+    
     
     
     /**
@@ -408,6 +424,55 @@ extern "C" {
                   liz_alloc_func_t alloc_func);
     
     
+    /**
+     * Returns the memory size in bytes of the live vm, e.g., to report
+     * memory usage.
+     */
+    size_t
+    liz_vm_memory_size(liz_vm_t const *vm);
+    
+    
+    /**
+     * Returns the bytes of the atoms, persistent state shape atom indices,
+     * subtree calls, and immediate action functions of shape, not counting
+     * padding between them.
+     */
+    size_t
+    liz_vm_shape_memory_size(liz_vm_shape_t const *shape);
+    
+    
+    /**
+     * Returns the bytes of the header and state slots of one actor adhering
+     * to spec, not counting padding between them.
+     */
+    size_t
+    liz_vm_actor_memory_size_requirement(liz_shape_specification_t spec);
+    
+    
+    /**
+     * Returns the memory size in bytes of a vm for spec rounded up to a 
+     * multiple of alignment, e.g., LIZ_CACHE_LINE_SIZE, so vms placed next 
+     * to each other never share an alignment sized block.
+     */
+    size_t
+    liz_vm_memory_size_requirement_aligned(liz_shape_specification_t spec,
+                                           size_t alignment);
+    
+    
+    /**
+     * Like liz_vm_create but aligns the vm to the bigger one of alignment and
+     * LIZ_VM_ALIGNMENT and pads it to liz_vm_memory_size_requirement_aligned.
+     * Pass LIZ_CACHE_LINE_SIZE to prevent false sharing between vms of 
+     * different workers. Destroy it with the dealloc function matching
+     * aligned_alloc_func.
+     */
+    liz_vm_t*
+    liz_vm_create_aligned(liz_shape_specification_t spec,
+                          size_t alignment,
+                          void * LIZ_RESTRICT allocator_context,
+                          liz_aligned_alloc_func_t aligned_alloc_func);
+    
+    
     
     void
     liz_vm_destroy(liz_vm_t *vm,
@@ -494,6 +559,15 @@ extern "C" {
     liz_vm_action_request_count(liz_vm_t const *vm);
     
     
+    /**
+     * Returns the statistics of the last actor update or cancellation.
+     *
+     * Only request counts are collected if LIZ_VM_STATS_ENABLE isn't defined.
+     */
+    liz_vm_update_stats_t
+    liz_vm_update_stats(liz_vm_t const *vm);
+    
+    
     
     /**
      * Copies the action launch and cancel requests of the last update from vm
@@ -527,6 +601,92 @@ extern "C" {
     
 #pragma mark Step actor update by hand
     
+    /**
+     * Resets vm and prepares it to step through the update of actor, e.g., 
+     * with liz_vm_step_update_actor.
+     *
+     * Returns false if shape is empty and there is nothing to step.
+     *
+     * @attention Only call if  liz_vm_fulfills_shape_specification is true.
+     */
+    bool
+    liz_vm_begin_update_actor(liz_vm_t *vm,
+                              liz_vm_actor_t const *actor,
+                              liz_vm_shape_t const *shape);
+    
+    
+    /**
+     * Continues the actor update begun with liz_vm_begin_update_actor for at 
+     * most max_step_count steps and returns the number of steps run.
+     *
+     * The update is done when liz_vm_is_running turns false. Between calls 
+     * vm holds the partial update - neither change actor nor its action 
+     * states, and pass the same time, monitor, and blackboard to finish it 
+     * like liz_vm_update_actor would have.
+     */
+    liz_int_t
+    liz_vm_step_update_actor(liz_vm_t *vm,
+                             liz_vm_monitor_t *monitor,
+                             void * LIZ_RESTRICT actor_blackboard,
+                             liz_time_t const time,
+                             liz_vm_actor_t const *actor,
+                             liz_vm_shape_t const *shape,
+                             liz_int_t const max_step_count);
+    
+    
+    /**
+     * Returns the immediate action function index of the node vm invokes with
+     * its next step, or -1 if the next step does not invoke an immediate 
+     * action.
+     *
+     * Together with liz_vm_step_begin_immediate_action and 
+     * liz_vm_step_end_immediate_action it allows to call the immediate 
+     * actions of many vms parked at the same node in one go, see 
+     * liz_vm_batch_update_actors.
+     */
+    liz_int_t
+    liz_vm_pending_immediate_action_function_index(liz_vm_t const *vm,
+                                                   liz_vm_shape_t const *shape);
+    
+    
+    /**
+     * Enters the pending immediate action node and returns the execution 
+     * request to call its immediate action function with.
+     *
+     * Call the function with vm's actor_random_number_seed and hand its 
+     * result to liz_vm_step_end_immediate_action before stepping vm again.
+     *
+     * @attention Only call if liz_vm_pending_immediate_action_function_index
+     *            does not return -1.
+     */
+    liz_execution_state_t
+    liz_vm_step_begin_immediate_action(liz_vm_t *vm,
+                                       liz_vm_monitor_t *monitor,
+                                       void * LIZ_RESTRICT actor_blackboard,
+                                       liz_time_t const time,
+                                       liz_vm_actor_t const *actor,
+                                       liz_vm_shape_t const *shape);
+    
+    
+    /**
+     * Stores execution_state returned by the immediate action function
+     * and leaves the node entered by liz_vm_step_begin_immediate_action like
+     * liz_vm_step_invoke_node would have.
+     *
+     * Cycle counters do not see immediate actions called this way, callers 
+     * bracket their call with LIZ_VM_COUNT_CYCLES_BEGIN and 
+     * LIZ_VM_COUNT_CYCLES_END (or LIZ_VM_COUNT_CYCLES_END_SHARED).
+     */
+    void
+    liz_vm_step_end_immediate_action(liz_vm_t *vm,
+                                     liz_vm_monitor_t *monitor,
+                                     void * LIZ_RESTRICT actor_blackboard,
+                                     liz_time_t const time,
+                                     liz_vm_actor_t const *actor,
+                                     liz_vm_shape_t const *shape,
+                                     liz_execution_state_t const execution_state);
+    
+    
     /**
      * Just runs cmd and returns the next to run.
      *
@@ -571,6 +731,20 @@ extern "C" {
                               liz_vm_shape_t const *shape);
     
     
+    /**
+     * Second half of liz_vm_step_guard_decider, called after the guard 
+     * function of the top decider guard ran - pops the guard to traverse up
+     * or cancels the cancellation range to traverse down into the next child.
+     */
+    void
+    liz_vm_leave_decider_guard(liz_vm_t *vm,
+                               liz_vm_monitor_t *monitor,
+                               void * LIZ_RESTRICT actor_blackboard,
+                               liz_time_t const time,
+                               liz_vm_actor_t const *actor,
+                               liz_vm_shape_t const *shape);
+    
+    
     
     void
     liz_vm_step_cleanup(liz_vm_t *vm,
@@ -588,18 +762,43 @@ extern "C" {
     
     
     
+    /**
+     * Seeks and consumes the actor's state of the immediate action at vm's
+     * shape atom index and returns the execution request to call the action
+     * with.
+     */
+    liz_execution_state_t
+    liz_vm_request_immediate_action(liz_vm_t *vm,
+                                    liz_vm_actor_t const *actor);
+    
+    
+    /**
+     * Stores the immediate action's execution_state in vm and moves vm
+     * behind the action node.
+     */
+    void
+    liz_vm_store_immediate_action(liz_vm_t *vm,
+                                  liz_execution_state_t const execution_state);
+    
+    
+    /**
+     * The liz_vm_invoke functions enter the node at vm's shape atom index.
+     * node_atom is its first atom as returned by liz_vm_shape_atom, callers
+     * decode it once, e.g., once for all lanes of a wavefront.
+     */
     void
     liz_vm_invoke_immediate_action(liz_vm_t *vm,
                                    void * LIZ_RESTRICT actor_blackboard,
                                    liz_time_t const time,
                                    liz_vm_actor_t const *actor,
-                                   liz_vm_shape_t const *shape);
+                                   liz_vm_shape_t const *shape,
+                                   liz_shape_atom_t const *node_atom);
     
     
     void
     liz_vm_invoke_deferred_action(liz_vm_t *vm,
                                   liz_vm_actor_t const *actor,
-                                  liz_vm_shape_t const *shape);
+                                  liz_shape_atom_t const *node_atom);
     
     void
     liz_vm_invoke_persistent_action(liz_vm_t *vm,
@@ -611,21 +810,21 @@ extern "C" {
     void
     liz_vm_invoke_sequence_decider(liz_vm_t *vm,
                                    liz_vm_actor_t const *actor,
-                                   liz_vm_shape_t const *shape);
+                                   liz_shape_atom_t const *node_atom);
 
     
     
     void
     liz_vm_invoke_dynamic_priority_decider(liz_vm_t *vm,
                                            liz_vm_actor_t const *actor,
-                                           liz_vm_shape_t const *shape);
+                                           liz_shape_atom_t const *node_atom);
     
     
     
     void
     liz_vm_invoke_concurrent_decider(liz_vm_t *vm,
                                      liz_vm_actor_t const *actor,
-                                     liz_vm_shape_t const *shape);
+                                     liz_shape_atom_t const *node_atom);
     
     
     
@@ -653,11 +852,11 @@ extern "C" {
     void
     liz_vm_init(liz_vm_t *vm,
                 liz_shape_specification_t const spec,
-                uint16_t *persistent_state_change_shape_atom_indices,
-                uint16_t *decider_state_shape_atom_indices,
-                uint16_t *action_state_shape_atom_indices,
+                liz_index_t *persistent_state_change_shape_atom_indices,
+                liz_index_t *decider_state_shape_atom_indices,
+                liz_index_t *action_state_shape_atom_indices,
                 liz_persistent_state_t *persistent_state_changes,
-                uint16_t *decider_states,
+                liz_index_t *decider_states,
                 uint8_t *action_states,
                 liz_vm_decider_guard_t *decider_guards,
                 liz_vm_action_request_t *action_requests);
@@ -689,6 +888,11 @@ extern "C" {
      * If jumping back in the stream shows up as a hotspot then rethink 
      * cancellation handling or store the action shape atoms together with their
      * action state in the vm.
+     *
+     * With a cancellation batch assigned the actions from the actor's action
+     * state buffer are batched and cancelled by 
+     * liz_vm_resolve_cancellation_batch during cleanup, or before cancelling 
+     * running vm actions to keep the cancellation order.
      */
     void
     liz_vm_cancel_actions_in_cancellation_range(liz_vm_t *vm,
@@ -700,12 +904,84 @@ extern "C" {
     
     
     
+#if defined(LIZ_VM_COUNTERS_ENABLE)
+#   define LIZ_VM_COUNT_NODE(vm, shape_item_index, traversal_mask) \
+    liz_vm_count_node((vm)->counters, shape_item_index, traversal_mask)
+#else
+#   define LIZ_VM_COUNT_NODE(vm, shape_item_index, traversal_mask) \
+    do { \
+        (void)(vm); \
+    } while (0)
+#endif
+    
+    
+#if defined(LIZ_VM_COUNTERS_ENABLE) && defined(LIZ_VM_COUNTERS_CYCLES_ENABLE)
+#   define LIZ_VM_COUNT_CYCLES_BEGIN(begin_cycles) \
+    uint64_t const begin_cycles = liz_cycle_count()
+#   define LIZ_VM_COUNT_CYCLES_END(begin_cycles, vm, shape_item_index) \
+    liz_vm_count_immediate_action_cycles((vm)->counters, shape_item_index, liz_cycle_count() - (begin_cycles))
+#   define LIZ_VM_COUNT_CYCLES_END_SHARED(begin_cycles, vm, shape_item_index, share_count) \
+    liz_vm_count_immediate_action_cycles((vm)->counters, shape_item_index, (liz_cycle_count() - (begin_cycles)) / (uint64_t)(share_count))
+#else
+#   define LIZ_VM_COUNT_CYCLES_BEGIN(begin_cycles) \
+    do { \
+    } while (0)
+#   define LIZ_VM_COUNT_CYCLES_END(begin_cycles, vm, shape_item_index) \
+    do { \
+    } while (0)
+#   define LIZ_VM_COUNT_CYCLES_END_SHARED(begin_cycles, vm, shape_item_index, share_count) \
+    do { \
+    } while (0)
+#endif
+    
+    
+#if defined(LIZ_VM_STATS_ENABLE)
+#   define LIZ_VM_STATS_COUNT_NODE(vm, traversal_mask) \
+    liz_vm_stats_count_node(&(vm)->update_stats, traversal_mask)
+#   define LIZ_VM_STATS_COUNT_IMMEDIATE_ACTION(vm) \
+    (vm)->update_stats.immediate_action_count += 1u
+#   define LIZ_VM_STATS_CYCLES_BEGIN(begin_cycles) \
+    uint64_t const begin_cycles = liz_cycle_count()
+#   define LIZ_VM_STATS_CYCLES_END(begin_cycles, vm) \
+    (vm)->update_stats.cycles += liz_cycle_count() - (begin_cycles)
+#   define LIZ_VM_STATS_CYCLES_END_SHARED(begin_cycles, vm, share_count) \
+    (vm)->update_stats.cycles += (liz_cycle_count() - (begin_cycles)) / (uint64_t)(share_count)
+#else
+#   define LIZ_VM_STATS_COUNT_NODE(vm, traversal_mask) \
+    do { \
+        (void)(vm); \
+    } while (0)
+#   define LIZ_VM_STATS_COUNT_IMMEDIATE_ACTION(vm) \
+    do { \
+        (void)(vm); \
+    } while (0)
+#   define LIZ_VM_STATS_CYCLES_BEGIN(begin_cycles) \
+    do { \
+    } while (0)
+#   define LIZ_VM_STATS_CYCLES_END(begin_cycles, vm) \
+    do { \
+        (void)(vm); \
+    } while (0)
+#   define LIZ_VM_STATS_CYCLES_END_SHARED(begin_cycles, vm, share_count) \
+    do { \
+        (void)(vm); \
+        (void)(share_count); \
+    } while (0)
+#endif
+    
+    
 #if defined(LIZ_VM_MONITOR_ENABLE)
 #   define LIZ_VM_MONITOR_NODE(monitor, shape_item_index, traversal_mask, vm, actor_blackboard, time, actor, shape) \
-    liz_vm_monitor_node(monitor, shape_item_index, traversal_mask, vm, actor_blackboard, time, actor, shape);
+    do { \
+        LIZ_VM_COUNT_NODE(vm, shape_item_index, traversal_mask); \
+        LIZ_VM_STATS_COUNT_NODE(vm, traversal_mask); \
+        liz_vm_monitor_node(monitor, shape_item_index, traversal_mask, vm, actor_blackboard, time, actor, shape); \
+    } while (0)
 #else
 #   define LIZ_VM_MONITOR_NODE(monitor, shape_item_index, traversal_mask, vm, actor_blackboard, time, actor, shape) \
     do { \
+        LIZ_VM_COUNT_NODE(vm, shape_item_index, traversal_mask); \
+        LIZ_VM_STATS_COUNT_NODE(vm, traversal_mask); \
         (void)monitor; \
         (void)shape_item_index; \
         (void)traversal_mask; \
@@ -719,6 +995,31 @@ extern "C" {
     
     
     
+    LIZ_INLINE static
+    bool
+    liz_vm_monitor_filter_matches(liz_vm_monitor_filter_t const *filter,
+                                  liz_uint_t const node_shape_atom_index,
+                                  liz_uint_t const traversal_mask)
+    {
+        liz_int_t const node_index = (liz_int_t)node_shape_atom_index;
+        
+        switch (traversal_mask) {
+            case liz_vm_monitor_node_flag_enter_from_top:
+                return node_index >= filter->next_shape_atom_index;
+            case liz_vm_monitor_node_flag_enter_from_bottom:
+            case liz_vm_monitor_node_flag_leave_to_bottom:
+                return node_index == filter->guard_shape_atom_index;
+            case liz_vm_monitor_node_flag_leave_to_top:
+                return (node_index == filter->action_shape_atom_index)
+                    || (node_index == filter->guard_shape_atom_index)
+                    || (0 == node_index);
+            default:
+                return true;
+        }
+    }
+    
+    
+    
     LIZ_INLINE static
     void
     liz_vm_monitor_node(liz_vm_monitor_t *monitor,
@@ -730,7 +1031,10 @@ extern "C" {
                         liz_vm_actor_t const *actor,
                         liz_vm_shape_t const *shape)
     {
-        if (NULL != monitor) {
+        if (NULL != monitor
+            && (NULL == monitor->filter
+                || liz_vm_monitor_filter_matches(monitor->filter, node_shape_atom_index, traversal_mask))) {
+            
             monitor->func(monitor->user_data,
                           node_shape_atom_index,
                           traversal_mask,
@@ -744,6 +1048,87 @@ extern "C" {
     
     
     
+    /**
+     * Counts a traversal step into or out of a node, see 
+     * liz_vm_node_counter_t. Branch free beyond the NULL check.
+     */
+    LIZ_INLINE static
+    void
+    liz_vm_count_node(liz_vm_counters_t *counters,
+                      liz_uint_t const node_shape_atom_index,
+                      liz_uint_t const traversal_mask)
+    {
+        if (NULL == counters) {
+            return;
+        }
+        
+        LIZ_ASSERT((liz_int_t)node_shape_atom_index < counters->count);
+        
+        liz_vm_node_counter_t *node = &counters->nodes[node_shape_atom_index];
+        node->enter_count += (uint32_t)(liz_vm_monitor_node_flag_enter_from_top == traversal_mask);
+        node->leave_count += (uint32_t)(liz_vm_monitor_node_flag_leave_to_top == traversal_mask);
+        node->guard_count += (uint32_t)(liz_vm_monitor_node_flag_enter_from_bottom == traversal_mask);
+        node->cancel_count += (uint32_t)((liz_vm_monitor_node_flag_cancel_action | liz_vm_monitor_node_flag_enter_from_top) == traversal_mask);
+        node->error_count += (uint32_t)(0u != (liz_vm_monitor_node_flag_error & traversal_mask));
+    }
+    
+    
+    
+    LIZ_INLINE static
+    void
+    liz_vm_stats_count_node(liz_vm_update_stats_t *update_stats,
+                            liz_uint_t const traversal_mask)
+    {
+        update_stats->visited_node_count += (uint32_t)(liz_vm_monitor_node_flag_enter_from_top == traversal_mask);
+        update_stats->cancelled_action_count += (uint32_t)((liz_vm_monitor_node_flag_cancel_action | liz_vm_monitor_node_flag_enter_from_top) == traversal_mask);
+    }
+    
+    
+    
+    LIZ_INLINE static
+    void
+    liz_vm_count_immediate_action_cycles(liz_vm_counters_t *counters,
+                                         liz_uint_t const node_shape_atom_index,
+                                         uint64_t const cycles)
+    {
+        if (NULL == counters) {
+            return;
+        }
+        
+        LIZ_ASSERT((liz_int_t)node_shape_atom_index < counters->count);
+        
+        counters->nodes[node_shape_atom_index].immediate_action_cycles += cycles;
+    }
+    
+    
+    
+    /**
+     * Returns the first atom of the node addressed by the shape atom index,
+     * and resolves subtree calls.
+     *
+     * subtree_call_index is a cursor into the shape's subtree calls.
+     */
+    LIZ_INLINE static
+    liz_shape_atom_t const*
+    liz_vm_shape_atom(liz_vm_shape_t const *shape,
+                      liz_int_t *subtree_call_index,
+                      liz_int_t const shape_atom_index)
+    {
+        if (0 == shape->spec.subtree_call_count) {
+            return &shape->atoms[shape_atom_index];
+        }
+        
+        liz_int_t const stream_index = liz_shape_subtree_call_stream_index(subtree_call_index,
+                                                                           (liz_index_t)shape_atom_index,
+                                                                           shape->subtree_calls,
+                                                                           shape->spec.subtree_call_count);
+        LIZ_ASSERT(shape->spec.shape_atom_count > stream_index);
+        
+        return &shape->atoms[stream_index];
+    }
+    
+    
+    
     LIZ_INLINE static
     liz_vm_decider_guard_t*
     liz_vm_current_top_decider_guard(liz_vm_t *vm)
@@ -864,8 +1249,8 @@ extern "C" {
      */
     void
     liz_vm_cancellation_range_adapt(liz_vm_cancellation_range_t *cancellation_range,
-                                    uint16_t const new_begin_index,
-                                    uint16_t const new_end_index);
+                                    liz_index_t const new_begin_index,
+                                    liz_index_t const new_end_index);
     
     
     /**
@@ -879,7 +1264,7 @@ extern "C" {
                                                liz_vm_action_request_t *deferred_action_requests,
                                                liz_lookaside_double_stack_t *deferrec_action_request_stack_header,
                                                liz_time_t const time,
-                                               liz_shape_atom_t const *shape_atoms,
+                                               liz_shape_atom_t const *first_shape_atom_of_node_in_stream,
                                                liz_int_t const shape_atom_index,
                                                liz_immediate_action_func_t const *immediate_action_functions,
                                                liz_int_t const immediate_action_function_count);
@@ -901,12 +1286,15 @@ extern "C" {
     
     /**
      * Call to emit an action launch or cancel request for a deferred action.
+     *
+     * shape_atom_index is stored in the request to address the node when 
+     * replying with execution state changes.
      */
     liz_execution_state_t
     liz_vm_launch_or_cancel_deferred_action(liz_vm_action_request_t *action_requests,
                                             liz_lookaside_double_stack_t *action_request_stack_header,
                                             liz_execution_state_t const execution_request,
-                                            liz_shape_atom_t const *shape_atoms,
+                                            liz_shape_atom_t const *first_shape_atom_of_node_in_stream,
                                             liz_int_t const shape_atom_index);
     
     
@@ -952,6 +1340,34 @@ extern "C" {
     
     
     
+    /**
+     * Cancels the actions of the vm's cancellation batch from the actor's 
+     * action state buffer in one sweep and empties the batch.
+     */
+    void
+    liz_vm_resolve_cancellation_batch(liz_vm_t *vm,
+                                      liz_vm_monitor_t *monitor,
+                                      void * LIZ_RESTRICT actor_blackboard,
+                                      liz_time_t const time,
+                                      liz_vm_actor_t const *actor,
+                                      liz_vm_shape_t const *shape);
+    
+    
+    /**
+     * Resolves a non-empty cancellation batch of vm so immediate action
+     * cancel calls happen before the next immediate action invocation as
+     * without batch.
+     */
+    void
+    liz_vm_resolve_cancellation_batch_before_immediate_action(liz_vm_t *vm,
+                                                              liz_vm_monitor_t *monitor,
+                                                              void * LIZ_RESTRICT actor_blackboard,
+                                                              liz_time_t const time,
+                                                              liz_vm_actor_t const *actor,
+                                                              liz_vm_shape_t const *shape);
+    
+    
+    
     /**
      * Cancel immediate and deferred action with a running (or launching) state
      * from the previous update that have not been invoked during the current
@@ -978,8 +1394,8 @@ extern "C" {
     LIZ_INLINE static
     void
     liz_vm_consume_state(liz_int_t *cursor,
-                         uint16_t const shape_atom_index,
-                         uint16_t const *shape_atom_indices,
+                         liz_index_t const shape_atom_index,
+                         liz_index_t const *shape_atom_indices,
                          liz_int_t const shape_atom_index_count)
     {
         LIZ_ASSERT(*cursor < shape_atom_index_count);
@@ -1000,7 +1416,7 @@ extern "C" {
      */
     void
     liz_vm_sort_values_for_keys_from_post_order_traversal(void * LIZ_RESTRICT values,
-                                                          uint16_t * LIZ_RESTRICT keys,
+                                                          liz_index_t * LIZ_RESTRICT keys,
                                                           size_t const value_size_in_bytes,
                                                           size_t const value_alignment_in_bytes,
                                                           liz_int_t const key_value_count,
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *
+ * Implementation of batched actor updates.
+ */
+
+#include "liz_vm_batch.h"
+
+#include "liz_assert.h"
+
+
+
+static
+bool
+liz_vm_batch_is_parked(liz_vm_t const *vm,
+                       liz_vm_shape_t const *shape,
+                       liz_immediate_action_batch_func_t const *batch_functions)
+{
+    if (NULL == batch_functions) {
+        return false;
+    }
+    
+    liz_int_t const function_index = liz_vm_pending_immediate_action_function_index(vm, shape);
+    
+    return (0 <= function_index) && (NULL != batch_functions[function_index]);
+}
+
+
+
+void
+liz_vm_batch_call_immediate_action(liz_vm_t * const *vms,
+                                   liz_vm_monitor_t *monitor,
+                                   void * const *actor_blackboards,
+                                   liz_time_t const time,
+                                   liz_vm_actor_t const *actors,
+                                   liz_int_t const lane_count,
+                                   liz_vm_shape_t const *shape,
+                                   liz_immediate_action_batch_func_t batch_function,
+                                   uint64_t const lane_mask)
+{
+    LIZ_ASSERT(LIZ_VM_BATCH_LANE_CAPACITY >= lane_count);
+    
+    liz_random_number_seed_t random_number_seeds[LIZ_VM_BATCH_LANE_CAPACITY];
+    liz_execution_state_t execution_states[LIZ_VM_BATCH_LANE_CAPACITY];
+    liz_int_t masked_lane_count = 0;
+    
+    LIZ_VM_STATS_CYCLES_BEGIN(batch_begin_cycles);
+    for (liz_int_t lane = 0; lane < lane_count; ++lane) {
+        
+        random_number_seeds[lane] = 0u;
+        execution_states[lane] = liz_execution_state_launch;
+        
+        if (0u == (lane_mask & (UINT64_C(1) << lane))) {
+            continue;
+        }
+        
+        execution_states[lane] = liz_vm_step_begin_immediate_action(vms[lane],
+                                                                    monitor,
+                                                                    actor_blackboards[lane],
+                                                                    time,
+                                                                    &actors[lane],
+                                                                    shape);
+        random_number_seeds[lane] = vms[lane]->actor_random_number_seed;
+        ++masked_lane_count;
+    }
+    
+    LIZ_VM_COUNT_CYCLES_BEGIN(tick_begin_cycles);
+    batch_function(actor_blackboards,
+                   random_number_seeds,
+                   time,
+                   execution_states,
+                   lane_mask,
+                   lane_count);
+    
+    // Count the shared call's cycles evenly split per lane like single 
+    // updates count them per call.
+    for (liz_int_t lane = 0; lane < lane_count; ++lane) {
+        
+        if (0u != (lane_mask & (UINT64_C(1) << lane))) {
+            LIZ_VM_COUNT_CYCLES_END_SHARED(tick_begin_cycles, vms[lane], vms[lane]->shape_atom_index, masked_lane_count);
+        }
+    }
+    
+    for (liz_int_t lane = 0; lane < lane_count; ++lane) {
+        
+        if (0u == (lane_mask & (UINT64_C(1) << lane))) {
+            continue;
+        }
+        
+        vms[lane]->actor_random_number_seed = random_number_seeds[lane];
+        liz_vm_step_end_immediate_action(vms[lane],
+                                         monitor,
+                                         actor_blackboards[lane],
+                                         time,
+                                         &actors[lane],
+                                         shape,
+                                         execution_states[lane]);
+    }
+    
+    // Split the shared call's cycles evenly between the lanes.
+    for (liz_int_t lane = 0; lane < lane_count; ++lane) {
+        
+        if (0u != (lane_mask & (UINT64_C(1) << lane))) {
+            LIZ_VM_STATS_CYCLES_END_SHARED(batch_begin_cycles, vms[lane], masked_lane_count);
+        }
+    }
+}
+
+
+
+liz_int_t
+liz_vm_batch_update_actors(liz_vm_t * const *vms,
+                           liz_vm_monitor_t *monitor,
+                           void * LIZ_RESTRICT user_data_lookup_context,
+                           liz_vm_user_data_lookup_func_t user_data_lookup_func,
+                           liz_time_t const time,
+                           liz_vm_actor_t const *actors,
+                           liz_int_t const lane_count,
+                           liz_vm_shape_t const *shape,
+                           liz_immediate_action_batch_func_t const *batch_functions)
+{
+    LIZ_ASSERT(0 <= lane_count);
+    LIZ_ASSERT(LIZ_VM_BATCH_LANE_CAPACITY >= lane_count);
+    
+    void *actor_blackboards[LIZ_VM_BATCH_LANE_CAPACITY];
+    
+    uint64_t active_mask = 0u;
+    
+    for (liz_int_t lane = 0; lane < lane_count; ++lane) {
+        
+        LIZ_ASSERT(liz_vm_fulfills_shape_specification(vms[lane], shape->spec));
+        
+        actor_blackboards[lane] = NULL;
+        
+        if (liz_vm_begin_update_actor(vms[lane], &actors[lane], shape)) {
+            actor_blackboards[lane] = user_data_lookup_func(user_data_lookup_context,
+                                                            actors[lane].header->user_data);
+            active_mask |= UINT64_C(1) << lane;
+        }
+    }
+    
+    liz_int_t batch_call_count = 0;
+    
+    while (0u != active_mask) {
+        
+        // Step each vm until it is done or parked in front of a batchable
+        // immediate action and find the lowest parking node.
+        uint64_t parked_mask = 0u;
+        liz_int_t parked_shape_atom_index = 0;
+        liz_int_t parked_lane = 0;
+        
+        for (liz_int_t lane = 0; lane < lane_count; ++lane) {
+            
+            uint64_t const lane_bit = UINT64_C(1) << lane;
+            
+            if (0u == (active_mask & lane_bit)) {
+                continue;
+            }
+            
+            liz_vm_t *vm = vms[lane];
+            
+            LIZ_VM_STATS_CYCLES_BEGIN(step_begin_cycles);
+            while (liz_vm_is_running(vm)
+                   && !liz_vm_batch_is_parked(vm, shape, batch_functions)) {
+                
+                liz_vm_step(vm,
+                            monitor,
+                            actor_blackboards[lane],
+                            time,
+                            &actors[lane],
+                            shape);
+            }
+            LIZ_VM_STATS_CYCLES_END(step_begin_cycles, vm);
+            
+            if (!liz_vm_is_running(vm)) {
+                active_mask &= ~lane_bit;
+            } else if (0u == parked_mask 
+                       || vm->shape_atom_index < parked_shape_atom_index) {
+                
+                parked_mask = lane_bit;
+                parked_shape_atom_index = vm->shape_atom_index;
+                parked_lane = lane;
+            } else if (vm->shape_atom_index == parked_shape_atom_index) {
+                parked_mask |= lane_bit;
+            }
+        }
+        
+        if (0u == parked_mask) {
+            break;
+        }
+        
+        // Call the immediate action of all vms parked at the lowest node at
+        // once. Vms parked further down stay parked until the next round.
+        liz_int_t const function_index = liz_vm_pending_immediate_action_function_index(vms[parked_lane], shape);
+        
+        liz_vm_batch_call_immediate_action(vms,
+                                           monitor,
+                                           actor_blackboards,
+                                           time,
+                                           actors,
+                                           lane_count,
+                                           shape,
+                                           batch_functions[function_index],
+                                           parked_mask);
+        ++batch_call_count;
+    }
+    
+    return batch_call_count;
+}
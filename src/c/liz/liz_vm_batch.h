@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *
+ * Batched actor updates - updates a batch of actors of the same shape, each 
+ * in its own vm, and calls an immediate action reached by many of them with
+ * a single liz_immediate_action_batch_func_t call.
+ *
+ * Each vm is stepped until it is done or parked in front of an immediate 
+ * action with a batch function. Then all vms parked at the lowest shape atom 
+ * index, alas at the same node, get their immediate action called in one go 
+ * and are stepped on. Parking at the lowest index first lets vms lagging 
+ * behind catch up with vms waiting further down the shape stream, so actors
+ * taking the same path share every batch call and diverged actors rejoin at
+ * the next node they share.
+ *
+ * Results are identical to updating each actor with liz_vm_update_actor as
+ * long as the batch functions behave like their unbatched counterparts. 
+ * Monitor calls for different vms interleave though.
+ *
+ * See liz_vm_wavefront.h for lockstep updates that decode each node once 
+ * for all actors.
+ */
+
+#ifndef LIZ_liz_vm_batch_H
+#define LIZ_liz_vm_batch_H
+
+
+#include <liz/liz_platform_types.h>
+#include <liz/liz_platform_macros.h>
+#include <liz/liz_common.h>
+#include <liz/liz_vm.h>
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+    
+    
+    /**
+     * Maximum number of actors, alas lanes, of a batch - one bit per lane of
+     * the liz_immediate_action_batch_func_t lane mask.
+     */
+#define LIZ_VM_BATCH_LANE_CAPACITY 64
+    
+    
+    
+    /**
+     * Calls batch_function for the pending immediate action of the vms whose
+     * lane bit is set in lane_mask and steps them out of the action node.
+     *
+     * @attention All vms in lane_mask must be in front of the same immediate
+     *            action, see liz_vm_pending_immediate_action_function_index.
+     */
+    void
+    liz_vm_batch_call_immediate_action(liz_vm_t * const *vms,
+                                       liz_vm_monitor_t *monitor,
+                                       void * const *actor_blackboards,
+                                       liz_time_t time,
+                                       liz_vm_actor_t const *actors,
+                                       liz_int_t lane_count,
+                                       liz_vm_shape_t const *shape,
+                                       liz_immediate_action_batch_func_t batch_function,
+                                       uint64_t lane_mask);
+    
+    
+    /**
+     * Updates the lane_count actors in actors, each in the vm with the same
+     * index in vms, and leaves their states and action requests in their vms
+     * to extract like after liz_vm_update_actor.
+     *
+     * batch_functions holds a batch function or NULL per immediate action 
+     * function of shape. Immediate actions without batch function, and all
+     * immediate actions if batch_functions is NULL, are called via the 
+     * shape's immediate action functions.
+     *
+     * Returns the number of batch function calls.
+     *
+     * @attention lane_count must not be greater than 
+     *            LIZ_VM_BATCH_LANE_CAPACITY and all vms must fulfill the
+     *            shape specification.
+     */
+    liz_int_t
+    liz_vm_batch_update_actors(liz_vm_t * const *vms,
+                               liz_vm_monitor_t *monitor,
+                               void * LIZ_RESTRICT user_data_lookup_context,
+                               liz_vm_user_data_lookup_func_t user_data_lookup_func,
+                               liz_time_t time,
+                               liz_vm_actor_t const *actors,
+                               liz_int_t lane_count,
+                               liz_vm_shape_t const *shape,
+                               liz_immediate_action_batch_func_t const *batch_functions);
+    
+    
+    
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+
+#endif /* LIZ_liz_vm_batch_H */
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "liz_vm_cancellation_batch.h"
+
+#include "liz_assert.h"
+#include "liz_common_internal.h"
+#include "liz_platform_functions.h"
+
+
+
+#pragma mark Create and destroy batches
+
+liz_int_t
+liz_vm_cancellation_batch_capacity_requirement(liz_shape_specification_t const spec)
+{
+    return (liz_int_t)spec.action_state_capacity + 1;
+}
+
+
+
+liz_vm_cancellation_batch_t*
+liz_vm_cancellation_batch_create(liz_int_t const capacity,
+                                 void * LIZ_RESTRICT allocator_context,
+                                 liz_alloc_func_t alloc_func)
+{
+    if (1 > capacity) {
+        return NULL;
+    }
+    
+    size_t const header_size = liz_allocation_size_aggregate(sizeof(liz_int_t),
+                                                             sizeof(liz_vm_cancellation_batch_t),
+                                                             sizeof(liz_int_t),
+                                                             0);
+    size_t const batch_size = header_size + sizeof(liz_vm_cancellation_interval_t) * (size_t)capacity;
+    liz_vm_cancellation_batch_t *batch = (liz_vm_cancellation_batch_t *)alloc_func(allocator_context, batch_size);
+    
+    if (NULL == batch) {
+        return NULL;
+    }
+    
+    batch->intervals = (liz_vm_cancellation_interval_t *)((char *)batch + header_size);
+    batch->capacity = capacity;
+    batch->count = 0;
+    
+    return batch;
+}
+
+
+
+void
+liz_vm_cancellation_batch_destroy(liz_vm_cancellation_batch_t *batch,
+                                  void * LIZ_RESTRICT allocator_context,
+                                  liz_dealloc_func_t dealloc_func)
+{
+    dealloc_func(allocator_context, batch);
+}
+
+
+
+#pragma mark Batching
+
+void
+liz_vm_cancellation_batch_clear(liz_vm_cancellation_batch_t *batch)
+{
+    batch->count = 0;
+}
+
+
+
+bool
+liz_vm_cancellation_batch_push(liz_vm_cancellation_batch_t *batch,
+                               liz_index_t const begin_index,
+                               liz_index_t const end_index,
+                               liz_int_t const actor_action_state_index)
+{
+    LIZ_ASSERT(begin_index < end_index);
+    
+    if (0 < batch->count) {
+        liz_vm_cancellation_interval_t *last = &batch->intervals[batch->count - 1];
+        
+        // The vm moves its cursor behind each cancelled range, therefore 
+        // ranges starting before the last interval's end only cancel behind
+        // it.
+        if (last->actor_action_state_index == actor_action_state_index
+            && begin_index <= last->end_index) {
+            
+            last->end_index = (liz_index_t)liz_max(last->end_index, end_index);
+            return true;
+        }
+    }
+    
+    if (batch->count == batch->capacity) {
+        return false;
+    }
+    
+    batch->intervals[batch->count++] = (liz_vm_cancellation_interval_t){
+        actor_action_state_index,
+        begin_index,
+        end_index
+    };
+    
+    return true;
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *
+ * Cancellation ranges batched during a vm update to resolve them in one 
+ * sweep over the actor's previous update action states during the vm's
+ * cleanup step instead of once per cancellation range.
+ *
+ * Cancel requests and immediate action cancel calls are emitted in the same
+ * order as by a vm without batch. The batch is resolved before each 
+ * immediate action invocation, before cancelling running actions of the 
+ * current update, when it is full, and during cleanup, so ranges batch up
+ * across the deferred and persistent actions visited in between.
+ *
+ * Typical usage:
+ * 1. Create a batch per vm with a capacity of at least 
+ *    liz_vm_cancellation_batch_capacity_requirement of the vm's shape 
+ *    specification - smaller capacities work but resolve whenever the batch
+ *    is full.
+ * 2. Assign the batch to the vm, vms cancel immediately when their 
+ *    cancellation batch is NULL.
+ */
+
+#ifndef LIZ_liz_vm_cancellation_batch_H
+#define LIZ_liz_vm_cancellation_batch_H
+
+
+#include <liz/liz_platform_types.h>
+#include <liz/liz_platform_macros.h>
+#include <liz/liz_allocator.h>
+#include <liz/liz_common.h>
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+    
+    
+    /**
+     * Shape atom index range [begin_index, end_index) of actions to cancel 
+     * and actor_action_state_index, the vm's cursor into the actor's action
+     * states when the range was batched.
+     */
+    typedef struct liz_vm_cancellation_interval {
+        liz_int_t actor_action_state_index;
+        liz_index_t begin_index;
+        liz_index_t end_index;
+    } liz_vm_cancellation_interval_t;
+    
+    
+    
+    /**
+     * Intervals in batching order.
+     *
+     * Treat as opaque, only access via the liz_vm_cancellation_batch 
+     * functions.
+     */
+    typedef struct liz_vm_cancellation_batch {
+        liz_vm_cancellation_interval_t *intervals;
+        liz_int_t capacity;
+        liz_int_t count;
+    } liz_vm_cancellation_batch_t;
+    
+    
+    
+    /**
+     * Returns the capacity for which a batch never needs to be resolved 
+     * before the cleanup step of vm updates of shapes with spec.
+     *
+     * Intervals batched without visiting actor action states in between are 
+     * coalesced if they overlap, otherwise each visited actor action state 
+     * allows one more interval.
+     */
+    liz_int_t
+    liz_vm_cancellation_batch_capacity_requirement(liz_shape_specification_t spec);
+    
+    
+    /**
+     * Returns NULL if capacity is less than 1 or memory can't be allocated,
+     * otherwise returns an empty batch.
+     */
+    liz_vm_cancellation_batch_t*
+    liz_vm_cancellation_batch_create(liz_int_t capacity,
+                                     void * LIZ_RESTRICT allocator_context,
+                                     liz_alloc_func_t alloc_func);
+    
+    
+    void
+    liz_vm_cancellation_batch_destroy(liz_vm_cancellation_batch_t *batch,
+                                      void * LIZ_RESTRICT allocator_context,
+                                      liz_dealloc_func_t dealloc_func);
+    
+    
+    void
+    liz_vm_cancellation_batch_clear(liz_vm_cancellation_batch_t *batch);
+    
+    
+    LIZ_INLINE static
+    bool
+    liz_vm_cancellation_batch_is_empty(liz_vm_cancellation_batch_t const *batch)
+    {
+        return 0 == batch->count;
+    }
+    
+    
+    /**
+     * Adds the non-empty range [begin_index, end_index), batched when the 
+     * vm's cursor into the actor's action states is at 
+     * actor_action_state_index.
+     *
+     * Coalesces the range with the last interval if the cursor did not move
+     * since and the range begins before or at the interval's end.
+     *
+     * Returns false and leaves the batch unchanged if the range can't be 
+     * coalesced and the batch is full.
+     */
+    bool
+    liz_vm_cancellation_batch_push(liz_vm_cancellation_batch_t *batch,
+                                   liz_index_t begin_index,
+                                   liz_index_t end_index,
+                                   liz_int_t actor_action_state_index);
+    
+    
+    
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+
+#endif /* LIZ_liz_vm_cancellation_batch_H */
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "liz_vm_counters.h"
+
+#include "liz_assert.h"
+#include "liz_platform_functions.h"
+
+
+
+#pragma mark Create and destroy counters
+
+liz_vm_counters_t*
+liz_vm_counters_create(liz_int_t const count,
+                       void * LIZ_RESTRICT allocator_context,
+                       liz_alloc_func_t alloc_func)
+{
+    if (0 > count) {
+        return NULL;
+    }
+    
+    size_t const header_size = liz_allocation_size_aggregate(sizeof(uint64_t),
+                                                             sizeof(liz_vm_counters_t),
+                                                             sizeof(uint64_t),
+                                                             0);
+    size_t const counters_size = header_size + sizeof(liz_vm_node_counter_t) * (size_t)count;
+    liz_vm_counters_t *counters = (liz_vm_counters_t *)alloc_func(allocator_context, counters_size);
+    
+    if (NULL == counters) {
+        return NULL;
+    }
+    
+    counters->nodes = (liz_vm_node_counter_t *)((char *)counters + header_size);
+    counters->count = count;
+    
+    liz_vm_counters_clear(counters);
+    
+    return counters;
+}
+
+
+
+void
+liz_vm_counters_destroy(liz_vm_counters_t *counters,
+                        void * LIZ_RESTRICT allocator_context,
+                        liz_dealloc_func_t dealloc_func)
+{
+    dealloc_func(allocator_context, counters);
+}
+
+
+
+#pragma mark Counting
+
+void
+liz_vm_counters_clear(liz_vm_counters_t *counters)
+{
+    liz_memset(counters->nodes, 0, sizeof(liz_vm_node_counter_t) * (size_t)counters->count);
+}
+
+
+
+void
+liz_vm_counters_merge(liz_vm_counters_t *target,
+                      liz_vm_counters_t const *source)
+{
+    LIZ_ASSERT(target->count == source->count);
+    
+    for (liz_int_t i = 0; i < target->count; ++i) {
+        liz_vm_node_counter_t *lhs = &target->nodes[i];
+        liz_vm_node_counter_t const *rhs = &source->nodes[i];
+        
+        lhs->enter_count += rhs->enter_count;
+        lhs->leave_count += rhs->leave_count;
+        lhs->guard_count += rhs->guard_count;
+        lhs->cancel_count += rhs->cancel_count;
+        lhs->error_count += rhs->error_count;
+        lhs->immediate_action_cycles += rhs->immediate_action_cycles;
+    }
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *
+ * Per node visit, cancellation, and immediate action timing counters filled
+ * by vms without calling a function per traversal step.
+ *
+ * Define LIZ_VM_COUNTERS_ENABLE to compile vms counting at the vm monitor 
+ * points, additionally define LIZ_VM_COUNTERS_CYCLES_ENABLE to sample 
+ * liz_cycle_count around immediate action ticks.
+ *
+ * Typical usage:
+ * 1. Create counters per thread (or per vm) with a count of at least 
+ *    liz_shape_specification_shape_atom_index_count of the counted shape.
+ * 2. Assign the counters to the vm(s) used by the thread, vms ignore counting
+ *    when their counters are NULL.
+ * 3. At frame end merge the per thread counters into frame or session
+ *    counters and clear the per thread counters.
+ *
+ * Counters are indexed by shape atom index, counting multiple shapes needs a 
+ * counters object per shape. Vms count via liz_vm_count_node declared in
+ * liz_vm.h.
+ */
+
+#ifndef LIZ_liz_vm_counters_H
+#define LIZ_liz_vm_counters_H
+
+
+#include <liz/liz_platform_types.h>
+#include <liz/liz_platform_macros.h>
+#include <liz/liz_allocator.h>
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+    
+    
+    /**
+     * enter_count counts invocations of the node, alas entering it from the
+     * top, while leave_count counts leaving it to the top. guard_count counts
+     * how often a decider guards its children, alas is entered from the 
+     * bottom. cancel_count counts cancellations of running actions from 
+     * the previous update or after an immediate cancellation.
+     */
+    typedef struct liz_vm_node_counter {
+        uint32_t enter_count;
+        uint32_t leave_count;
+        uint32_t guard_count;
+        uint32_t cancel_count;
+        uint32_t error_count;
+        uint32_t padding;
+        uint64_t immediate_action_cycles;
+    } liz_vm_node_counter_t;
+    
+    
+    
+    typedef struct liz_vm_counters {
+        liz_vm_node_counter_t *nodes;
+        liz_int_t count;
+    } liz_vm_counters_t;
+    
+    
+    
+    /**
+     * Returns NULL if count is negative or memory can't be allocated, 
+     * otherwise returns zeroed counters for count shape atom indices.
+     */
+    liz_vm_counters_t*
+    liz_vm_counters_create(liz_int_t count,
+                           void * LIZ_RESTRICT allocator_context,
+                           liz_alloc_func_t alloc_func);
+    
+    
+    void
+    liz_vm_counters_destroy(liz_vm_counters_t *counters,
+                            void * LIZ_RESTRICT allocator_context,
+                            liz_dealloc_func_t dealloc_func);
+    
+    
+    void
+    liz_vm_counters_clear(liz_vm_counters_t *counters);
+    
+    
+    /**
+     * Adds the counts of source to target. Both must have the same count.
+     */
+    void
+    liz_vm_counters_merge(liz_vm_counters_t *target,
+                          liz_vm_counters_t const *source);
+    
+    
+    
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+
+#endif /* LIZ_liz_vm_counters_H */
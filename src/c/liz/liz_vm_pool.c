@@ -0,0 +1,389 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "liz_vm_pool.h"
+
+#include "liz_platform_functions.h"
+#include "liz_assert.h"
+#include "liz_common_internal.h"
+
+
+
+static
+liz_int_t
+liz_vm_pool_size_class_capacity(liz_int_t const size_class)
+{
+    LIZ_ASSERT(0 <= size_class && size_class < LIZ_VM_POOL_SIZE_CLASS_COUNT);
+    
+    // Shifting into the last class could overflow 32 bit liz_int_t.
+    if (LIZ_VM_POOL_SIZE_CLASS_COUNT - 1 == size_class) {
+        return (liz_int_t)LIZ_COUNT_MAX;
+    }
+    
+    return (liz_int_t)LIZ_VM_POOL_MIN_SIZE_CLASS_CAPACITY << size_class;
+}
+
+
+
+static
+void
+liz_vm_pool_lock(liz_vm_pool_t *pool)
+{
+    while (0u != liz_atomic_exchange_acquire_uint32(&pool->lock, 1u)) {
+        while (0u != liz_atomic_load_acquire_uint32(&pool->lock)) {
+            // Spin on loads to not bounce the cache line between waiters.
+        }
+    }
+}
+
+
+
+static
+void
+liz_vm_pool_unlock(liz_vm_pool_t *pool)
+{
+    liz_atomic_store_release_uint32(&pool->lock, 0u);
+}
+
+
+
+static
+liz_vm_t**
+liz_vm_pool_free_vms(liz_vm_pool_t *pool,
+                     liz_int_t const size_class)
+{
+    return pool->free_vms + size_class * pool->vm_capacity_per_size_class;
+}
+
+
+
+static
+liz_vm_t*
+liz_vm_pool_pop_free_vm(liz_vm_pool_t *pool,
+                        liz_int_t const size_class)
+{
+    if (0 == pool->free_counts[size_class]) {
+        return NULL;
+    }
+    
+    pool->free_counts[size_class] -= 1;
+    
+    return liz_vm_pool_free_vms(pool, size_class)[pool->free_counts[size_class]];
+}
+
+
+
+static
+void
+liz_vm_pool_push_free_vm(liz_vm_pool_t *pool,
+                         liz_int_t const size_class,
+                         liz_vm_t *vm)
+{
+    LIZ_ASSERT(pool->free_counts[size_class] < pool->vm_counts[size_class]);
+    
+    liz_vm_pool_free_vms(pool, size_class)[pool->free_counts[size_class]] = vm;
+    pool->free_counts[size_class] += 1;
+}
+
+
+
+/* Creates a vm of size_class outside of the lock after claiming its slot
+ * under the lock, gives the slot back if creation fails.
+ */
+static
+liz_vm_t*
+liz_vm_pool_create_vm(liz_vm_pool_t *pool,
+                      liz_int_t const size_class)
+{
+    liz_vm_t *vm = liz_vm_create(liz_vm_pool_size_class_specification(size_class),
+                                 pool->allocator_context,
+                                 pool->alloc_func);
+    
+    if (NULL == vm) {
+        liz_vm_pool_lock(pool);
+        pool->vm_counts[size_class] -= 1;
+        liz_vm_pool_unlock(pool);
+    }
+    
+    return vm;
+}
+
+
+
+static
+liz_int_t
+liz_vm_pool_vm_size_class(liz_vm_t const *vm)
+{
+    liz_int_t const capacity = liz_lookaside_stack_capacity(&vm->decider_state_stack_header);
+    
+    for (liz_int_t size_class = 0; size_class < LIZ_VM_POOL_SIZE_CLASS_COUNT; ++size_class) {
+        if (capacity == liz_vm_pool_size_class_capacity(size_class)) {
+            return size_class;
+        }
+    }
+    
+    LIZ_ASSERT(0 && "Vm doesn't belong to a vm pool.");
+    return 0;
+}
+
+
+
+liz_int_t
+liz_vm_pool_size_class(liz_shape_specification_t const spec)
+{
+    liz_int_t capacity = spec.decider_state_capacity;
+    capacity = liz_max(capacity, spec.action_state_capacity);
+    capacity = liz_max(capacity, spec.persistent_state_change_capacity);
+    capacity = liz_max(capacity, spec.decider_guard_capacity);
+    capacity = liz_max(capacity, spec.action_request_capacity);
+    
+    LIZ_ASSERT(liz_vm_pool_size_class_capacity(LIZ_VM_POOL_SIZE_CLASS_COUNT - 2) < (liz_int_t)LIZ_COUNT_MAX
+               && (liz_int_t)LIZ_COUNT_MAX / 2 <= liz_vm_pool_size_class_capacity(LIZ_VM_POOL_SIZE_CLASS_COUNT - 2)
+               && "Size class count must match LIZ_COUNT_MAX.");
+    
+    liz_int_t size_class = 0;
+    while ((size_class < LIZ_VM_POOL_SIZE_CLASS_COUNT - 1)
+           && (capacity > liz_vm_pool_size_class_capacity(size_class))) {
+        ++size_class;
+    }
+    
+    return size_class;
+}
+
+
+
+liz_shape_specification_t
+liz_vm_pool_size_class_specification(liz_int_t const size_class)
+{
+    liz_index_t const capacity = (liz_index_t)liz_vm_pool_size_class_capacity(size_class);
+    
+    liz_shape_specification_t spec;
+    liz_memset(&spec, 0, sizeof(spec));
+    
+    spec.decider_state_capacity = capacity;
+    spec.action_state_capacity = capacity;
+    spec.persistent_state_change_capacity = capacity;
+    spec.decider_guard_capacity = capacity;
+    spec.action_request_capacity = capacity;
+    
+    return spec;
+}
+
+
+
+liz_vm_pool_t*
+liz_vm_pool_create(liz_int_t const vm_capacity_per_size_class,
+                   void *allocator_context,
+                   liz_alloc_func_t alloc_func,
+                   liz_dealloc_func_t dealloc_func)
+{
+    if (0 >= vm_capacity_per_size_class) {
+        return NULL;
+    }
+    
+    size_t const pool_size = liz_allocation_size_aggregate(sizeof(liz_int_t),
+                                                           sizeof(liz_vm_pool_t),
+                                                           sizeof(liz_vm_t *),
+                                                           sizeof(liz_vm_t *) * LIZ_VM_POOL_SIZE_CLASS_COUNT * (size_t)vm_capacity_per_size_class);
+    
+    liz_vm_pool_t *pool = (liz_vm_pool_t *)alloc_func(allocator_context, pool_size);
+    
+    if (NULL == pool) {
+        return NULL;
+    }
+    
+    liz_memset(pool, 0, sizeof(*pool));
+    
+    char *free_vms = (char *)pool + sizeof(liz_vm_pool_t);
+    free_vms += liz_allocation_alignment_offset(free_vms, sizeof(liz_vm_t *));
+    
+    pool->free_vms = (liz_vm_t **)free_vms;
+    pool->vm_capacity_per_size_class = vm_capacity_per_size_class;
+    pool->allocator_context = allocator_context;
+    pool->alloc_func = alloc_func;
+    pool->dealloc_func = dealloc_func;
+    
+    return pool;
+}
+
+
+
+void
+liz_vm_pool_destroy(liz_vm_pool_t *pool,
+                    void * LIZ_RESTRICT allocator_context,
+                    liz_dealloc_func_t dealloc_func)
+{
+    for (liz_int_t size_class = 0; size_class < LIZ_VM_POOL_SIZE_CLASS_COUNT; ++size_class) {
+        LIZ_ASSERT(pool->free_counts[size_class] == pool->vm_counts[size_class]
+                   && "All vms must be released before destroying their pool.");
+        
+        liz_vm_t **free_vms = liz_vm_pool_free_vms(pool, size_class);
+        
+        for (liz_int_t i = 0; i < pool->free_counts[size_class]; ++i) {
+            liz_vm_destroy(free_vms[i], pool->allocator_context, pool->dealloc_func);
+        }
+    }
+    
+    dealloc_func(allocator_context, pool);
+}
+
+
+
+bool
+liz_vm_pool_reserve(liz_vm_pool_t *pool,
+                    liz_shape_specification_t const spec,
+                    liz_int_t const vm_count)
+{
+    liz_int_t const size_class = liz_vm_pool_size_class(spec);
+    
+    if (vm_count > pool->vm_capacity_per_size_class) {
+        return false;
+    }
+    
+    for (;;) {
+        liz_vm_pool_lock(pool);
+        
+        bool const is_reserved = (pool->vm_counts[size_class] >= vm_count);
+        if (!is_reserved) {
+            pool->vm_counts[size_class] += 1;
+        }
+        
+        liz_vm_pool_unlock(pool);
+        
+        if (is_reserved) {
+            return true;
+        }
+        
+        liz_vm_t *vm = liz_vm_pool_create_vm(pool, size_class);
+        
+        if (NULL == vm) {
+            return false;
+        }
+        
+        liz_vm_pool_release(pool, vm);
+    }
+}
+
+
+
+liz_vm_t*
+liz_vm_pool_acquire(liz_vm_pool_t *pool,
+                    liz_shape_specification_t const spec)
+{
+    liz_int_t const size_class = liz_vm_pool_size_class(spec);
+    
+    liz_vm_pool_lock(pool);
+    
+    liz_vm_t *vm = liz_vm_pool_pop_free_vm(pool, size_class);
+    
+    if (NULL == vm && pool->vm_counts[size_class] < pool->vm_capacity_per_size_class) {
+        pool->vm_counts[size_class] += 1;
+        liz_vm_pool_unlock(pool);
+        
+        return liz_vm_pool_create_vm(pool, size_class);
+    }
+    
+    for (liz_int_t c = size_class + 1; (NULL == vm) && (c < LIZ_VM_POOL_SIZE_CLASS_COUNT); ++c) {
+        vm = liz_vm_pool_pop_free_vm(pool, c);
+    }
+    
+    liz_vm_pool_unlock(pool);
+    
+    return vm;
+}
+
+
+
+void
+liz_vm_pool_release(liz_vm_pool_t *pool,
+                    liz_vm_t *vm)
+{
+    liz_int_t const size_class = liz_vm_pool_vm_size_class(vm);
+    
+    liz_vm_pool_lock(pool);
+    liz_vm_pool_push_free_vm(pool, size_class, vm);
+    liz_vm_pool_unlock(pool);
+}
+
+
+
+bool
+liz_vm_pool_acquire_batch(liz_vm_pool_t *pool,
+                          liz_shape_specification_t const *specs,
+                          liz_int_t const shape_count,
+                          liz_vm_t **vms)
+{
+    liz_vm_t *size_class_vms[LIZ_VM_POOL_SIZE_CLASS_COUNT] = {NULL};
+    
+    for (liz_int_t i = 0; i < shape_count; ++i) {
+        liz_int_t const size_class = liz_vm_pool_size_class(specs[i]);
+        
+        if (NULL == size_class_vms[size_class]) {
+            size_class_vms[size_class] = liz_vm_pool_acquire(pool, specs[i]);
+            
+            if (NULL == size_class_vms[size_class]) {
+                liz_vm_pool_release_batch(pool, vms, i);
+                return false;
+            }
+        }
+        
+        vms[i] = size_class_vms[size_class];
+    }
+    
+    return true;
+}
+
+
+
+void
+liz_vm_pool_release_batch(liz_vm_pool_t *pool,
+                          liz_vm_t * const *vms,
+                          liz_int_t const shape_count)
+{
+    // A batch holds at most one vm per size class.
+    liz_vm_t *released_vms[LIZ_VM_POOL_SIZE_CLASS_COUNT];
+    liz_int_t released_vm_count = 0;
+    
+    for (liz_int_t i = 0; i < shape_count; ++i) {
+        bool is_released = false;
+        
+        for (liz_int_t r = 0; r < released_vm_count; ++r) {
+            is_released = is_released || (released_vms[r] == vms[i]);
+        }
+        
+        if (!is_released) {
+            LIZ_ASSERT(released_vm_count < LIZ_VM_POOL_SIZE_CLASS_COUNT);
+            
+            released_vms[released_vm_count++] = vms[i];
+            liz_vm_pool_release(pool, vms[i]);
+        }
+    }
+}
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *
+ * Pool of vms bucketed by size class, shared by worker threads.
+ *
+ * A shape specification maps to the smallest size class whose capacity 
+ * covers all of its vm capacities. Vms of a size class are created for the
+ * class' merged specification on first use and are recycled afterwards, so
+ * small trees run on small vms and nobody tracks merged specifications by 
+ * hand.
+ *
+ * Typical usage:
+ * 1. Create one pool with a vm capacity per size class of at least the 
+ *    worker count and reserve vms for the shapes in use while loading.
+ * 2. Each worker acquires vms for the shapes of its batch, updates the 
+ *    batch's actors, and releases the vms again.
+ */
+
+#ifndef LIZ_liz_vm_pool_H
+#define LIZ_liz_vm_pool_H
+
+
+#include <liz/liz_platform_types.h>
+#include <liz/liz_platform_macros.h>
+#include <liz/liz_allocator.h>
+#include <liz/liz_common.h>
+#include <liz/liz_vm.h>
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+    
+    
+    /**
+     * Capacity of the smallest size class. Each following class doubles the
+     * capacity, the last one is capped at LIZ_COUNT_MAX.
+     */
+#define LIZ_VM_POOL_MIN_SIZE_CLASS_CAPACITY 8
+    
+    /**
+     * Number of size classes until the last one reaches LIZ_COUNT_MAX. Wide
+     * indices need more doublings to cover their capacities.
+     */
+#if defined(LIZ_WIDE_INDEX_ENABLE)
+#   define LIZ_VM_POOL_SIZE_CLASS_COUNT 29
+#else
+#   define LIZ_VM_POOL_SIZE_CLASS_COUNT 14
+#endif
+    
+    
+    
+    /**
+     * free_vms holds vm_capacity_per_size_class slots per size class, the 
+     * first free_counts[size_class] of them point to vms ready for reuse.
+     * vm_counts[size_class] vms of a class exist in total.
+     */
+    typedef struct liz_vm_pool {
+        liz_vm_t **free_vms;
+        liz_int_t free_counts[LIZ_VM_POOL_SIZE_CLASS_COUNT];
+        liz_int_t vm_counts[LIZ_VM_POOL_SIZE_CLASS_COUNT];
+        liz_int_t vm_capacity_per_size_class;
+        
+        void *allocator_context;
+        liz_alloc_func_t alloc_func;
+        liz_dealloc_func_t dealloc_func;
+        
+        uint32_t volatile lock;
+    } liz_vm_pool_t;
+    
+    
+    
+    /**
+     * Returns the smallest size class able to run shapes adhering to spec.
+     */
+    liz_int_t
+    liz_vm_pool_size_class(liz_shape_specification_t spec);
+    
+    
+    /**
+     * Returns the specification the vms of size_class are created for.
+     */
+    liz_shape_specification_t
+    liz_vm_pool_size_class_specification(liz_int_t size_class);
+    
+    
+    /**
+     * Allocates the pool via alloc_func and keeps allocator_context, 
+     * alloc_func, and dealloc_func to create and destroy its vms.
+     *
+     * Returns NULL if vm_capacity_per_size_class is not positive or if memory
+     * can't be allocated.
+     */
+    liz_vm_pool_t*
+    liz_vm_pool_create(liz_int_t vm_capacity_per_size_class,
+                       void *allocator_context,
+                       liz_alloc_func_t alloc_func,
+                       liz_dealloc_func_t dealloc_func);
+    
+    
+    /**
+     * Destroys all vms of pool and then the pool via dealloc_func and 
+     * allocator_context. All vms must have been released.
+     */
+    void
+    liz_vm_pool_destroy(liz_vm_pool_t *pool,
+                        void * LIZ_RESTRICT allocator_context,
+                        liz_dealloc_func_t dealloc_func);
+    
+    
+    /**
+     * Creates vms for the size class of spec until vm_count of them exist,
+     * e.g., while loading shapes to not allocate while updating actors.
+     *
+     * Returns false if vm_count exceeds the vm capacity per size class or if
+     * memory can't be allocated.
+     */
+    bool
+    liz_vm_pool_reserve(liz_vm_pool_t *pool,
+                        liz_shape_specification_t spec,
+                        liz_int_t vm_count);
+    
+    
+    /**
+     * Returns the smallest fitting vm for spec. Prefers a free vm of spec's
+     * size class, then creates one if the class has capacity left, then falls
+     * back to a free vm of a bigger size class.
+     *
+     * Returns NULL if no fitting vm is available. Thread-safe.
+     */
+    liz_vm_t*
+    liz_vm_pool_acquire(liz_vm_pool_t *pool,
+                        liz_shape_specification_t spec);
+    
+    
+    /**
+     * Returns vm from liz_vm_pool_acquire to pool. Thread-safe.
+     */
+    void
+    liz_vm_pool_release(liz_vm_pool_t *pool,
+                        liz_vm_t *vm);
+    
+    
+    /**
+     * Stores the smallest fitting vm for each of the shape_count specs in 
+     * vms. Shapes of the same size class share one vm as a worker updates 
+     * its batch one actor after the other.
+     *
+     * Returns false and acquires nothing if not all vms are available. 
+     * Thread-safe.
+     */
+    bool
+    liz_vm_pool_acquire_batch(liz_vm_pool_t *pool,
+                              liz_shape_specification_t const *specs,
+                              liz_int_t shape_count,
+                              liz_vm_t **vms);
+    
+    
+    /**
+     * Releases the vms of liz_vm_pool_acquire_batch, each shared vm once. 
+     * Thread-safe.
+     */
+    void
+    liz_vm_pool_release_batch(liz_vm_pool_t *pool,
+                              liz_vm_t * const *vms,
+                              liz_int_t shape_count);
+    
+    
+    
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+
+#endif /* LIZ_liz_vm_pool_H */
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "liz_vm_stats.h"
+
+#include "liz_platform_functions.h"
+
+
+
+void
+liz_vm_stats_clear(liz_vm_stats_t *stats)
+{
+    liz_memset(stats, 0, sizeof(*stats));
+}
+
+
+
+void
+liz_vm_stats_add_update(liz_vm_stats_t *stats,
+                        liz_vm_update_stats_t const *update_stats)
+{
+    stats->update_count += 1u;
+    stats->cycles += update_stats->cycles;
+    stats->max_cycles = (stats->max_cycles < update_stats->cycles) ? update_stats->cycles : stats->max_cycles;
+    stats->visited_node_count += update_stats->visited_node_count;
+    stats->immediate_action_count += update_stats->immediate_action_count;
+    stats->cancelled_action_count += update_stats->cancelled_action_count;
+    stats->launch_request_count += update_stats->launch_request_count;
+    stats->cancel_request_count += update_stats->cancel_request_count;
+}
+
+
+
+void
+liz_vm_stats_merge(liz_vm_stats_t *target,
+                   liz_vm_stats_t const *source)
+{
+    target->update_count += source->update_count;
+    target->cycles += source->cycles;
+    target->max_cycles = (target->max_cycles < source->max_cycles) ? source->max_cycles : target->max_cycles;
+    target->visited_node_count += source->visited_node_count;
+    target->immediate_action_count += source->immediate_action_count;
+    target->cancelled_action_count += source->cancelled_action_count;
+    target->launch_request_count += source->launch_request_count;
+    target->cancel_request_count += source->cancel_request_count;
+}
+
+
+
+uint64_t
+liz_vm_stats_mean_cycles(liz_vm_stats_t const *stats)
+{
+    if (0u == stats->update_count) {
+        return 0u;
+    }
+    
+    return stats->cycles / stats->update_count;
+}
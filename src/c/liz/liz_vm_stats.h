@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *
+ * Per update and aggregated vm cost statistics, e.g., for schedulers to 
+ * amortize expensive actors over multiple frames or for cost dashboards.
+ *
+ * Define LIZ_VM_STATS_ENABLE to compile vms which collect visit, immediate
+ * action, cancellation, and cycle counts during updates. Request counts are
+ * available without it.
+ *
+ * Typical usage:
+ * 1. Keep a liz_vm_stats_t per shape and per thread.
+ * 2. After each actor update or cancellation get the vm's update stats via 
+ *    liz_vm_update_stats and add them to the stats of the actor's shape.
+ * 3. At frame end merge the per thread stats of each shape.
+ */
+
+#ifndef LIZ_liz_vm_stats_H
+#define LIZ_liz_vm_stats_H
+
+
+#include <liz/liz_platform_types.h>
+#include <liz/liz_platform_macros.h>
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+    
+    
+    /**
+     * Statistics of a single actor update or cancellation.
+     *
+     * visited_node_count counts nodes entered from the top and 
+     * cancelled_action_count counts actions cancelled from the previous 
+     * update or immediately. immediate_action_count counts immediate action
+     * ticks excluding cancellations. cycles are measured via liz_cycle_count.
+     */
+    typedef struct liz_vm_update_stats {
+        uint64_t cycles;
+        uint32_t visited_node_count;
+        uint32_t immediate_action_count;
+        uint32_t cancelled_action_count;
+        uint32_t launch_request_count;
+        uint32_t cancel_request_count;
+        uint32_t padding;
+    } liz_vm_update_stats_t;
+    
+    
+    
+    /**
+     * Sums of update statistics, e.g., of all updates of actors sharing a 
+     * shape.
+     */
+    typedef struct liz_vm_stats {
+        uint64_t update_count;
+        uint64_t cycles;
+        uint64_t max_cycles;
+        uint64_t visited_node_count;
+        uint64_t immediate_action_count;
+        uint64_t cancelled_action_count;
+        uint64_t launch_request_count;
+        uint64_t cancel_request_count;
+    } liz_vm_stats_t;
+    
+    
+    
+    void
+    liz_vm_stats_clear(liz_vm_stats_t *stats);
+    
+    
+    void
+    liz_vm_stats_add_update(liz_vm_stats_t *stats,
+                            liz_vm_update_stats_t const *update_stats);
+    
+    
+    /**
+     * Adds the sums of source to target and keeps the maximum of their 
+     * maximal cycles.
+     */
+    void
+    liz_vm_stats_merge(liz_vm_stats_t *target,
+                       liz_vm_stats_t const *source);
+    
+    
+    /**
+     * Returns the average cycles per update or zero if no update was added.
+     */
+    uint64_t
+    liz_vm_stats_mean_cycles(liz_vm_stats_t const *stats);
+    
+    
+    
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+
+#endif /* LIZ_liz_vm_stats_H */
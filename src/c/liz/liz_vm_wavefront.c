@@ -0,0 +1,752 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *
+ * Implementation of the wavefront vm.
+ */
+
+#include "liz_vm_wavefront.h"
+
+#include "liz_assert.h"
+#include "liz_lookaside_stack.h"
+
+
+
+static
+size_t
+liz_vm_wavefront_aggregate(size_t const previous_size,
+                           size_t const additional_size)
+{
+    // Round each part up, too, as the placing arena hands out aligned sizes.
+    size_t const aligned_additional_size = liz_allocation_size_aggregate(LIZ_ARENA_ALIGNMENT,
+                                                                         additional_size,
+                                                                         LIZ_ARENA_ALIGNMENT,
+                                                                         0u);
+    
+    return liz_allocation_size_aggregate(LIZ_ARENA_ALIGNMENT,
+                                         previous_size,
+                                         LIZ_ARENA_ALIGNMENT,
+                                         aligned_additional_size);
+}
+
+
+
+static
+liz_vm_wavefront_pc_t
+liz_vm_wavefront_lane_pc(liz_vm_t const *vm,
+                         liz_vm_shape_t const *shape)
+{
+    liz_vm_wavefront_pc_t pc = {
+        vm->shape_atom_index,
+        1,
+        liz_lookaside_stack_count(&vm->decider_guard_stack_header)
+    };
+    
+    if (liz_vm_cmd_guard_decider == vm->cmd) {
+        // Leave child nodes to their guard before entering their siblings.
+        pc.cmd_rank = 0;
+    } else if (liz_vm_cmd_cleanup == vm->cmd) {
+        // Cleanup is the last step of every lane.
+        pc.shape_atom_index = (liz_int_t)liz_shape_specification_shape_atom_index_count(shape->spec);
+    }
+    
+    return pc;
+}
+
+
+
+/**
+ * Returns true if lhs runs before rhs - lower shape atom index first, then 
+ * guards before node invocations, then deeper guards first so lanes leaving
+ * more deciders catch up with the others.
+ */
+static
+bool
+liz_vm_wavefront_pc_less(liz_vm_wavefront_pc_t const lhs,
+                         liz_vm_wavefront_pc_t const rhs)
+{
+    if (lhs.shape_atom_index != rhs.shape_atom_index) {
+        return lhs.shape_atom_index < rhs.shape_atom_index;
+    }
+    
+    if (lhs.cmd_rank != rhs.cmd_rank) {
+        return lhs.cmd_rank < rhs.cmd_rank;
+    }
+    
+    return lhs.guard_depth > rhs.guard_depth;
+}
+
+
+
+static
+bool
+liz_vm_wavefront_pc_equal(liz_vm_wavefront_pc_t const lhs,
+                          liz_vm_wavefront_pc_t const rhs)
+{
+    return (lhs.shape_atom_index == rhs.shape_atom_index)
+        && (lhs.cmd_rank == rhs.cmd_rank)
+        && (lhs.guard_depth == rhs.guard_depth);
+}
+
+
+
+#pragma mark Create and destroy wavefront
+
+liz_vm_wavefront_t*
+liz_vm_wavefront_create(liz_shape_specification_t const spec,
+                        liz_int_t const lane_capacity,
+                        void * LIZ_RESTRICT allocator_context,
+                        liz_alloc_func_t alloc_func)
+{
+    if (1 > lane_capacity || LIZ_VM_WAVEFRONT_LANE_CAPACITY < lane_capacity) {
+        return NULL;
+    }
+    
+    size_t block_size = liz_vm_wavefront_aggregate(0u, sizeof(liz_vm_wavefront_t));
+    for (liz_int_t lane = 0; lane < lane_capacity; ++lane) {
+        block_size = liz_vm_wavefront_aggregate(block_size, liz_vm_memory_size_requirement(spec));
+    }
+    
+    void *block = alloc_func(allocator_context, block_size);
+    
+    if (NULL == block) {
+        return NULL;
+    }
+    
+    LIZ_ASSERT(0u == liz_allocation_alignment_offset(block, LIZ_ARENA_ALIGNMENT)
+               && "Alignment of allocated memory less than required.");
+    
+    // Carve the parts out of the block in the order of the size calculation.
+    liz_arena_t placement;
+    liz_arena_init(&placement, block, block_size);
+    
+    liz_vm_wavefront_t *wavefront = (liz_vm_wavefront_t *)liz_arena_alloc(&placement, sizeof(liz_vm_wavefront_t));
+    
+    for (liz_int_t lane = 0; lane < LIZ_VM_WAVEFRONT_LANE_CAPACITY; ++lane) {
+        wavefront->vms[lane] = NULL;
+        wavefront->actor_blackboards[lane] = NULL;
+    }
+    
+    for (liz_int_t lane = 0; lane < lane_capacity; ++lane) {
+        wavefront->vms[lane] = liz_vm_create(spec, &placement, liz_arena_alloc);
+        LIZ_ASSERT(NULL != wavefront->vms[lane]);
+    }
+    
+    wavefront->subtree_call_index = 0;
+    wavefront->lane_capacity = lane_capacity;
+    wavefront->last_lane_step_count = 0;
+    
+    return wavefront;
+}
+
+
+
+void
+liz_vm_wavefront_destroy(liz_vm_wavefront_t *wavefront,
+                         void * LIZ_RESTRICT allocator_context,
+                         liz_dealloc_func_t dealloc_func)
+{
+    dealloc_func(allocator_context, wavefront);
+}
+
+
+
+liz_vm_t*
+liz_vm_wavefront_lane_vm(liz_vm_wavefront_t *wavefront,
+                         liz_int_t const lane)
+{
+    LIZ_ASSERT(0 <= lane && lane < wavefront->lane_capacity);
+    
+    return wavefront->vms[lane];
+}
+
+
+
+
+
+
+#pragma mark Wave steps
+
+/**
+ * Runs an immediate action for all lanes in active_mask in three phases -
+ * enter the node and fetch the execution requests, call the batch function
+ * once or the immediate action function per lane, store the returned states
+ * and leave the node.
+ */
+static
+void
+liz_vm_wavefront_invoke_immediate_action(liz_vm_wavefront_t *wavefront,
+                                         liz_vm_monitor_t *monitor,
+                                         liz_time_t const time,
+                                         liz_vm_actor_t const *actors,
+                                         liz_int_t const lane_count,
+                                         liz_vm_shape_t const *shape,
+                                         liz_int_t const node_shape_atom_index,
+                                         liz_shape_atom_t const *node_atom,
+                                         liz_immediate_action_batch_func_t batch_function,
+                                         uint64_t const active_mask)
+{
+    liz_vm_t * const *vms = wavefront->vms;
+    void * const *actor_blackboards = wavefront->actor_blackboards;
+    
+    liz_random_number_seed_t random_number_seeds[LIZ_VM_WAVEFRONT_LANE_CAPACITY];
+    liz_execution_state_t execution_states[LIZ_VM_WAVEFRONT_LANE_CAPACITY];
+    liz_int_t active_lane_count = 0;
+    
+    for (liz_int_t lane = 0; lane < lane_count; ++lane) {
+        
+        random_number_seeds[lane] = 0;
+        execution_states[lane] = liz_execution_state_launch;
+        
+        if (0u == (active_mask & (UINT64_C(1) << lane))) {
+            continue;
+        }
+        
+        liz_vm_t *vm = vms[lane];
+        
+        LIZ_VM_MONITOR_NODE(monitor,
+                            node_shape_atom_index,
+                            liz_vm_monitor_node_flag_enter_from_top,
+                            vm,
+                            actor_blackboards[lane],
+                            time,
+                            &actors[lane],
+                            shape);
+        
+        liz_vm_resolve_cancellation_batch_before_immediate_action(vm,
+                                                                  monitor,
+                                                                  actor_blackboards[lane],
+                                                                  time,
+                                                                  &actors[lane],
+                                                                  shape);
+        
+        vm->subtree_call_index = wavefront->subtree_call_index;
+        execution_states[lane] = liz_vm_request_immediate_action(vm,
+                                                                 &actors[lane]);
+        random_number_seeds[lane] = vm->actor_random_number_seed;
+        ++active_lane_count;
+    }
+    
+    if (NULL != batch_function) {
+        LIZ_VM_COUNT_CYCLES_BEGIN(batch_begin_cycles);
+        batch_function(actor_blackboards,
+                       random_number_seeds,
+                       time,
+                       execution_states,
+                       active_mask,
+                       lane_count);
+        
+        // Count the shared call's cycles evenly split per lane.
+        for (liz_int_t lane = 0; lane < lane_count; ++lane) {
+            
+            if (0u != (active_mask & (UINT64_C(1) << lane))) {
+                LIZ_VM_COUNT_CYCLES_END_SHARED(batch_begin_cycles, vms[lane], node_shape_atom_index, active_lane_count);
+            }
+        }
+    } else {
+        for (liz_int_t lane = 0; lane < lane_count; ++lane) {
+            
+            if (0u == (active_mask & (UINT64_C(1) << lane))) {
+                continue;
+            }
+            
+            LIZ_VM_COUNT_CYCLES_BEGIN(tick_begin_cycles);
+            execution_states[lane] = liz_vm_tick_immediate_action(actor_blackboards[lane],
+                                                                  &random_number_seeds[lane],
+                                                                  time,
+                                                                  execution_states[lane],
+                                                                  node_atom,
+                                                                  shape->immediate_action_functions,
+                                                                  shape->spec.immediate_action_function_count);
+            LIZ_VM_COUNT_CYCLES_END(tick_begin_cycles, vms[lane], node_shape_atom_index);
+        }
+    }
+    
+    for (liz_int_t lane = 0; lane < lane_count; ++lane) {
+        
+        if (0u == (active_mask & (UINT64_C(1) << lane))) {
+            continue;
+        }
+        
+        liz_vm_t *vm = vms[lane];
+        
+        vm->actor_random_number_seed = random_number_seeds[lane];
+        LIZ_VM_STATS_COUNT_IMMEDIATE_ACTION(vm);
+        liz_vm_store_immediate_action(vm,
+                                      execution_states[lane]);
+        
+        LIZ_VM_MONITOR_NODE(monitor,
+                            node_shape_atom_index,
+                            liz_vm_monitor_node_flag_leave_to_top,
+                            vm,
+                            actor_blackboards[lane],
+                            time,
+                            &actors[lane],
+                            shape);
+        
+        // Traverse up to decider, alas its associated guard.
+        vm->cmd = liz_vm_cmd_guard_decider;
+    }
+}
+
+
+
+/**
+ * Enters the node decoded into node_atom for all lanes in active_mask, runs
+ * the node type's invocation for each of them, and leaves the node again.
+ */
+static
+void
+liz_vm_wavefront_invoke_node(liz_vm_wavefront_t *wavefront,
+                             liz_vm_monitor_t *monitor,
+                             liz_time_t const time,
+                             liz_vm_actor_t const *actors,
+                             liz_int_t const lane_count,
+                             liz_vm_shape_t const *shape,
+                             liz_immediate_action_batch_func_t const *batch_functions,
+                             liz_int_t const node_shape_atom_index,
+                             liz_shape_atom_t const *node_atom,
+                             uint64_t const active_mask)
+{
+    liz_vm_t * const *vms = wavefront->vms;
+    void * const *actor_blackboards = wavefront->actor_blackboards;
+    liz_node_type_t const node_type = (liz_node_type_t)(node_atom->type_mask.type);
+    
+    if (liz_node_type_immediate_action == node_type) {
+        
+        liz_immediate_action_batch_func_t batch_function = NULL;
+        
+        if (NULL != batch_functions) {
+            batch_function = batch_functions[node_atom->immediate_action.function_index];
+        }
+        
+        liz_vm_wavefront_invoke_immediate_action(wavefront,
+                                                 monitor,
+                                                 time,
+                                                 actors,
+                                                 lane_count,
+                                                 shape,
+                                                 node_shape_atom_index,
+                                                 node_atom,
+                                                 batch_function,
+                                                 active_mask);
+        return;
+    }
+    
+    for (liz_int_t lane = 0; lane < lane_count; ++lane) {
+        
+        if (0u == (active_mask & (UINT64_C(1) << lane))) {
+            continue;
+        }
+        
+        LIZ_VM_MONITOR_NODE(monitor,
+                            node_shape_atom_index,
+                            liz_vm_monitor_node_flag_enter_from_top,
+                            vms[lane],
+                            actor_blackboards[lane],
+                            time,
+                            &actors[lane],
+                            shape);
+        
+        vms[lane]->subtree_call_index = wavefront->subtree_call_index;
+    }
+    
+    // Dispatch once on the node type, then invoke the node per lane.
+    liz_vm_cmd_t next_cmd = liz_vm_cmd_error;
+    liz_vm_monitor_node_flag_t traversal_direction = liz_vm_monitor_node_flag_error;
+    
+    switch (node_type) {
+        case liz_node_type_deferred_action:
+            for (liz_int_t lane = 0; lane < lane_count; ++lane) {
+                if (0u != (active_mask & (UINT64_C(1) << lane))) {
+                    liz_vm_invoke_deferred_action(vms[lane],
+                                                  &actors[lane],
+                                                  node_atom);
+                }
+            }
+            
+            next_cmd = liz_vm_cmd_guard_decider;
+            traversal_direction = liz_vm_monitor_node_flag_leave_to_top;
+            break;
+            
+        case liz_node_type_persistent_action:
+            for (liz_int_t lane = 0; lane < lane_count; ++lane) {
+                if (0u != (active_mask & (UINT64_C(1) << lane))) {
+                    liz_vm_invoke_persistent_action(vms[lane],
+                                                    &actors[lane],
+                                                    shape);
+                }
+            }
+            
+            next_cmd = liz_vm_cmd_guard_decider;
+            traversal_direction = liz_vm_monitor_node_flag_leave_to_top;
+            break;
+            
+        case liz_node_type_sequence_decider:
+            for (liz_int_t lane = 0; lane < lane_count; ++lane) {
+                if (0u != (active_mask & (UINT64_C(1) << lane))) {
+                    liz_vm_invoke_sequence_decider(vms[lane],
+                                                   &actors[lane],
+                                                   node_atom);
+                }
+            }
+            
+            next_cmd = liz_vm_cmd_invoke_node;
+            traversal_direction = liz_vm_monitor_node_flag_leave_to_bottom;
+            break;
+            
+        case liz_node_type_dynamic_priority_decider:
+            for (liz_int_t lane = 0; lane < lane_count; ++lane) {
+                if (0u != (active_mask & (UINT64_C(1) << lane))) {
+                    liz_vm_invoke_dynamic_priority_decider(vms[lane],
+                                                           &actors[lane],
+                                                           node_atom);
+                }
+            }
+            
+            next_cmd = liz_vm_cmd_invoke_node;
+            traversal_direction = liz_vm_monitor_node_flag_leave_to_bottom;
+            break;
+            
+        case liz_node_type_concurrent_decider:
+            for (liz_int_t lane = 0; lane < lane_count; ++lane) {
+                if (0u != (active_mask & (UINT64_C(1) << lane))) {
+                    liz_vm_invoke_concurrent_decider(vms[lane],
+                                                     &actors[lane],
+                                                     node_atom);
+                }
+            }
+            
+            next_cmd = liz_vm_cmd_invoke_node;
+            traversal_direction = liz_vm_monitor_node_flag_leave_to_bottom;
+            break;
+            
+        default:
+            LIZ_ASSERT(0 && "Unhandled node type.");
+            break;
+    }
+    
+    for (liz_int_t lane = 0; lane < lane_count; ++lane) {
+        
+        if (0u == (active_mask & (UINT64_C(1) << lane))) {
+            continue;
+        }
+        
+        liz_vm_t *vm = vms[lane];
+        liz_vm_cmd_t lane_next_cmd = next_cmd;
+        liz_vm_monitor_node_flag_t lane_traversal_direction = traversal_direction;
+        
+        if (liz_vm_cmd_invoke_node == next_cmd) {
+            LIZ_VM_CATCH_CHILDLESS_DECIDER(vm, &lane_next_cmd, &lane_traversal_direction);
+        }
+        
+        LIZ_VM_MONITOR_NODE(monitor,
+                            node_shape_atom_index,
+                            lane_traversal_direction,
+                            vm,
+                            actor_blackboards[lane],
+                            time,
+                            &actors[lane],
+                            shape);
+        
+        vm->cmd = lane_next_cmd;
+    }
+}
+
+
+
+/**
+ * Re-enters the decider of the top decider guard shared by all lanes in 
+ * active_mask from the bottom, runs the guard type's guard function for 
+ * each lane, and leaves the decider up or down.
+ */
+static
+void
+liz_vm_wavefront_guard_decider(liz_vm_wavefront_t *wavefront,
+                               liz_vm_monitor_t *monitor,
+                               liz_time_t const time,
+                               liz_vm_actor_t const *actors,
+                               liz_int_t const lane_count,
+                               liz_vm_shape_t const *shape,
+                               liz_int_t const first_active_lane,
+                               uint64_t const active_mask)
+{
+    liz_vm_t * const *vms = wavefront->vms;
+    void * const *actor_blackboards = wavefront->actor_blackboards;
+    
+    // An empty guard stack means that the lanes left the root node to its 
+    // top, alas their updates are done.
+    if (0 == liz_lookaside_stack_count(&vms[first_active_lane]->decider_guard_stack_header)) {
+        
+        for (liz_int_t lane = first_active_lane; lane < lane_count; ++lane) {
+            if (0u != (active_mask & (UINT64_C(1) << lane))) {
+                vms[lane]->cmd = liz_vm_cmd_cleanup;
+            }
+        }
+        
+        return;
+    }
+    
+    liz_vm_decider_guard_t const *first_top_guard = liz_vm_current_top_decider_guard(vms[first_active_lane]);
+    liz_int_t const guard_shape_atom_index = first_top_guard->shape_atom_index;
+    liz_node_type_t const guard_type = (liz_node_type_t)(first_top_guard->type);
+    
+    for (liz_int_t lane = first_active_lane; lane < lane_count; ++lane) {
+        
+        if (0u == (active_mask & (UINT64_C(1) << lane))) {
+            continue;
+        }
+        
+        LIZ_ASSERT(guard_shape_atom_index == liz_vm_current_top_decider_guard(vms[lane])->shape_atom_index
+                   && "Active lanes must share their top decider guard.");
+        
+        LIZ_VM_MONITOR_NODE(monitor,
+                            guard_shape_atom_index,
+                            liz_vm_monitor_node_flag_enter_from_bottom,
+                            vms[lane],
+                            actor_blackboards[lane],
+                            time,
+                            &actors[lane],
+                            shape);
+    }
+    
+    // Dispatch once on the guard type, then guard per lane.
+    switch (guard_type) {
+        case liz_node_type_sequence_decider:
+            for (liz_int_t lane = first_active_lane; lane < lane_count; ++lane) {
+                if (0u != (active_mask & (UINT64_C(1) << lane))) {
+                    liz_vm_guard_sequence_decider(vms[lane]);
+                }
+            }
+            break;
+            
+        case liz_node_type_concurrent_decider:
+            for (liz_int_t lane = first_active_lane; lane < lane_count; ++lane) {
+                if (0u != (active_mask & (UINT64_C(1) << lane))) {
+                    liz_vm_guard_concurrent_decider(vms[lane]);
+                }
+            }
+            break;
+            
+        case liz_node_type_dynamic_priority_decider:
+            for (liz_int_t lane = first_active_lane; lane < lane_count; ++lane) {
+                if (0u != (active_mask & (UINT64_C(1) << lane))) {
+                    liz_vm_guard_dynamic_priority_decider(vms[lane]);
+                }
+            }
+            break;
+            
+        default:
+            LIZ_ASSERT(0 && "Unhandled decider guard type.");
+            break;
+    }
+    
+    for (liz_int_t lane = first_active_lane; lane < lane_count; ++lane) {
+        
+        if (0u != (active_mask & (UINT64_C(1) << lane))) {
+            liz_vm_leave_decider_guard(vms[lane],
+                                       monitor,
+                                       actor_blackboards[lane],
+                                       time,
+                                       &actors[lane],
+                                       shape);
+        }
+    }
+}
+
+
+
+#pragma mark Update actors in lockstep
+
+liz_int_t
+liz_vm_wavefront_update_actors(liz_vm_wavefront_t *wavefront,
+                               liz_vm_monitor_t *monitor,
+                               void * LIZ_RESTRICT user_data_lookup_context,
+                               liz_vm_user_data_lookup_func_t user_data_lookup_func,
+                               liz_time_t const time,
+                               liz_vm_actor_t const *actors,
+                               liz_int_t const lane_count,
+                               liz_vm_shape_t const *shape,
+                               liz_immediate_action_batch_func_t const *batch_functions)
+{
+    LIZ_ASSERT(0 <= lane_count && lane_count <= wavefront->lane_capacity);
+    
+    liz_vm_t * const *vms = wavefront->vms;
+    liz_vm_wavefront_pc_t *lane_pcs = wavefront->lane_pcs;
+    
+    uint64_t running_mask = 0u;
+    liz_int_t running_lane_count = 0;
+    
+    for (liz_int_t lane = 0; lane < lane_count; ++lane) {
+        
+        LIZ_ASSERT(liz_vm_fulfills_shape_specification(vms[lane], shape->spec));
+        
+        wavefront->actor_blackboards[lane] = NULL;
+        
+        if (liz_vm_begin_update_actor(vms[lane], &actors[lane], shape)) {
+            wavefront->actor_blackboards[lane] = user_data_lookup_func(user_data_lookup_context,
+                                                                       actors[lane].header->user_data);
+            lane_pcs[lane] = liz_vm_wavefront_lane_pc(vms[lane], shape);
+            running_mask |= UINT64_C(1) << lane;
+            ++running_lane_count;
+        }
+    }
+    
+    uint64_t const updated_mask = running_mask;
+    
+    wavefront->subtree_call_index = 0;
+    
+    liz_int_t wave_step_count = 0;
+    liz_int_t lane_step_count = 0;
+    
+    LIZ_VM_STATS_CYCLES_BEGIN(update_begin_cycles);
+    while (0u != running_mask) {
+        
+        // Activate the lanes at the lowest program counter.
+        uint64_t active_mask = 0u;
+        liz_int_t first_active_lane = 0;
+        
+        for (liz_int_t lane = 0; lane < lane_count; ++lane) {
+            
+            uint64_t const lane_bit = UINT64_C(1) << lane;
+            
+            if (0u == (running_mask & lane_bit)) {
+                continue;
+            }
+            
+            if (0u == active_mask
+                || liz_vm_wavefront_pc_less(lane_pcs[lane], lane_pcs[first_active_lane])) {
+                
+                active_mask = lane_bit;
+                first_active_lane = lane;
+            } else if (liz_vm_wavefront_pc_equal(lane_pcs[lane], lane_pcs[first_active_lane])) {
+                active_mask |= lane_bit;
+            }
+        }
+        
+        liz_int_t const shape_atom_index = lane_pcs[first_active_lane].shape_atom_index;
+        
+        switch (vms[first_active_lane]->cmd) {
+            case liz_vm_cmd_invoke_node:
+            {
+                // Decode the node once for all active lanes. The walk only
+                // moves forward, so the shared subtree call cursor does, too.
+                liz_shape_atom_t const *node_atom = liz_vm_shape_atom(shape,
+                                                                      &wavefront->subtree_call_index,
+                                                                      shape_atom_index);
+                
+                liz_vm_wavefront_invoke_node(wavefront,
+                                             monitor,
+                                             time,
+                                             actors,
+                                             lane_count,
+                                             shape,
+                                             batch_functions,
+                                             shape_atom_index,
+                                             node_atom,
+                                             active_mask);
+                break;
+            }
+                
+            case liz_vm_cmd_guard_decider:
+                liz_vm_wavefront_guard_decider(wavefront,
+                                               monitor,
+                                               time,
+                                               actors,
+                                               lane_count,
+                                               shape,
+                                               first_active_lane,
+                                               active_mask);
+                break;
+                
+            case liz_vm_cmd_cleanup:
+                for (liz_int_t lane = first_active_lane; lane < lane_count; ++lane) {
+                    if (0u != (active_mask & (UINT64_C(1) << lane))) {
+                        liz_vm_step_cleanup(vms[lane],
+                                            monitor,
+                                            wavefront->actor_blackboards[lane],
+                                            time,
+                                            &actors[lane],
+                                            shape);
+                    }
+                }
+                break;
+                
+            default:
+                LIZ_ASSERT(0 && "Unhandled vm command.");
+                break;
+        }
+        
+        // Retire finished lanes and move the others' program counters.
+        for (liz_int_t lane = first_active_lane; lane < lane_count; ++lane) {
+            
+            uint64_t const lane_bit = UINT64_C(1) << lane;
+            
+            if (0u == (active_mask & lane_bit)) {
+                continue;
+            }
+            
+            ++lane_step_count;
+            
+            if (liz_vm_is_running(vms[lane])) {
+                LIZ_ASSERT(!liz_vm_wavefront_pc_less(liz_vm_wavefront_lane_pc(vms[lane], shape), lane_pcs[lane])
+                           && "Lanes must never move backwards in the walk.");
+                lane_pcs[lane] = liz_vm_wavefront_lane_pc(vms[lane], shape);
+            } else {
+                running_mask &= ~lane_bit;
+            }
+        }
+        
+        ++wave_step_count;
+    }
+    
+    // Split the update's cycles evenly between the lanes.
+    for (liz_int_t lane = 0; lane < lane_count; ++lane) {
+        
+        if (0u != (updated_mask & (UINT64_C(1) << lane))) {
+            LIZ_VM_STATS_CYCLES_END_SHARED(update_begin_cycles, vms[lane], running_lane_count);
+        }
+    }
+    
+    wavefront->last_lane_step_count = lane_step_count;
+    
+    return wave_step_count;
+}
+
+
+
+liz_int_t
+liz_vm_wavefront_last_lane_step_count(liz_vm_wavefront_t const *wavefront)
+{
+    return wavefront->last_lane_step_count;
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *
+ * Wavefront vm - updates a group of up to 64 actors of the same shape in 
+ * lockstep, alas in lanes, and walks the shape once for all of them. Each 
+ * lane keeps its execution state in a vm of its own.
+ *
+ * Each wave step picks the lowest program counter among the running lanes,
+ * alas the lowest shape atom index, guards before node invocations, and 
+ * deeper guards first, and sets the lanes at it in the active mask. The 
+ * node, or the guard, is decoded and dispatched on once and its work runs 
+ * for every active lane. Diverged lanes wait masked out until the active 
+ * lanes catch up with them. Program counters never move backwards, so the 
+ * shape atom stream is walked once from front to back per update.
+ *
+ * Immediate actions run in three phases: all active lanes fetch their 
+ * execution requests, then the action's batch function is called once for
+ * the active mask, or its immediate action function once per lane, and 
+ * finally all lanes store the returned states.
+ *
+ * Each lane vm ends up exactly like after liz_vm_update_actor - only the 
+ * order of monitor calls of different lanes interleaves.
+ *
+ * Typical usage:
+ * 1. Create a wavefront for the shape specification and the group size.
+ * 2. Update a group of actors with liz_vm_wavefront_update_actors.
+ * 3. Extract each actor's state and action requests from its lane vm.
+ */
+
+#ifndef LIZ_liz_vm_wavefront_H
+#define LIZ_liz_vm_wavefront_H
+
+
+#include <liz/liz_platform_types.h>
+#include <liz/liz_platform_macros.h>
+#include <liz/liz_allocator.h>
+#include <liz/liz_common.h>
+#include <liz/liz_vm.h>
+#include <liz/liz_vm_batch.h>
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+    
+    
+#define LIZ_VM_WAVEFRONT_LANE_CAPACITY LIZ_VM_BATCH_LANE_CAPACITY
+    
+    
+    
+    /**
+     * Position of a lane in the walk of the shape. Lanes with equal program
+     * counters run the same step on the same node.
+     */
+    typedef struct liz_vm_wavefront_pc {
+        liz_int_t shape_atom_index;
+        liz_int_t cmd_rank;
+        liz_int_t guard_depth;
+    } liz_vm_wavefront_pc_t;
+    
+    
+    
+    /**
+     * Treat as opaque, only access via the liz_vm_wavefront functions.
+     */
+    typedef struct liz_vm_wavefront {
+        liz_vm_t *vms[LIZ_VM_WAVEFRONT_LANE_CAPACITY];
+        void *actor_blackboards[LIZ_VM_WAVEFRONT_LANE_CAPACITY];
+        liz_vm_wavefront_pc_t lane_pcs[LIZ_VM_WAVEFRONT_LANE_CAPACITY];
+        
+        // Subtree call cursor of the walk, shared by all lanes.
+        liz_int_t subtree_call_index;
+        
+        liz_int_t lane_capacity;
+        liz_int_t last_lane_step_count;
+    } liz_vm_wavefront_t;
+    
+    
+    
+    /**
+     * Creates a wavefront with lane_capacity vms for shapes fitting spec in
+     * one memory block.
+     *
+     * Returns NULL if lane_capacity is less than one or greater than 
+     * LIZ_VM_WAVEFRONT_LANE_CAPACITY, or if memory can't be allocated.
+     */
+    liz_vm_wavefront_t*
+    liz_vm_wavefront_create(liz_shape_specification_t spec,
+                            liz_int_t lane_capacity,
+                            void * LIZ_RESTRICT allocator_context,
+                            liz_alloc_func_t alloc_func);
+    
+    
+    void
+    liz_vm_wavefront_destroy(liz_vm_wavefront_t *wavefront,
+                             void * LIZ_RESTRICT allocator_context,
+                             liz_dealloc_func_t dealloc_func);
+    
+    
+    /**
+     * Returns the vm of lane, it holds the state and action requests of the
+     * lane's actor after liz_vm_wavefront_update_actors.
+     */
+    liz_vm_t*
+    liz_vm_wavefront_lane_vm(liz_vm_wavefront_t *wavefront,
+                             liz_int_t lane);
+    
+    
+    /**
+     * Updates the lane_count actors in actors in lockstep, each in the vm of
+     * the lane with the same index.
+     *
+     * batch_functions holds a batch function or NULL per immediate action 
+     * function of shape, see liz_vm_batch_update_actors. Pass NULL to call 
+     * all immediate actions via the shape's immediate action functions.
+     *
+     * Returns the number of wave steps, compare with 
+     * liz_vm_wavefront_last_lane_step_count to see how well lanes converge.
+     *
+     * @attention lane_count must not be greater than the wavefront's lane
+     *            capacity.
+     */
+    liz_int_t
+    liz_vm_wavefront_update_actors(liz_vm_wavefront_t *wavefront,
+                                   liz_vm_monitor_t *monitor,
+                                   void * LIZ_RESTRICT user_data_lookup_context,
+                                   liz_vm_user_data_lookup_func_t user_data_lookup_func,
+                                   liz_time_t time,
+                                   liz_vm_actor_t const *actors,
+                                   liz_int_t lane_count,
+                                   liz_vm_shape_t const *shape,
+                                   liz_immediate_action_batch_func_t const *batch_functions);
+    
+    
+    /**
+     * Returns the summed steps of all lanes during the last 
+     * liz_vm_wavefront_update_actors call.
+     */
+    liz_int_t
+    liz_vm_wavefront_last_lane_step_count(liz_vm_wavefront_t const *wavefront);
+    
+    
+    
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+
+#endif /* LIZ_liz_vm_wavefront_H */
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "liz_vm_worker.h"
+
+#include "liz_assert.h"
+
+
+
+static
+size_t
+liz_vm_worker_aggregate(size_t const previous_size,
+                        size_t const additional_size)
+{
+    // Round each part up, too, as the placing arena hands out aligned sizes.
+    size_t const aligned_additional_size = liz_allocation_size_aggregate(LIZ_ARENA_ALIGNMENT,
+                                                                         additional_size,
+                                                                         LIZ_ARENA_ALIGNMENT,
+                                                                         0u);
+    
+    return liz_allocation_size_aggregate(LIZ_ARENA_ALIGNMENT,
+                                         previous_size,
+                                         LIZ_ARENA_ALIGNMENT,
+                                         aligned_additional_size);
+}
+
+
+
+size_t
+liz_vm_worker_memory_size_requirement(liz_shape_specification_t const spec,
+                                      liz_int_t const request_capacity,
+                                      size_t const scratch_size)
+{
+    LIZ_ASSERT(0 <= request_capacity);
+    
+    size_t size = liz_vm_worker_aggregate(0u, sizeof(liz_vm_worker_t));
+    size = liz_vm_worker_aggregate(size, liz_vm_memory_size_requirement(spec));
+    size = liz_vm_worker_aggregate(size, sizeof(liz_action_request_t) * (size_t)request_capacity);
+    size = liz_vm_worker_aggregate(size, scratch_size);
+    
+    return size;
+}
+
+
+
+liz_vm_worker_t*
+liz_vm_worker_create(liz_shape_specification_t const spec,
+                     liz_int_t const request_capacity,
+                     size_t const scratch_size,
+                     void * LIZ_RESTRICT allocator_context,
+                     liz_alloc_func_t alloc_func)
+{
+    if (0 > request_capacity) {
+        return NULL;
+    }
+    
+    size_t const block_size = liz_vm_worker_memory_size_requirement(spec,
+                                                                    request_capacity,
+                                                                    scratch_size);
+    void *block = alloc_func(allocator_context, block_size);
+    
+    if (NULL == block) {
+        return NULL;
+    }
+    
+    LIZ_ASSERT(0u == liz_allocation_alignment_offset(block, LIZ_ARENA_ALIGNMENT)
+               && "Alignment of allocated memory less than required.");
+    
+    // Carve the parts out of the block in the order of the size calculation.
+    liz_arena_t placement;
+    liz_arena_init(&placement, block, block_size);
+    
+    liz_vm_worker_t *worker = (liz_vm_worker_t *)liz_arena_alloc(&placement, sizeof(liz_vm_worker_t));
+    worker->vm = liz_vm_create(spec, &placement, liz_arena_alloc);
+    worker->requests = (liz_action_request_t *)liz_arena_alloc(&placement, sizeof(liz_action_request_t) * (size_t)request_capacity);
+    worker->request_capacity = request_capacity;
+    
+    // Hand the scratch arena its rounded up size so it can serve an 
+    // allocation of scratch_size bytes.
+    size_t const aligned_scratch_size = liz_vm_worker_aggregate(0u, scratch_size);
+    void *scratch = liz_arena_alloc(&placement, aligned_scratch_size);
+    liz_arena_init(&worker->scratch, scratch, aligned_scratch_size);
+    
+    LIZ_ASSERT(NULL != worker->vm && NULL != scratch);
+    
+    return worker;
+}
+
+
+
+void
+liz_vm_worker_destroy(liz_vm_worker_t *worker,
+                      void * LIZ_RESTRICT allocator_context,
+                      liz_dealloc_func_t dealloc_func)
+{
+    dealloc_func(allocator_context, worker);
+}
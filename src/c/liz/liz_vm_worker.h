@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *
+ * Per worker thread bundle of a vm, its action request output buffer, and a
+ * scratch arena placed in one memory block.
+ *
+ * Placing everything a worker touches while updating actors in one block 
+ * keeps it on few pages - allocate the block with liz_huge_page_alloc to 
+ * back it with huge pages and cut down on TLB misses.
+ *
+ * Typical usage:
+ * 1. Create one worker per job thread for the biggest shape specification.
+ * 2. Update actors with the worker's vm, extract their requests into the 
+ *    worker's request buffer, and allocate temporaries from its scratch 
+ *    arena.
+ * 3. Reset the scratch arena at the end of each frame.
+ */
+
+#ifndef LIZ_liz_vm_worker_H
+#define LIZ_liz_vm_worker_H
+
+
+#include <liz/liz_platform_types.h>
+#include <liz/liz_platform_macros.h>
+#include <liz/liz_allocator.h>
+#include <liz/liz_common.h>
+#include <liz/liz_vm.h>
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+    
+    
+    typedef struct liz_vm_worker {
+        liz_vm_t *vm;
+        liz_action_request_t *requests;
+        liz_int_t request_capacity;
+        liz_arena_t scratch;
+    } liz_vm_worker_t;
+    
+    
+    
+    /**
+     * Returns the size of the block holding a worker with a vm for spec, 
+     * request_capacity action requests, and scratch_size bytes of scratch
+     * arena. The block must be LIZ_ARENA_ALIGNMENT aligned.
+     */
+    size_t
+    liz_vm_worker_memory_size_requirement(liz_shape_specification_t spec,
+                                          liz_int_t request_capacity,
+                                          size_t scratch_size);
+    
+    
+    /**
+     * Allocates one block via alloc_func and places the worker, its vm, its
+     * request buffer, and its scratch arena in it.
+     *
+     * Returns NULL if request_capacity is negative or if memory can't be 
+     * allocated.
+     */
+    liz_vm_worker_t*
+    liz_vm_worker_create(liz_shape_specification_t spec,
+                         liz_int_t request_capacity,
+                         size_t scratch_size,
+                         void * LIZ_RESTRICT allocator_context,
+                         liz_alloc_func_t alloc_func);
+    
+    
+    void
+    liz_vm_worker_destroy(liz_vm_worker_t *worker,
+                          void * LIZ_RESTRICT allocator_context,
+                          liz_dealloc_func_t dealloc_func);
+    
+    
+    
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+
+#endif /* LIZ_liz_vm_worker_H */
@@ -0,0 +1,366 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Wide id lookup table implementation.
+ */
+
+#include "liz_wide_table.h"
+
+#include "liz_assert.h"
+#include "liz_platform_functions.h"
+
+
+
+static
+liz_wide_table_index_t*
+liz_wide_table_rooster_slot(liz_wide_table_t const *table,
+                            uint32_t const rooster_index)
+{
+    uint32_t const slot_mask = (1u << table->segment_slot_shift) - 1u;
+    
+    return table->segments[rooster_index >> table->segment_slot_shift]->rooster + (rooster_index & slot_mask);
+}
+
+
+
+static
+liz_wide_id_t*
+liz_wide_table_data_id_slot(liz_wide_table_t const *table,
+                            uint32_t const data_index)
+{
+    uint32_t const slot_mask = (1u << table->segment_slot_shift) - 1u;
+    
+    return table->segments[data_index >> table->segment_slot_shift]->data_ids + (data_index & slot_mask);
+}
+
+
+
+static
+char*
+liz_wide_table_data_slot(liz_wide_table_t const *table,
+                         uint32_t const data_index)
+{
+    uint32_t const slot_mask = (1u << table->segment_slot_shift) - 1u;
+    
+    return table->segments[data_index >> table->segment_slot_shift]->data_slots + (size_t)(data_index & slot_mask) * table->data_slot_size;
+}
+
+
+
+static
+void
+liz_wide_table_enqueue_free_index(liz_wide_table_t *table,
+                                  uint32_t const rooster_index)
+{
+    liz_wide_table_rooster_slot(table, rooster_index)->next_free_index = LIZ_WIDE_TABLE_INVALID_INDEX;
+    
+    if (LIZ_WIDE_TABLE_INVALID_INDEX == table->freelist_enqueue_index) {
+        table->freelist_dequeue_index = rooster_index;
+    } else {
+        liz_wide_table_rooster_slot(table, table->freelist_enqueue_index)->next_free_index = rooster_index;
+    }
+    
+    table->freelist_enqueue_index = rooster_index;
+}
+
+
+
+#pragma mark Create, destroy, and grow table
+
+liz_wide_table_t*
+liz_wide_table_create(liz_int_t const segment_slot_count,
+                      liz_int_t const max_segment_count,
+                      liz_int_t const data_slot_size,
+                      liz_int_t const data_slot_alignment,
+                      void * LIZ_RESTRICT allocator_context,
+                      liz_alloc_func_t alloc_func)
+{
+    if (0 >= segment_slot_count
+        || 0 != (segment_slot_count & (segment_slot_count - 1))
+        || 0 > max_segment_count
+        || (uint64_t)UINT32_MAX < (uint64_t)max_segment_count
+        || LIZ_WIDE_TABLE_CAPACITY_MAX / (uint64_t)segment_slot_count < (uint64_t)max_segment_count
+        || 0 >= data_slot_alignment
+        || 0 != (data_slot_alignment & (data_slot_alignment - 1))
+        || 0 > data_slot_size
+        || 0 != data_slot_size % data_slot_alignment) {
+        
+        return NULL;
+    }
+    
+    size_t const table_size = sizeof(liz_wide_table_t) 
+        + sizeof(liz_wide_table_segment_t *) * (size_t)max_segment_count;
+    liz_wide_table_t *table = (liz_wide_table_t *)alloc_func(allocator_context, table_size);
+    
+    if (NULL == table) {
+        return NULL;
+    }
+    
+    uint32_t segment_slot_shift = 0u;
+    while ((liz_int_t)1 << segment_slot_shift < segment_slot_count) {
+        ++segment_slot_shift;
+    }
+    
+    table->segments = (liz_wide_table_segment_t **)(table + 1);
+    table->segment_count = 0u;
+    table->segment_capacity = (uint32_t)max_segment_count;
+    table->segment_slot_shift = segment_slot_shift;
+    table->data_slot_size = (uint32_t)data_slot_size;
+    table->data_slot_alignment = (uint32_t)data_slot_alignment;
+    table->count = 0u;
+    table->freelist_dequeue_index = LIZ_WIDE_TABLE_INVALID_INDEX;
+    table->freelist_enqueue_index = LIZ_WIDE_TABLE_INVALID_INDEX;
+    
+    return table;
+}
+
+
+
+void
+liz_wide_table_destroy(liz_wide_table_t *table,
+                       void * LIZ_RESTRICT allocator_context,
+                       liz_dealloc_func_t dealloc_func)
+{
+    if (NULL != table) {
+        
+        for (uint32_t i = 0; i < table->segment_count; ++i) {
+            dealloc_func(allocator_context, table->segments[i]);
+        }
+        
+        dealloc_func(allocator_context, table);
+    }
+}
+
+
+
+bool
+liz_wide_table_reserve(liz_wide_table_t *table,
+                       liz_int_t const slot_capacity,
+                       void * LIZ_RESTRICT allocator_context,
+                       liz_alloc_func_t alloc_func)
+{
+    size_t const segment_slot_count = (size_t)1u << table->segment_slot_shift;
+    
+    if (0 > slot_capacity
+        || (uint64_t)table->segment_capacity * segment_slot_count < (uint64_t)slot_capacity) {
+        
+        return false;
+    }
+    
+    size_t const segment_alignment = sizeof(void *);
+    size_t segment_size = sizeof(liz_wide_table_segment_t);
+    segment_size = liz_allocation_size_aggregate(segment_alignment,
+                                                 segment_size,
+                                                 sizeof(liz_wide_id_t),
+                                                 sizeof(liz_wide_table_index_t) * segment_slot_count);
+    segment_size = liz_allocation_size_aggregate(segment_alignment,
+                                                 segment_size,
+                                                 sizeof(liz_wide_id_t),
+                                                 sizeof(liz_wide_id_t) * segment_slot_count);
+    segment_size = liz_allocation_size_aggregate(segment_alignment,
+                                                 segment_size,
+                                                 table->data_slot_alignment,
+                                                 (size_t)table->data_slot_size * segment_slot_count);
+    
+    while ((uint64_t)liz_wide_table_capacity(table) < (uint64_t)slot_capacity) {
+        
+        liz_wide_table_segment_t *segment = (liz_wide_table_segment_t *)alloc_func(allocator_context, segment_size);
+        
+        if (NULL == segment) {
+            return false;
+        }
+        
+        char *ptr = (char *)(segment + 1);
+        ptr += liz_allocation_alignment_offset(ptr, sizeof(liz_wide_id_t));
+        segment->rooster = (liz_wide_table_index_t *)ptr;
+        
+        ptr += sizeof(liz_wide_table_index_t) * segment_slot_count;
+        ptr += liz_allocation_alignment_offset(ptr, sizeof(liz_wide_id_t));
+        segment->data_ids = (liz_wide_id_t *)ptr;
+        
+        ptr += sizeof(liz_wide_id_t) * segment_slot_count;
+        ptr += liz_allocation_alignment_offset(ptr, table->data_slot_alignment);
+        segment->data_slots = ptr;
+        
+        uint32_t const first_rooster_index = table->segment_count << table->segment_slot_shift;
+        table->segments[table->segment_count++] = segment;
+        
+        for (uint32_t i = 0; i < (uint32_t)segment_slot_count; ++i) {
+            segment->rooster[i] = (liz_wide_table_index_t){
+                (liz_wide_id_t)(first_rooster_index + i),
+                LIZ_WIDE_TABLE_INVALID_INDEX,
+                LIZ_WIDE_TABLE_INVALID_INDEX
+            };
+            
+            liz_wide_table_enqueue_free_index(table, first_rooster_index + i);
+        }
+    }
+    
+    return true;
+}
+
+
+
+#pragma mark Access table
+
+bool
+liz_wide_table_is_full(liz_wide_table_t const *table)
+{
+    return (liz_int_t)table->count == liz_wide_table_capacity(table);
+}
+
+
+
+liz_int_t
+liz_wide_table_count(liz_wide_table_t const *table)
+{
+    return (liz_int_t)table->count;
+}
+
+
+
+liz_int_t
+liz_wide_table_capacity(liz_wide_table_t const *table)
+{
+    return (liz_int_t)table->segment_count << table->segment_slot_shift;
+}
+
+
+
+liz_wide_id_t
+liz_wide_table_add(liz_wide_table_t *table)
+{
+    LIZ_ASSERT(false == liz_wide_table_is_full(table));
+    
+    uint32_t const rooster_index = table->freelist_dequeue_index;
+    liz_wide_table_index_t *rooster_slot = liz_wide_table_rooster_slot(table, rooster_index);
+    
+    table->freelist_dequeue_index = rooster_slot->next_free_index;
+    if (LIZ_WIDE_TABLE_INVALID_INDEX == table->freelist_dequeue_index) {
+        table->freelist_enqueue_index = LIZ_WIDE_TABLE_INVALID_INDEX;
+    }
+    
+    uint32_t const data_index = table->count++;
+    rooster_slot->indirection_index = data_index;
+    *liz_wide_table_data_id_slot(table, data_index) = rooster_slot->versioned_id;
+    
+    return rooster_slot->versioned_id;
+}
+
+
+
+void
+liz_wide_table_remove(liz_wide_table_t *table,
+                      liz_wide_id_t const id)
+{
+    LIZ_ASSERT(0u != table->count);
+    LIZ_ASSERT(true == liz_wide_table_contains(table, id));
+    
+    uint32_t const rooster_index = (uint32_t)(id & LIZ_WIDE_TABLE_ID_TO_ROOSTER_INDEX_MASK);
+    liz_wide_table_index_t *rooster_slot = liz_wide_table_rooster_slot(table, rooster_index);
+    uint32_t const data_index = rooster_slot->indirection_index;
+    
+    /* Increase the versioning to invalidate the id and free the slot. */
+    rooster_slot->versioned_id += LIZ_WIDE_TABLE_ROOSTER_ID_VERSION_INCREMENT;
+    rooster_slot->indirection_index = LIZ_WIDE_TABLE_INVALID_INDEX;
+    liz_wide_table_enqueue_free_index(table, rooster_index);
+    
+    /* Move the last data slot, possibly from another segment, into the hole. */
+    uint32_t const defrag_data_index = --(table->count);
+    
+    if (defrag_data_index != data_index) {
+        liz_wide_id_t const defrag_data_id = *liz_wide_table_data_id_slot(table, defrag_data_index);
+        
+        *liz_wide_table_data_id_slot(table, data_index) = defrag_data_id;
+        liz_wide_table_rooster_slot(table, (uint32_t)(defrag_data_id & LIZ_WIDE_TABLE_ID_TO_ROOSTER_INDEX_MASK))->indirection_index = data_index;
+        
+        liz_memcpy(liz_wide_table_data_slot(table, data_index),
+                   liz_wide_table_data_slot(table, defrag_data_index),
+                   table->data_slot_size);
+    }
+}
+
+
+
+bool
+liz_wide_table_contains(liz_wide_table_t const *table,
+                        liz_wide_id_t const id)
+{
+    uint64_t const rooster_index = id & LIZ_WIDE_TABLE_ID_TO_ROOSTER_INDEX_MASK;
+    
+    if ((uint64_t)liz_wide_table_capacity(table) <= rooster_index) {
+        return false;
+    }
+    
+    liz_wide_table_index_t const *rooster_slot = liz_wide_table_rooster_slot(table, (uint32_t)rooster_index);
+    
+    return id == rooster_slot->versioned_id
+        && LIZ_WIDE_TABLE_INVALID_INDEX != rooster_slot->indirection_index;
+}
+
+
+
+void*
+liz_wide_table_lookup(liz_wide_table_t *table,
+                      liz_wide_id_t const id)
+{
+    LIZ_ASSERT(true == liz_wide_table_contains(table, id));
+    
+    uint32_t const rooster_index = (uint32_t)(id & LIZ_WIDE_TABLE_ID_TO_ROOSTER_INDEX_MASK);
+    
+    return liz_wide_table_data_slot(table, liz_wide_table_rooster_slot(table, rooster_index)->indirection_index);
+}
+
+
+
+void*
+liz_wide_table_data(liz_wide_table_t *table,
+                    liz_int_t const index)
+{
+    LIZ_ASSERT(index < liz_wide_table_count(table));
+    
+    return liz_wide_table_data_slot(table, (uint32_t)index);
+}
+
+
+
+liz_wide_id_t
+liz_wide_table_data_id(liz_wide_table_t const *table,
+                       liz_int_t const index)
+{
+    LIZ_ASSERT(index < liz_wide_table_count(table));
+    
+    return *liz_wide_table_data_id_slot(table, (uint32_t)index);
+}
@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Wide id variant of liz_table for more than LIZ_TABLE_CAPACITY_MAX data 
+ * slots - ids are 64 bits wide and storage grows segment by segment.
+ *
+ * A liz_wide_id_t splits into LIZ_WIDE_TABLE_INDEX_BIT_COUNT low bits of 
+ * rooster index and the remaining high bits of version. Define 
+ * LIZ_WIDE_TABLE_INDEX_BIT_COUNT for the whole build to change the split.
+ *
+ * Rooster slots, data ids, and data slots live in fixed size segments of a 
+ * power of two slot count. Indices map to their segment by a shift and to 
+ * the slot inside the segment by a mask, so lookups stay O(1). Growing adds
+ * segments to a directory allocated on creation - existing segments are 
+ * never moved or rehashed, alas data slot pointers stay valid while growing.
+ *
+ * Like liz_table, data is kept tightly packed across segments by moving the
+ * last data slot into a removed one.
+ *
+ * See liz_table.h for the 16 bit id original.
+ */
+
+#ifndef LIZ_liz_wide_table_H
+#define LIZ_liz_wide_table_H
+
+
+#include <liz/liz_platform_types.h>
+#include <liz/liz_allocator.h>
+#include <liz/liz_common.h>
+
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+    
+    
+    
+#if !defined(LIZ_WIDE_TABLE_INDEX_BIT_COUNT)
+#   define LIZ_WIDE_TABLE_INDEX_BIT_COUNT 32
+#endif
+    
+#if LIZ_WIDE_TABLE_INDEX_BIT_COUNT < 16 || LIZ_WIDE_TABLE_INDEX_BIT_COUNT > 32
+#   error LIZ_WIDE_TABLE_INDEX_BIT_COUNT must be in the range 16 to 32.
+#endif
+    
+#define LIZ_WIDE_TABLE_ID_TO_ROOSTER_INDEX_MASK ((UINT64_C(1) << LIZ_WIDE_TABLE_INDEX_BIT_COUNT) - UINT64_C(1))
+#define LIZ_WIDE_TABLE_ROOSTER_ID_VERSION_INCREMENT (UINT64_C(1) << LIZ_WIDE_TABLE_INDEX_BIT_COUNT)
+    
+    /* Marks free rooster slots and the end of the freelist. The highest index
+     * is never used for data.
+     */
+#define LIZ_WIDE_TABLE_INVALID_INDEX UINT32_MAX
+#define LIZ_WIDE_TABLE_CAPACITY_MAX ((uint64_t)LIZ_WIDE_TABLE_ID_TO_ROOSTER_INDEX_MASK)
+    
+    
+    
+    typedef uint64_t liz_wide_id_t;
+    
+    
+    
+    /**
+     * Rooster slot - indirection_index points to the data slot or is 
+     * LIZ_WIDE_TABLE_INVALID_INDEX if the slot is on the FIFO freelist.
+     */
+    typedef struct liz_wide_table_index {
+        liz_wide_id_t versioned_id;
+        uint32_t indirection_index;
+        uint32_t next_free_index;
+    } liz_wide_table_index_t;
+    
+    
+    
+    /**
+     * Segment header, its rooster slots, data ids, and data slots follow in
+     * the same allocation.
+     */
+    typedef struct liz_wide_table_segment {
+        liz_wide_table_index_t *rooster;
+        liz_wide_id_t *data_ids;
+        char *data_slots;
+    } liz_wide_table_segment_t;
+    
+    
+    
+    /**
+     * Treat as opaque, only access via the liz_wide_table functions.
+     */
+    typedef struct liz_wide_table {
+        liz_wide_table_segment_t **segments;
+        
+        uint32_t segment_count;
+        uint32_t segment_capacity;
+        uint32_t segment_slot_shift;
+        uint32_t data_slot_size;
+        uint32_t data_slot_alignment;
+        
+        uint32_t count;
+        
+        /* FIFO queue of unused rooster slots to keep version wear off 
+         * minimal.
+         */
+        uint32_t freelist_dequeue_index;
+        uint32_t freelist_enqueue_index;
+    } liz_wide_table_t;
+    
+    
+    
+    /**
+     * Creates a table without data slots which can grow up to 
+     * max_segment_count segments of segment_slot_count data slots each.
+     *
+     * Returns NULL if segment_slot_count isn't a power of two, if the maximal
+     * capacity exceeds LIZ_WIDE_TABLE_CAPACITY_MAX, if data_slot_size isn't a
+     * multiple of the power of two data_slot_alignment, or if memory can't be
+     * allocated.
+     */
+    liz_wide_table_t*
+    liz_wide_table_create(liz_int_t segment_slot_count,
+                          liz_int_t max_segment_count,
+                          liz_int_t data_slot_size,
+                          liz_int_t data_slot_alignment,
+                          void * LIZ_RESTRICT allocator_context,
+                          liz_alloc_func_t alloc_func);
+    
+    
+    /**
+     * Deallocates table and all its segments without calling any 
+     * finalization on the data.
+     *
+     * Accepts NULL as a value for table.
+     */
+    void
+    liz_wide_table_destroy(liz_wide_table_t *table,
+                           void * LIZ_RESTRICT allocator_context,
+                           liz_dealloc_func_t dealloc_func);
+    
+    
+    /**
+     * Adds segments until table can hold at least slot_capacity data slots.
+     * Existing data isn't moved.
+     *
+     * Returns false if slot_capacity exceeds the maximal capacity or if 
+     * memory can't be allocated - segments added before stay.
+     */
+    bool
+    liz_wide_table_reserve(liz_wide_table_t *table,
+                           liz_int_t slot_capacity,
+                           void * LIZ_RESTRICT allocator_context,
+                           liz_alloc_func_t alloc_func);
+    
+    
+    bool
+    liz_wide_table_is_full(liz_wide_table_t const *table);
+    
+    
+    liz_int_t
+    liz_wide_table_count(liz_wide_table_t const *table);
+    
+    
+    /**
+     * Returns the number of data slots of the currently allocated segments.
+     */
+    liz_int_t
+    liz_wide_table_capacity(liz_wide_table_t const *table);
+    
+    
+    /**
+     * Registers a data slot on table and returns its id.
+     *
+     * @attention Don't call when table is full, reserve first.
+     */
+    liz_wide_id_t
+    liz_wide_table_add(liz_wide_table_t *table);
+    
+    
+    /**
+     * Unregisters the data slot of id and moves the last data slot into it
+     * to keep data packed tightly.
+     *
+     * @attention Only call with contained ids.
+     */
+    void
+    liz_wide_table_remove(liz_wide_table_t *table,
+                          liz_wide_id_t id);
+    
+    
+    bool
+    liz_wide_table_contains(liz_wide_table_t const *table,
+                            liz_wide_id_t id);
+    
+    
+    /**
+     * Returns a pointer to the data slot of id. The pointer becomes invalid 
+     * on removal but not on adding or growing.
+     *
+     * @attention Only call with contained ids.
+     */
+    void*
+    liz_wide_table_lookup(liz_wide_table_t *table,
+                          liz_wide_id_t id);
+    
+    
+    /**
+     * Returns a pointer to the indexed data slot. Data is packed tightly in
+     * each segment, index must be less than liz_wide_table_count.
+     */
+    void*
+    liz_wide_table_data(liz_wide_table_t *table,
+                        liz_int_t index);
+    
+    
+    /**
+     * Companion function for liz_wide_table_data.
+     */
+    liz_wide_id_t
+    liz_wide_table_data_id(liz_wide_table_t const *table,
+                           liz_int_t index);
+    
+    
+    
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+
+#endif /* LIZ_liz_wide_table_H */
@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Checks creation of actor clips and access to their actors and streams.
+ */
+
+#include <unittestpp.h>
+
+#include <liz/liz_common.h>
+#include <liz/liz_common_internal.h>
+#include <liz/liz_vm.h>
+#include <liz/liz_actor_clip.h>
+
+#include "liz_test_helpers.h"
+
+
+
+SUITE(liz_actor_clip_test)
+{
+    namespace {
+        
+        liz_shape_specification_t const clip_test_spec = {
+            5, // shape_atom_count
+            1, // immediate_action_function_count
+            2, // persistent_state_count
+            3, // decider_state_capacity
+            4, // action_state_capacity
+            2, // persistent_state_change_capacity
+            3, // decider_guard_capacity
+            4, // action_request_capacity
+            0, // subtree_call_count
+            5  // shape_atom_index_count
+        };
+        
+    } // anonymous namespace
+    
+    
+    
+    TEST(create_and_destroy)
+    {
+        counting_allocator allocator;
+        
+        liz_actor_clip_t *clip = liz_actor_clip_create(clip_test_spec,
+                                                       16,
+                                                       7, // clip_id
+                                                       3, // shape_id
+                                                       &allocator,
+                                                       counting_alloc);
+        CHECK(NULL != clip);
+        CHECK_EQUAL(16u, clip->header.capacity);
+        CHECK_EQUAL(0u, clip->header.count);
+        CHECK_EQUAL(7u, clip->header.clip_id);
+        CHECK_EQUAL(3u, clip->header.shape_id);
+        CHECK_EQUAL(clip_test_spec, clip->spec);
+        
+        liz_actor_clip_destroy(clip, &allocator, counting_dealloc);
+        
+        CHECK(allocator.is_balanced());
+    }
+    
+    
+    
+    TEST(create_with_negative_capacity)
+    {
+        counting_allocator allocator;
+        
+        CHECK(NULL == liz_actor_clip_create(clip_test_spec,
+                                            -1,
+                                            0,
+                                            0,
+                                            &allocator,
+                                            counting_alloc));
+        CHECK(allocator.is_balanced());
+    }
+    
+    
+    
+    TEST(streams_are_aligned_and_inside_of_clip_memory)
+    {
+        counting_allocator allocator;
+        liz_int_t const capacity = 3;
+        
+        liz_actor_clip_t *clip = liz_actor_clip_create(clip_test_spec,
+                                                       capacity,
+                                                       0,
+                                                       0,
+                                                       &allocator,
+                                                       counting_alloc);
+        
+        char const *clip_begin = reinterpret_cast<char const*>(clip);
+        char const *clip_end = clip_begin + liz_actor_clip_memory_size_requirement(clip_test_spec, capacity);
+        
+        size_t actor_size = 0;
+        
+        for (liz_int_t i = 0; i < liz_actor_clip_stream_count; ++i) {
+            liz_actor_clip_stream_t const stream = static_cast<liz_actor_clip_stream_t>(i);
+            char const *stream_begin = static_cast<char const*>(liz_actor_clip_stream_data(clip, stream));
+            size_t const slot_size = liz_actor_clip_stream_slot_size(clip_test_spec, stream);
+            
+            CHECK_EQUAL(0u, reinterpret_cast<uintptr_t>(stream_begin) % LIZ_ACTOR_CLIP_ALIGNMENT);
+            CHECK(clip_begin + sizeof(liz_actor_clip_t) <= stream_begin);
+            CHECK(stream_begin + slot_size * capacity <= clip_end);
+            
+            actor_size += slot_size;
+        }
+        
+        CHECK_EQUAL(actor_size, clip->header.actor_size);
+        
+        liz_actor_clip_destroy(clip, &allocator, counting_dealloc);
+    }
+    
+    
+    
+    TEST(streams_are_aligned_to_requested_stream_alignment)
+    {
+        liz_int_t const capacity = 3;
+        size_t const stream_alignment = 64;
+        
+        liz_actor_clip_t *clip = liz_actor_clip_create_aligned(clip_test_spec,
+                                                               capacity,
+                                                               0,
+                                                               0,
+                                                               stream_alignment,
+                                                               NULL,
+                                                               liz_default_aligned_alloc);
+        CHECK(NULL != clip);
+        
+        char const *clip_begin = reinterpret_cast<char const*>(clip);
+        char const *clip_end = clip_begin + liz_actor_clip_memory_size_requirement_aligned(clip_test_spec, 
+                                                                                          capacity,
+                                                                                          stream_alignment);
+        
+        CHECK_EQUAL(0u, reinterpret_cast<uintptr_t>(clip) % stream_alignment);
+        
+        for (liz_int_t i = 0; i < liz_actor_clip_stream_count; ++i) {
+            liz_actor_clip_stream_t const stream = static_cast<liz_actor_clip_stream_t>(i);
+            char const *stream_begin = static_cast<char const*>(liz_actor_clip_stream_data(clip, stream));
+            size_t const slot_size = liz_actor_clip_stream_slot_size(clip_test_spec, stream);
+            
+            CHECK_EQUAL(0u, reinterpret_cast<uintptr_t>(stream_begin) % stream_alignment);
+            CHECK(stream_begin + slot_size * capacity <= clip_end);
+        }
+        
+        CHECK(0 <= liz_actor_clip_add_actor(clip, 1, 0, 0));
+        
+        liz_actor_clip_destroy(clip, NULL, liz_default_aligned_dealloc);
+    }
+    
+    
+    
+    TEST(add_actors_and_access_their_slots)
+    {
+        counting_allocator allocator;
+        
+        liz_actor_clip_t *clip = liz_actor_clip_create(clip_test_spec,
+                                                       4,
+                                                       0,
+                                                       0,
+                                                       &allocator,
+                                                       counting_alloc);
+        
+        CHECK_EQUAL(0, liz_actor_clip_add_actor(clip, 11, 111, 1111));
+        CHECK_EQUAL(1, liz_actor_clip_add_actor(clip, 22, 222, 2222));
+        CHECK_EQUAL(2u, clip->header.count);
+        
+        liz_vm_actor_t const actor0 = liz_actor_clip_actor(clip, 0);
+        liz_vm_actor_t const actor1 = liz_actor_clip_actor(clip, 1);
+        
+        CHECK_EQUAL(11u, actor0.header->actor_id);
+        CHECK_EQUAL(111u, actor0.header->user_data);
+        CHECK_EQUAL(1111, actor0.header->random_number_seed);
+        CHECK_EQUAL(0, actor0.header->decider_state_count);
+        CHECK_EQUAL(0, actor0.header->action_state_count);
+        CHECK_EQUAL(22u, actor1.header->actor_id);
+        
+        // Slots of consecutive actors are packed per stream.
+        CHECK(actor0.persistent_states + clip_test_spec.persistent_state_count == actor1.persistent_states);
+        CHECK(actor0.decider_states + clip_test_spec.decider_state_capacity == actor1.decider_states);
+        CHECK(actor0.decider_state_shape_atom_indices + clip_test_spec.decider_state_capacity == actor1.decider_state_shape_atom_indices);
+        CHECK(actor0.action_states + clip_test_spec.action_state_capacity == actor1.action_states);
+        CHECK(actor0.action_state_shape_atom_indices + clip_test_spec.action_state_capacity == actor1.action_state_shape_atom_indices);
+        
+        liz_actor_clip_clear(clip);
+        CHECK_EQUAL(0u, clip->header.count);
+        
+        liz_actor_clip_destroy(clip, &allocator, counting_dealloc);
+    }
+    
+    
+    
+    TEST_FIXTURE(liz_vm_test_fixture, update_clip_actor)
+    {
+        push_shape_concurrent_decider(4);
+        push_shape_persistent_action();
+        push_shape_immediate_action(immediate_action_func_index_running2);
+        push_shape_deferred_action(42, 7);
+        
+        create_expected_result_and_proband_vms_for_shape();
+        
+        liz_actor_clip_t *clip = liz_actor_clip_create(shape.spec,
+                                                       2,
+                                                       0,
+                                                       0,
+                                                       &allocator,
+                                                       counting_alloc);
+        liz_actor_clip_add_actor(clip, 0, 0, 0);
+        liz_actor_clip_add_actor(clip, 1, reinterpret_cast<uintptr_t>(proband_blackboard), 0);
+        
+        liz_vm_actor_t clip_actor = liz_actor_clip_actor(clip, 1);
+        
+        set_actor_persistent_state(target_select_expected_result,
+                                   0, // persistent state index
+                                   1, // shape_atom_index
+                                   liz_execution_state_running);
+        clip_actor.persistent_states[0] = expected_result_actor.persistent_states[0];
+        
+        liz_vm_update_actor(expected_result_vm,
+                            NULL,
+                            NULL,
+                            identity_user_data_lookup_func,
+                            0.0,
+                            &expected_result_actor,
+                            &shape);
+        liz_vm_update_actor(proband_vm,
+                            NULL,
+                            NULL,
+                            identity_user_data_lookup_func,
+                            0.0,
+                            &clip_actor,
+                            &shape);
+        
+        CHECK_EQUAL(expected_result_vm_extractable_state_comparator, 
+                    proband_vm_extractable_state_comparator);
+        
+        liz_vm_extract_actor_state(expected_result_vm, &expected_result_actor, &shape);
+        liz_vm_extract_actor_state(proband_vm, &clip_actor, &shape);
+        
+        CHECK(0 != clip_actor.header->action_state_count);
+        CHECK_EQUAL(expected_result_actor.header->action_state_count, clip_actor.header->action_state_count);
+        CHECK_ARRAY_EQUAL(expected_result_actor.action_states, 
+                          clip_actor.action_states, 
+                          clip_actor.header->action_state_count);
+        CHECK_EQUAL(0, liz_actor_clip_actor(clip, 0).header->action_state_count);
+        
+        liz_actor_clip_destroy(clip, &allocator, counting_dealloc);
+    }
+    
+} // SUITE(liz_actor_clip_test)
+
@@ -0,0 +1,440 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Checks writing and restoring full and delta compressed actor snapshots.
+ */
+
+#include <unittestpp.h>
+
+#include <cstring>
+#include <vector>
+
+#include <liz/liz_common.h>
+#include <liz/liz_common_internal.h>
+#include <liz/liz_actor_clip.h>
+#include <liz/liz_actor_snapshot.h>
+
+#include "liz_test_helpers.h"
+
+
+
+SUITE(liz_actor_snapshot_test)
+{
+    namespace {
+        
+        liz_shape_specification_t const snapshot_test_spec = {
+            16, // shape_atom_count
+            1, // immediate_action_function_count
+            3, // persistent_state_count
+            4, // decider_state_capacity
+            5, // action_state_capacity
+            3, // persistent_state_change_capacity
+            4, // decider_guard_capacity
+            5, // action_request_capacity
+            0, // subtree_call_count
+            16 // shape_atom_index_count
+        };
+        
+        
+        liz_int_t const snapshot_test_clip_capacity = 32;
+        
+        
+        
+        class memory_stream {
+        public:
+            
+            memory_stream()
+            :   bytes()
+            ,   read_index(0)
+            ,   write_capacity(~std::size_t(0))
+            {
+                
+            }
+            
+            std::vector<unsigned char> bytes;
+            std::size_t read_index;
+            std::size_t write_capacity;
+        };
+        
+        
+        bool
+        memory_stream_write(void *context,
+                            void const *data,
+                            size_t byte_count)
+        {
+            memory_stream *stream = static_cast<memory_stream*>(context);
+            
+            if (stream->write_capacity - stream->bytes.size() < byte_count) {
+                return false;
+            }
+            
+            unsigned char const *data_bytes = static_cast<unsigned char const*>(data);
+            stream->bytes.insert(stream->bytes.end(), data_bytes, data_bytes + byte_count);
+            
+            return true;
+        }
+        
+        
+        bool
+        memory_stream_read(void *context,
+                           void *data,
+                           size_t byte_count)
+        {
+            memory_stream *stream = static_cast<memory_stream*>(context);
+            
+            if (stream->bytes.size() - stream->read_index < byte_count) {
+                return false;
+            }
+            
+            std::memcpy(data, &stream->bytes[stream->read_index], byte_count);
+            stream->read_index += byte_count;
+            
+            return true;
+        }
+        
+        
+        
+        class snapshot_fixture {
+        public:
+            
+            snapshot_fixture()
+            :   allocator()
+            ,   clip(create_clip(1))
+            ,   restored_clip(create_clip(2))
+            ,   reference_clip(create_clip(3))
+            ,   scratch(liz_actor_snapshot_scratch_size_requirement(snapshot_test_spec,
+                                                                    snapshot_test_clip_capacity))
+            ,   stream()
+            {
+                
+            }
+            
+            
+            ~snapshot_fixture()
+            {
+                liz_actor_clip_destroy(reference_clip, &allocator, counting_dealloc);
+                liz_actor_clip_destroy(restored_clip, &allocator, counting_dealloc);
+                liz_actor_clip_destroy(clip, &allocator, counting_dealloc);
+            }
+            
+            
+            liz_actor_clip_t* create_clip(liz_id_t const clip_id)
+            {
+                return liz_actor_clip_create(snapshot_test_spec,
+                                             snapshot_test_clip_capacity,
+                                             clip_id,
+                                             42, // shape_id
+                                             &allocator,
+                                             counting_alloc);
+            }
+            
+            
+            // Fills actor_count actors with states derived from seed.
+            static void fill_clip(liz_actor_clip_t *target,
+                                  liz_int_t const actor_count,
+                                  uint16_t const seed)
+            {
+                liz_actor_clip_clear(target);
+                
+                for (liz_int_t i = 0; i < actor_count; ++i) {
+                    liz_actor_clip_add_actor(target, 
+                                             static_cast<liz_id_t>(i), 
+                                             static_cast<uint64_t>(i) * 3u, 
+                                             i);
+                    set_actor_states(target, i, seed);
+                }
+            }
+            
+            
+            static void set_actor_states(liz_actor_clip_t *target,
+                                         liz_int_t const index,
+                                         uint16_t const seed)
+            {
+                liz_vm_actor_t const actor = liz_actor_clip_actor(target, index);
+                uint16_t const value = static_cast<uint16_t>(seed + index);
+                
+                actor.header->decider_state_count = 2;
+                actor.header->action_state_count = 3;
+                
+                for (liz_int_t i = 0; i < snapshot_test_spec.decider_state_capacity; ++i) {
+                    actor.decider_state_shape_atom_indices[i] = static_cast<liz_index_t>(i);
+                    actor.decider_states[i] = value;
+                }
+                
+                for (liz_int_t i = 0; i < snapshot_test_spec.action_state_capacity; ++i) {
+                    actor.action_state_shape_atom_indices[i] = static_cast<liz_index_t>(i + 5);
+                    actor.action_states[i] = static_cast<uint8_t>(value);
+                }
+                
+                for (liz_int_t i = 0; i < snapshot_test_spec.persistent_state_count; ++i) {
+                    actor.persistent_states[i].persistent_action.state = static_cast<uint8_t>((value + i) % 4);
+                }
+            }
+            
+            
+            static bool clip_streams_are_equal(liz_actor_clip_t const *lhs,
+                                               liz_actor_clip_t const *rhs)
+            {
+                if (lhs->header.count != rhs->header.count) {
+                    return false;
+                }
+                
+                for (liz_int_t i = 0; i < liz_actor_clip_stream_count; ++i) {
+                    liz_actor_clip_stream_t const clip_stream = static_cast<liz_actor_clip_stream_t>(i);
+                    size_t const byte_count = liz_actor_clip_stream_slot_size(lhs->spec, clip_stream) * lhs->header.count;
+                    
+                    if (0 != std::memcmp(liz_actor_clip_stream_data(lhs, clip_stream),
+                                         liz_actor_clip_stream_data(rhs, clip_stream),
+                                         byte_count)) {
+                        return false;
+                    }
+                }
+                
+                return true;
+            }
+            
+            
+            bool write(liz_actor_clip_t const *reference)
+            {
+                return liz_actor_snapshot_write(clip,
+                                                reference,
+                                                &scratch[0],
+                                                scratch.size(),
+                                                memory_stream_write,
+                                                &stream);
+            }
+            
+            
+            bool restore(liz_actor_clip_t *target,
+                         liz_actor_clip_t const *reference)
+            {
+                liz_actor_snapshot_header_t header;
+                
+                return liz_actor_snapshot_read_header(&header, memory_stream_read, &stream)
+                    && liz_actor_snapshot_restore(&header,
+                                                  target,
+                                                  reference,
+                                                  &scratch[0],
+                                                  scratch.size(),
+                                                  memory_stream_read,
+                                                  &stream);
+            }
+            
+            
+            counting_allocator allocator;
+            
+            liz_actor_clip_t *clip;
+            liz_actor_clip_t *restored_clip;
+            liz_actor_clip_t *reference_clip;
+            
+            std::vector<unsigned char> scratch;
+            memory_stream stream;
+            
+        private:
+            snapshot_fixture(snapshot_fixture const&); // = 0
+            snapshot_fixture& operator=(snapshot_fixture const&); // = 0
+        };
+        
+    } // anonymous namespace
+    
+    
+    
+    TEST_FIXTURE(snapshot_fixture, full_snapshot_round_trip)
+    {
+        fill_clip(clip, 20, 7);
+        clip->header.user_data = 1234;
+        
+        CHECK(write(NULL));
+        CHECK(restore(restored_clip, NULL));
+        
+        CHECK_EQUAL(stream.bytes.size(), stream.read_index);
+        CHECK(clip_streams_are_equal(clip, restored_clip));
+        CHECK_EQUAL(1234u, restored_clip->header.user_data);
+        CHECK_EQUAL(1u, restored_clip->header.clip_id);
+        CHECK_EQUAL(static_cast<uint32_t>(snapshot_test_clip_capacity), restored_clip->header.capacity);
+    }
+    
+    
+    
+    TEST_FIXTURE(snapshot_fixture, empty_clip_round_trip)
+    {
+        fill_clip(restored_clip, 3, 1);
+        
+        CHECK(write(NULL));
+        CHECK(restore(restored_clip, NULL));
+        
+        CHECK_EQUAL(0u, restored_clip->header.count);
+    }
+    
+    
+    
+    TEST_FIXTURE(snapshot_fixture, delta_snapshot_is_smaller_than_full_snapshot)
+    {
+        fill_clip(reference_clip, 20, 7);
+        fill_clip(clip, 20, 7);
+        set_actor_states(clip, 13, 99);
+        
+        CHECK(write(NULL));
+        std::size_t const full_size = stream.bytes.size();
+        stream.bytes.clear();
+        
+        CHECK(write(reference_clip));
+        
+        CHECK(stream.bytes.size() < full_size / 2);
+    }
+    
+    
+    
+    TEST_FIXTURE(snapshot_fixture, delta_snapshot_restore_with_separate_reference)
+    {
+        fill_clip(reference_clip, 20, 7);
+        fill_clip(clip, 20, 7);
+        set_actor_states(clip, 0, 99);
+        set_actor_states(clip, 13, 99);
+        set_actor_states(clip, 19, 99);
+        
+        CHECK(write(reference_clip));
+        CHECK(restore(restored_clip, reference_clip));
+        
+        CHECK(clip_streams_are_equal(clip, restored_clip));
+    }
+    
+    
+    
+    TEST_FIXTURE(snapshot_fixture, delta_snapshot_restore_in_place)
+    {
+        fill_clip(reference_clip, 20, 7);
+        fill_clip(restored_clip, 20, 7);
+        fill_clip(clip, 20, 8);
+        set_actor_states(clip, 5, 7);
+        
+        CHECK(write(reference_clip));
+        CHECK(restore(restored_clip, restored_clip));
+        
+        CHECK(clip_streams_are_equal(clip, restored_clip));
+    }
+    
+    
+    
+    TEST_FIXTURE(snapshot_fixture, delta_snapshot_with_changed_actor_counts)
+    {
+        fill_clip(reference_clip, 10, 7);
+        fill_clip(clip, 25, 7);
+        
+        CHECK(write(reference_clip));
+        CHECK(restore(restored_clip, reference_clip));
+        CHECK(clip_streams_are_equal(clip, restored_clip));
+        
+        fill_clip(reference_clip, 25, 7);
+        fill_clip(clip, 10, 7);
+        stream = memory_stream();
+        
+        CHECK(write(reference_clip));
+        CHECK(restore(restored_clip, reference_clip));
+        CHECK(clip_streams_are_equal(clip, restored_clip));
+    }
+    
+    
+    
+    TEST_FIXTURE(snapshot_fixture, reject_delta_snapshot_without_matching_reference)
+    {
+        fill_clip(reference_clip, 10, 7);
+        fill_clip(clip, 10, 8);
+        
+        CHECK(write(reference_clip));
+        CHECK(!restore(restored_clip, NULL));
+        
+        stream.read_index = 0;
+        liz_actor_clip_add_actor(reference_clip, 10, 0, 0);
+        CHECK(!restore(restored_clip, reference_clip));
+    }
+    
+    
+    
+    TEST_FIXTURE(snapshot_fixture, reject_clip_with_different_stream_layout_or_too_small_capacity)
+    {
+        fill_clip(clip, 20, 7);
+        CHECK(write(NULL));
+        
+        liz_shape_specification_t other_spec = snapshot_test_spec;
+        other_spec.action_state_capacity += 1;
+        liz_actor_clip_t *other_clip = liz_actor_clip_create(other_spec, 
+                                                             snapshot_test_clip_capacity,
+                                                             0,
+                                                             0,
+                                                             &allocator,
+                                                             counting_alloc);
+        CHECK(!restore(other_clip, NULL));
+        liz_actor_clip_destroy(other_clip, &allocator, counting_dealloc);
+        
+        stream.read_index = 0;
+        liz_actor_clip_t *small_clip = liz_actor_clip_create(snapshot_test_spec, 
+                                                             19,
+                                                             0,
+                                                             0,
+                                                             &allocator,
+                                                             counting_alloc);
+        CHECK(!restore(small_clip, NULL));
+        liz_actor_clip_destroy(small_clip, &allocator, counting_dealloc);
+    }
+    
+    
+    
+    TEST_FIXTURE(snapshot_fixture, reject_invalid_header_and_truncated_snapshot)
+    {
+        fill_clip(clip, 20, 7);
+        CHECK(write(NULL));
+        
+        stream.bytes[0] ^= 0xFFu;
+        CHECK(!restore(restored_clip, NULL));
+        stream.bytes[0] ^= 0xFFu;
+        
+        stream.read_index = 0;
+        stream.bytes.pop_back();
+        CHECK(!restore(restored_clip, NULL));
+    }
+    
+    
+    
+    TEST_FIXTURE(snapshot_fixture, report_failing_write)
+    {
+        fill_clip(clip, 20, 7);
+        stream.write_capacity = sizeof(liz_actor_snapshot_header_t) + 1;
+        
+        CHECK(!write(NULL));
+    }
+    
+} // SUITE(liz_actor_snapshot_test)
+
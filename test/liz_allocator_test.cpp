@@ -649,4 +649,167 @@ SUITE(liz_allocator_test)
         CHECK_EQUAL(expected_offset, result);
     }
     
+    
+    
+    TEST(arena_allocates_aligned_and_resets)
+    {
+        char memory[128 + LIZ_ARENA_ALIGNMENT];
+        liz_arena_t arena;
+        liz_arena_init(&arena, memory + 1, sizeof(memory) - 1);
+        
+        char *first = static_cast<char *>(liz_arena_alloc(&arena, 3));
+        char *second = static_cast<char *>(liz_arena_alloc(&arena, 17));
+        
+        CHECK(NULL != first);
+        CHECK_EQUAL(0u, liz_allocation_alignment_offset(first, LIZ_ARENA_ALIGNMENT));
+        CHECK_EQUAL(0u, liz_allocation_alignment_offset(second, LIZ_ARENA_ALIGNMENT));
+        CHECK_EQUAL(first + LIZ_ARENA_ALIGNMENT, second);
+        
+        CHECK(NULL == liz_arena_alloc(&arena, 128));
+        
+        liz_arena_dealloc(&arena, second);
+        liz_arena_reset(&arena);
+        
+        CHECK_EQUAL(first, liz_arena_alloc(&arena, 128 - LIZ_ARENA_ALIGNMENT));
+    }
+    
+    
+    
+    TEST(arena_tracks_used_size_and_high_water_mark)
+    {
+        char memory[128 + LIZ_ARENA_ALIGNMENT];
+        liz_arena_t arena;
+        liz_arena_init(&arena, memory + 1, sizeof(memory) - 1);
+        
+        CHECK_EQUAL(0u, liz_arena_used_size(&arena));
+        CHECK_EQUAL(0u, liz_arena_high_water_size(&arena));
+        
+        liz_arena_alloc(&arena, 3);
+        liz_arena_alloc(&arena, 40);
+        
+        CHECK_EQUAL(4u * LIZ_ARENA_ALIGNMENT, liz_arena_used_size(&arena));
+        
+        liz_arena_reset(&arena);
+        liz_arena_alloc(&arena, 1);
+        
+        CHECK_EQUAL(LIZ_ARENA_ALIGNMENT, liz_arena_used_size(&arena));
+        CHECK_EQUAL(4u * LIZ_ARENA_ALIGNMENT, liz_arena_high_water_size(&arena));
+    }
+    
+    
+    
+    TEST(arena_allocates_aligned_to_requested_alignment)
+    {
+        char memory[4 * LIZ_CACHE_LINE_SIZE];
+        liz_arena_t arena;
+        liz_arena_init(&arena, memory + 1, sizeof(memory) - 1);
+        
+        char *first = static_cast<char *>(liz_arena_alloc(&arena, 3));
+        char *second = static_cast<char *>(liz_arena_aligned_alloc(&arena, 5, LIZ_CACHE_LINE_SIZE));
+        char *third = static_cast<char *>(liz_arena_aligned_alloc(&arena, 5, 4));
+        
+        CHECK(NULL != second);
+        CHECK(first < second);
+        CHECK_EQUAL(0u, liz_allocation_alignment_offset(second, LIZ_CACHE_LINE_SIZE));
+        CHECK_EQUAL(second + LIZ_ARENA_ALIGNMENT, third);
+        
+        size_t const offset = arena.offset;
+        CHECK(NULL == liz_arena_aligned_alloc(&arena, 3 * LIZ_CACHE_LINE_SIZE, LIZ_CACHE_LINE_SIZE));
+        CHECK_EQUAL(offset, arena.offset);
+    }
+    
+    
+    
+    TEST(default_aligned_alloc_and_dealloc)
+    {
+        size_t const alignments[] = {1, 8, 32, LIZ_CACHE_LINE_SIZE, 4096};
+        
+        for (std::size_t i = 0; i < sizeof(alignments) / sizeof(alignments[0]); ++i) {
+            char *block = static_cast<char *>(liz_default_aligned_alloc(NULL, 33, alignments[i]));
+            
+            CHECK(NULL != block);
+            CHECK_EQUAL(0u, liz_allocation_alignment_offset(block, alignments[i]));
+            
+            block[0] = 1;
+            block[32] = 2;
+            
+            liz_default_aligned_dealloc(NULL, block);
+        }
+        
+        liz_default_aligned_dealloc(NULL, NULL);
+    }
+    
+    
+    
+    TEST(pool_allocates_fixed_size_blocks)
+    {
+        char memory[4 * 32 + LIZ_ARENA_ALIGNMENT];
+        liz_pool_t pool;
+        liz_pool_init(&pool, memory, sizeof(memory), 20);
+        
+        CHECK_EQUAL(32u, pool.block_size);
+        CHECK(4u <= pool.block_count);
+        
+        void *blocks[4];
+        for (int i = 0; i < 4; ++i) {
+            blocks[i] = liz_pool_alloc(&pool, 20);
+            CHECK(NULL != blocks[i]);
+            CHECK_EQUAL(0u, liz_allocation_alignment_offset(blocks[i], LIZ_ARENA_ALIGNMENT));
+        }
+        
+        CHECK(NULL == liz_pool_alloc(&pool, 33));
+        
+        liz_pool_dealloc(&pool, blocks[2]);
+        liz_pool_dealloc(&pool, NULL);
+        
+        while (1u < pool.free_block_count) {
+            liz_pool_alloc(&pool, 1);
+        }
+        
+        CHECK_EQUAL(blocks[2], liz_pool_alloc(&pool, 1));
+        CHECK(NULL == liz_pool_alloc(&pool, 1));
+    }
+    
+    
+    
+    TEST(thread_arena_allocates_from_the_thread_arena)
+    {
+        CHECK(NULL == liz_thread_arena_alloc(NULL, 4));
+        
+        char memory[64];
+        liz_arena_t arena;
+        liz_arena_init(&arena, memory, sizeof(memory));
+        
+        CHECK(NULL == liz_thread_arena_set(&arena));
+        
+        void *ptr = liz_thread_arena_alloc(NULL, 4);
+        CHECK(NULL != ptr);
+        CHECK(static_cast<char *>(ptr) >= memory && static_cast<char *>(ptr) < memory + sizeof(memory));
+        
+        liz_thread_arena_dealloc(NULL, ptr);
+        
+        CHECK_EQUAL(&arena, liz_thread_arena_set(NULL));
+    }
+    
+    
+    
+    TEST(huge_page_alloc_and_dealloc)
+    {
+        size_t const sizes[] = {1, 4096, 3 * 1024 * 1024};
+        
+        for (std::size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+            char *block = static_cast<char *>(liz_huge_page_alloc(NULL, sizes[i]));
+            
+            CHECK(NULL != block);
+            CHECK_EQUAL(0u, liz_allocation_alignment_offset(block, LIZ_ARENA_ALIGNMENT));
+            
+            block[0] = 1;
+            block[sizes[i] - 1] = 2;
+            
+            liz_huge_page_dealloc(NULL, block);
+        }
+        
+        liz_huge_page_dealloc(NULL, NULL);
+    }
+    
 } // SUITE(liz_allocator_test)
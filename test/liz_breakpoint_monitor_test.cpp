@@ -0,0 +1,511 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Checks that breakpoint monitors only call breakpoint functions for 
+ * breakpoints matching the vm traversal.
+ */
+
+#include <unittestpp.h>
+
+#include <liz/liz_common.h>
+#include <liz/liz_vm.h>
+#include <liz/liz_breakpoint_monitor.h>
+
+#include "liz_test_helpers.h"
+
+
+
+SUITE(liz_breakpoint_monitor_test)
+{
+    namespace {
+        
+        struct traversal_step {
+            liz_uint_t node_shape_atom_index;
+            liz_uint_t traversal_mask;
+        };
+        
+        
+        // Traversal of a sequence containing an action and a sequence of two
+        // actions, all actions succeeding.
+        traversal_step const nested_sequences_traversal[] = {
+            {0, liz_vm_monitor_node_flag_enter_from_top},
+            {0, liz_vm_monitor_node_flag_leave_to_bottom},
+            {1, liz_vm_monitor_node_flag_enter_from_top},
+            {1, liz_vm_monitor_node_flag_leave_to_top},
+            {0, liz_vm_monitor_node_flag_enter_from_bottom},
+            {0, liz_vm_monitor_node_flag_leave_to_bottom},
+            {2, liz_vm_monitor_node_flag_enter_from_top},
+            {2, liz_vm_monitor_node_flag_leave_to_bottom},
+            {3, liz_vm_monitor_node_flag_enter_from_top},
+            {3, liz_vm_monitor_node_flag_leave_to_top},
+            {2, liz_vm_monitor_node_flag_enter_from_bottom},
+            {2, liz_vm_monitor_node_flag_leave_to_bottom},
+            {4, liz_vm_monitor_node_flag_enter_from_top},
+            {4, liz_vm_monitor_node_flag_leave_to_top},
+            {2, liz_vm_monitor_node_flag_enter_from_bottom},
+            {2, liz_vm_monitor_node_flag_leave_to_top},
+            {0, liz_vm_monitor_node_flag_enter_from_bottom},
+            {0, liz_vm_monitor_node_flag_leave_to_top}
+        };
+        
+        
+        liz_index_t const nested_sequences_breakpoint_shape_atom_indices[] = {2, 3, 4};
+        uint16_t const nested_sequences_breakpoint_function_indices[] = {0, 0, 0};
+        uint8_t const nested_sequences_breakpoint_flags[] = {
+            liz_vm_monitor_node_flag_enter_from_bottom | liz_vm_monitor_node_flag_leave_to_top,
+            liz_vm_monitor_node_flag_enter_from_top,
+            liz_vm_monitor_node_flag_enter_from_top | liz_vm_monitor_node_flag_leave_to_top
+        };
+        
+        liz_breakpoint_stream_t const nested_sequences_breakpoints = {
+            nested_sequences_breakpoint_shape_atom_indices,
+            nested_sequences_breakpoint_function_indices,
+            nested_sequences_breakpoint_flags,
+            3 // count
+        };
+        
+        liz_vm_monitor_func_t const breakpoint_functions[] = {
+            monitor_test_func
+        };
+        
+        
+        int breakpoint_monitor_call_count = 0;
+        
+        
+        void
+        counting_breakpoint_monitor_func(uintptr_t user_data,
+                                         liz_uint_t const node_shape_atom_index,
+                                         liz_uint_t const traversal_mask,
+                                         liz_vm_t const *vm,
+                                         void const * LIZ_RESTRICT actor_blackboard,
+                                         liz_time_t const time,
+                                         liz_vm_actor_t const *actor,
+                                         liz_vm_shape_t const *shape)
+        {
+            ++breakpoint_monitor_call_count;
+            
+            liz_breakpoint_monitor_func(user_data,
+                                        node_shape_atom_index,
+                                        traversal_mask,
+                                        vm,
+                                        actor_blackboard,
+                                        time,
+                                        actor,
+                                        shape);
+        }
+        
+        
+        void
+        counting_monitor_func(uintptr_t user_data,
+                              liz_uint_t const node_shape_atom_index,
+                              liz_uint_t const traversal_mask,
+                              liz_vm_t const *vm,
+                              void const * LIZ_RESTRICT actor_blackboard,
+                              liz_time_t const time,
+                              liz_vm_actor_t const *actor,
+                              liz_vm_shape_t const *shape)
+        {
+            (void)user_data;
+            (void)node_shape_atom_index;
+            (void)traversal_mask;
+            (void)vm;
+            (void)actor_blackboard;
+            (void)time;
+            (void)actor;
+            (void)shape;
+            
+            ++breakpoint_monitor_call_count;
+        }
+        
+        
+        class breakpoint_monitor_fixture : public liz_vm_test_fixture {
+        public:
+            
+            breakpoint_monitor_fixture()
+            :   liz_vm_test_fixture()
+            ,   allocator()
+            ,   breakpoint_log()
+            ,   breakpoint_monitor(NULL)
+            {
+                
+            }
+            
+            
+            ~breakpoint_monitor_fixture()
+            {
+                if (NULL != breakpoint_monitor) {
+                    liz_breakpoint_monitor_destroy(breakpoint_monitor, 
+                                                   &allocator, 
+                                                   counting_dealloc);
+                }
+            }
+            
+            
+            void create_nested_sequences()
+            {
+                push_shape_sequence_decider(5);
+                push_shape_immediate_action(immediate_action_func_index_success3);
+                push_shape_sequence_decider(3);
+                push_shape_immediate_action(immediate_action_func_index_success3);
+                push_shape_immediate_action(immediate_action_func_index_success3);
+                
+                create_expected_result_and_proband_vms_for_shape();
+            }
+            
+            
+            void create_breakpoint_monitor(liz_breakpoint_stream_t const *breakpoints)
+            {
+                breakpoint_monitor = liz_breakpoint_monitor_create(breakpoints,
+                                                                   breakpoint_functions,
+                                                                   1, // function_count
+                                                                   shape.spec.decider_guard_capacity,
+                                                                   reinterpret_cast<uintptr_t>(&breakpoint_log),
+                                                                   &allocator,
+                                                                   counting_alloc);
+            }
+            
+            
+            void monitor_step(liz_uint_t const node_shape_atom_index,
+                              liz_uint_t const traversal_mask)
+            {
+                liz_breakpoint_monitor_func(reinterpret_cast<uintptr_t>(breakpoint_monitor),
+                                            node_shape_atom_index,
+                                            traversal_mask,
+                                            proband_vm,
+                                            proband_blackboard,
+                                            0, // time
+                                            &proband_actor,
+                                            &shape);
+            }
+            
+            
+            void monitor_nested_sequences_traversal()
+            {
+                std::size_t const step_count = sizeof(nested_sequences_traversal) / sizeof(nested_sequences_traversal[0]);
+                
+                for (std::size_t i = 0; i < step_count; ++i) {
+                    monitor_step(nested_sequences_traversal[i].node_shape_atom_index,
+                                 nested_sequences_traversal[i].traversal_mask);
+                }
+            }
+            
+            
+            void push_expected_log_entry(liz_vm_monitor_log &log,
+                                         liz_uint_t const node_shape_atom_index,
+                                         liz_uint_t const traversal_mask)
+            {
+                liz_vm_monitor_log_entry const entry = {
+                    node_shape_atom_index,
+                    traversal_mask,
+                    proband_vm,
+                    proband_blackboard,
+                    0, // time
+                    &proband_actor,
+                    &shape
+                };
+                
+                log.push_back(entry);
+            }
+            
+            
+            liz_vm_monitor_log nested_sequences_expected_log()
+            {
+                liz_vm_monitor_log log;
+                
+                push_expected_log_entry(log, 3, liz_vm_monitor_node_flag_enter_from_top);
+                push_expected_log_entry(log, 2, liz_vm_monitor_node_flag_enter_from_bottom);
+                push_expected_log_entry(log, 4, liz_vm_monitor_node_flag_enter_from_top);
+                push_expected_log_entry(log, 4, liz_vm_monitor_node_flag_leave_to_top);
+                push_expected_log_entry(log, 2, liz_vm_monitor_node_flag_enter_from_bottom);
+                push_expected_log_entry(log, 2, liz_vm_monitor_node_flag_leave_to_top);
+                
+                return log;
+            }
+            
+            
+            counting_allocator allocator;
+            liz_vm_monitor_log breakpoint_log;
+            liz_breakpoint_monitor_t *breakpoint_monitor;
+        };
+        
+    } // anonymous namespace
+    
+    
+    
+    TEST(breakpoint_stream_validity)
+    {
+        liz_index_t const shape_atom_indices[] = {1, 3, 3};
+        uint16_t const function_indices[] = {0, 1, 0};
+        uint8_t const flags[] = {
+            liz_vm_monitor_node_flag_enter_from_top,
+            liz_vm_monitor_node_flag_enter_from_top,
+            liz_vm_monitor_node_flag_enter_from_top
+        };
+        
+        liz_breakpoint_stream_t stream = {
+            shape_atom_indices,
+            function_indices,
+            flags,
+            2 // count
+        };
+        
+        CHECK(liz_breakpoint_stream_is_valid(&stream, 2));
+        CHECK(!liz_breakpoint_stream_is_valid(&stream, 1));
+        
+        // Multiple breakpoints for the same node aren't allowed.
+        stream.count = 3;
+        CHECK(!liz_breakpoint_stream_is_valid(&stream, 2));
+        
+        counting_allocator allocator;
+        CHECK(NULL == liz_breakpoint_monitor_create(&stream,
+                                                    breakpoint_functions,
+                                                    2, // function_count
+                                                    1, // guard_capacity
+                                                    0, // user_data
+                                                    &allocator,
+                                                    counting_alloc));
+        CHECK(allocator.is_balanced());
+    }
+    
+    
+    
+    TEST_FIXTURE(breakpoint_monitor_fixture, create_and_destroy)
+    {
+        create_nested_sequences();
+        create_breakpoint_monitor(&nested_sequences_breakpoints);
+        
+        CHECK(NULL != breakpoint_monitor);
+        
+        liz_vm_monitor_t const monitor = liz_breakpoint_monitor_vm_monitor(breakpoint_monitor);
+        CHECK_EQUAL(reinterpret_cast<uintptr_t>(breakpoint_monitor), monitor.user_data);
+        CHECK(liz_breakpoint_monitor_func == monitor.func);
+        CHECK(&breakpoint_monitor->filter == monitor.filter);
+        
+        liz_breakpoint_monitor_destroy(breakpoint_monitor, &allocator, counting_dealloc);
+        breakpoint_monitor = NULL;
+        
+        CHECK(allocator.is_balanced());
+    }
+    
+    
+    
+    TEST_FIXTURE(breakpoint_monitor_fixture, no_breakpoints_never_trigger)
+    {
+        create_nested_sequences();
+        
+        liz_breakpoint_stream_t const no_breakpoints = {NULL, NULL, NULL, 0};
+        create_breakpoint_monitor(&no_breakpoints);
+        
+        monitor_nested_sequences_traversal();
+        
+        CHECK(breakpoint_log.empty());
+    }
+    
+    
+    
+    TEST_FIXTURE(breakpoint_monitor_fixture, trigger_matching_traversal_directions)
+    {
+        create_nested_sequences();
+        create_breakpoint_monitor(&nested_sequences_breakpoints);
+        
+        monitor_nested_sequences_traversal();
+        
+        CHECK_EQUAL(nested_sequences_expected_log(), breakpoint_log);
+    }
+    
+    
+    
+    TEST_FIXTURE(breakpoint_monitor_fixture, rewind_after_leaving_root)
+    {
+        create_nested_sequences();
+        create_breakpoint_monitor(&nested_sequences_breakpoints);
+        
+        monitor_nested_sequences_traversal();
+        breakpoint_log.clear();
+        monitor_nested_sequences_traversal();
+        
+        CHECK_EQUAL(nested_sequences_expected_log(), breakpoint_log);
+    }
+    
+    
+    
+    TEST_FIXTURE(breakpoint_monitor_fixture, reset_after_abandoned_update)
+    {
+        create_nested_sequences();
+        create_breakpoint_monitor(&nested_sequences_breakpoints);
+        
+        // Abandon the update after entering the nested sequence.
+        for (std::size_t i = 0; i < 9; ++i) {
+            monitor_step(nested_sequences_traversal[i].node_shape_atom_index,
+                         nested_sequences_traversal[i].traversal_mask);
+        }
+        
+        liz_breakpoint_monitor_reset(breakpoint_monitor);
+        breakpoint_log.clear();
+        monitor_nested_sequences_traversal();
+        
+        CHECK_EQUAL(nested_sequences_expected_log(), breakpoint_log);
+    }
+    
+    
+    
+    TEST_FIXTURE(breakpoint_monitor_fixture, trigger_cancellation_only_if_requested)
+    {
+        create_nested_sequences();
+        
+        liz_index_t const shape_atom_indices[] = {1, 3};
+        uint16_t const function_indices[] = {0, 0};
+        uint8_t const flags[] = {
+            liz_vm_monitor_node_flag_enter_from_top,
+            liz_vm_monitor_node_flag_cancel_action | liz_vm_monitor_node_flag_leave_to_top
+        };
+        liz_breakpoint_stream_t const breakpoints = {
+            shape_atom_indices,
+            function_indices,
+            flags,
+            2 // count
+        };
+        create_breakpoint_monitor(&breakpoints);
+        
+        // Cancellations are monitored independent of the traversal order.
+        monitor_step(3, liz_vm_monitor_node_flag_cancel_action | liz_vm_monitor_node_flag_enter_from_top);
+        monitor_step(3, liz_vm_monitor_node_flag_cancel_action | liz_vm_monitor_node_flag_leave_to_top);
+        monitor_step(1, liz_vm_monitor_node_flag_cancel_action | liz_vm_monitor_node_flag_enter_from_top);
+        monitor_step(1, liz_vm_monitor_node_flag_cancel_action | liz_vm_monitor_node_flag_leave_to_top);
+        
+        liz_vm_monitor_log expected_log;
+        push_expected_log_entry(expected_log, 
+                                3, 
+                                liz_vm_monitor_node_flag_cancel_action | liz_vm_monitor_node_flag_leave_to_top);
+        
+        CHECK_EQUAL(expected_log, breakpoint_log);
+        
+        // Cancellations don't move the traversal cursor.
+        breakpoint_log.clear();
+        monitor_step(0, liz_vm_monitor_node_flag_enter_from_top);
+        monitor_step(1, liz_vm_monitor_node_flag_enter_from_top);
+        
+        expected_log.clear();
+        push_expected_log_entry(expected_log, 1, liz_vm_monitor_node_flag_enter_from_top);
+        
+        CHECK_EQUAL(expected_log, breakpoint_log);
+    }
+    
+    
+    
+    TEST_FIXTURE(breakpoint_monitor_fixture, monitor_vm_update)
+    {
+        create_nested_sequences();
+        create_breakpoint_monitor(&nested_sequences_breakpoints);
+        
+        liz_vm_monitor_t monitor = liz_breakpoint_monitor_vm_monitor(breakpoint_monitor);
+        
+        liz_vm_monitor_log expected_log;
+#if defined(LIZ_VM_MONITOR_ENABLE)
+        expected_log = nested_sequences_expected_log();
+#endif
+        
+        for (int i = 0; i < 2; ++i) {
+            breakpoint_log.clear();
+            
+            liz_vm_update_actor(proband_vm,
+                                &monitor,
+                                NULL,
+                                identity_user_data_lookup_func,
+                                0, // time
+                                &proband_actor,
+                                &shape);
+            liz_vm_extract_actor_state(proband_vm, &proband_actor, &shape);
+            
+            CHECK_EQUAL(expected_log, breakpoint_log);
+        }
+    }
+    
+    TEST_FIXTURE(breakpoint_monitor_fixture, vm_calls_monitor_only_on_filter_hits)
+    {
+        create_nested_sequences();
+        create_breakpoint_monitor(&nested_sequences_breakpoints);
+        
+        liz_vm_monitor_t monitor = liz_breakpoint_monitor_vm_monitor(breakpoint_monitor);
+        monitor.func = counting_breakpoint_monitor_func;
+        breakpoint_monitor_call_count = 0;
+        
+        liz_vm_update_actor(proband_vm,
+                            &monitor,
+                            NULL,
+                            identity_user_data_lookup_func,
+                            0, // time
+                            &proband_actor,
+                            &shape);
+        
+#if defined(LIZ_VM_MONITOR_ENABLE)
+        // Of the 18 traversal steps only the breakpoint nodes' steps, the
+        // guard steps of the decider breakpoint, and leaving the root call 
+        // out.
+        CHECK_EQUAL(10, breakpoint_monitor_call_count);
+        CHECK_EQUAL(nested_sequences_expected_log(), breakpoint_log);
+#else
+        CHECK_EQUAL(0, breakpoint_monitor_call_count);
+#endif
+    }
+    
+    TEST_FIXTURE(breakpoint_monitor_fixture, filter_sentinels_only_match_leaving_root)
+    {
+        create_nested_sequences();
+        
+        liz_vm_monitor_filter_t const filter = {
+            LIZ_VM_MONITOR_FILTER_END_SHAPE_ATOM_INDEX,
+            LIZ_VM_MONITOR_FILTER_NO_SHAPE_ATOM_INDEX,
+            LIZ_VM_MONITOR_FILTER_NO_SHAPE_ATOM_INDEX
+        };
+        liz_vm_monitor_t monitor = {0, counting_monitor_func, &filter};
+        breakpoint_monitor_call_count = 0;
+        
+        liz_vm_update_actor(proband_vm,
+                            &monitor,
+                            NULL,
+                            identity_user_data_lookup_func,
+                            0, // time
+                            &proband_actor,
+                            &shape);
+        
+#if defined(LIZ_VM_MONITOR_ENABLE)
+        CHECK_EQUAL(1, breakpoint_monitor_call_count);
+#else
+        CHECK_EQUAL(0, breakpoint_monitor_call_count);
+#endif
+    }
+    
+} // SUITE(liz_breakpoint_monitor_test)
@@ -53,10 +53,10 @@ SUITE(liz_common_internal_test)
     TEST(merge_lesser_with_greater_shape_specification)
     {
         liz_shape_specification_t lesser = {
-            1, 2, 3, 4, 5, 6, 7, 8
+            1, 2, 3, 4, 5, 6, 7, 8, 9, 10
         };
         liz_shape_specification_t greater = {
-            2, 3, 4, 5, 6, 7, 8, 9
+            2, 3, 4, 5, 6, 7, 8, 9, 10, 11
         };
         
         liz_shape_specification_t const expected_result_spec = greater;
@@ -70,14 +70,14 @@ SUITE(liz_common_internal_test)
     TEST(merge_two_shape_specifications)
     {
         liz_shape_specification_t lesser = {
-            1, 2, 3, 4, 5, 6, 7, 8
+            1, 2, 3, 4, 5, 6, 7, 8, 9, 10
         };
         liz_shape_specification_t greater = {
-            1, 3, 2, 8, 0, 7, 4, 9
+            1, 3, 2, 8, 0, 7, 4, 9, 12, 3
         };
         
         liz_shape_specification_t const expected_result_spec = {
-            1, 3, 3, 8, 5, 7, 7, 9
+            1, 3, 3, 8, 5, 7, 7, 9, 12, 10
         };
         
         liz_shape_specification_t const proband_spec = liz_shape_specification_merge_max(lesser, greater);
@@ -151,8 +151,8 @@ SUITE(liz_common_internal_test)
             }
             
             
-            void set_expected_result_persistent_action_state(uint16_t const persistent_state_index,
-                                                             uint16_t const shape_atom_index,
+            void set_expected_result_persistent_action_state(liz_index_t const persistent_state_index,
+                                                             liz_index_t const shape_atom_index,
                                                              liz_execution_state_t const exec_state)
             {
                 assert(persistent_state_index < state_count);
@@ -164,7 +164,7 @@ SUITE(liz_common_internal_test)
             }
             
             
-            void push_persistent_action_state_change(uint16_t const shape_atom_index,
+            void push_persistent_action_state_change(liz_index_t const shape_atom_index,
                                                      liz_execution_state const exec_state)
             {
                 assert(0 < shape_atom_index);
@@ -183,15 +183,15 @@ SUITE(liz_common_internal_test)
             liz_shape_atom_t shape_atoms[state_count + 1];
             
             liz_persistent_state_t expected_states[state_count];
-            uint16_t expected_state_shape_atom_indices[state_count];
+            liz_index_t expected_state_shape_atom_indices[state_count];
             
             liz_persistent_state_t proband_states[state_count];
-            uint16_t proband_state_shape_atom_indices[state_count];
+            liz_index_t proband_state_shape_atom_indices[state_count];
             
             
             liz_int_t change_count;
             liz_persistent_state_t state_changes[state_count];
-            uint16_t state_change_shape_atom_indices[state_count];
+            liz_index_t state_change_shape_atom_indices[state_count];
             
             liz_persistent_state_comparator expected_result_comparator;
             liz_persistent_state_comparator proband_comparator;
@@ -202,9 +202,9 @@ SUITE(liz_common_internal_test)
             
             
             void init_persistent_states(liz_persistent_state_t *states, 
-                                        uint16_t *shape_atom_indices, 
+                                        liz_index_t *shape_atom_indices, 
                                         liz_int_t const count, 
-                                        uint16_t const start_index, 
+                                        liz_index_t const start_index, 
                                         liz_execution_state_t const init_state)
             {
                 for (liz_int_t i = 0; i < count; ++i) {
@@ -270,6 +270,120 @@ SUITE(liz_common_internal_test)
         CHECK_EQUAL(expected_result_comparator, proband_comparator);
     }
     
+    
+    TEST(collect_subtree_calls_and_map_shape_atom_indices_to_stream_indices)
+    {
+        // Main tree: concurrent decider calling the shared subtree twice.
+        // Shared subtree: sequence decider with two immediate actions.
+        liz_int_t const stream_capacity = 8;
+        liz_shape_atom_t atoms[stream_capacity];
+        liz_int_t stream_index = 0;
+        liz_shape_atom_stream_add_concurrent_decider(atoms, &stream_index, stream_capacity, 7);
+        liz_shape_atom_stream_add_subtree_call(atoms, &stream_index, stream_capacity, 5, 3);
+        liz_shape_atom_stream_add_subtree_call(atoms, &stream_index, stream_capacity, 5, 3);
+        liz_int_t const main_tree_atom_count = stream_index;
+        liz_shape_atom_stream_add_sequence_decider(atoms, &stream_index, stream_capacity, 3);
+        liz_shape_atom_stream_add_immediate_action(atoms, &stream_index, stream_capacity, 0);
+        liz_shape_atom_stream_add_immediate_action(atoms, &stream_index, stream_capacity, 1);
+        
+        liz_int_t const call_capacity = 2;
+        liz_shape_subtree_call_t calls[call_capacity];
+        liz_int_t shape_atom_index_count = 0;
+        liz_int_t const call_count = liz_shape_atom_stream_collect_subtree_calls(calls,
+                                                                                 call_capacity,
+                                                                                 &shape_atom_index_count,
+                                                                                 atoms,
+                                                                                 main_tree_atom_count);
+        
+        CHECK_EQUAL(2, call_count);
+        CHECK_EQUAL(7, shape_atom_index_count);
+        CHECK_EQUAL(1, calls[0].begin_index);
+        CHECK_EQUAL(4, calls[0].end_index);
+        CHECK_EQUAL(5, calls[0].subtree_stream_index);
+        CHECK_EQUAL(3, calls[0].resume_stream_index);
+        CHECK_EQUAL(4, calls[1].begin_index);
+        CHECK_EQUAL(7, calls[1].end_index);
+        CHECK_EQUAL(5, calls[1].subtree_stream_index);
+        CHECK_EQUAL(5, calls[1].resume_stream_index);
+        
+        liz_int_t const expected_stream_indices[] = {0, 5, 6, 7, 5, 6, 7};
+        liz_int_t cursor = 0;
+        for (liz_int_t i = 0; i < shape_atom_index_count; ++i) {
+            CHECK_EQUAL(expected_stream_indices[i], 
+                        liz_shape_subtree_call_stream_index(&cursor,
+                                                            static_cast<liz_index_t>(i),
+                                                            calls,
+                                                            call_count));
+        }
+        
+        // Looking up decreasing shape atom indices moves the cursor back.
+        CHECK_EQUAL(6, liz_shape_subtree_call_stream_index(&cursor, 2, calls, call_count));
+        CHECK_EQUAL(0, liz_shape_subtree_call_stream_index(&cursor, 0, calls, call_count));
+        CHECK_EQUAL(0, cursor);
+    }
+    
+    
+    TEST(lower_bound_key_in_empty_keys)
+    {
+        liz_index_t const keys[1] = {0};
+        
+        CHECK_EQUAL(0, liz_lower_bound_key(7, keys, 0, 0));
+    }
+    
+    
+    TEST(lower_bound_key_in_short_keys)
+    {
+        liz_index_t const keys[] = {1, 3, 3, 8};
+        liz_int_t const key_count = sizeof(keys) / sizeof(keys[0]);
+        
+        CHECK_EQUAL(0, liz_lower_bound_key(0, keys, 0, key_count));
+        CHECK_EQUAL(0, liz_lower_bound_key(1, keys, 0, key_count));
+        CHECK_EQUAL(1, liz_lower_bound_key(2, keys, 0, key_count));
+        CHECK_EQUAL(1, liz_lower_bound_key(3, keys, 0, key_count));
+        CHECK_EQUAL(3, liz_lower_bound_key(4, keys, 0, key_count));
+        CHECK_EQUAL(4, liz_lower_bound_key(9, keys, 0, key_count));
+        
+        // Searches never move before begin_index.
+        CHECK_EQUAL(2, liz_lower_bound_key(1, keys, 2, key_count));
+        CHECK_EQUAL(4, liz_lower_bound_key(1, keys, key_count, key_count));
+    }
+    
+    
+    TEST(lower_bound_key_across_blocks)
+    {
+        liz_int_t const key_count = 101;
+        liz_index_t keys[key_count];
+        for (liz_int_t i = 0; i < key_count; ++i) {
+            keys[i] = static_cast<liz_index_t>(2 * i);
+        }
+        
+        for (liz_int_t begin_index = 0; begin_index < 20; ++begin_index) {
+            for (liz_int_t key = 0; key <= 2 * key_count; ++key) {
+                liz_int_t const expected_result = liz_max(begin_index, (key + 1) / 2);
+                CHECK_EQUAL(expected_result, 
+                            liz_lower_bound_key(static_cast<liz_index_t>(key), 
+                                                keys, 
+                                                begin_index, 
+                                                key_count));
+            }
+        }
+    }
+    
+    
+    TEST(lower_bound_key_compares_keys_unsigned)
+    {
+        liz_index_t keys[40];
+        liz_int_t const key_count = sizeof(keys) / sizeof(keys[0]);
+        for (liz_int_t i = 0; i < key_count; ++i) {
+            keys[i] = static_cast<liz_index_t>(LIZ_INDEX_MAX - key_count + i);
+        }
+        keys[0] = 0;
+        
+        CHECK_EQUAL(1, liz_lower_bound_key(1, keys, 0, key_count));
+        CHECK_EQUAL(key_count - 1, liz_lower_bound_key(LIZ_INDEX_MAX - 1, keys, 0, key_count));
+        CHECK_EQUAL(key_count, liz_lower_bound_key(LIZ_INDEX_MAX, keys, 0, key_count));
+    }
+    
 } // SUITE(liz_common_internal_test)
 
 
@@ -0,0 +1,129 @@
+/*
+ * Generated by liz_shape_compile_to_c - do not edit, regenerate when the
+ * shape changes.
+ */
+
+#include <liz/liz_assert.h>
+#include <liz/liz_vm.h>
+
+
+
+liz_execution_state_t
+immediate_action_func_running2(void *actor_blackboard,
+                               liz_random_number_seed_t *random_number_seed,
+                               liz_time_t time,
+                               liz_execution_state_t execution_request);
+
+
+
+static
+void
+liz_compiled_test_shape_update_actor(liz_vm_t *vm,
+                                     liz_vm_monitor_t *monitor,
+                                     void * LIZ_RESTRICT user_data_lookup_context,
+                                     liz_vm_user_data_lookup_func_t user_data_lookup_func,
+                                     liz_time_t const time,
+                                     liz_vm_actor_t const *actor,
+                                     liz_vm_shape_t const *shape)
+{
+    LIZ_ASSERT(8 == liz_shape_specification_shape_atom_index_count(shape->spec)
+               && 6 == shape->spec.immediate_action_function_count
+               && "Shape differs from the compiled one.");
+    LIZ_ASSERT(liz_vm_fulfills_shape_specification(vm, shape->spec));
+    
+    if (!liz_vm_begin_update_actor(vm, actor, shape)) {
+        return;
+    }
+    
+    void *actor_blackboard = user_data_lookup_func(user_data_lookup_context,
+                                                   actor->header->user_data);
+    
+    LIZ_VM_STATS_CYCLES_BEGIN(update_begin_cycles);
+    {
+        // Concurrent decider 0.
+        LIZ_VM_MONITOR_NODE(monitor, 0, liz_vm_monitor_node_flag_enter_from_top, vm, actor_blackboard, time, actor, shape);
+        liz_vm_invoke_concurrent_decider(vm, actor, &shape->atoms[0]);
+        LIZ_VM_MONITOR_NODE(monitor, 0, liz_vm_monitor_node_flag_leave_to_bottom, vm, actor_blackboard, time, actor, shape);
+        
+        if (1 == vm->shape_atom_index) {
+            // Dynamic priority decider 1.
+            LIZ_VM_MONITOR_NODE(monitor, 1, liz_vm_monitor_node_flag_enter_from_top, vm, actor_blackboard, time, actor, shape);
+            liz_vm_invoke_dynamic_priority_decider(vm, actor, &shape->atoms[1]);
+            LIZ_VM_MONITOR_NODE(monitor, 1, liz_vm_monitor_node_flag_leave_to_bottom, vm, actor_blackboard, time, actor, shape);
+            
+            if (2 == vm->shape_atom_index) {
+                // Persistent action 2.
+                LIZ_VM_MONITOR_NODE(monitor, 2, liz_vm_monitor_node_flag_enter_from_top, vm, actor_blackboard, time, actor, shape);
+                liz_execution_state_t execution_state = (liz_execution_state_t)(actor->persistent_states[0].persistent_action.state);
+                LIZ_VM_CATCH_INVALID_PERSISTENT_AND_IMMEDIATE_ACTION_STATE(&execution_state);
+                vm->actor_persistent_state_index = 1;
+                vm->shape_atom_index = 3;
+                vm->execution_state = execution_state;
+                vm->cmd = liz_vm_cmd_guard_decider;
+                LIZ_VM_MONITOR_NODE(monitor, 2, liz_vm_monitor_node_flag_leave_to_top, vm, actor_blackboard, time, actor, shape);
+                
+                LIZ_VM_MONITOR_NODE(monitor, 1, liz_vm_monitor_node_flag_enter_from_bottom, vm, actor_blackboard, time, actor, shape);
+                liz_vm_guard_dynamic_priority_decider(vm);
+                liz_vm_leave_decider_guard(vm, monitor, actor_blackboard, time, actor, shape);
+            }
+            
+            if (3 == vm->shape_atom_index) {
+                // Deferred action 3.
+                LIZ_VM_MONITOR_NODE(monitor, 3, liz_vm_monitor_node_flag_enter_from_top, vm, actor_blackboard, time, actor, shape);
+                liz_vm_invoke_deferred_action(vm, actor, &shape->atoms[3]);
+                vm->cmd = liz_vm_cmd_guard_decider;
+                LIZ_VM_MONITOR_NODE(monitor, 3, liz_vm_monitor_node_flag_leave_to_top, vm, actor_blackboard, time, actor, shape);
+                
+                LIZ_VM_MONITOR_NODE(monitor, 1, liz_vm_monitor_node_flag_enter_from_bottom, vm, actor_blackboard, time, actor, shape);
+                liz_vm_guard_dynamic_priority_decider(vm);
+                liz_vm_leave_decider_guard(vm, monitor, actor_blackboard, time, actor, shape);
+            }
+            
+            LIZ_VM_MONITOR_NODE(monitor, 0, liz_vm_monitor_node_flag_enter_from_bottom, vm, actor_blackboard, time, actor, shape);
+            liz_vm_guard_concurrent_decider(vm);
+            liz_vm_leave_decider_guard(vm, monitor, actor_blackboard, time, actor, shape);
+        }
+        
+        if (5 == vm->shape_atom_index) {
+            // Sequence decider 5.
+            LIZ_VM_MONITOR_NODE(monitor, 5, liz_vm_monitor_node_flag_enter_from_top, vm, actor_blackboard, time, actor, shape);
+            liz_vm_invoke_sequence_decider(vm, actor, &shape->atoms[5]);
+            LIZ_VM_MONITOR_NODE(monitor, 5, liz_vm_monitor_node_flag_leave_to_bottom, vm, actor_blackboard, time, actor, shape);
+            
+            if (6 == vm->shape_atom_index) {
+                // Immediate action 6.
+                liz_execution_state_t execution_state = liz_vm_step_begin_immediate_action(vm, monitor, actor_blackboard, time, actor, shape);
+                LIZ_VM_COUNT_CYCLES_BEGIN(tick_begin_cycles);
+                execution_state = shape->immediate_action_functions[3](actor_blackboard, &vm->actor_random_number_seed, time, execution_state);
+                LIZ_VM_COUNT_CYCLES_END(tick_begin_cycles, vm, 6);
+                liz_vm_step_end_immediate_action(vm, monitor, actor_blackboard, time, actor, shape, execution_state);
+                
+                LIZ_VM_MONITOR_NODE(monitor, 5, liz_vm_monitor_node_flag_enter_from_bottom, vm, actor_blackboard, time, actor, shape);
+                liz_vm_guard_sequence_decider(vm);
+                liz_vm_leave_decider_guard(vm, monitor, actor_blackboard, time, actor, shape);
+            }
+            
+            if (7 == vm->shape_atom_index) {
+                // Immediate action 7.
+                liz_execution_state_t execution_state = liz_vm_step_begin_immediate_action(vm, monitor, actor_blackboard, time, actor, shape);
+                LIZ_VM_COUNT_CYCLES_BEGIN(tick_begin_cycles);
+                execution_state = immediate_action_func_running2(actor_blackboard, &vm->actor_random_number_seed, time, execution_state);
+                LIZ_VM_COUNT_CYCLES_END(tick_begin_cycles, vm, 7);
+                liz_vm_step_end_immediate_action(vm, monitor, actor_blackboard, time, actor, shape, execution_state);
+                
+                LIZ_VM_MONITOR_NODE(monitor, 5, liz_vm_monitor_node_flag_enter_from_bottom, vm, actor_blackboard, time, actor, shape);
+                liz_vm_guard_sequence_decider(vm);
+                liz_vm_leave_decider_guard(vm, monitor, actor_blackboard, time, actor, shape);
+            }
+            
+            LIZ_VM_MONITOR_NODE(monitor, 0, liz_vm_monitor_node_flag_enter_from_bottom, vm, actor_blackboard, time, actor, shape);
+            liz_vm_guard_concurrent_decider(vm);
+            liz_vm_leave_decider_guard(vm, monitor, actor_blackboard, time, actor, shape);
+        }
+    }
+    
+    // The root has been left to its top.
+    vm->cmd = liz_vm_cmd_cleanup;
+    liz_vm_step_cleanup(vm, monitor, actor_blackboard, time, actor, shape);
+    LIZ_VM_STATS_CYCLES_END(update_begin_cycles, vm);
+}
@@ -0,0 +1,376 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Checks concurrent adding, deferred removal, and compaction of the 
+ * concurrent table.
+ */
+
+#include <unittestpp.h>
+
+#include <set>
+#include <vector>
+
+#include <pthread.h>
+
+#include "liz_test_helpers.h"
+
+#include <liz/liz_concurrent_table.h>
+
+
+
+SUITE(liz_concurrent_table_test)
+{
+    namespace {
+        
+        struct payload {
+            uint32_t owner;
+            uint32_t value;
+        };
+        
+        
+        
+        // One thread's frame of concurrent_adds_removals_and_lookups.
+        struct frame_worker {
+            liz_concurrent_table_t *table;
+            liz_concurrent_table_cache_t *cache;
+            std::vector<liz_id_t> *ids;
+            uint32_t owner;
+            uint32_t frame;
+            int failure_count;
+        };
+        
+        
+        // Removes the ids added last frame and adds new ones.
+        void*
+        run_frame_worker(void *context)
+        {
+            frame_worker *worker = static_cast<frame_worker *>(context);
+            std::vector<liz_id_t> &ids = *(worker->ids);
+            
+            for (std::size_t i = 0; i < ids.size(); ++i) {
+                payload const *data = static_cast<payload *>(liz_concurrent_table_lookup(worker->table, ids[i]));
+                if (worker->owner != data->owner) {
+                    ++(worker->failure_count);
+                }
+                liz_concurrent_table_remove_deferred(worker->cache, ids[i]);
+            }
+            ids.clear();
+            
+            while (liz_concurrent_table_cache_can_add(worker->cache)) {
+                payload const data = {worker->owner, worker->frame};
+                ids.push_back(liz_concurrent_table_add(worker->table, worker->cache, &data));
+            }
+            
+            return NULL;
+        }
+        
+        
+        class concurrent_table_fixture {
+        public:
+            
+            concurrent_table_fixture()
+            :   allocator()
+            ,   table(NULL)
+            ,   caches()
+            {
+                table = liz_concurrent_table_create(64, 
+                                                    sizeof(payload), 
+                                                    sizeof(uint32_t), 
+                                                    &allocator, 
+                                                    counting_alloc);
+                
+                for (int i = 0; i < 2; ++i) {
+                    caches.push_back(liz_concurrent_table_cache_create(16, 
+                                                                       16, 
+                                                                       &allocator, 
+                                                                       counting_alloc));
+                }
+                
+                sync();
+            }
+            
+            
+            ~concurrent_table_fixture()
+            {
+                for (std::size_t i = 0; i < caches.size(); ++i) {
+                    liz_concurrent_table_cache_destroy(caches[i], &allocator, counting_dealloc);
+                }
+                
+                liz_concurrent_table_destroy(table, &allocator, counting_dealloc);
+            }
+            
+            
+            void sync()
+            {
+                liz_concurrent_table_sync(table, 
+                                          &caches[0], 
+                                          static_cast<liz_int_t>(caches.size()));
+            }
+            
+            
+            liz_id_t add(std::size_t const cache_index,
+                         uint32_t const value)
+            {
+                payload const data = {static_cast<uint32_t>(cache_index), value};
+                
+                return liz_concurrent_table_add(table, caches[cache_index], &data);
+            }
+            
+            
+            bool is_packed_and_consistent() const
+            {
+                for (liz_int_t i = 0; i < liz_concurrent_table_count(table); ++i) {
+                    liz_id_t const id = liz_concurrent_table_data_id(table, i);
+                    
+                    if (!liz_concurrent_table_contains(table, id)
+                        || liz_concurrent_table_lookup(table, id) != liz_concurrent_table_data(table, i)) {
+                        
+                        return false;
+                    }
+                }
+                
+                return true;
+            }
+            
+            
+            counting_allocator allocator;
+            liz_concurrent_table_t *table;
+            std::vector<liz_concurrent_table_cache_t *> caches;
+            
+        private:
+            concurrent_table_fixture(concurrent_table_fixture const&); // = 0
+            concurrent_table_fixture& operator=(concurrent_table_fixture const&); // = 0
+        };
+        
+    } // anonymous namespace
+    
+    
+    
+    TEST(create_rejects_invalid_parameters)
+    {
+        counting_allocator allocator;
+        
+        CHECK(NULL == liz_concurrent_table_create(LIZ_CONCURRENT_TABLE_CAPACITY_MAX + 1, 4, 4, &allocator, counting_alloc));
+        CHECK(NULL == liz_concurrent_table_create(4, 6, 4, &allocator, counting_alloc));
+        CHECK(NULL == liz_concurrent_table_create(4, 6, 3, &allocator, counting_alloc));
+        CHECK(allocator.is_balanced());
+    }
+    
+    
+    
+    TEST_FIXTURE(concurrent_table_fixture, sync_hands_out_ids_up_to_capacity)
+    {
+        CHECK_EQUAL(16u, caches[0]->add_id_count);
+        CHECK_EQUAL(16u, caches[1]->add_id_count);
+        
+        std::set<liz_id_t> ids;
+        for (std::size_t c = 0; c < caches.size(); ++c) {
+            while (liz_concurrent_table_cache_can_add(caches[c])) {
+                ids.insert(add(c, 0));
+            }
+        }
+        
+        CHECK_EQUAL(32u, ids.size());
+        CHECK_EQUAL(32, liz_concurrent_table_count(table));
+        
+        sync();
+        
+        for (std::size_t c = 0; c < caches.size(); ++c) {
+            while (liz_concurrent_table_cache_can_add(caches[c])) {
+                add(c, 0);
+            }
+        }
+        
+        sync();
+        
+        CHECK_EQUAL(64, liz_concurrent_table_count(table));
+        CHECK(!liz_concurrent_table_cache_can_add(caches[0]));
+        CHECK(!liz_concurrent_table_cache_can_add(caches[1]));
+    }
+    
+    
+    
+    TEST_FIXTURE(concurrent_table_fixture, removals_are_deferred_until_sync)
+    {
+        liz_id_t const first = add(0, 1);
+        liz_id_t const second = add(0, 2);
+        liz_id_t const third = add(1, 3);
+        
+        liz_concurrent_table_remove_deferred(caches[1], first);
+        liz_concurrent_table_remove_deferred(caches[0], first);
+        
+        CHECK(liz_concurrent_table_contains(table, first));
+        CHECK_EQUAL(1u, static_cast<payload *>(liz_concurrent_table_lookup(table, first))->value);
+        
+        sync();
+        
+        CHECK(!liz_concurrent_table_contains(table, first));
+        CHECK(liz_concurrent_table_contains(table, second));
+        CHECK(liz_concurrent_table_contains(table, third));
+        CHECK_EQUAL(2, liz_concurrent_table_count(table));
+        CHECK_EQUAL(2u, static_cast<payload *>(liz_concurrent_table_lookup(table, second))->value);
+        CHECK_EQUAL(3u, static_cast<payload *>(liz_concurrent_table_lookup(table, third))->value);
+        CHECK(is_packed_and_consistent());
+    }
+    
+    
+    
+    TEST_FIXTURE(concurrent_table_fixture, reused_rooster_slots_get_new_versions)
+    {
+        // Cycle through all rooster slots so the removed one comes up again.
+        std::vector<liz_id_t> removed_ids;
+        
+        for (int round = 0; round < 8; ++round) {
+            while (liz_concurrent_table_cache_can_add(caches[0])) {
+                liz_id_t const id = add(0, 0);
+                liz_concurrent_table_remove_deferred(caches[0], id);
+                removed_ids.push_back(id);
+            }
+            sync();
+        }
+        
+        CHECK_EQUAL(0, liz_concurrent_table_count(table));
+        
+        std::set<liz_id_t> const unique_ids(removed_ids.begin(), removed_ids.end());
+        CHECK_EQUAL(removed_ids.size(), unique_ids.size());
+        
+        for (std::size_t i = 0; i < removed_ids.size(); ++i) {
+            CHECK(!liz_concurrent_table_contains(table, removed_ids[i]));
+        }
+    }
+    
+    
+    
+    TEST_FIXTURE(concurrent_table_fixture, compaction_keeps_data_packed)
+    {
+        std::vector<liz_id_t> ids;
+        for (uint32_t i = 0; i < 16; ++i) {
+            ids.push_back(add(0, i));
+        }
+        sync();
+        
+        // Remove from the front, the middle, and the end.
+        uint32_t const removed_values[] = {0, 1, 7, 9, 14, 15};
+        for (std::size_t i = 0; i < sizeof(removed_values) / sizeof(removed_values[0]); ++i) {
+            liz_concurrent_table_remove_deferred(caches[1], ids[removed_values[i]]);
+        }
+        sync();
+        
+        CHECK_EQUAL(10, liz_concurrent_table_count(table));
+        CHECK(is_packed_and_consistent());
+        
+        std::set<uint32_t> values;
+        for (liz_int_t i = 0; i < liz_concurrent_table_count(table); ++i) {
+            values.insert(static_cast<payload *>(liz_concurrent_table_data(table, i))->value);
+        }
+        
+        uint32_t const expected_value_array[] = {2, 3, 4, 5, 6, 8, 10, 11, 12, 13};
+        std::set<uint32_t> const expected_values(expected_value_array, expected_value_array + 10);
+        CHECK(expected_values == values);
+    }
+    
+    
+    
+    TEST(concurrent_adds_removals_and_lookups)
+    {
+        counting_allocator allocator;
+        
+        int const thread_count = 4;
+        int const adds_per_frame = 32;
+        liz_concurrent_table_t *table = liz_concurrent_table_create(thread_count * adds_per_frame * 2, 
+                                                                    sizeof(payload), 
+                                                                    sizeof(uint32_t), 
+                                                                    &allocator, 
+                                                                    counting_alloc);
+        std::vector<liz_concurrent_table_cache_t *> caches;
+        for (int i = 0; i < thread_count; ++i) {
+            caches.push_back(liz_concurrent_table_cache_create(adds_per_frame, 
+                                                               adds_per_frame, 
+                                                               &allocator, 
+                                                               counting_alloc));
+        }
+        
+        std::vector<std::vector<liz_id_t> > live_ids(static_cast<std::size_t>(thread_count));
+        std::vector<int> failure_counts(static_cast<std::size_t>(thread_count), 0);
+        
+        for (int frame = 0; frame < 16; ++frame) {
+            liz_concurrent_table_sync(table, &caches[0], thread_count);
+            
+            std::vector<frame_worker> workers(static_cast<std::size_t>(thread_count));
+            std::vector<pthread_t> threads(static_cast<std::size_t>(thread_count));
+            
+            for (std::size_t t = 0; t < workers.size(); ++t) {
+                frame_worker const worker = {
+                    table, 
+                    caches[t], 
+                    &live_ids[t], 
+                    static_cast<uint32_t>(t), 
+                    static_cast<uint32_t>(frame),
+                    0
+                };
+                workers[t] = worker;
+                
+                int const error_code = pthread_create(&threads[t], NULL, run_frame_worker, &workers[t]);
+                CHECK_EQUAL(0, error_code);
+            }
+            
+            for (std::size_t t = 0; t < threads.size(); ++t) {
+                pthread_join(threads[t], NULL);
+                failure_counts[t] += workers[t].failure_count;
+            }
+        }
+        
+        liz_concurrent_table_sync(table, &caches[0], thread_count);
+        
+        CHECK_EQUAL(thread_count * adds_per_frame, liz_concurrent_table_count(table));
+        for (int t = 0; t < thread_count; ++t) {
+            CHECK_EQUAL(0, failure_counts[static_cast<std::size_t>(t)]);
+            
+            for (std::size_t i = 0; i < live_ids[static_cast<std::size_t>(t)].size(); ++i) {
+                liz_id_t const id = live_ids[static_cast<std::size_t>(t)][i];
+                CHECK(liz_concurrent_table_contains(table, id));
+                CHECK_EQUAL(15u, static_cast<payload *>(liz_concurrent_table_lookup(table, id))->value);
+            }
+        }
+        
+        for (int i = 0; i < thread_count; ++i) {
+            liz_concurrent_table_cache_destroy(caches[static_cast<std::size_t>(i)], &allocator, counting_dealloc);
+        }
+        liz_concurrent_table_destroy(table, &allocator, counting_dealloc);
+        
+        CHECK(allocator.is_balanced());
+    }
+    
+} // SUITE(liz_concurrent_table_test)
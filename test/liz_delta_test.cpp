@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Checks recording vm update state changes and applying them forward and in
+ * reverse.
+ */
+
+#include <unittestpp.h>
+
+#include <vector>
+
+#include <liz/liz_common.h>
+#include <liz/liz_common_internal.h>
+#include <liz/liz_vm.h>
+#include <liz/liz_delta.h>
+
+#include "liz_test_helpers.h"
+
+
+
+SUITE(liz_delta_test)
+{
+    namespace {
+        
+        class delta_fixture : public liz_vm_test_fixture {
+        public:
+            
+            delta_fixture()
+            :   liz_vm_test_fixture()
+            ,   delta()
+            ,   changes()
+            {
+                
+            }
+            
+            
+            liz_int_t record()
+            {
+                changes.resize(liz_delta_change_capacity_requirement(shape.spec));
+                
+                return liz_delta_record(&delta,
+                                        &changes[0],
+                                        static_cast<liz_int_t>(changes.size()),
+                                        proband_vm,
+                                        &proband_actor,
+                                        &shape);
+            }
+            
+            
+            void update_proband_and_expected_result_actors()
+            {
+                liz_vm_update_actor(proband_vm,
+                                    NULL,
+                                    NULL,
+                                    identity_user_data_lookup_func,
+                                    0.0,
+                                    &proband_actor,
+                                    &shape);
+                
+                record();
+                
+                liz_vm_extract_actor_state(proband_vm, &proband_actor, &shape);
+                liz_delta_apply(&expected_result_actor, 
+                                &shape, 
+                                &delta, 
+                                &changes[0], 
+                                liz_delta_direction_forward);
+            }
+            
+            
+            liz_delta_t delta;
+            std::vector<liz_delta_change_t> changes;
+        };
+        
+    } // anonymous namespace
+    
+    
+    
+    TEST_FIXTURE(delta_fixture, replay_vm_updates)
+    {
+        push_shape_sequence_decider(3);
+        push_shape_immediate_action(immediate_action_func_index_success3);
+        push_shape_immediate_action(immediate_action_func_index_running2);
+        
+        create_expected_result_and_proband_vms_for_shape();
+        
+        // The first update launches a running action below the sequence.
+        update_proband_and_expected_result_actors();
+        
+        CHECK_EQUAL(2, delta.change_count);
+        CHECK_EQUAL(liz_delta_state_type_decider, changes[0].state_type);
+        CHECK_EQUAL(liz_delta_presence_new, changes[0].presence_mask);
+        CHECK_EQUAL(liz_delta_state_type_action, changes[1].state_type);
+        CHECK_EQUAL(2, changes[1].shape_atom_index);
+        CHECK_EQUAL(liz_execution_state_running, changes[1].new_state);
+        CHECK_EQUAL(expected_result_actor_comparator, proband_actor_comparator);
+        
+        // Nothing changes while the action keeps running.
+        update_proband_and_expected_result_actors();
+        
+        CHECK_EQUAL(0, delta.change_count);
+        CHECK_EQUAL(expected_result_actor_comparator, proband_actor_comparator);
+    }
+    
+    
+    
+    TEST_FIXTURE(delta_fixture, record_apply_and_reverse_changes)
+    {
+        push_shape_sequence_decider(4);
+        push_shape_persistent_action();
+        push_shape_immediate_action(immediate_action_func_index_identity0);
+        push_shape_immediate_action(immediate_action_func_index_identity1);
+        shape.spec.persistent_state_change_capacity = shape.spec.persistent_state_count;
+        
+        create_expected_result_and_proband_vms_for_shape();
+        
+        set_actor_persistent_state(target_select_both, 
+                                   0, // persistent_state_index
+                                   1, // shape_atom_index
+                                   liz_execution_state_running);
+        push_actor_decider_state(target_select_both, 0, 1);
+        push_actor_action_state(target_select_both, 2, liz_execution_state_running);
+        
+        // Decider state changes, the action state moves from one action to 
+        // another, and the persistent action succeeds.
+        push_vm_decider_state(target_select_proband, 0, 2);
+        push_vm_action_state(target_select_proband, 3, liz_execution_state_running);
+        push_vm_persistent_action_state_change(target_select_proband, 1, liz_execution_state_success);
+        proband_vm->actor_random_number_seed = 17;
+        proband_vm->cmd = liz_vm_cmd_done;
+        
+        CHECK_EQUAL(4, record());
+        CHECK_EQUAL(0, delta.old_random_number_seed);
+        CHECK_EQUAL(17, delta.new_random_number_seed);
+        
+        liz_vm_extract_actor_state(proband_vm, &proband_actor, &shape);
+        liz_delta_apply(&expected_result_actor, 
+                        &shape, 
+                        &delta, 
+                        &changes[0], 
+                        liz_delta_direction_forward);
+        
+        CHECK_EQUAL(expected_result_actor_comparator, proband_actor_comparator);
+        CHECK_EQUAL(17, expected_result_actor_header.random_number_seed);
+        
+        liz_delta_apply(&proband_actor, 
+                        &shape, 
+                        &delta, 
+                        &changes[0], 
+                        liz_delta_direction_reverse);
+        
+        CHECK_EQUAL(0, proband_actor_header.random_number_seed);
+        CHECK_EQUAL(1, proband_actor_header.decider_state_count);
+        CHECK_EQUAL(1, proband_actor_decider_states[0]);
+        CHECK_EQUAL(1, proband_actor_header.action_state_count);
+        CHECK_EQUAL(2, proband_actor_action_state_shape_atom_indices[0]);
+        CHECK_EQUAL(liz_execution_state_running, proband_actor_persistent_states[0].persistent_action.state);
+    }
+    
+} // SUITE(liz_delta_test)
+
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+/**
+ * @file
+ *
+ * Checks the memory sizes of the default 16 bit index configuration and of
+ * LIZ_WIDE_INDEX_ENABLE, and updates a shape close to or beyond the 16 bit
+ * limit. Build the tests in both configurations to cover both.
+ */
+
+#include <unittestpp.h>
+
+#include <liz/liz_platform_types.h>
+#include <liz/liz_common.h>
+#include <liz/liz_common_internal.h>
+#include <liz/liz_vm.h>
+
+#include "liz_test_helpers.h"
+
+
+
+SUITE(liz_index_width_test)
+{
+    TEST(index_width_memory_sizes)
+    {
+#if defined(LIZ_WIDE_INDEX_ENABLE)
+        CHECK_EQUAL(4u, sizeof(liz_index_t));
+        CHECK_EQUAL(8u, sizeof(liz_shape_atom_t));
+        CHECK_EQUAL(32u, sizeof(liz_vm_decider_guard_t));
+        CHECK(UINT16_MAX < LIZ_COUNT_MAX);
+#else
+        CHECK_EQUAL(2u, sizeof(liz_index_t));
+        CHECK_EQUAL(4u, sizeof(liz_shape_atom_t));
+        CHECK_EQUAL(16u, sizeof(liz_vm_decider_guard_t));
+        CHECK_EQUAL(UINT16_MAX, LIZ_COUNT_MAX);
+#endif
+    }
+    
+    
+    
+    TEST_FIXTURE(liz_vm_test_fixture, update_large_shape)
+    {
+#if defined(LIZ_WIDE_INDEX_ENABLE)
+        liz_int_t const immediate_action_count = 70000;
+#else
+        liz_int_t const immediate_action_count = 32000;
+#endif
+        
+        push_shape_sequence_decider(static_cast<liz_index_t>(1 + immediate_action_count + 2) // shape atom end offset
+                                    );
+        for (liz_int_t i = 0; i < immediate_action_count; ++i) {
+            push_shape_immediate_action(immediate_action_func_index_success3);
+        }
+        push_shape_deferred_action(42, // action_id
+                                   7 // resource_id
+                                   );
+        
+        create_expected_result_and_proband_vms_for_shape();
+        
+        liz_vm_update_actor(proband_vm,
+                            NULL, // monitor
+                            NULL,
+                            identity_user_data_lookup_func,
+                            0, // time
+                            &proband_actor,
+                            &shape);
+        
+        CHECK_EQUAL(liz_execution_state_launch, proband_vm->execution_state);
+        
+        liz_action_request_t request;
+        CHECK_EQUAL(1, liz_vm_extract_action_requests(proband_vm, &request, 1, 1));
+        CHECK_EQUAL(42u, request.action_id);
+        CHECK_EQUAL(static_cast<liz_uint_t>(1 + immediate_action_count), static_cast<liz_uint_t>(request.shape_atom_index));
+    }
+    
+} // SUITE(liz_index_width_test)
@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Checks level of detail scheduling of actor clip updates.
+ */
+
+#include <unittestpp.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <liz/liz_common.h>
+#include <liz/liz_common_internal.h>
+#include <liz/liz_vm.h>
+#include <liz/liz_actor_clip.h>
+#include <liz/liz_lod_schedule.h>
+
+#include "liz_test_helpers.h"
+
+
+
+SUITE(liz_lod_schedule_test)
+{
+    namespace {
+        
+        // Tick interval and phase of the actors of the lod fixture.
+        uint16_t const lod_tick_schedules[][2] = {
+            {1, 0},
+            {2, 0},
+            {2, 1},
+            {4, 3},
+            {4, 0},
+            {1, 0},
+            {4, 1}
+        };
+        
+        liz_int_t const lod_actor_count = sizeof(lod_tick_schedules) / sizeof(lod_tick_schedules[0]);
+        
+        
+        class lod_fixture : public liz_vm_test_fixture {
+        public:
+            
+            lod_fixture()
+            :   liz_vm_test_fixture()
+            ,   allocator()
+            ,   clip(NULL)
+            ,   schedule(NULL)
+            {
+                push_shape_deferred_action(42, // action_id
+                                           7 // resource_id
+                                           );
+                
+                create_expected_result_and_proband_vms_for_shape();
+                
+                clip = liz_actor_clip_create(shape.spec, 
+                                             lod_actor_count, 
+                                             1, // clip_id
+                                             1, // shape_id
+                                             &allocator, 
+                                             counting_alloc);
+                
+                for (liz_int_t i = 0; i < lod_actor_count; ++i) {
+                    liz_int_t const index = liz_actor_clip_add_actor(clip, 
+                                                                     static_cast<liz_id_t>(100 + i),
+                                                                     0, // user_data
+                                                                     0); // random_number_seed
+                    liz_actor_clip_set_tick_schedule(clip, 
+                                                     index, 
+                                                     lod_tick_schedules[i][0], 
+                                                     lod_tick_schedules[i][1]);
+                }
+                
+                schedule = liz_lod_schedule_create(lod_actor_count, 
+                                                   4, // max_tick_interval
+                                                   &allocator, 
+                                                   counting_alloc);
+            }
+            
+            
+            ~lod_fixture()
+            {
+                liz_lod_schedule_destroy(schedule, &allocator, counting_dealloc);
+                liz_actor_clip_destroy(clip, &allocator, counting_dealloc);
+            }
+            
+            
+            std::vector<uint32_t> expected_due_actors(uint64_t const frame) const
+            {
+                std::vector<uint32_t> due_actors;
+                
+                for (liz_int_t i = 0; i < lod_actor_count; ++i) {
+                    if (frame % lod_tick_schedules[i][0] == lod_tick_schedules[i][1]) {
+                        due_actors.push_back(static_cast<uint32_t>(i));
+                    }
+                }
+                
+                return due_actors;
+            }
+            
+            
+            counting_allocator allocator;
+            liz_actor_clip_t *clip;
+            liz_lod_schedule_t *schedule;
+        };
+        
+    } // anonymous namespace
+    
+    
+    
+    TEST(create_and_destroy)
+    {
+        counting_allocator allocator;
+        
+        CHECK(NULL == liz_lod_schedule_create(4, 0, &allocator, counting_alloc));
+        CHECK(NULL == liz_lod_schedule_create(4, 3, &allocator, counting_alloc));
+        CHECK(NULL == liz_lod_schedule_create(-1, 4, &allocator, counting_alloc));
+        
+        liz_lod_schedule_t *schedule = liz_lod_schedule_create(4, 
+                                                               32768, 
+                                                               &allocator, 
+                                                               counting_alloc);
+        CHECK(NULL != schedule);
+        CHECK_EQUAL(0, liz_lod_schedule_due_actor_count(schedule, 0));
+        
+        liz_lod_schedule_destroy(schedule, &allocator, counting_dealloc);
+        
+        CHECK(allocator.is_balanced());
+    }
+    
+    
+    
+    TEST_FIXTURE(lod_fixture, set_tick_schedule)
+    {
+        CHECK(!liz_actor_clip_set_tick_schedule(clip, 0, 0, 0));
+        CHECK(!liz_actor_clip_set_tick_schedule(clip, 0, 3, 0));
+        CHECK(!liz_actor_clip_set_tick_schedule(clip, 0, 2, 2));
+        
+        CHECK_EQUAL(1u, clip->tick_schedules[0].tick_interval);
+        CHECK_EQUAL(2u, clip->tick_schedules[2].tick_interval);
+        CHECK_EQUAL(1u, clip->tick_schedules[2].tick_phase);
+    }
+    
+    
+    
+    TEST_FIXTURE(lod_fixture, collect_due_actors)
+    {
+        CHECK(liz_lod_schedule_build(schedule, clip));
+        
+        for (uint64_t frame = 0; frame < 9; ++frame) {
+            std::vector<uint32_t> const expected = expected_due_actors(frame);
+            
+            CHECK_EQUAL(static_cast<liz_int_t>(expected.size()), 
+                        liz_lod_schedule_due_actor_count(schedule, frame));
+            
+            std::vector<uint32_t> due_actors(lod_actor_count);
+            liz_int_t const count = liz_lod_schedule_collect_due_actors(schedule, 
+                                                                        frame, 
+                                                                        &due_actors[0], 
+                                                                        lod_actor_count);
+            due_actors.resize(static_cast<std::size_t>(count));
+            std::sort(due_actors.begin(), due_actors.end());
+            
+            CHECK(expected == due_actors);
+        }
+    }
+    
+    
+    
+    TEST_FIXTURE(lod_fixture, reject_too_long_tick_intervals)
+    {
+        liz_actor_clip_set_tick_schedule(clip, 3, 8, 0);
+        
+        CHECK(!liz_lod_schedule_build(schedule, clip));
+        CHECK_EQUAL(0, liz_lod_schedule_due_actor_count(schedule, 0));
+    }
+    
+    
+    
+    TEST_FIXTURE(lod_fixture, update_due_actors_and_ingest_all_state_updates)
+    {
+        CHECK(liz_lod_schedule_build(schedule, clip));
+        
+        std::vector<liz_action_request_t> requests(lod_actor_count);
+        
+        // Frame 0: each due actor launches its deferred action.
+        liz_int_t request_count = liz_lod_schedule_update_due_actors(schedule,
+                                                                      0, // frame
+                                                                      clip,
+                                                                      proband_vm,
+                                                                      NULL, // monitor
+                                                                      NULL,
+                                                                      identity_user_data_lookup_func,
+                                                                      0, // time
+                                                                      NULL, // action_state_updates
+                                                                      0,
+                                                                      &requests[0],
+                                                                      lod_actor_count,
+                                                                      &shape);
+        std::vector<uint32_t> const due_actors = expected_due_actors(0);
+        
+        CHECK_EQUAL(static_cast<liz_int_t>(due_actors.size()), request_count);
+        for (liz_int_t i = 0; i < request_count; ++i) {
+            CHECK_EQUAL(liz_action_request_type_launch, requests[i].type);
+            CHECK(std::find(due_actors.begin(), due_actors.end(), requests[i].actor_id - 100u) != due_actors.end());
+        }
+        
+        // Actor 4 isn't due in frame 1 but still receives its state update.
+        liz_action_state_update_t updates[] = {
+            {104, 0, liz_execution_state_running},
+            {100, 0, liz_execution_state_running},
+            {999, 0, liz_execution_state_fail}
+        };
+        liz_action_state_update_sort(updates, 3);
+        
+        liz_lod_schedule_update_due_actors(schedule,
+                                           1, // frame
+                                           clip,
+                                           proband_vm,
+                                           NULL, // monitor
+                                           NULL,
+                                           identity_user_data_lookup_func,
+                                           0, // time
+                                           updates,
+                                           3,
+                                           &requests[0],
+                                           lod_actor_count,
+                                           &shape);
+        
+        liz_vm_actor_t const not_due_actor = liz_actor_clip_actor(clip, 4);
+        CHECK_EQUAL(1u, not_due_actor.header->action_state_count);
+        CHECK_EQUAL(liz_execution_state_running, not_due_actor.action_states[0]);
+    }
+    
+    
+    TEST(sort_state_updates_by_actor_then_max_shape_atom_index)
+    {
+        liz_action_state_update_t updates[] = {
+            {7, LIZ_INDEX_MAX, liz_execution_state_running},
+            {7, 0, liz_execution_state_fail},
+            {3, LIZ_INDEX_MAX, liz_execution_state_success}
+        };
+        liz_action_state_update_sort(updates, 3);
+        
+        CHECK_EQUAL(3u, updates[0].actor_id);
+        CHECK_EQUAL(7u, updates[1].actor_id);
+        CHECK_EQUAL(0u, static_cast<unsigned>(updates[1].shape_atom_index));
+        CHECK_EQUAL(7u, updates[2].actor_id);
+        CHECK_EQUAL(static_cast<unsigned>(LIZ_INDEX_MAX), static_cast<unsigned>(updates[2].shape_atom_index));
+    }
+    
+} // SUITE(liz_lod_schedule_test)
@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Checks per category memory usage telemetry via the tracking allocator and
+ * the memory size queries of liz objects.
+ */
+
+#include <cstring>
+
+#include <unittestpp.h>
+
+#include <liz/liz_common.h>
+#include <liz/liz_common_internal.h>
+#include <liz/liz_allocator.h>
+#include <liz/liz_memory_telemetry.h>
+#include <liz/liz_vm.h>
+#include <liz/liz_actor_clip.h>
+#include <liz/liz_table.h>
+
+#include "liz_test_helpers.h"
+
+
+
+SUITE(liz_memory_telemetry_test)
+{
+    namespace {
+        
+        liz_shape_specification_t const telemetry_test_spec = {
+            5, // shape_atom_count
+            1, // immediate_action_function_count
+            2, // persistent_state_count
+            3, // decider_state_capacity
+            4, // action_state_capacity
+            2, // persistent_state_change_capacity
+            3, // decider_guard_capacity
+            4, // action_request_capacity
+            0, // subtree_call_count
+            5  // shape_atom_index_count
+        };
+        
+    } // anonymous namespace
+    
+    
+    
+    TEST(record_usage_and_high_water_marks)
+    {
+        liz_memory_telemetry_t telemetry;
+        liz_memory_telemetry_init(&telemetry);
+        
+        CHECK(liz_memory_telemetry_is_balanced(&telemetry));
+        
+        liz_memory_telemetry_record_alloc(&telemetry, liz_memory_category_vm, 100);
+        liz_memory_telemetry_record_alloc(&telemetry, liz_memory_category_shape, 30);
+        liz_memory_telemetry_record_dealloc(&telemetry, liz_memory_category_vm, 100);
+        liz_memory_telemetry_record_alloc(&telemetry, liz_memory_category_vm, 40);
+        
+        liz_memory_usage_t const vm_usage = liz_memory_telemetry_usage(&telemetry, liz_memory_category_vm);
+        CHECK_EQUAL(40u, vm_usage.byte_count);
+        CHECK_EQUAL(100u, vm_usage.high_water_byte_count);
+        CHECK_EQUAL(2u, vm_usage.allocation_count);
+        CHECK_EQUAL(1u, vm_usage.deallocation_count);
+        
+        liz_memory_usage_t const total = liz_memory_telemetry_total(&telemetry);
+        CHECK_EQUAL(70u, total.byte_count);
+        CHECK_EQUAL(130u, total.high_water_byte_count);
+        CHECK(!liz_memory_telemetry_is_balanced(&telemetry));
+        
+        liz_memory_telemetry_reset_high_water(&telemetry);
+        CHECK_EQUAL(40u, liz_memory_telemetry_usage(&telemetry, liz_memory_category_vm).high_water_byte_count);
+        CHECK_EQUAL(70u, liz_memory_telemetry_total(&telemetry).high_water_byte_count);
+        
+        liz_memory_telemetry_record_dealloc(&telemetry, liz_memory_category_vm, 40);
+        liz_memory_telemetry_record_dealloc(&telemetry, liz_memory_category_shape, 30);
+        CHECK(liz_memory_telemetry_is_balanced(&telemetry));
+    }
+    
+    
+    
+    TEST(tracking_allocator_records_liz_objects_per_category)
+    {
+        counting_allocator allocator;
+        liz_memory_telemetry_t telemetry;
+        liz_memory_telemetry_init(&telemetry);
+        
+        liz_tracking_allocator_t vm_allocator;
+        liz_tracking_allocator_init(&vm_allocator, 
+                                    &telemetry, 
+                                    liz_memory_category_vm,
+                                    &allocator,
+                                    counting_alloc,
+                                    counting_dealloc);
+        liz_tracking_allocator_t clip_allocator;
+        liz_tracking_allocator_init(&clip_allocator, 
+                                    &telemetry, 
+                                    liz_memory_category_clip,
+                                    &allocator,
+                                    counting_alloc,
+                                    counting_dealloc);
+        liz_tracking_allocator_t table_allocator;
+        liz_tracking_allocator_init(&table_allocator, 
+                                    &telemetry, 
+                                    liz_memory_category_table,
+                                    &allocator,
+                                    counting_alloc,
+                                    counting_dealloc);
+        
+        liz_vm_t *vm = liz_vm_create(telemetry_test_spec, &vm_allocator, liz_tracking_alloc);
+        liz_actor_clip_t *clip = liz_actor_clip_create(telemetry_test_spec, 
+                                                       8, 
+                                                       0, 
+                                                       0, 
+                                                       &clip_allocator, 
+                                                       liz_tracking_alloc);
+        liz_table_t *table = liz_table_create(16, 8, 8, &table_allocator, liz_tracking_alloc);
+        
+        CHECK(NULL != vm);
+        CHECK(NULL != clip);
+        CHECK(NULL != table);
+        
+        CHECK_EQUAL(liz_vm_memory_size_requirement(telemetry_test_spec),
+                    liz_memory_telemetry_usage(&telemetry, liz_memory_category_vm).byte_count);
+        CHECK_EQUAL(liz_actor_clip_memory_size_requirement(telemetry_test_spec, 8),
+                    liz_memory_telemetry_usage(&telemetry, liz_memory_category_clip).byte_count);
+        CHECK_EQUAL(liz_table_memory_size_requirement(16, 8, 8),
+                    liz_memory_telemetry_usage(&telemetry, liz_memory_category_table).byte_count);
+        CHECK_EQUAL(0u, liz_memory_telemetry_usage(&telemetry, liz_memory_category_shape).byte_count);
+        
+        liz_table_destroy(table, &table_allocator, liz_tracking_dealloc);
+        liz_actor_clip_destroy(clip, &clip_allocator, liz_tracking_dealloc);
+        liz_vm_destroy(vm, &vm_allocator, liz_tracking_dealloc);
+        liz_tracking_dealloc(&vm_allocator, NULL);
+        
+        CHECK(liz_memory_telemetry_is_balanced(&telemetry));
+        CHECK_EQUAL(liz_vm_memory_size_requirement(telemetry_test_spec),
+                    liz_memory_telemetry_usage(&telemetry, liz_memory_category_vm).high_water_byte_count);
+        CHECK(allocator.is_balanced());
+    }
+    
+    
+    
+    TEST(memory_size_of_live_objects)
+    {
+        counting_allocator allocator;
+        
+        liz_vm_t *vm = liz_vm_create(telemetry_test_spec, &allocator, counting_alloc);
+        CHECK_EQUAL(liz_vm_memory_size_requirement(telemetry_test_spec), liz_vm_memory_size(vm));
+        liz_vm_destroy(vm, &allocator, counting_dealloc);
+        
+        liz_actor_clip_t *clip = liz_actor_clip_create(telemetry_test_spec, 
+                                                       8, 
+                                                       0, 
+                                                       0, 
+                                                       &allocator, 
+                                                       counting_alloc);
+        CHECK(liz_actor_clip_memory_size(clip) <= liz_actor_clip_memory_size_requirement(telemetry_test_spec, 8));
+        CHECK(liz_actor_clip_memory_size(clip) >= 8u * clip->header.actor_size);
+        liz_actor_clip_destroy(clip, &allocator, counting_dealloc);
+        
+        liz_table_t *table = liz_table_create(16, 8, 8, &allocator, counting_alloc);
+        CHECK(liz_table_memory_size(table) <= liz_table_memory_size_requirement(16, 8, 8));
+        CHECK(liz_table_memory_size(table) >= 16u * 8u);
+        liz_table_destroy(table, &allocator, counting_dealloc);
+        
+        liz_vm_shape_t shape;
+        std::memset(&shape, 0, sizeof(shape));
+        shape.spec = telemetry_test_spec;
+        CHECK_EQUAL(5u * sizeof(liz_shape_atom_t) 
+                    + 2u * sizeof(liz_index_t) 
+                    + 1u * sizeof(liz_immediate_action_func_t), 
+                    liz_vm_shape_memory_size(&shape));
+        
+        CHECK_EQUAL(sizeof(liz_actor_header_t) 
+                    + 2u * sizeof(liz_persistent_state_t)
+                    + 3u * 2u * sizeof(liz_index_t)
+                    + 4u * (sizeof(liz_index_t) + sizeof(uint8_t)),
+                    liz_vm_actor_memory_size_requirement(telemetry_test_spec));
+        
+        CHECK(allocator.is_balanced());
+    }
+    
+} // SUITE(liz_memory_telemetry_test)
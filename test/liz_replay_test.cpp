@@ -0,0 +1,415 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Checks recording actor updates and replaying and verifying them.
+ */
+
+#include <unittestpp.h>
+
+#include <cstring>
+#include <vector>
+
+#include <liz/liz_common.h>
+#include <liz/liz_common_internal.h>
+#include <liz/liz_vm.h>
+#include <liz/liz_replay.h>
+
+#include "liz_test_helpers.h"
+
+
+
+SUITE(liz_replay_test)
+{
+    namespace {
+        
+        struct scripted_blackboard {
+            liz_execution_state_t result;
+            int call_count;
+        };
+        
+        
+        // Consumes a random number on each call to check that seed changes
+        // are replayed.
+        liz_execution_state_t
+        scripted_immediate_action(void *actor_blackboard,
+                                  liz_random_number_seed_t *random_number_seed,
+                                  liz_time_t time,
+                                  liz_execution_state_t execution_request)
+        {
+            (void)time;
+            
+            scripted_blackboard *blackboard = static_cast<scripted_blackboard*>(actor_blackboard);
+            blackboard->call_count += 1;
+            *random_number_seed += 1;
+            
+            if (liz_execution_state_cancel == execution_request) {
+                return liz_execution_state_cancel;
+            }
+            
+            return blackboard->result;
+        }
+        
+        
+#if defined(LIZ_VM_MONITOR_ENABLE)
+        
+        struct monitored_arguments {
+            void const *actor_blackboard;
+            liz_vm_shape_t const *shape;
+            int call_count;
+        };
+        
+        
+        void
+        argument_monitor_func(uintptr_t user_data,
+                              liz_uint_t const node_shape_atom_index,
+                              liz_uint_t const traversal_mask,
+                              liz_vm_t const *vm,
+                              void const * LIZ_RESTRICT actor_blackboard,
+                              liz_time_t const time,
+                              liz_vm_actor_t const *actor,
+                              liz_vm_shape_t const *shape)
+        {
+            (void)node_shape_atom_index;
+            (void)traversal_mask;
+            (void)vm;
+            (void)time;
+            (void)actor;
+            
+            monitored_arguments *arguments = reinterpret_cast<monitored_arguments*>(user_data);
+            arguments->actor_blackboard = actor_blackboard;
+            arguments->shape = shape;
+            arguments->call_count += 1;
+        }
+        
+#endif // defined(LIZ_VM_MONITOR_ENABLE)
+        
+        
+        class replay_fixture : public liz_vm_test_fixture {
+        public:
+            
+            replay_fixture()
+            :   liz_vm_test_fixture()
+            ,   blackboard()
+            ,   log(1024)
+            ,   recorder()
+            ,   player()
+            {
+                push_shape_concurrent_decider(5);
+                push_shape_immediate_action(immediate_action_func_index_identity0);
+                push_shape_immediate_action(immediate_action_func_index_identity1);
+                push_shape_deferred_action(42, 7);
+                
+                create_expected_result_and_proband_vms_for_shape();
+                
+                shape.immediate_action_functions[immediate_action_func_index_identity0] = scripted_immediate_action;
+                shape.immediate_action_functions[immediate_action_func_index_identity1] = scripted_immediate_action;
+                
+                blackboard.result = liz_execution_state_running;
+                blackboard.call_count = 0;
+                proband_actor_header.user_data = reinterpret_cast<uintptr_t>(&blackboard);
+                proband_actor_header.random_number_seed = 100;
+                expected_result_actor_header.random_number_seed = 100;
+                
+                liz_replay_recorder_init(&recorder, &log[0], log.size());
+            }
+            
+            
+            void record_proband_update(liz_execution_state_t const result,
+                                       liz_action_state_update_t const *updates,
+                                       liz_int_t const update_count)
+            {
+                blackboard.result = result;
+                
+                liz_replay_record_update_actor(&recorder,
+                                               proband_vm,
+                                               NULL,
+                                               NULL,
+                                               identity_user_data_lookup_func,
+                                               static_cast<liz_time_t>(blackboard.call_count),
+                                               updates,
+                                               update_count,
+                                               &proband_actor,
+                                               &shape);
+                liz_vm_extract_actor_state(proband_vm, &proband_actor, &shape);
+            }
+            
+            
+            void record_three_frames()
+            {
+                record_proband_update(liz_execution_state_running, NULL, 0);
+                
+                liz_action_state_update_t const updates[] = {
+                    {1, 3, liz_execution_state_fail}, // Other actor.
+                    {0, 3, liz_execution_state_success}
+                };
+                record_proband_update(liz_execution_state_success, updates, 2);
+                
+                record_proband_update(liz_execution_state_fail, NULL, 0);
+            }
+            
+            
+            liz_replay_status_t replay_expected_result_update()
+            {
+                liz_replay_status_t const status = liz_replay_player_update_actor(&player,
+                                                                                  expected_result_vm,
+                                                                                  NULL,
+                                                                                  &expected_result_actor,
+                                                                                  &shape);
+                if (liz_replay_status_match == status
+                    || liz_replay_status_diverged == status) {
+                    
+                    liz_vm_extract_actor_state(expected_result_vm, &expected_result_actor, &shape);
+                }
+                
+                return status;
+            }
+            
+            
+            scripted_blackboard blackboard;
+            std::vector<uint8_t> log;
+            liz_replay_recorder_t recorder;
+            liz_replay_player_t player;
+        };
+        
+    } // anonymous namespace
+    
+    
+    
+    TEST_FIXTURE(replay_fixture, record_and_replay_updates)
+    {
+        record_three_frames();
+        
+        CHECK(!recorder.overflowed);
+        CHECK_EQUAL(5, blackboard.call_count);
+        
+        liz_replay_player_init(&player, &log[0], recorder.log_size);
+        
+        liz_replay_update_record_t record;
+        CHECK(liz_replay_player_peek(&player, &record));
+        CHECK_EQUAL(0u, record.actor_id);
+        CHECK_EQUAL(100, record.random_number_seed);
+        CHECK_EQUAL(2, record.immediate_action_call_count);
+        
+        CHECK_EQUAL(liz_replay_status_match, replay_expected_result_update());
+        CHECK_EQUAL(liz_replay_status_match, replay_expected_result_update());
+        CHECK_EQUAL(liz_replay_status_match, replay_expected_result_update());
+        CHECK_EQUAL(liz_replay_status_end_of_log, replay_expected_result_update());
+        
+        // The replay did not call the game's immediate actions.
+        CHECK_EQUAL(5, blackboard.call_count);
+        CHECK_EQUAL(proband_actor_header.random_number_seed, expected_result_actor_header.random_number_seed);
+        CHECK_EQUAL(expected_result_actor_comparator, proband_actor_comparator);
+    }
+    
+    
+    
+    TEST_FIXTURE(replay_fixture, verify_checksums_only_if_enabled)
+    {
+        record_proband_update(liz_execution_state_running, NULL, 0);
+        
+        liz_replay_update_record_t record;
+        liz_replay_player_init(&player, &log[0], recorder.log_size);
+        CHECK(liz_replay_player_peek(&player, &record));
+        CHECK_EQUAL(0u, record.flags & LIZ_REPLAY_UPDATE_RECORD_FLAG_CHECKSUM);
+        
+        liz_replay_recorder_clear(&recorder);
+        liz_replay_recorder_set_checksum_enabled(&recorder, true);
+        record_proband_update(liz_execution_state_running, NULL, 0);
+        
+        liz_replay_player_init(&player, &log[0], recorder.log_size);
+        CHECK(liz_replay_player_peek(&player, &record));
+        CHECK_EQUAL(LIZ_REPLAY_UPDATE_RECORD_FLAG_CHECKSUM, record.flags & LIZ_REPLAY_UPDATE_RECORD_FLAG_CHECKSUM);
+        
+        // A corrupted checksum makes the otherwise matching replay diverge.
+        record.result_checksum = ~record.result_checksum;
+        std::memcpy(&log[0], &record, sizeof(record));
+        
+        CHECK_EQUAL(liz_replay_status_diverged, replay_expected_result_update());
+    }
+    
+    
+    
+    TEST_FIXTURE(replay_fixture, detect_diverging_actor_state)
+    {
+        record_three_frames();
+        liz_replay_player_init(&player, &log[0], recorder.log_size);
+        
+        CHECK_EQUAL(liz_replay_status_match, replay_expected_result_update());
+        
+        // Lose the action state update for the deferred action.
+        expected_result_actor_header.action_state_count -= 1;
+        
+        CHECK_EQUAL(liz_replay_status_diverged, replay_expected_result_update());
+    }
+    
+    
+    
+    TEST_FIXTURE(replay_fixture, detect_truncated_log)
+    {
+        record_three_frames();
+        liz_replay_player_init(&player, &log[0], recorder.log_size - 1);
+        
+        CHECK_EQUAL(liz_replay_status_match, replay_expected_result_update());
+        CHECK_EQUAL(liz_replay_status_match, replay_expected_result_update());
+        CHECK_EQUAL(liz_replay_status_malformed, replay_expected_result_update());
+    }
+    
+    
+    
+    TEST_FIXTURE(replay_fixture, checksum_ignores_action_request_padding)
+    {
+        record_proband_update(liz_execution_state_running, NULL, 0);
+        
+        CHECK_EQUAL(1, liz_vm_action_request_count(proband_vm));
+        uint32_t const checksum = liz_replay_vm_result_checksum(proband_vm);
+        
+        // Scribble over the request including its padding, then restore
+        // the fields.
+        liz_vm_action_request_t const request = proband_vm->action_requests[0];
+        std::memset(&proband_vm->action_requests[0], 0xab, sizeof(request));
+        proband_vm->action_requests[0].action_id = request.action_id;
+        proband_vm->action_requests[0].resource_id = request.resource_id;
+        proband_vm->action_requests[0].shape_atom_index = request.shape_atom_index;
+        
+        CHECK_EQUAL(checksum, liz_replay_vm_result_checksum(proband_vm));
+    }
+    
+    
+    
+    TEST_FIXTURE(replay_fixture, drop_records_after_overflow_until_cleared)
+    {
+        liz_replay_recorder_init(&recorder, &log[0], sizeof(liz_replay_update_record_t));
+        
+        record_proband_update(liz_execution_state_running, NULL, 0);
+        
+        CHECK(recorder.overflowed);
+        CHECK_EQUAL(0u, recorder.log_size);
+        CHECK_EQUAL(2, blackboard.call_count);
+        
+        record_proband_update(liz_execution_state_running, NULL, 0);
+        
+        CHECK_EQUAL(0u, recorder.log_size);
+        CHECK_EQUAL(4, blackboard.call_count);
+        
+        liz_replay_recorder_clear(&recorder);
+        
+        CHECK(!recorder.overflowed);
+    }
+    
+#if defined(LIZ_VM_MONITOR_ENABLE)
+    
+    TEST_FIXTURE(replay_fixture, pass_blackboard_and_shape_to_monitors)
+    {
+        monitored_arguments arguments = {NULL, NULL, 0};
+        liz_vm_monitor_t argument_monitor = {
+            reinterpret_cast<uintptr_t>(&arguments),
+            argument_monitor_func,
+            NULL
+        };
+        
+        liz_replay_record_update_actor(&recorder,
+                                       proband_vm,
+                                       &argument_monitor,
+                                       NULL,
+                                       identity_user_data_lookup_func,
+                                       0, // time
+                                       NULL,
+                                       0,
+                                       &proband_actor,
+                                       &shape);
+        
+        CHECK(0 < arguments.call_count);
+        CHECK_EQUAL(static_cast<void const*>(&blackboard), arguments.actor_blackboard);
+        CHECK_EQUAL(&shape, arguments.shape);
+        
+        arguments.actor_blackboard = &arguments;
+        arguments.shape = NULL;
+        arguments.call_count = 0;
+        liz_replay_player_init(&player, &log[0], recorder.log_size);
+        
+        CHECK_EQUAL(liz_replay_status_match, liz_replay_player_update_actor(&player,
+                                                                            expected_result_vm,
+                                                                            &argument_monitor,
+                                                                            &expected_result_actor,
+                                                                            &shape));
+        
+        CHECK(0 < arguments.call_count);
+        CHECK_EQUAL(static_cast<void const*>(NULL), arguments.actor_blackboard);
+        CHECK_EQUAL(&shape, arguments.shape);
+    }
+    
+#endif // defined(LIZ_VM_MONITOR_ENABLE)
+    
+    
+    
+    TEST_FIXTURE(liz_vm_test_fixture, drop_record_exceeding_call_byte_count)
+    {
+        // Each call appends its request and result byte and the changed seed.
+        liz_int_t const immediate_action_count = 1 + UINT16_MAX / (1 + static_cast<liz_int_t>(sizeof(liz_random_number_seed_t)));
+        
+        push_shape_concurrent_decider(static_cast<liz_index_t>(1 + immediate_action_count));
+        for (liz_int_t i = 0; i < immediate_action_count; ++i) {
+            push_shape_immediate_action(immediate_action_func_index_identity0);
+        }
+        
+        create_expected_result_and_proband_vms_for_shape();
+        
+        shape.immediate_action_functions[immediate_action_func_index_identity0] = scripted_immediate_action;
+        
+        scripted_blackboard blackboard = {liz_execution_state_success, 0};
+        proband_actor_header.user_data = reinterpret_cast<uintptr_t>(&blackboard);
+        
+        std::vector<uint8_t> log(2 * UINT16_MAX);
+        liz_replay_recorder_t recorder;
+        liz_replay_recorder_init(&recorder, &log[0], log.size());
+        
+        liz_replay_record_update_actor(&recorder,
+                                       proband_vm,
+                                       NULL,
+                                       NULL,
+                                       identity_user_data_lookup_func,
+                                       0, // time
+                                       NULL,
+                                       0,
+                                       &proband_actor,
+                                       &shape);
+        
+        CHECK_EQUAL(static_cast<int>(immediate_action_count), blackboard.call_count);
+        CHECK(recorder.overflowed);
+        CHECK_EQUAL(0u, recorder.log_size);
+    }
+    
+} // SUITE(liz_replay_test)
+
@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Checks writing, validating, and loading relocatable shape blobs.
+ */
+
+#include <unittestpp.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <liz/liz_common.h>
+#include <liz/liz_common_internal.h>
+#include <liz/liz_vm.h>
+#include <liz/liz_shape_blob.h>
+
+#include "liz_test_helpers.h"
+
+
+
+SUITE(liz_shape_blob_test)
+{
+    namespace {
+        
+        char const* const immediate_action_names[liz_vm_test_fixture::shape_immediate_action_function_count] = {
+            "identity0",
+            "identity1",
+            "running2",
+            "success3",
+            "fail4",
+            "cancel5"
+        };
+        
+        
+        // Registered in a different order than used by the shape.
+        char const* const registry_names[liz_vm_test_fixture::shape_immediate_action_function_count] = {
+            "cancel5",
+            "fail4",
+            "success3",
+            "running2",
+            "identity1",
+            "identity0"
+        };
+        
+        liz_immediate_action_func_t const registry_functions[liz_vm_test_fixture::shape_immediate_action_function_count] = {
+            immediate_action_func_cancel5,
+            immediate_action_func_fail4,
+            immediate_action_func_success3,
+            immediate_action_func_running2,
+            immediate_action_func_identity1,
+            immediate_action_func_identity0
+        };
+        
+        
+        class shape_blob_fixture : public liz_vm_test_fixture {
+        public:
+            
+            shape_blob_fixture()
+            :   liz_vm_test_fixture()
+            ,   blob()
+            ,   resolved_functions(shape_immediate_action_function_count)
+            ,   registry()
+            {
+                registry.names = registry_names;
+                registry.functions = registry_functions;
+                registry.count = shape_immediate_action_function_count;
+                
+                push_shape_concurrent_decider(5);
+                push_shape_persistent_action();
+                push_shape_immediate_action(immediate_action_func_index_running2);
+                push_shape_deferred_action(42, 7);
+                
+                create_expected_result_and_proband_vms_for_shape();
+            }
+            
+            
+            std::size_t write_blob()
+            {
+                std::size_t const blob_size = liz_shape_blob_memory_size_requirement(&shape, 
+                                                                                     immediate_action_names);
+                
+                // Backed by uint64_t to fulfill the blob alignment.
+                blob.resize((blob_size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+                
+                return liz_shape_blob_write(&blob[0], 
+                                            blob.size() * sizeof(uint64_t), 
+                                            &shape, 
+                                            immediate_action_names);
+            }
+            
+            
+            std::vector<uint64_t> blob;
+            std::vector<liz_immediate_action_func_t> resolved_functions;
+            liz_immediate_action_registry_t registry;
+        };
+        
+    } // anonymous namespace
+    
+    
+    
+    TEST(registry_lookup)
+    {
+        liz_immediate_action_registry_t registry = {
+            registry_names,
+            registry_functions,
+            liz_vm_test_fixture::shape_immediate_action_function_count
+        };
+        
+        CHECK(immediate_action_func_success3 == liz_immediate_action_registry_lookup(&registry, "success3"));
+        CHECK(NULL == liz_immediate_action_registry_lookup(&registry, "success4"));
+    }
+    
+    
+    
+    TEST_FIXTURE(shape_blob_fixture, write_and_validate_blob)
+    {
+        std::size_t const blob_size = write_blob();
+        
+        CHECK(0 != blob_size);
+        CHECK_EQUAL(liz_shape_blob_memory_size_requirement(&shape, immediate_action_names), blob_size);
+        CHECK(liz_shape_blob_is_valid(&blob[0], blob_size));
+        CHECK_EQUAL(shape.spec, liz_shape_blob_specification(&blob[0]));
+        CHECK(0 == std::strcmp("fail4", liz_shape_blob_immediate_action_name(&blob[0], immediate_action_func_index_fail4)));
+    }
+    
+    
+    
+    TEST_FIXTURE(shape_blob_fixture, write_into_too_small_buffer)
+    {
+        std::size_t const blob_size = liz_shape_blob_memory_size_requirement(&shape, 
+                                                                             immediate_action_names);
+        blob.resize(blob_size / sizeof(uint64_t));
+        
+        CHECK_EQUAL(0u, liz_shape_blob_write(&blob[0], 
+                                             blob_size - 1, 
+                                             &shape, 
+                                             immediate_action_names));
+    }
+    
+    
+    
+    TEST_FIXTURE(shape_blob_fixture, reject_invalid_blobs)
+    {
+        std::size_t const blob_size = write_blob();
+        
+        CHECK(!liz_shape_blob_is_valid(NULL, blob_size));
+        CHECK(!liz_shape_blob_is_valid(&blob[0], blob_size - 1));
+        CHECK(!liz_shape_blob_is_valid(&blob[0], sizeof(liz_shape_blob_header_t) - 1));
+        
+        liz_shape_blob_header_t *header = reinterpret_cast<liz_shape_blob_header_t*>(&blob[0]);
+        
+        header->version += 1;
+        CHECK(!liz_shape_blob_is_valid(&blob[0], blob_size));
+        header->version -= 1;
+        
+        header->atoms_offset = static_cast<uint32_t>(blob_size);
+        CHECK(!liz_shape_blob_is_valid(&blob[0], blob_size));
+    }
+    
+    
+    
+    TEST_FIXTURE(shape_blob_fixture, resolve_unregistered_immediate_action)
+    {
+        write_blob();
+        
+        registry.count -= 1; // Drops identity0.
+        
+        CHECK(!liz_shape_blob_resolve_immediate_action_functions(&blob[0], 
+                                                                 &registry, 
+                                                                 &resolved_functions[0], 
+                                                                 shape_immediate_action_function_count));
+    }
+    
+    
+    
+    TEST_FIXTURE(shape_blob_fixture, update_actor_with_relocated_blob_shape)
+    {
+        std::size_t const blob_size = write_blob();
+        
+        // Move the blob to another address to show that it is relocatable.
+        std::vector<uint64_t> relocated_blob(blob);
+        std::fill(blob.begin(), blob.end(), 0);
+        
+        CHECK(liz_shape_blob_is_valid(&relocated_blob[0], blob_size));
+        CHECK(liz_shape_blob_resolve_immediate_action_functions(&relocated_blob[0], 
+                                                                &registry, 
+                                                                &resolved_functions[0], 
+                                                                shape_immediate_action_function_count));
+        
+        liz_vm_shape_t blob_shape;
+        liz_shape_blob_get_shape(&relocated_blob[0], 
+                                 &resolved_functions[0],
+                                 &blob_shape);
+        
+        set_actor_persistent_state(target_select_both,
+                                   0, // persistent state index
+                                   1, // shape_atom_index
+                                   liz_execution_state_running);
+        
+        liz_vm_update_actor(expected_result_vm,
+                            NULL,
+                            NULL,
+                            identity_user_data_lookup_func,
+                            0.0,
+                            &expected_result_actor,
+                            &shape);
+        liz_vm_update_actor(proband_vm,
+                            NULL,
+                            NULL,
+                            identity_user_data_lookup_func,
+                            0.0,
+                            &proband_actor,
+                            &blob_shape);
+        
+        CHECK_EQUAL(expected_result_vm_extractable_state_comparator, 
+                    proband_vm_extractable_state_comparator);
+        CHECK_ARRAY_EQUAL(expected_result_blackboard, 
+                          proband_blackboard, 
+                          shape_immediate_action_function_count);
+    }
+    
+} // SUITE(liz_shape_blob_test)
+
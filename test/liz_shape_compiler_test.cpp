@@ -0,0 +1,408 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Checks the generated C source and that the update function compiled from
+ * it matches the interpreting vm. liz_compiled_test_shape.h is the 
+ * unedited output of liz_shape_compile_to_c for the compiled test shape 
+ * with the function name liz_compiled_test_shape_update_actor and the 
+ * compiled function names below, a test compares it against a fresh 
+ * compilation to catch stale output.
+ *
+ * The build defines LIZ_TEST_SOURCE_DIRECTORY as the path of the test 
+ * directory including the trailing separator, otherwise the tests are 
+ * expected to run from the repository root.
+ */
+
+#include <unittestpp.h>
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <liz/liz_common.h>
+#include <liz/liz_vm.h>
+#include <liz/liz_shape_compiler.h>
+
+#include "liz_test_helpers.h"
+#include "liz_compiled_test_shape.h"
+
+
+
+#if !defined(LIZ_TEST_SOURCE_DIRECTORY)
+#   define LIZ_TEST_SOURCE_DIRECTORY "test/"
+#endif
+
+
+
+SUITE(liz_shape_compiler_test)
+{
+    namespace {
+        
+        liz_vm_monitor_t *monitor_null = NULL;
+        void* user_data_lookup_context_null = NULL;
+        liz_time_t const update_time_zero = 0;
+        
+        
+        
+        // Names of the fixture's immediate action functions the compiled 
+        // test shape calls directly.
+        char const *compiled_function_names[liz_vm_test_fixture::shape_immediate_action_function_count] = {
+            NULL,
+            NULL,
+            "immediate_action_func_running2",
+            NULL,
+            NULL,
+            NULL
+        };
+        
+        
+        
+        // Returns the checked-in liz_compiled_test_shape.h or an empty string
+        // if it can't be read.
+        std::string
+        read_compiled_test_shape_source()
+        {
+            std::ifstream file(LIZ_TEST_SOURCE_DIRECTORY "liz_compiled_test_shape.h", std::ios::in | std::ios::binary);
+            std::ostringstream source;
+            
+            if (file) {
+                source << file.rdbuf();
+            }
+            
+            return source.str();
+        }
+        
+        
+        
+        typedef std::vector<std::pair<liz_uint_t, liz_uint_t> > node_traversal_log;
+        
+        
+#if defined(LIZ_VM_MONITOR_ENABLE)
+        // Logs the shape atom index and traversal mask of each monitored 
+        // node, ignoring which vm and actor traversed it.
+        void
+        node_traversal_logging_monitor_func(uintptr_t user_data,
+                                            liz_uint_t node_shape_atom_index,
+                                            liz_uint_t traversal_mask,
+                                            liz_vm_t const *vm,
+                                            void const *actor_blackboard,
+                                            liz_time_t time,
+                                            liz_vm_actor_t const *actor,
+                                            liz_vm_shape_t const *shape)
+        {
+            (void)vm;
+            (void)actor_blackboard;
+            (void)time;
+            (void)actor;
+            (void)shape;
+            
+            reinterpret_cast<node_traversal_log *>(user_data)->push_back(std::make_pair(node_shape_atom_index, traversal_mask));
+        }
+#endif // defined(LIZ_VM_MONITOR_ENABLE)
+        
+        
+        
+        class compiler_fixture : public liz_vm_test_fixture {
+        public:
+            
+            // Regenerate liz_compiled_test_shape.h when changing the shape.
+            void push_compiled_test_shape()
+            {
+                push_shape_concurrent_decider(8); // shape_atom_index 0
+                {
+                    push_shape_dynamic_priority_decider(4); // shape_atom_index 1
+                    {
+                        push_shape_persistent_action(); // shape_atom_index 2
+                        push_shape_deferred_action(1, 1); // shape_atom_index 3-4
+                    }
+                    
+                    push_shape_sequence_decider(3); // shape_atom_index 5
+                    {
+                        // Called through the shape's function table.
+                        push_shape_immediate_action(immediate_action_func_index_success3); // shape_atom_index 6
+                        
+                        // Called directly.
+                        push_shape_immediate_action(immediate_action_func_index_running2); // shape_atom_index 7
+                    }
+                }
+                
+                create_expected_result_and_proband_vms_for_shape();
+            }
+            
+            
+            std::string compile(char const * const *function_names,
+                                char const *function_name = "compiled_update_actor")
+            {
+                liz_int_t const length = liz_shape_compile_to_c(NULL, 0, function_name, &shape, function_names);
+                
+                std::vector<char> source(static_cast<std::size_t>(length) + 1u, 'x');
+                liz_int_t const written_length = liz_shape_compile_to_c(&source[0],
+                                                                        static_cast<liz_int_t>(source.size()),
+                                                                        function_name,
+                                                                        &shape,
+                                                                        function_names);
+                CHECK_EQUAL(length, written_length);
+                
+                return std::string(&source[0]);
+            }
+            
+            
+            // Updates the expected result actor with the interpreting vm and
+            // the proband actor with the compiled update function.
+            void update_vms(liz_vm_monitor_t *expected_result_monitor = monitor_null,
+                            liz_vm_monitor_t *proband_update_monitor = monitor_null)
+            {
+                liz_vm_update_actor(expected_result_vm,
+                                    expected_result_monitor,
+                                    user_data_lookup_context_null,
+                                    identity_user_data_lookup_func,
+                                    update_time_zero,
+                                    &expected_result_actor,
+                                    &shape);
+                
+                liz_compiled_test_shape_update_actor(proband_vm,
+                                                     proband_update_monitor,
+                                                     user_data_lookup_context_null,
+                                                     identity_user_data_lookup_func,
+                                                     update_time_zero,
+                                                     &proband_actor,
+                                                     &shape);
+            }
+            
+            
+            void check_equal_updates()
+            {
+                CHECK_EQUAL(expected_result_vm_comparator, 
+                            proband_vm_comparator);
+                CHECK_EQUAL(expected_result_vm->execution_state, proband_vm->execution_state);
+                CHECK_EQUAL(expected_result_vm->actor_random_number_seed, proband_vm->actor_random_number_seed);
+                CHECK_EQUAL(expected_result_vm->action_request_stack_header, proband_vm->action_request_stack_header);
+                CHECK_ARRAY_EQUAL(expected_result_blackboard, 
+                                  proband_blackboard, 
+                                  shape_immediate_action_function_count);
+            }
+        };
+        
+    } // anonymous namespace
+    
+    
+    
+    TEST_FIXTURE(compiler_fixture, compile_calls_named_functions_directly)
+    {
+        push_compiled_test_shape();
+        
+        std::string const source = compile(compiled_function_names);
+        
+        CHECK(std::string::npos != source.find("compiled_update_actor(liz_vm_t *vm,"));
+        CHECK(std::string::npos != source.find("execution_state = shape->immediate_action_functions[3](actor_blackboard,"));
+        CHECK(std::string::npos != source.find("execution_state = immediate_action_func_running2(actor_blackboard,"));
+    }
+    
+    
+    
+    TEST_FIXTURE(compiler_fixture, compile_writes_structured_control_flow)
+    {
+        push_compiled_test_shape();
+        
+        std::string const source = compile(compiled_function_names);
+        
+        // No interpreter loop.
+        CHECK(std::string::npos == source.find("liz_vm_step("));
+        CHECK(std::string::npos == source.find("while"));
+        CHECK(std::string::npos == source.find("switch"));
+        
+        // Each decider child is entered if its decider chose it and guarded
+        // by a direct call for the decider's type.
+        CHECK(std::string::npos != source.find("if (1 == vm->shape_atom_index) {"));
+        CHECK(std::string::npos != source.find("if (5 == vm->shape_atom_index) {"));
+        CHECK(std::string::npos != source.find("if (7 == vm->shape_atom_index) {"));
+        CHECK(std::string::npos == source.find("if (4 == vm->shape_atom_index) {"));
+        CHECK(std::string::npos != source.find("liz_vm_guard_concurrent_decider(vm);"));
+        CHECK(std::string::npos != source.find("liz_vm_guard_dynamic_priority_decider(vm);"));
+        CHECK(std::string::npos != source.find("liz_vm_guard_sequence_decider(vm);"));
+        
+        // Shape atoms and persistent states at constant offsets.
+        CHECK(std::string::npos != source.find("liz_vm_invoke_sequence_decider(vm, actor, &shape->atoms[5]);"));
+        CHECK(std::string::npos != source.find("liz_vm_invoke_deferred_action(vm, actor, &shape->atoms[3]);"));
+        CHECK(std::string::npos != source.find("actor->persistent_states[0].persistent_action.state"));
+    }
+    
+    
+    
+    TEST_FIXTURE(compiler_fixture, checked_in_source_matches_fresh_compilation)
+    {
+        push_compiled_test_shape();
+        
+        std::string const checked_in_source = read_compiled_test_shape_source();
+        
+        CHECK(!checked_in_source.empty());
+        CHECK(compile(compiled_function_names, "liz_compiled_test_shape_update_actor") == checked_in_source);
+    }
+    
+    
+    
+    TEST_FIXTURE(compiler_fixture, compile_without_names_uses_function_table)
+    {
+        push_compiled_test_shape();
+        
+        std::string const source = compile(NULL);
+        
+        CHECK(std::string::npos == source.find("immediate_action_func_"));
+        CHECK(std::string::npos != source.find("execution_state = shape->immediate_action_functions[3](actor_blackboard,"));
+        CHECK(std::string::npos != source.find("execution_state = shape->immediate_action_functions[2](actor_blackboard,"));
+    }
+    
+    
+    
+    TEST_FIXTURE(compiler_fixture, compile_truncates_and_rejects_invalid_input)
+    {
+        push_compiled_test_shape();
+        
+        liz_int_t const length = liz_shape_compile_to_c(NULL, 0, "compiled_update_actor", &shape, NULL);
+        CHECK(0 < length);
+        
+        char truncated[16];
+        CHECK_EQUAL(length, liz_shape_compile_to_c(truncated, 16, "compiled_update_actor", &shape, NULL));
+        CHECK_EQUAL(15u, std::strlen(truncated));
+        
+        CHECK_EQUAL(-1, liz_shape_compile_to_c(NULL, 0, NULL, &shape, NULL));
+    }
+    
+    
+    
+    TEST_FIXTURE(compiler_fixture, compile_rejects_childless_decider)
+    {
+        push_shape_sequence_decider(2); // shape_atom_index 0
+        {
+            push_shape_immediate_action(immediate_action_func_index_success3); // shape_atom_index 1
+        }
+        
+        // Cut the only child off its decider.
+        shape_atoms[0].sequence_decider.end_offset = 1;
+        
+        CHECK_EQUAL(-1, liz_shape_compile_to_c(NULL, 0, "compiled_update_actor", &shape, NULL));
+    }
+    
+    
+    
+    TEST_FIXTURE(compiler_fixture, compiled_update_matches_launching_actor)
+    {
+        push_compiled_test_shape();
+        
+        set_actor_persistent_state(target_select_both, 0, 2, liz_execution_state_fail);
+        
+        update_vms();
+        
+        check_equal_updates();
+        CHECK_EQUAL(1, liz_lookaside_double_stack_count(&proband_vm->action_request_stack_header,
+                                                        LIZ_VM_ACTION_REQUEST_STACK_SIDE_LAUNCH));
+    }
+    
+    
+    
+    TEST_FIXTURE(compiler_fixture, compiled_update_matches_cancelling_actor)
+    {
+        push_compiled_test_shape();
+        
+        set_actor_persistent_state(target_select_both, 0, 2, liz_execution_state_success);
+        push_actor_action_state(target_select_both, 3, liz_execution_state_running);
+        
+        update_vms();
+        
+        check_equal_updates();
+        CHECK_EQUAL(1, liz_lookaside_double_stack_count(&proband_vm->action_request_stack_header,
+                                                        LIZ_VM_ACTION_REQUEST_STACK_SIDE_CANCEL));
+    }
+    
+    
+    
+    TEST_FIXTURE(compiler_fixture, compiled_update_matches_running_actor)
+    {
+        push_compiled_test_shape();
+        
+        set_actor_persistent_state(target_select_both, 0, 2, liz_execution_state_fail);
+        push_actor_decider_state(target_select_both, 5, 7);
+        push_actor_action_state(target_select_both, 3, liz_execution_state_running);
+        push_actor_action_state(target_select_both, 7, liz_execution_state_running);
+        
+        update_vms();
+        
+        check_equal_updates();
+        
+        // The sequence resumed at its reached child.
+        CHECK(liz_execution_state_success != proband_blackboard[immediate_action_func_index_success3]);
+        CHECK_EQUAL(liz_execution_state_running, proband_blackboard[immediate_action_func_index_running2]);
+    }
+    
+    
+    
+    TEST_FIXTURE(compiler_fixture, compiled_update_monitors_like_interpreter)
+    {
+        push_compiled_test_shape();
+        
+        set_actor_persistent_state(target_select_both, 0, 2, liz_execution_state_success);
+        push_actor_action_state(target_select_both, 3, liz_execution_state_running);
+        
+        node_traversal_log expected_result_log;
+        node_traversal_log proband_log;
+        liz_vm_monitor_t expected_result_node_monitor = {
+            reinterpret_cast<uintptr_t>(&expected_result_log),
+            NULL,
+            NULL
+        };
+        liz_vm_monitor_t proband_node_monitor = {
+            reinterpret_cast<uintptr_t>(&proband_log),
+            NULL,
+            NULL
+        };
+#if defined(LIZ_VM_MONITOR_ENABLE)
+        expected_result_node_monitor.func = node_traversal_logging_monitor_func;
+        proband_node_monitor.func = node_traversal_logging_monitor_func;
+#endif
+        
+        update_vms(&expected_result_node_monitor, &proband_node_monitor);
+        
+        check_equal_updates();
+        CHECK_EQUAL(expected_result_log.size(), proband_log.size());
+        CHECK(expected_result_log == proband_log);
+#if defined(LIZ_VM_MONITOR_ENABLE)
+        CHECK(!proband_log.empty());
+#endif
+    }
+    
+} // SUITE(liz_shape_compiler_test)
@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Checks time sliced actor clip updates.
+ */
+
+#include <unittestpp.h>
+
+#include <vector>
+
+#include <liz/liz_common.h>
+#include <liz/liz_vm.h>
+#include <liz/liz_actor_clip.h>
+#include <liz/liz_sliced_update.h>
+
+#include "liz_test_helpers.h"
+
+
+
+SUITE(liz_sliced_update_test)
+{
+    namespace {
+        
+        liz_int_t const sliced_actor_count = 3;
+        liz_int_t const sliced_deferred_action_count = 4;
+        
+        
+        class sliced_fixture : public liz_vm_test_fixture {
+        public:
+            
+            sliced_fixture()
+            :   liz_vm_test_fixture()
+            ,   allocator()
+            ,   clip(NULL)
+            ,   sliced_update(NULL)
+            ,   requests()
+            {
+                push_shape_concurrent_decider(1 + 2 * sliced_deferred_action_count // shape atom end offset
+                                              );
+                for (liz_int_t i = 0; i < sliced_deferred_action_count; ++i) {
+                    push_shape_deferred_action(static_cast<uint32_t>(42 + i), // action_id
+                                               7 // resource_id
+                                               );
+                }
+                
+                create_expected_result_and_proband_vms_for_shape();
+                
+                clip = liz_actor_clip_create(shape.spec, 
+                                             sliced_actor_count, 
+                                             1, // clip_id
+                                             1, // shape_id
+                                             &allocator, 
+                                             counting_alloc);
+                
+                for (liz_int_t i = 0; i < sliced_actor_count; ++i) {
+                    liz_actor_clip_add_actor(clip, 
+                                             static_cast<liz_id_t>(100 + i),
+                                             0, // user_data
+                                             0); // random_number_seed
+                }
+                
+                sliced_update = liz_sliced_update_create(shape.spec, 
+                                                         &allocator, 
+                                                         counting_alloc);
+                
+                requests.resize(static_cast<std::size_t>(sliced_actor_count * sliced_deferred_action_count));
+            }
+            
+            
+            ~sliced_fixture()
+            {
+                liz_sliced_update_destroy(sliced_update, &allocator, counting_dealloc);
+                liz_actor_clip_destroy(clip, &allocator, counting_dealloc);
+            }
+            
+            
+            liz_int_t run(liz_update_budget_t const budget,
+                          uint32_t const *actor_indices,
+                          liz_int_t const actor_index_count,
+                          liz_int_t const request_offset)
+            {
+                return liz_sliced_update_run(sliced_update,
+                                             budget,
+                                             clip,
+                                             actor_indices,
+                                             actor_index_count,
+                                             NULL, // monitor
+                                             NULL,
+                                             identity_user_data_lookup_func,
+                                             0, // time
+                                             &requests[0] + request_offset,
+                                             static_cast<liz_int_t>(requests.size()) - request_offset,
+                                             &shape);
+            }
+            
+            
+            counting_allocator allocator;
+            liz_actor_clip_t *clip;
+            liz_sliced_update_t *sliced_update;
+            std::vector<liz_action_request_t> requests;
+        };
+        
+        
+        liz_update_budget_t const unlimited_budget = {
+            0, // max_step_count
+            0 // max_cycle_count
+        };
+        
+    } // anonymous namespace
+    
+    
+    
+    TEST(create_and_destroy)
+    {
+        counting_allocator allocator;
+        
+        liz_shape_specification_t spec = {};
+        spec.action_request_capacity = 4;
+        spec.action_state_capacity = 4;
+        spec.decider_guard_capacity = 2;
+        
+        liz_sliced_update_t *sliced_update = liz_sliced_update_create(spec, 
+                                                                      &allocator, 
+                                                                      counting_alloc);
+        CHECK(NULL != sliced_update);
+        CHECK(!liz_sliced_update_is_pending(sliced_update));
+        CHECK(liz_vm_fulfills_shape_specification(sliced_update->vm, spec));
+        
+        liz_sliced_update_destroy(sliced_update, &allocator, counting_dealloc);
+        
+        CHECK(allocator.is_balanced());
+    }
+    
+    
+    
+    TEST_FIXTURE(sliced_fixture, unlimited_budget_updates_whole_batch)
+    {
+        liz_int_t const request_count = run(unlimited_budget, NULL, sliced_actor_count, 0);
+        
+        CHECK_EQUAL(sliced_actor_count * sliced_deferred_action_count, request_count);
+        CHECK(!liz_sliced_update_is_pending(sliced_update));
+        
+        for (liz_int_t i = 0; i < sliced_actor_count; ++i) {
+            liz_vm_actor_t const actor = liz_actor_clip_actor(clip, i);
+            
+            CHECK_EQUAL(static_cast<liz_index_t>(sliced_deferred_action_count), actor.header->action_state_count);
+            
+            for (liz_int_t k = 0; k < sliced_deferred_action_count; ++k) {
+                CHECK_EQUAL(actor.header->actor_id, 
+                            requests[static_cast<std::size_t>(i * sliced_deferred_action_count + k)].actor_id);
+            }
+        }
+    }
+    
+    
+    
+    TEST_FIXTURE(sliced_fixture, step_budget_parks_and_resumes_actors)
+    {
+        run(unlimited_budget, NULL, 1, 0);
+        liz_int_t const actor_step_count = liz_sliced_update_last_step_count(sliced_update);
+        CHECK(1 < actor_step_count);
+        
+        liz_actor_clip_clear(clip);
+        for (liz_int_t i = 0; i < sliced_actor_count; ++i) {
+            liz_actor_clip_add_actor(clip, static_cast<liz_id_t>(100 + i), 0, 0);
+        }
+        
+        liz_update_budget_t const budget = {
+            3, // max_step_count
+            0 // max_cycle_count
+        };
+        
+        liz_int_t request_count = 0;
+        liz_int_t step_count = 0;
+        liz_int_t call_count = 0;
+        
+        do {
+            request_count += run(budget, NULL, sliced_actor_count, request_count);
+            
+            CHECK(budget.max_step_count >= liz_sliced_update_last_step_count(sliced_update));
+            step_count += liz_sliced_update_last_step_count(sliced_update);
+            ++call_count;
+            
+            // Parked actors keep their states until their update finishes.
+            if (liz_sliced_update_is_pending(sliced_update)) {
+                CHECK_EQUAL(0u, liz_actor_clip_actor(clip, sliced_actor_count - 1).header->action_state_count);
+            }
+        } while (liz_sliced_update_is_pending(sliced_update) && call_count < 1000);
+        
+        CHECK_EQUAL(sliced_actor_count * actor_step_count, step_count);
+        CHECK_EQUAL((step_count + budget.max_step_count - 1) / budget.max_step_count, call_count);
+        CHECK_EQUAL(sliced_actor_count * sliced_deferred_action_count, request_count);
+        
+        for (liz_int_t i = 0; i < sliced_actor_count; ++i) {
+            liz_vm_actor_t const actor = liz_actor_clip_actor(clip, i);
+            
+            CHECK_EQUAL(static_cast<liz_index_t>(sliced_deferred_action_count), actor.header->action_state_count);
+            CHECK_EQUAL(actor.header->actor_id, 
+                        requests[static_cast<std::size_t>(i * sliced_deferred_action_count)].actor_id);
+        }
+    }
+    
+    
+    
+    TEST_FIXTURE(sliced_fixture, insufficient_request_capacity_defers_actors)
+    {
+        liz_int_t const request_offset = static_cast<liz_int_t>(requests.size()) - 1;
+        
+        CHECK_EQUAL(0, run(unlimited_budget, NULL, sliced_actor_count, request_offset));
+        CHECK_EQUAL(0, liz_sliced_update_last_step_count(sliced_update));
+        CHECK(liz_sliced_update_is_pending(sliced_update));
+        
+        CHECK_EQUAL(sliced_actor_count * sliced_deferred_action_count,
+                    run(unlimited_budget, NULL, sliced_actor_count, 0));
+        CHECK(!liz_sliced_update_is_pending(sliced_update));
+    }
+    
+    
+    
+    TEST_FIXTURE(sliced_fixture, update_indexed_batch)
+    {
+        uint32_t const actor_indices[] = {2, 0};
+        
+        liz_int_t const request_count = run(unlimited_budget, actor_indices, 2, 0);
+        
+        CHECK_EQUAL(2 * sliced_deferred_action_count, request_count);
+        CHECK_EQUAL(102u, requests[0].actor_id);
+        CHECK_EQUAL(100u, requests[static_cast<std::size_t>(sliced_deferred_action_count)].actor_id);
+        CHECK_EQUAL(0u, liz_actor_clip_actor(clip, 1).header->action_state_count);
+    }
+    
+} // SUITE(liz_sliced_update_test)
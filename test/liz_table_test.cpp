@@ -39,6 +39,8 @@
 
 #include <unittestpp.h>
 
+#include <vector>
+
 
 #include "liz_test_helpers.h"
 
@@ -1183,5 +1185,209 @@ SUITE(liz_table_test)
     }
     
     
+    TEST(add_batch_returns_contiguous_data_slots)
+    {
+        counting_allocator allocator;
+        
+        liz_table_t *table = liz_table_create(8,
+                                              sizeof(int32_t),
+                                              sizeof(int32_t),
+                                              &allocator,
+                                              counting_alloc);
+        
+        liz_id_t const single_id = liz_table_add(table);
+        
+        liz_id_t ids[5];
+        liz_int_t const first_index = liz_table_add_batch(table, ids, 5);
+        
+        CHECK_EQUAL(1, first_index);
+        CHECK_EQUAL(6, liz_table_count(table));
+        CHECK(liz_table_contains(table, single_id));
+        
+        for (liz_int_t i = 0; i < 5; ++i) {
+            CHECK(liz_table_contains(table, ids[i]));
+            CHECK_EQUAL(ids[i], liz_table_data_id(table, first_index + i));
+            CHECK_EQUAL(liz_table_data(table, first_index + i), liz_table_lookup(table, ids[i]));
+            CHECK_EQUAL(ids[0] + (liz_id_t)i, ids[i]);
+        }
+        
+        liz_table_destroy(table, &allocator, counting_dealloc);
+        
+        CHECK(allocator.is_balanced());
+    }
+    
+    
+    TEST(remove_batch_compacts_in_one_pass)
+    {
+        counting_allocator allocator;
+        
+        liz_table_t *table = liz_table_create(16,
+                                              sizeof(int32_t),
+                                              sizeof(int32_t),
+                                              &allocator,
+                                              counting_alloc);
+        
+        liz_id_t ids[10];
+        liz_table_add_batch(table, ids, 10);
+        for (liz_int_t i = 0; i < 10; ++i) {
+            *static_cast<int32_t *>(liz_table_lookup(table, ids[i])) = static_cast<int32_t>(i);
+        }
+        
+        liz_id_t const removed_ids[] = {ids[0], ids[9], ids[4], ids[8]};
+        liz_table_remove_batch(table, removed_ids, 4);
+        
+        CHECK_EQUAL(6, liz_table_count(table));
+        
+        int32_t const kept_values[] = {1, 2, 3, 5, 6, 7};
+        for (std::size_t i = 0; i < sizeof(kept_values) / sizeof(kept_values[0]); ++i) {
+            liz_id_t const id = ids[kept_values[i]];
+            CHECK(liz_table_contains(table, id));
+            CHECK_EQUAL(kept_values[i], *static_cast<int32_t *>(liz_table_lookup(table, id)));
+        }
+        
+        for (liz_int_t i = 0; i < liz_table_count(table); ++i) {
+            CHECK_EQUAL(liz_table_data(table, i), liz_table_lookup(table, liz_table_data_id(table, i)));
+        }
+        
+        for (std::size_t i = 0; i < sizeof(removed_ids) / sizeof(removed_ids[0]); ++i) {
+            CHECK(!liz_table_contains(table, removed_ids[i]));
+        }
+        
+        // Freed rooster slots are reused.
+        liz_id_t more_ids[10];
+        liz_table_add_batch(table, more_ids, 10);
+        CHECK(liz_table_is_full(table));
+        
+        liz_table_destroy(table, &allocator, counting_dealloc);
+        
+        CHECK(allocator.is_balanced());
+    }
+    
+    
+    TEST(sort_by_id_and_by_key)
+    {
+        counting_allocator allocator;
+        
+        struct data {
+            int32_t value;
+            char padding[92];
+        };
+        
+        liz_table_t *table = liz_table_create(32,
+                                              sizeof(data),
+                                              sizeof(int32_t),
+                                              &allocator,
+                                              counting_alloc);
+        
+        liz_id_t ids[32];
+        liz_table_add_batch(table, ids, 32);
+        for (liz_int_t i = 0; i < 32; ++i) {
+            static_cast<data *>(liz_table_lookup(table, ids[i]))->value = static_cast<int32_t>(i);
+        }
+        
+        // Shuffle data order by swap-with-last removals.
+        liz_table_remove(table, ids[0]);
+        liz_table_remove(table, ids[5]);
+        liz_table_remove(table, ids[11]);
+        
+        liz_table_sort_by_id(table);
+        
+        for (liz_int_t i = 1; i < liz_table_count(table); ++i) {
+            CHECK((liz_table_data_id(table, i - 1) & LIZ_TABLE_ID_TO_ROOSTER_INDEX_MASK) 
+                  < (liz_table_data_id(table, i) & LIZ_TABLE_ID_TO_ROOSTER_INDEX_MASK));
+        }
+        
+        // Group by value parity, e.g., a shape id.
+        uint32_t keys[32];
+        for (liz_int_t i = 0; i < liz_table_count(table); ++i) {
+            keys[i] = static_cast<uint32_t>(static_cast<data *>(liz_table_data(table, i))->value % 2);
+        }
+        
+        liz_table_sort_by_key(table, keys);
+        
+        for (liz_int_t i = 0; i < liz_table_count(table); ++i) {
+            liz_id_t const id = liz_table_data_id(table, i);
+            data const *slot = static_cast<data *>(liz_table_data(table, i));
+            
+            CHECK_EQUAL(liz_table_data(table, i), liz_table_lookup(table, id));
+            CHECK_EQUAL(keys[i], static_cast<uint32_t>(slot->value % 2));
+            CHECK_EQUAL(ids[slot->value], id);
+            
+            if (0 < i) {
+                CHECK(keys[i - 1] <= keys[i]);
+            }
+        }
+        
+        liz_table_destroy(table, &allocator, counting_dealloc);
+        
+        CHECK(allocator.is_balanced());
+    }
+    
+    
+    TEST(partitioned_add_and_remove_keep_partitions_contiguous)
+    {
+        counting_allocator allocator;
+        
+        struct data {
+            int32_t partition;
+            int32_t value;
+        };
+        
+        liz_int_t const partition_count = 4;
+        uint32_t partition_offsets[partition_count + 1] = {0, 0, 0, 0, 0};
+        
+        liz_table_t *table = liz_table_create(64,
+                                              sizeof(data),
+                                              sizeof(int32_t),
+                                              &allocator,
+                                              counting_alloc);
+        
+        std::vector<liz_id_t> ids;
+        
+        // Interleave adds to all but one partition, then remove from the 
+        // front, the middle, and the back.
+        int32_t const add_partitions[] = {3, 0, 1, 3, 3, 0, 1, 0, 3, 1, 0, 3};
+        for (std::size_t i = 0; i < sizeof(add_partitions) / sizeof(add_partitions[0]); ++i) {
+            liz_id_t const id = liz_table_add_to_partition(table, 
+                                                           partition_offsets, 
+                                                           partition_count, 
+                                                           add_partitions[i]);
+            data *slot = static_cast<data *>(liz_table_lookup(table, id));
+            slot->partition = add_partitions[i];
+            slot->value = static_cast<int32_t>(i);
+            ids.push_back(id);
+        }
+        
+        std::size_t const removed_indices[] = {1, 4, 11, 6, 0};
+        for (std::size_t i = 0; i < sizeof(removed_indices) / sizeof(removed_indices[0]); ++i) {
+            liz_table_remove_from_partition(table, 
+                                            partition_offsets, 
+                                            partition_count, 
+                                            ids[removed_indices[i]]);
+            CHECK(!liz_table_contains(table, ids[removed_indices[i]]));
+        }
+        
+        CHECK_EQUAL(7, liz_table_count(table));
+        CHECK_EQUAL(0u, partition_offsets[0]);
+        CHECK_EQUAL(3u, partition_offsets[1]);
+        CHECK_EQUAL(5u, partition_offsets[2]);
+        CHECK_EQUAL(5u, partition_offsets[3]);
+        CHECK_EQUAL(7u, partition_offsets[4]);
+        
+        for (liz_int_t i = 0; i < liz_table_count(table); ++i) {
+            liz_id_t const id = liz_table_data_id(table, i);
+            data const *slot = static_cast<data *>(liz_table_data(table, i));
+            
+            CHECK_EQUAL(liz_table_data(table, i), liz_table_lookup(table, id));
+            CHECK_EQUAL(slot->partition, liz_table_data_partition(partition_offsets, partition_count, i));
+            CHECK_EQUAL(ids[static_cast<std::size_t>(slot->value)], id);
+        }
+        
+        liz_table_destroy(table, &allocator, counting_dealloc);
+        
+        CHECK(allocator.is_balanced());
+    }
+    
+    
     
 } // SUITE(liz_table_test)
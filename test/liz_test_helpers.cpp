@@ -88,7 +88,9 @@ operator==(liz_shape_specification_t const& lhs,
                          && (lhs.action_state_capacity == rhs.action_state_capacity)
                          && (lhs.persistent_state_change_capacity == rhs.persistent_state_change_capacity)
                          && (lhs.decider_guard_capacity == rhs.decider_guard_capacity)
-                         && (lhs.action_request_capacity == rhs.action_request_capacity));
+                         && (lhs.action_request_capacity == rhs.action_request_capacity)
+                         && (lhs.subtree_call_count == rhs.subtree_call_count)
+                         && (lhs.shape_atom_index_count == rhs.shape_atom_index_count));
     
     return result;
 }
@@ -173,10 +175,10 @@ operator==(liz_vm_monitor_t const& lhs,
 
 bool
 persistent_state_array_equals(liz_persistent_state_t const* lhs,
-                              uint16_t const* lhs_shape_atom_indices,
+                              liz_index_t const* lhs_shape_atom_indices,
                               liz_int_t const lhs_count,
                               liz_persistent_state_t const* rhs,
-                              uint16_t const* rhs_shape_atom_indices,
+                              liz_index_t const* rhs_shape_atom_indices,
                               liz_int_t const rhs_count,
                               liz_shape_atom_t const* shape_atoms,
                               liz_int_t const shape_atom_count)
@@ -223,7 +225,7 @@ persistent_state_array_equals(liz_persistent_state_t const* lhs,
 
 void 
 liz_persistent_state_comparator::set(liz_persistent_state_t const* values,
-                                     uint16_t const* keys,
+                                     liz_index_t const* keys,
                                      liz_int_t const count,
                                      liz_shape_atom_t const* shape_atoms,
                                      liz_int_t const shape_atom_count)
@@ -260,7 +262,7 @@ liz_persistent_state_comparator::operator==(liz_persistent_state_comparator cons
 bool
 liz_vm_actor_equals(liz_vm_actor const& lhs,
                     liz_vm_actor const& rhs,
-                    uint16_t const* persistent_state_shape_atom_indices,
+                    liz_index_t const* persistent_state_shape_atom_indices,
                     liz_int_t const persistent_state_count,
                     liz_shape_atom_t const* shape_atoms,
                     liz_int_t const shape_atom_count)
@@ -549,6 +551,9 @@ liz_node_type_to_c_str(liz_node_type_t const type)
         case liz_node_type_concurrent_decider:
             result = "liz_node_type_concurrent_decider";
             break;
+        case liz_node_type_subtree_call:
+            result = "liz_node_type_subtree_call";
+            break;
         default:
             result = "unknown";
             break;
@@ -621,6 +626,16 @@ liz_vm_cmd_to_c_str(liz_vm_cmd_t const cmd)
 
 
 
+void*
+identity_user_data_lookup_func(void *context,
+                               uintptr_t user_data)
+{
+    (void)context;
+    return reinterpret_cast<void*>(user_data);
+}
+
+
+
 UnitTest::MemoryOutStream&
 operator<<(UnitTest::MemoryOutStream& mos, liz_vm_monitor_node_flag_t const flag)
 {
@@ -721,6 +736,8 @@ operator<<(UnitTest::MemoryOutStream& mos, liz_shape_specification_t const& spec
     mos << " persistent_state_change_capacity: " << spec.persistent_state_change_capacity;
     mos << " decider_guard_Capacity: " << spec.decider_guard_capacity;
     mos << " action_request_capacity: " << spec.action_request_capacity;
+    mos << " subtree_call_count: " << spec.subtree_call_count;
+    mos << " shape_atom_index_count: " << spec.shape_atom_index_count;
     mos << "}";
     
     return mos;
@@ -803,7 +820,7 @@ operator<<(UnitTest::MemoryOutStream& mos, liz_vm_monitor_t const& monitor)
 void
 persistent_state_array_print(UnitTest::MemoryOutStream& mos, 
                              liz_persistent_state_t const* states,
-                             uint16_t const* shape_atom_indices,
+                             liz_index_t const* shape_atom_indices,
                              liz_int_t const count,
                              liz_shape_atom_t const* shape_atoms,
                              liz_int_t const shape_atom_count)
@@ -883,7 +900,7 @@ operator<<(UnitTest::MemoryOutStream& mos, liz_actor_header_t const& actor_heade
 void
 liz_vm_actor_print(UnitTest::MemoryOutStream& mos,
                    liz_vm_actor_t const& actor,
-                   uint16_t const* persistent_state_shape_atom_indices,
+                   liz_index_t const* persistent_state_shape_atom_indices,
                    liz_int_t const persistent_state_count,
                    liz_shape_atom_t const* shape_atoms,
                    liz_int_t const shape_atom_count)
@@ -1402,6 +1419,7 @@ liz_vm_test_fixture::liz_vm_test_fixture()
     
     proband_monitor.user_data = reinterpret_cast<uintptr_t>(&proband_monitor_log);
     proband_monitor.func = monitor_test_func;
+    proband_monitor.filter = NULL;
     
 #if defined(LIZ_VM_MONITOR_ENABLE)
     monitor = &proband_monitor;
@@ -1554,7 +1572,7 @@ liz_vm_test_fixture::push_shape_persistent_action()
     assert(LIZ_COUNT_MAX > shape.spec.persistent_state_count);
     shape.spec.persistent_state_count += 1u;
     
-    shape_persistent_state_shape_atom_indices.push_back(static_cast<uint16_t>(persistent_action_shape_atom_index));
+    shape_persistent_state_shape_atom_indices.push_back(static_cast<liz_index_t>(persistent_action_shape_atom_index));
     
     // Relink to the vector storage in case the push back needed to
     // create a larger internal array and destroyed the smaller old 
@@ -1575,7 +1593,7 @@ liz_vm_test_fixture::push_shape_persistent_action()
 
 
 void 
-liz_vm_test_fixture::push_shape_sequence_decider(uint16_t const sub_stream_end_offset)
+liz_vm_test_fixture::push_shape_sequence_decider(liz_index_t const sub_stream_end_offset)
 {
     assert(shape.spec.shape_atom_count + sub_stream_end_offset > LIZ_NODE_SHAPE_ATOM_COUNT_SEQUENCE_DECIDER + 0 * LIZ_NODE_SHAPE_ATOM_COUNT_SEQUENCE_DECIDER_TWO_CHILDREN);
     
@@ -1618,7 +1636,7 @@ liz_vm_test_fixture::push_shape_sequence_decider(uint16_t const sub_stream_end_o
 
 
 void 
-liz_vm_test_fixture::push_shape_dynamic_priority_decider(uint16_t const sub_stream_end_offset)
+liz_vm_test_fixture::push_shape_dynamic_priority_decider(liz_index_t const sub_stream_end_offset)
 {
     assert(shape.spec.shape_atom_count + sub_stream_end_offset > LIZ_NODE_SHAPE_ATOM_COUNT_DYNAMIC_PRIORITY_DECIDER + 0 * LIZ_NODE_SHAPE_ATOM_COUNT_DYNAMIC_PRIORITY_DECIDER_TWO_CHILDREN);
     
@@ -1644,7 +1662,7 @@ liz_vm_test_fixture::push_shape_dynamic_priority_decider(uint16_t const sub_stre
 
 
 void 
-liz_vm_test_fixture::push_shape_concurrent_decider(uint16_t const sub_stream_end_offset)
+liz_vm_test_fixture::push_shape_concurrent_decider(liz_index_t const sub_stream_end_offset)
 {
     assert(shape.spec.shape_atom_count + sub_stream_end_offset > LIZ_NODE_SHAPE_ATOM_COUNT_CONCURRENT_DECIDER + 0 * LIZ_NODE_SHAPE_ATOM_COUNT_CONCURRENT_DECIDER_TWO_CHILDREN);
     
@@ -1675,7 +1693,7 @@ liz_vm_test_fixture::push_shape_concurrent_decider(uint16_t const sub_stream_end
 
 void 
 liz_vm_test_fixture::push_actor_action_state(liz_vm_test_fixture::target_select const target_vm,
-                        uint16_t const shape_atom_index,
+                        liz_index_t const shape_atom_index,
                         uint8_t const state)
 {
     if (target_vm == target_select_expected_result 
@@ -1712,8 +1730,8 @@ liz_vm_test_fixture::push_actor_action_state(liz_vm_test_fixture::target_select
 
 void 
 liz_vm_test_fixture::push_actor_decider_state(liz_vm_test_fixture::target_select const target_vm,
-                                              uint16_t const shape_atom_index,
-                                              uint16_t const state)
+                                              liz_index_t const shape_atom_index,
+                                              liz_index_t const state)
 {
     if (target_vm == target_select_expected_result 
         || target_vm == target_select_both) {
@@ -1747,8 +1765,8 @@ liz_vm_test_fixture::push_actor_decider_state(liz_vm_test_fixture::target_select
 
 void 
 liz_vm_test_fixture::set_actor_persistent_state(liz_vm_test_fixture::target_select const target_vm,
-                                                uint16_t const persistent_state_index,
-                                                uint16_t const shape_atom_index,
+                                                liz_index_t const persistent_state_index,
+                                                liz_index_t const shape_atom_index,
                                                 liz_execution_state_t const exec_state)
 {
     assert(persistent_state_index < shape.spec.persistent_state_count);
@@ -1818,7 +1836,7 @@ liz_vm_test_fixture::create_expected_result_and_proband_vms_for_shape()
 
 void 
 liz_vm_test_fixture::push_vm_action_state(liz_vm_test_fixture::target_select const target_vm,
-                                          uint16_t const shape_atom_index,
+                                          liz_index_t const shape_atom_index,
                                           uint8_t const state)
 {
     if (target_vm == target_select_expected_result 
@@ -1851,7 +1869,7 @@ void
 liz_vm_test_fixture::push_vm_action_launch_request(liz_vm_test_fixture::target_select const target_vm,
                                                    uint32_t const action_id,
                                                    uint16_t const resource_id,
-                                                   uint16_t const shape_atom_index)
+                                                   liz_index_t const shape_atom_index)
 {
     if (target_vm == target_select_expected_result 
         || target_vm == target_select_both) {
@@ -1891,7 +1909,7 @@ void
 liz_vm_test_fixture::push_vm_action_cancel_request(liz_vm_test_fixture::target_select const target_vm,
                                                    uint32_t const action_id,
                                                    uint16_t const resource_id,
-                                                   uint16_t const shape_atom_index)
+                                                   liz_index_t const shape_atom_index)
 {
     if (target_vm == target_select_expected_result 
         || target_vm == target_select_both) {
@@ -1930,7 +1948,7 @@ liz_vm_test_fixture::push_vm_action_cancel_request(liz_vm_test_fixture::target_s
 
 void 
 liz_vm_test_fixture::push_vm_persistent_action_state_change(liz_vm_test_fixture::target_select const target_vm,
-                                                            uint16_t const shape_atom_index,
+                                                            liz_index_t const shape_atom_index,
                                                             liz_execution_state const exec_state)
 {
     assert(shape_atom_index < shape.spec.shape_atom_count);
@@ -1964,8 +1982,8 @@ liz_vm_test_fixture::push_vm_persistent_action_state_change(liz_vm_test_fixture:
 
 void 
 liz_vm_test_fixture::push_vm_decider_state(liz_vm_test_fixture::target_select const target_vm,
-                                           uint16_t const shape_atom_index,
-                                           uint16_t const state)
+                                           liz_index_t const shape_atom_index,
+                                           liz_index_t const state)
 {
     assert(shape_atom_index < shape.spec.shape_atom_count);
     
@@ -1998,7 +2016,7 @@ liz_vm_test_fixture::push_vm_decider_state(liz_vm_test_fixture::target_select co
 
 void 
 liz_vm_test_fixture::push_monitor_log_entry(liz_vm_test_fixture::target_select const target_log,
-                                            uint16_t const shape_atom_index,
+                                            liz_index_t const shape_atom_index,
                                             liz_uint_t const monitor_mask,
                                             liz_time_t const time)
 {
@@ -107,10 +107,10 @@ operator==(liz_vm_monitor_t const& lhs,
 
 bool
 persistent_state_array_equals(liz_persistent_state_t const* lhs,
-                              uint16_t const* lhs_shape_atom_indices,
+                              liz_index_t const* lhs_shape_atom_indices,
                               liz_int_t const lhs_count,
                               liz_persistent_state_t const* rhs,
-                              uint16_t const* rhs_shape_atom_indices,
+                              liz_index_t const* rhs_shape_atom_indices,
                               liz_int_t const rhs_count,
                               liz_shape_atom_t const* shape_atoms,
                               liz_int_t const shape_atom_count);
@@ -121,7 +121,7 @@ public:
     // Does not take over ownership or memory management of data.
     void 
     set(liz_persistent_state_t const* values,
-        uint16_t const* keys,
+        liz_index_t const* keys,
         liz_int_t const count,
         liz_shape_atom_t const* shape_atoms,
         liz_int_t const shape_atom_count);    
@@ -130,7 +130,7 @@ public:
     operator==(liz_persistent_state_comparator const& other) const;    
     
     liz_persistent_state_t const* values_;
-    uint16_t const* keys_;
+    liz_index_t const* keys_;
     liz_int_t count_;
     liz_shape_atom_t const* shape_atoms_;
     liz_int_t shape_atom_count_;
@@ -164,7 +164,7 @@ array_equals(T const* lhs,
 bool
 liz_vm_actor_equals(liz_vm_actor const& lhs,
                     liz_vm_actor const& rhs,
-                    uint16_t const* persistent_state_shape_atom_indices,
+                    liz_index_t const* persistent_state_shape_atom_indices,
                     liz_int_t const persistent_state_count,
                     liz_shape_atom_t const* shape_atoms,
                     liz_int_t const shape_atom_count);
@@ -282,6 +282,12 @@ char const*
 liz_vm_cmd_to_c_str(liz_vm_cmd_t const cmd) ;
 
 
+// Returns user_data as the actor blackboard.
+void*
+identity_user_data_lookup_func(void *context,
+                               uintptr_t user_data);
+
+
 UnitTest::MemoryOutStream&
 operator<<(UnitTest::MemoryOutStream& mos, liz_vm_monitor_node_flag_t const flag);
 
@@ -325,7 +331,7 @@ operator<<(UnitTest::MemoryOutStream& mos, liz_vm_monitor_t const& monitor) ;
 void
 persistent_state_array_print(UnitTest::MemoryOutStream& mos, 
                              liz_persistent_state_t const* states,
-                             uint16_t const* shape_atom_indices,
+                             liz_index_t const* shape_atom_indices,
                              liz_int_t const count,
                              liz_shape_atom_t const* shape_atoms,
                              liz_int_t const shape_atom_count);
@@ -366,7 +372,7 @@ operator<<(UnitTest::MemoryOutStream& mos, liz_actor_header_t const& actor_heade
 void
 liz_vm_actor_print(UnitTest::MemoryOutStream& mos,
                    liz_vm_actor_t const& actor,
-                   uint16_t const* persistent_state_shape_atom_indices,
+                   liz_index_t const* persistent_state_shape_atom_indices,
                    liz_int_t const persistent_state_count,
                    liz_shape_atom_t const* shape_atoms,
                    liz_int_t const shape_atom_count);
@@ -551,28 +557,28 @@ public:
     
     
     
-    void push_shape_sequence_decider(uint16_t const sub_stream_end_offset);
+    void push_shape_sequence_decider(liz_index_t const sub_stream_end_offset);
     
     
     
-    void push_shape_dynamic_priority_decider(uint16_t const sub_stream_end_offset);
+    void push_shape_dynamic_priority_decider(liz_index_t const sub_stream_end_offset);
     
     
-    void push_shape_concurrent_decider(uint16_t const sub_stream_end_offset);
+    void push_shape_concurrent_decider(liz_index_t const sub_stream_end_offset);
     
     
     
     void push_actor_action_state(target_select const target_vm,
-                                 uint16_t const shape_atom_index,
+                                 liz_index_t const shape_atom_index,
                                  uint8_t const state);
     
     void push_actor_decider_state(target_select const target_vm,
-                                  uint16_t const shape_atom_index,
-                                  uint16_t const state);    
+                                  liz_index_t const shape_atom_index,
+                                  liz_index_t const state);    
     
     void set_actor_persistent_state(target_select const target_vm,
-                                    uint16_t const persistent_state_index,
-                                    uint16_t const shape_atom_index,
+                                    liz_index_t const persistent_state_index,
+                                    liz_index_t const shape_atom_index,
                                     liz_execution_state_t const exec_state);
     
     
@@ -584,35 +590,35 @@ public:
     
     
     void push_vm_action_state(target_select const target_vm,
-                              uint16_t const shape_atom_index,
+                              liz_index_t const shape_atom_index,
                               uint8_t const state);
     
     
     void push_vm_action_launch_request(target_select const target_vm,
                                        uint32_t const action_id,
                                        uint16_t const resource_id,
-                                       uint16_t const shape_atom_index);
+                                       liz_index_t const shape_atom_index);
     
     
     void push_vm_action_cancel_request(target_select const target_vm,
                                        uint32_t const action_id,
                                        uint16_t const resource_id,
-                                       uint16_t const shape_atom_index);
+                                       liz_index_t const shape_atom_index);
     
     
     
     void push_vm_persistent_action_state_change(target_select const target_vm,
-                                                uint16_t const shape_atom_index,
+                                                liz_index_t const shape_atom_index,
                                                 liz_execution_state const exec_state);
     
     
     void push_vm_decider_state(target_select const target_vm,
-                               uint16_t const shape_atom_index,
-                               uint16_t const state);
+                               liz_index_t const shape_atom_index,
+                               liz_index_t const state);
     
     
     void push_monitor_log_entry(target_select const target_log,
-                                uint16_t const shape_atom_index,
+                                liz_index_t const shape_atom_index,
                                 liz_uint_t const monitor_mask,
                                 liz_time_t const time);
     
@@ -631,20 +637,20 @@ public:
     
     std::vector<liz_shape_atom_t> shape_atoms;
     std::vector<liz_immediate_action_func_t> shape_immediate_action_functions;
-    std::vector<uint16_t> shape_persistent_state_shape_atom_indices;
+    std::vector<liz_index_t> shape_persistent_state_shape_atom_indices;
     
     liz_actor_header_t expected_result_actor_header;
     std::vector<liz_persistent_state_t> expected_result_actor_persistent_states;
-    std::vector<uint16_t> expected_result_actor_decider_state_shape_atom_indices;
-    std::vector<uint16_t> expected_result_actor_decider_states;
-    std::vector<uint16_t> expected_result_actor_action_state_shape_atom_indices;
+    std::vector<liz_index_t> expected_result_actor_decider_state_shape_atom_indices;
+    std::vector<liz_index_t> expected_result_actor_decider_states;
+    std::vector<liz_index_t> expected_result_actor_action_state_shape_atom_indices;
     std::vector<uint8_t> expected_result_actor_action_states;
     
     liz_actor_header_t proband_actor_header;
     std::vector<liz_persistent_state_t> proband_actor_persistent_states;
-    std::vector<uint16_t> proband_actor_decider_state_shape_atom_indices;
-    std::vector<uint16_t> proband_actor_decider_states;
-    std::vector<uint16_t> proband_actor_action_state_shape_atom_indices;
+    std::vector<liz_index_t> proband_actor_decider_state_shape_atom_indices;
+    std::vector<liz_index_t> proband_actor_decider_states;
+    std::vector<liz_index_t> proband_actor_action_state_shape_atom_indices;
     std::vector<uint8_t> proband_actor_action_states;
     
     liz_execution_state_t expected_result_blackboard[shape_immediate_action_function_count];
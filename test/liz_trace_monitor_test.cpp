@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Checks recording vm traversals into trace monitors and writing them as
+ * Chrome Trace Event JSON.
+ */
+
+#include <unittestpp.h>
+
+#include <string>
+
+#include <liz/liz_common.h>
+#include <liz/liz_vm.h>
+#include <liz/liz_trace_monitor.h>
+
+#include "liz_test_helpers.h"
+
+
+
+SUITE(liz_trace_monitor_test)
+{
+    namespace {
+        
+        // Advances by one microsecond per call at a thousand ticks per
+        // microsecond.
+        uint64_t
+        step_clock(void *context)
+        {
+            uint64_t *ticks = static_cast<uint64_t*>(context);
+            *ticks += 1000u;
+            
+            return *ticks;
+        }
+        
+        
+        bool
+        string_write(void *context,
+                     void const *data,
+                     size_t byte_count)
+        {
+            std::string *str = static_cast<std::string*>(context);
+            str->append(static_cast<char const*>(data), byte_count);
+            
+            return true;
+        }
+        
+        
+        bool
+        failing_write(void *context,
+                      void const *data,
+                      size_t byte_count)
+        {
+            (void)context;
+            (void)data;
+            (void)byte_count;
+            
+            return false;
+        }
+        
+        
+        class trace_monitor_fixture : public liz_vm_test_fixture {
+        public:
+            
+            trace_monitor_fixture()
+            :   liz_vm_test_fixture()
+            ,   allocator()
+            ,   ticks(0)
+            ,   trace()
+            ,   trace_monitor(NULL)
+            {
+                push_shape_sequence_decider(3);
+                push_shape_immediate_action(immediate_action_func_index_success3);
+                push_shape_immediate_action(immediate_action_func_index_success3);
+                
+                create_expected_result_and_proband_vms_for_shape();
+                
+                proband_actor_header.actor_id = 4;
+            }
+            
+            
+            ~trace_monitor_fixture()
+            {
+                if (NULL != trace_monitor) {
+                    liz_trace_monitor_destroy(trace_monitor, 
+                                              &allocator, 
+                                              counting_dealloc);
+                }
+            }
+            
+            
+            void create_trace_monitor(uint32_t const event_capacity,
+                                      uint32_t const actor_sample_period)
+            {
+                trace_monitor = liz_trace_monitor_create(event_capacity,
+                                                         actor_sample_period,
+                                                         2, // thread_id
+                                                         &ticks,
+                                                         step_clock,
+                                                         &allocator,
+                                                         counting_alloc);
+            }
+            
+            
+            void monitor_step(liz_uint_t const node_shape_atom_index,
+                              liz_uint_t const traversal_mask)
+            {
+                liz_trace_monitor_func(reinterpret_cast<uintptr_t>(trace_monitor),
+                                       node_shape_atom_index,
+                                       traversal_mask,
+                                       proband_vm,
+                                       proband_blackboard,
+                                       0, // time
+                                       &proband_actor,
+                                       &shape);
+            }
+            
+            
+            bool write_trace()
+            {
+                liz_trace_writer_t writer;
+                
+                bool result = liz_trace_writer_begin(&writer, &trace, string_write, 0, 1000);
+                result = liz_trace_monitor_flush(trace_monitor, &writer) && result;
+                result = liz_trace_writer_end(&writer) && result;
+                
+                return result;
+            }
+            
+            
+            counting_allocator allocator;
+            uint64_t ticks;
+            std::string trace;
+            liz_trace_monitor_t *trace_monitor;
+        };
+        
+    } // anonymous namespace
+    
+    
+    
+    TEST(create_and_destroy)
+    {
+        counting_allocator allocator;
+        
+        CHECK(NULL == liz_trace_monitor_create(0, 1, 0, NULL, NULL, &allocator, counting_alloc));
+        CHECK(NULL == liz_trace_monitor_create(6, 1, 0, NULL, NULL, &allocator, counting_alloc));
+        
+        liz_trace_monitor_t *monitor = liz_trace_monitor_create(8, 
+                                                                1, 
+                                                                0, 
+                                                                NULL, 
+                                                                NULL, 
+                                                                &allocator, 
+                                                                counting_alloc);
+        CHECK(NULL != monitor);
+        CHECK_EQUAL(0u, liz_trace_monitor_event_count(monitor));
+        
+        liz_vm_monitor_t const vm_monitor = liz_trace_monitor_vm_monitor(monitor);
+        CHECK_EQUAL(reinterpret_cast<uintptr_t>(monitor), vm_monitor.user_data);
+        CHECK(liz_trace_monitor_func == vm_monitor.func);
+        
+        liz_trace_monitor_destroy(monitor, &allocator, counting_dealloc);
+        
+        CHECK(allocator.is_balanced());
+    }
+    
+    
+    
+    TEST_FIXTURE(trace_monitor_fixture, record_and_write_events)
+    {
+        create_trace_monitor(8, 1);
+        
+        monitor_step(0, liz_vm_monitor_node_flag_enter_from_top);
+        monitor_step(0, liz_vm_monitor_node_flag_leave_to_bottom);
+        monitor_step(2, liz_vm_monitor_node_flag_cancel_action | liz_vm_monitor_node_flag_enter_from_top);
+        monitor_step(2, liz_vm_monitor_node_flag_cancel_action | liz_vm_monitor_node_flag_leave_to_top);
+        monitor_step(0, liz_vm_monitor_node_flag_enter_from_bottom);
+        monitor_step(0, liz_vm_monitor_node_flag_leave_to_top);
+        monitor_step(1, liz_vm_monitor_node_flag_error);
+        
+        CHECK_EQUAL(5u, liz_trace_monitor_event_count(trace_monitor));
+        CHECK(write_trace());
+        CHECK_EQUAL(0u, liz_trace_monitor_event_count(trace_monitor));
+        
+        std::string const expected_trace = 
+            "{\"traceEvents\":[\n"
+            "{\"name\":\"node 0\",\"cat\":\"liz\",\"ph\":\"B\",\"ts\":1.000,\"pid\":1,\"tid\":2,\"args\":{\"actor\":4}},\n"
+            "{\"name\":\"cancel node 2\",\"cat\":\"liz\",\"ph\":\"B\",\"ts\":2.000,\"pid\":1,\"tid\":2,\"args\":{\"actor\":4}},\n"
+            "{\"name\":\"cancel node 2\",\"cat\":\"liz\",\"ph\":\"E\",\"ts\":3.000,\"pid\":1,\"tid\":2,\"args\":{\"actor\":4}},\n"
+            "{\"name\":\"node 0\",\"cat\":\"liz\",\"ph\":\"E\",\"ts\":4.000,\"pid\":1,\"tid\":2,\"args\":{\"actor\":4}},\n"
+            "{\"name\":\"error node 1\",\"cat\":\"liz\",\"ph\":\"i\",\"s\":\"t\",\"ts\":5.000,\"pid\":1,\"tid\":2,\"args\":{\"actor\":4}}\n"
+            "],\"displayTimeUnit\":\"ns\"}\n";
+        
+        CHECK_EQUAL(expected_trace, trace);
+    }
+    
+    
+    
+    TEST_FIXTURE(trace_monitor_fixture, sample_actors)
+    {
+        create_trace_monitor(8, 3);
+        
+        monitor_step(0, liz_vm_monitor_node_flag_enter_from_top);
+        CHECK_EQUAL(0u, liz_trace_monitor_event_count(trace_monitor));
+        
+        // Sampling is decided per actor, not per event.
+        liz_vm_actor_t other_actor = proband_actor;
+        liz_actor_header_t other_actor_header = proband_actor_header;
+        other_actor_header.actor_id = 6;
+        other_actor.header = &other_actor_header;
+        
+        liz_trace_monitor_func(reinterpret_cast<uintptr_t>(trace_monitor),
+                               0,
+                               liz_vm_monitor_node_flag_enter_from_top,
+                               proband_vm,
+                               proband_blackboard,
+                               0, // time
+                               &other_actor,
+                               &shape);
+        CHECK_EQUAL(1u, liz_trace_monitor_event_count(trace_monitor));
+        
+        monitor_step(0, liz_vm_monitor_node_flag_leave_to_top);
+        CHECK_EQUAL(1u, liz_trace_monitor_event_count(trace_monitor));
+    }
+    
+    
+    
+    TEST_FIXTURE(trace_monitor_fixture, sample_reused_actor_per_header)
+    {
+        create_trace_monitor(8, 3);
+        
+        liz_actor_header_t sampled_actor_header = proband_actor_header;
+        sampled_actor_header.actor_id = 6;
+        
+        proband_actor.header = &sampled_actor_header;
+        monitor_step(0, liz_vm_monitor_node_flag_enter_from_top);
+        CHECK_EQUAL(1u, liz_trace_monitor_event_count(trace_monitor));
+        
+        // The same actor struct now represents an actor that isn't sampled.
+        proband_actor.header = &proband_actor_header;
+        monitor_step(0, liz_vm_monitor_node_flag_enter_from_top);
+        CHECK_EQUAL(1u, liz_trace_monitor_event_count(trace_monitor));
+        
+        proband_actor.header = &sampled_actor_header;
+        monitor_step(0, liz_vm_monitor_node_flag_leave_to_top);
+        CHECK_EQUAL(2u, liz_trace_monitor_event_count(trace_monitor));
+    }
+    
+    
+    
+    TEST_FIXTURE(trace_monitor_fixture, drop_events_if_full)
+    {
+        create_trace_monitor(2, 1);
+        
+        monitor_step(0, liz_vm_monitor_node_flag_enter_from_top);
+        monitor_step(1, liz_vm_monitor_node_flag_enter_from_top);
+        monitor_step(1, liz_vm_monitor_node_flag_leave_to_top);
+        
+        CHECK_EQUAL(2u, liz_trace_monitor_event_count(trace_monitor));
+        CHECK_EQUAL(1u, liz_trace_monitor_dropped_event_count(trace_monitor));
+        
+        CHECK(write_trace());
+        
+        // Flushing frees space in the ring buffer.
+        monitor_step(2, liz_vm_monitor_node_flag_enter_from_top);
+        monitor_step(2, liz_vm_monitor_node_flag_leave_to_top);
+        
+        CHECK_EQUAL(2u, liz_trace_monitor_event_count(trace_monitor));
+        CHECK_EQUAL(1u, liz_trace_monitor_dropped_event_count(trace_monitor));
+    }
+    
+    
+    
+    TEST_FIXTURE(trace_monitor_fixture, report_write_failures)
+    {
+        create_trace_monitor(8, 1);
+        
+        monitor_step(0, liz_vm_monitor_node_flag_enter_from_top);
+        
+        liz_trace_writer_t writer;
+        CHECK(!liz_trace_writer_begin(&writer, NULL, failing_write, 0, 1));
+        CHECK(!liz_trace_monitor_flush(trace_monitor, &writer));
+        CHECK(!liz_trace_writer_end(&writer));
+    }
+    
+    
+    
+    TEST_FIXTURE(trace_monitor_fixture, trace_vm_update)
+    {
+        create_trace_monitor(64, 1);
+        
+        liz_vm_monitor_t monitor = liz_trace_monitor_vm_monitor(trace_monitor);
+        
+        liz_vm_update_actor(proband_vm,
+                            &monitor,
+                            NULL,
+                            identity_user_data_lookup_func,
+                            0, // time
+                            &proband_actor,
+                            &shape);
+        
+#if defined(LIZ_VM_MONITOR_ENABLE)
+        // Enter and leave each of the three nodes.
+        CHECK_EQUAL(6u, liz_trace_monitor_event_count(trace_monitor));
+#else
+        CHECK_EQUAL(0u, liz_trace_monitor_event_count(trace_monitor));
+#endif
+    }
+    
+} // SUITE(liz_trace_monitor_test)
@@ -0,0 +1,372 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Checks that batched actor updates produce the same vm results as updating
+ * each actor with liz_vm_update_actor and that actors reaching the same node
+ * share a batch function call.
+ */
+
+#include <unittestpp.h>
+
+#include <vector>
+
+#include <liz/liz_common.h>
+#include <liz/liz_vm.h>
+#include <liz/liz_vm_batch.h>
+
+#include "liz_test_helpers.h"
+
+
+
+SUITE(liz_vm_batch_test)
+{
+    namespace {
+        
+        liz_vm_monitor_t *monitor_null = NULL;
+        void* user_data_lookup_context_null = NULL;
+        liz_time_t const update_time_zero = 0;
+        
+        
+        
+        std::vector<liz_immediate_action_func_t> forwarded_functions;
+        std::vector<liz_int_t> batch_call_lane_counts;
+        
+        
+        // Calls the forwarded function per lane in lane_mask and logs the 
+        // number of lanes per call.
+        template<liz_int_t function_index>
+        void
+        forwarding_immediate_action_batch_func(void * const *actor_blackboards,
+                                               liz_random_number_seed_t *rnd_seeds,
+                                               liz_time_t time,
+                                               liz_execution_state_t *execution_states,
+                                               uint64_t lane_mask,
+                                               liz_int_t lane_count)
+        {
+            liz_int_t masked_lane_count = 0;
+            
+            for (liz_int_t lane = 0; lane < lane_count; ++lane) {
+                if (0u != (lane_mask & (UINT64_C(1) << lane))) {
+                    execution_states[lane] = forwarded_functions[function_index](actor_blackboards[lane],
+                                                                                 &rnd_seeds[lane],
+                                                                                 time,
+                                                                                 execution_states[lane]);
+                    ++masked_lane_count;
+                }
+            }
+            
+            batch_call_lane_counts.push_back(masked_lane_count);
+        }
+        
+        
+        
+        class batch_fixture : public liz_vm_test_fixture {
+        public:
+            batch_fixture()
+            :   liz_vm_test_fixture()
+            ,   lane_vms()
+            ,   lane_actors()
+            ,   batch_functions(shape_immediate_action_function_count, NULL)
+            {
+                forwarded_functions = shape_immediate_action_functions;
+                batch_call_lane_counts.clear();
+                
+                batch_functions[immediate_action_func_index_running2] = forwarding_immediate_action_batch_func<immediate_action_func_index_running2>;
+                batch_functions[immediate_action_func_index_success3] = forwarding_immediate_action_batch_func<immediate_action_func_index_success3>;
+                batch_functions[immediate_action_func_index_fail4] = forwarding_immediate_action_batch_func<immediate_action_func_index_fail4>;
+            }
+            
+            
+            ~batch_fixture()
+            {
+                for (std::size_t i = 0; i < lane_vms.size(); ++i) {
+                    liz_vm_destroy(lane_vms[i], &allocator, counting_dealloc);
+                }
+            }
+            
+            
+            // Lanes alternate between the proband and the expected result 
+            // actor.
+            void create_vms_with_lane_count(liz_int_t const lane_count)
+            {
+                create_expected_result_and_proband_vms_for_shape();
+                
+                for (liz_int_t i = 0; i < lane_count; ++i) {
+                    lane_vms.push_back(liz_vm_create(shape.spec, &allocator, counting_alloc));
+                    lane_actors.push_back((0 == i % 2) ? proband_actor : expected_result_actor);
+                }
+            }
+            
+            
+            // Updates the actors one by one as reference and then batched.
+            liz_int_t update_vms(liz_immediate_action_batch_func_t const *functions)
+            {
+                liz_vm_update_actor(expected_result_vm,
+                                    monitor_null,
+                                    user_data_lookup_context_null,
+                                    identity_user_data_lookup_func,
+                                    update_time_zero,
+                                    &expected_result_actor,
+                                    &shape);
+                
+                liz_vm_update_actor(proband_vm,
+                                    monitor_null,
+                                    user_data_lookup_context_null,
+                                    identity_user_data_lookup_func,
+                                    update_time_zero,
+                                    &proband_actor,
+                                    &shape);
+                
+                return liz_vm_batch_update_actors(&lane_vms[0],
+                                                  monitor_null,
+                                                  user_data_lookup_context_null,
+                                                  identity_user_data_lookup_func,
+                                                  update_time_zero,
+                                                  &lane_actors[0],
+                                                  static_cast<liz_int_t>(lane_vms.size()),
+                                                  &shape,
+                                                  functions);
+            }
+            
+            
+            void check_lanes_equal_single_updates()
+            {
+                for (std::size_t i = 0; i < lane_vms.size(); ++i) {
+                    liz_vm_comparator lane_vm_comparator;
+                    lane_vm_comparator.set(lane_vms[i],
+                                           shape.atoms,
+                                           shape.spec.shape_atom_count);
+                    
+                    if (0 == i % 2) {
+                        CHECK_EQUAL(proband_vm_comparator, lane_vm_comparator);
+                        CHECK_EQUAL(proband_vm->execution_state, lane_vms[i]->execution_state);
+                    } else {
+                        CHECK_EQUAL(expected_result_vm_comparator, lane_vm_comparator);
+                        CHECK_EQUAL(expected_result_vm->execution_state, lane_vms[i]->execution_state);
+                    }
+                }
+            }
+            
+            
+            std::vector<liz_vm_t*> lane_vms;
+            std::vector<liz_vm_actor_t> lane_actors;
+            std::vector<liz_immediate_action_batch_func_t> batch_functions;
+        };
+        
+        
+        
+        // The proband actor's persistent action succeeds and skips the 
+        // success action, the expected result actor's fails and runs it.
+        void
+        push_shape_with_diverging_lanes(batch_fixture &fixture)
+        {
+            typedef liz_vm_test_fixture fixture_t;
+            
+            fixture.push_shape_concurrent_decider(5); // shape_atom_index 0
+            {
+                fixture.push_shape_dynamic_priority_decider(3); // shape_atom_index 1
+                {
+                    fixture.push_shape_persistent_action(); // shape_atom_index 2
+                    fixture.push_shape_immediate_action(fixture_t::immediate_action_func_index_success3); // shape_atom_index 3
+                }
+                
+                fixture.push_shape_immediate_action(fixture_t::immediate_action_func_index_running2); // shape_atom_index 4
+            }
+        }
+        
+        
+        void
+        set_actor_states_with_diverging_lanes(batch_fixture &fixture)
+        {
+            typedef liz_vm_test_fixture fixture_t;
+            
+            fixture.set_actor_persistent_state(fixture_t::target_select_proband, 0, 2, liz_execution_state_success);
+            fixture.set_actor_persistent_state(fixture_t::target_select_expected_result, 0, 2, liz_execution_state_fail);
+        }
+        
+    } // anonymous namespace
+    
+    
+    
+    TEST_FIXTURE(batch_fixture, empty_shape)
+    {
+        create_vms_with_lane_count(3);
+        
+        CHECK_EQUAL(0, update_vms(&batch_functions[0]));
+        check_lanes_equal_single_updates();
+    }
+    
+    
+    
+    TEST_FIXTURE(batch_fixture, same_path_lanes_share_batch_calls)
+    {
+        push_shape_sequence_decider(4); // shape_atom_index 0
+        {
+            push_shape_immediate_action(immediate_action_func_index_success3); // shape_atom_index 1
+            push_shape_immediate_action(immediate_action_func_index_success3); // shape_atom_index 2
+            push_shape_immediate_action(immediate_action_func_index_running2); // shape_atom_index 3
+        }
+        
+        create_vms_with_lane_count(4);
+        
+        CHECK_EQUAL(3, update_vms(&batch_functions[0]));
+        check_lanes_equal_single_updates();
+        
+        liz_int_t const expected_lane_counts[] = {4, 4, 4};
+        CHECK_EQUAL(3u, batch_call_lane_counts.size());
+        CHECK_ARRAY_EQUAL(expected_lane_counts, batch_call_lane_counts, 3);
+        
+#if defined(LIZ_VM_STATS_ENABLE)
+        liz_vm_update_stats_t const single_stats = liz_vm_update_stats(proband_vm);
+        
+        for (std::size_t i = 0; i < lane_vms.size(); ++i) {
+            liz_vm_update_stats_t const lane_stats = liz_vm_update_stats(lane_vms[i]);
+            
+            CHECK_EQUAL(single_stats.visited_node_count, lane_stats.visited_node_count);
+            CHECK_EQUAL(single_stats.immediate_action_count, lane_stats.immediate_action_count);
+        }
+#endif
+    }
+    
+    
+    
+    TEST_FIXTURE(batch_fixture, batch_calls_count_immediate_action_cycles)
+    {
+        push_shape_sequence_decider(4); // shape_atom_index 0
+        {
+            push_shape_immediate_action(immediate_action_func_index_success3); // shape_atom_index 1
+            push_shape_immediate_action(immediate_action_func_index_success3); // shape_atom_index 2
+            push_shape_immediate_action(immediate_action_func_index_running2); // shape_atom_index 3
+        }
+        
+        create_vms_with_lane_count(4);
+        
+        liz_vm_counters_t *counters = liz_vm_counters_create(liz_shape_specification_shape_atom_index_count(shape.spec), 
+                                                             &allocator, 
+                                                             counting_alloc);
+        for (std::size_t i = 0; i < lane_vms.size(); ++i) {
+            lane_vms[i]->counters = counters;
+        }
+        
+        CHECK_EQUAL(3, update_vms(&batch_functions[0]));
+        
+        CHECK_EQUAL(0u, counters->nodes[0].immediate_action_cycles);
+#if defined(LIZ_VM_COUNTERS_ENABLE) && defined(LIZ_VM_COUNTERS_CYCLES_ENABLE)
+        CHECK(0u < counters->nodes[1].immediate_action_cycles);
+        CHECK(0u < counters->nodes[2].immediate_action_cycles);
+        CHECK(0u < counters->nodes[3].immediate_action_cycles);
+#else
+        CHECK_EQUAL(0u, counters->nodes[3].immediate_action_cycles);
+#endif
+        
+        liz_vm_counters_destroy(counters, &allocator, counting_dealloc);
+    }
+    
+    
+    
+    TEST_FIXTURE(batch_fixture, diverging_lanes_rejoin_at_the_same_node)
+    {
+        push_shape_with_diverging_lanes(*this);
+        create_vms_with_lane_count(5);
+        set_actor_states_with_diverging_lanes(*this);
+        
+        CHECK_EQUAL(2, update_vms(&batch_functions[0]));
+        check_lanes_equal_single_updates();
+        
+        // The expected result lanes call the success action alone, then all
+        // lanes share the running action.
+        liz_int_t const expected_lane_counts[] = {2, 5};
+        CHECK_EQUAL(2u, batch_call_lane_counts.size());
+        CHECK_ARRAY_EQUAL(expected_lane_counts, batch_call_lane_counts, 2);
+    }
+    
+    
+    
+    TEST_FIXTURE(batch_fixture, actions_without_batch_function_are_called_one_by_one)
+    {
+        push_shape_with_diverging_lanes(*this);
+        create_vms_with_lane_count(4);
+        set_actor_states_with_diverging_lanes(*this);
+        
+        batch_functions[immediate_action_func_index_success3] = NULL;
+        
+        CHECK_EQUAL(1, update_vms(&batch_functions[0]));
+        check_lanes_equal_single_updates();
+        
+        CHECK_EQUAL(0, update_vms(NULL));
+        check_lanes_equal_single_updates();
+    }
+    
+    TEST_FIXTURE(batch_fixture, diverging_lanes_cancel_like_single_updates)
+    {
+        push_shape_concurrent_decider(9); // shape_atom_index 0
+        {
+            push_shape_dynamic_priority_decider(4); // shape_atom_index 1
+            {
+                push_shape_persistent_action(); // shape_atom_index 2
+                push_shape_deferred_action(1, 1); // shape_atom_index 3-4
+            }
+            
+            push_shape_dynamic_priority_decider(4); // shape_atom_index 5
+            {
+                push_shape_persistent_action(); // shape_atom_index 6
+                push_shape_deferred_action(2, 2); // shape_atom_index 7-8
+            }
+        }
+        
+        create_vms_with_lane_count(6);
+        
+        // Only the proband actor cancels its running deferred actions.
+        set_actor_persistent_state(target_select_proband, 0, 2, liz_execution_state_success);
+        set_actor_persistent_state(target_select_proband, 1, 6, liz_execution_state_success);
+        set_actor_persistent_state(target_select_expected_result, 0, 2, liz_execution_state_fail);
+        set_actor_persistent_state(target_select_expected_result, 1, 6, liz_execution_state_fail);
+        push_actor_action_state(target_select_both, 3, liz_execution_state_running);
+        push_actor_action_state(target_select_both, 7, liz_execution_state_running);
+        
+        update_vms(&batch_functions[0]);
+        check_lanes_equal_single_updates();
+        
+        for (std::size_t i = 0; i < lane_vms.size(); ++i) {
+            liz_vm_t const *single_vm = (0 == i % 2) ? proband_vm : expected_result_vm;
+            
+            CHECK_EQUAL(single_vm->action_request_stack_header, lane_vms[i]->action_request_stack_header);
+        }
+        
+        CHECK(0 != liz_lookaside_double_stack_count(&lane_vms[0]->action_request_stack_header,
+                                                    LIZ_VM_ACTION_REQUEST_STACK_SIDE_CANCEL));
+    }
+    
+} // SUITE(liz_vm_batch_test)
@@ -0,0 +1,440 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Checks that vms with a cancellation batch cancel the same actions in the 
+ * same order as vms cancelling immediately.
+ */
+
+#include <unittestpp.h>
+
+#include <vector>
+
+#include <liz/liz_common.h>
+#include <liz/liz_vm.h>
+#include <liz/liz_vm_cancellation_batch.h>
+
+#include "liz_test_helpers.h"
+
+
+
+SUITE(liz_vm_cancellation_batch_test)
+{
+    namespace {
+        
+        liz_vm_monitor_t *monitor_null = NULL;
+        void* user_data_lookup_context_null = NULL;
+        liz_time_t const update_time_zero = 0;
+        
+        
+        
+        struct immediate_action_call {
+            void *actor_blackboard;
+            liz_int_t function_index;
+            liz_execution_state_t execution_request;
+        };
+        
+        
+        std::vector<immediate_action_call> calls;
+        std::vector<liz_immediate_action_func_t> logged_functions;
+        
+        
+        // Unlike the fixture's running function accepts cancellation.
+        liz_execution_state_t
+        immediate_action_func_running_until_cancel2(void* actor_blackboard,
+                                                    liz_random_number_seed_t* rnd_seed,
+                                                    liz_time_t time,
+                                                    liz_execution_state_t execution_request)
+        {
+            (void)rnd_seed;
+            (void)time;
+            
+            if (liz_execution_state_cancel != execution_request) {
+                execution_request = liz_execution_state_running;
+            }
+            
+            liz_execution_state_t* states = static_cast<liz_execution_state_t*>(actor_blackboard);
+            states[liz_vm_test_fixture::immediate_action_func_index_running2] = execution_request;
+            
+            return execution_request;
+        }
+        
+        
+        // Logs and forwards all calls to the logged function.
+        template<liz_int_t function_index>
+        liz_execution_state_t
+        logging_immediate_action_func(void* actor_blackboard,
+                                      liz_random_number_seed_t* rnd_seed,
+                                      liz_time_t time,
+                                      liz_execution_state_t execution_request)
+        {
+            immediate_action_call const call = {actor_blackboard, function_index, execution_request};
+            calls.push_back(call);
+            
+            return logged_functions[function_index](actor_blackboard, 
+                                                    rnd_seed, 
+                                                    time, 
+                                                    execution_request);
+        }
+        
+        
+        std::vector<liz_int_t>
+        cancel_call_function_indices(void const *actor_blackboard)
+        {
+            std::vector<liz_int_t> result;
+            
+            for (std::size_t i = 0; i < calls.size(); ++i) {
+                if (actor_blackboard == calls[i].actor_blackboard
+                    && liz_execution_state_cancel == calls[i].execution_request) {
+                    
+                    result.push_back(calls[i].function_index);
+                }
+            }
+            
+            return result;
+        }
+        
+        
+        // Returns the function indices of all calls, cancel calls negated.
+        std::vector<liz_int_t>
+        call_function_indices(void const *actor_blackboard)
+        {
+            std::vector<liz_int_t> result;
+            
+            for (std::size_t i = 0; i < calls.size(); ++i) {
+                if (actor_blackboard == calls[i].actor_blackboard) {
+                    bool const is_cancel = (liz_execution_state_cancel == calls[i].execution_request);
+                    result.push_back(is_cancel ? -calls[i].function_index : calls[i].function_index);
+                }
+            }
+            
+            return result;
+        }
+        
+        
+        
+        class batch_fixture : public liz_vm_test_fixture {
+        public:
+            batch_fixture()
+            :   liz_vm_test_fixture()
+            ,   batch(NULL)
+            {
+                calls.clear();
+                logged_functions = shape_immediate_action_functions;
+                logged_functions[immediate_action_func_index_running2] = immediate_action_func_running_until_cancel2;
+                
+                shape_immediate_action_functions[immediate_action_func_index_identity0] = logging_immediate_action_func<immediate_action_func_index_identity0>;
+                shape_immediate_action_functions[immediate_action_func_index_identity1] = logging_immediate_action_func<immediate_action_func_index_identity1>;
+                shape_immediate_action_functions[immediate_action_func_index_running2] = logging_immediate_action_func<immediate_action_func_index_running2>;
+                shape_immediate_action_functions[immediate_action_func_index_success3] = logging_immediate_action_func<immediate_action_func_index_success3>;
+            }
+            
+            
+            ~batch_fixture()
+            {
+                if (NULL != batch) {
+                    liz_vm_cancellation_batch_destroy(batch, &allocator, counting_dealloc);
+                }
+            }
+            
+            
+            void create_vms_with_batch_capacity(liz_int_t const capacity)
+            {
+                create_expected_result_and_proband_vms_for_shape();
+                
+                batch = liz_vm_cancellation_batch_create(capacity, &allocator, counting_alloc);
+                proband_vm->cancellation_batch = batch;
+            }
+            
+            
+            // Updates the expected result vm without and the proband vm with
+            // cancellation batch.
+            void update_vms()
+            {
+                liz_vm_update_actor(expected_result_vm,
+                                    monitor_null,
+                                    user_data_lookup_context_null,
+                                    identity_user_data_lookup_func,
+                                    update_time_zero,
+                                    &expected_result_actor,
+                                    &shape);
+                
+                liz_vm_update_actor(proband_vm,
+                                    monitor_null,
+                                    user_data_lookup_context_null,
+                                    identity_user_data_lookup_func,
+                                    update_time_zero,
+                                    &proband_actor,
+                                    &shape);
+            }
+            
+            
+            void check_equal_cancellation()
+            {
+                liz_lookaside_double_stack_t const *expected_result_requests = &expected_result_vm->action_request_stack_header;
+                liz_lookaside_double_stack_t const *proband_requests = &proband_vm->action_request_stack_header;
+                
+                CHECK_EQUAL(*expected_result_requests, *proband_requests);
+                
+                liz_int_t const capacity = liz_lookaside_double_stack_capacity(proband_requests);
+                liz_int_t const cancel_count = liz_lookaside_double_stack_count(proband_requests, 
+                                                                                LIZ_VM_ACTION_REQUEST_STACK_SIDE_CANCEL);
+                CHECK_ARRAY_EQUAL(expected_result_vm->action_requests + capacity - cancel_count,
+                                  proband_vm->action_requests + capacity - cancel_count,
+                                  cancel_count);
+                
+                std::vector<liz_int_t> const expected_result_calls = cancel_call_function_indices(expected_result_blackboard);
+                std::vector<liz_int_t> const proband_calls = cancel_call_function_indices(proband_blackboard);
+                
+                CHECK_EQUAL(expected_result_calls.size(), proband_calls.size());
+                CHECK(expected_result_calls == proband_calls);
+                CHECK(call_function_indices(expected_result_blackboard) == call_function_indices(proband_blackboard));
+                
+                CHECK_EQUAL(expected_result_vm_comparator, 
+                            proband_vm_comparator);
+                CHECK_ARRAY_EQUAL(expected_result_blackboard, 
+                                  proband_blackboard, 
+                                  shape_immediate_action_function_count);
+                CHECK_EQUAL(expected_result_vm->execution_state, proband_vm->execution_state);
+            }
+            
+            
+            liz_vm_cancellation_batch_t *batch;
+        };
+        
+        
+        
+        // Two dynamic priority deciders cancel their previously running 
+        // lower-priority children.
+        void
+        push_shape_with_two_cancelling_deciders(batch_fixture &fixture)
+        {
+            fixture.push_shape_concurrent_decider(9); // shape_atom_index 0
+            {
+                fixture.push_shape_dynamic_priority_decider(4); // shape_atom_index 1
+                {
+                    fixture.push_shape_persistent_action(); // shape_atom_index 2
+                    fixture.push_shape_deferred_action(1, 1); // shape_atom_index 3-4
+                }
+                
+                fixture.push_shape_dynamic_priority_decider(4); // shape_atom_index 5
+                {
+                    fixture.push_shape_persistent_action(); // shape_atom_index 6
+                    fixture.push_shape_deferred_action(2, 2); // shape_atom_index 7-8
+                }
+            }
+        }
+        
+        
+        void
+        set_actor_states_with_two_cancelling_deciders(batch_fixture &fixture)
+        {
+            typedef liz_vm_test_fixture fixture_t;
+            
+            fixture.set_actor_persistent_state(fixture_t::target_select_both, 0, 2, liz_execution_state_success);
+            fixture.set_actor_persistent_state(fixture_t::target_select_both, 1, 6, liz_execution_state_success);
+            fixture.push_actor_action_state(fixture_t::target_select_both, 3, liz_execution_state_running);
+            fixture.push_actor_action_state(fixture_t::target_select_both, 7, liz_execution_state_running);
+        }
+        
+    } // anonymous namespace
+    
+    
+    
+    TEST(create_batch)
+    {
+        counting_allocator allocator;
+        
+        CHECK(NULL == liz_vm_cancellation_batch_create(0, &allocator, counting_alloc));
+        
+        liz_vm_cancellation_batch_t *batch = liz_vm_cancellation_batch_create(3, &allocator, counting_alloc);
+        CHECK(NULL != batch);
+        CHECK(liz_vm_cancellation_batch_is_empty(batch));
+        CHECK_EQUAL(3, batch->capacity);
+        
+        liz_vm_cancellation_batch_destroy(batch, &allocator, counting_dealloc);
+        
+        CHECK(allocator.is_balanced());
+        
+        liz_shape_specification_t spec = {};
+        spec.action_state_capacity = 7;
+        CHECK_EQUAL(8, liz_vm_cancellation_batch_capacity_requirement(spec));
+    }
+    
+    
+    
+    TEST(push_coalesces_ranges_without_cursor_movement)
+    {
+        counting_allocator allocator;
+        liz_vm_cancellation_batch_t *batch = liz_vm_cancellation_batch_create(2, &allocator, counting_alloc);
+        
+        CHECK(liz_vm_cancellation_batch_push(batch, 3, 5, 0));
+        CHECK(liz_vm_cancellation_batch_push(batch, 5, 7, 0));
+        CHECK(liz_vm_cancellation_batch_push(batch, 1, 6, 0));
+        CHECK_EQUAL(1, batch->count);
+        CHECK_EQUAL(3, batch->intervals[0].begin_index);
+        CHECK_EQUAL(7, batch->intervals[0].end_index);
+        
+        // Gaps and cursor movements need separate intervals.
+        CHECK(liz_vm_cancellation_batch_push(batch, 9, 10, 0));
+        CHECK(!liz_vm_cancellation_batch_push(batch, 10, 12, 1));
+        CHECK_EQUAL(2, batch->count);
+        
+        liz_vm_cancellation_batch_clear(batch);
+        CHECK(liz_vm_cancellation_batch_is_empty(batch));
+        
+        liz_vm_cancellation_batch_destroy(batch, &allocator, counting_dealloc);
+        CHECK(allocator.is_balanced());
+    }
+    
+    
+    
+    TEST_FIXTURE(batch_fixture, batched_ranges_cancel_in_order)
+    {
+        push_shape_with_two_cancelling_deciders(*this);
+        create_vms_with_batch_capacity(liz_vm_cancellation_batch_capacity_requirement(shape.spec));
+        set_actor_states_with_two_cancelling_deciders(*this);
+        
+        update_vms();
+        
+        check_equal_cancellation();
+        CHECK(liz_vm_cancellation_batch_is_empty(batch));
+    }
+    
+    
+    
+    TEST_FIXTURE(batch_fixture, full_batch_resolves_early_in_order)
+    {
+        push_shape_with_two_cancelling_deciders(*this);
+        create_vms_with_batch_capacity(1);
+        set_actor_states_with_two_cancelling_deciders(*this);
+        
+        update_vms();
+        
+        check_equal_cancellation();
+    }
+    
+    
+    
+    TEST_FIXTURE(batch_fixture, running_vm_actions_cancel_after_batched_ones)
+    {
+        push_shape_concurrent_decider(6); // shape_atom_index 0
+        {
+            // Cancels its previously running lower-priority child.
+            push_shape_dynamic_priority_decider(3); // shape_atom_index 1
+            {
+                push_shape_persistent_action(); // shape_atom_index 2
+                push_shape_immediate_action(immediate_action_func_index_identity0); // shape_atom_index 3
+            }
+            
+            // Runs - is cancelled.
+            push_shape_immediate_action(immediate_action_func_index_running2); // shape_atom_index 4
+            
+            // Fails.
+            push_shape_immediate_action(immediate_action_func_index_fail4); // shape_atom_index 5
+        }
+        
+        create_vms_with_batch_capacity(liz_vm_cancellation_batch_capacity_requirement(shape.spec));
+        
+        set_actor_persistent_state(target_select_both, 0, 2, liz_execution_state_success);
+        push_actor_action_state(target_select_both, 3, liz_execution_state_running);
+        
+        update_vms();
+        
+        check_equal_cancellation();
+        
+        std::vector<liz_int_t> const proband_calls = cancel_call_function_indices(proband_blackboard);
+        CHECK_EQUAL(2u, proband_calls.size());
+        CHECK_EQUAL(static_cast<liz_int_t>(immediate_action_func_index_identity0), proband_calls[0]);
+        CHECK_EQUAL(static_cast<liz_int_t>(immediate_action_func_index_running2), proband_calls[1]);
+    }
+    
+    
+    
+    TEST_FIXTURE(batch_fixture, batched_cancel_calls_precede_following_invocations)
+    {
+        push_shape_concurrent_decider(5); // shape_atom_index 0
+        {
+            // Cancels its previously running lower-priority child.
+            push_shape_dynamic_priority_decider(3); // shape_atom_index 1
+            {
+                push_shape_persistent_action(); // shape_atom_index 2
+                push_shape_immediate_action(immediate_action_func_index_identity1); // shape_atom_index 3
+            }
+            
+            push_shape_immediate_action(immediate_action_func_index_success3); // shape_atom_index 4
+        }
+        
+        create_vms_with_batch_capacity(liz_vm_cancellation_batch_capacity_requirement(shape.spec));
+        
+        set_actor_persistent_state(target_select_both, 0, 2, liz_execution_state_success);
+        push_actor_action_state(target_select_both, 3, liz_execution_state_running);
+        
+        update_vms();
+        
+        check_equal_cancellation();
+        
+        std::vector<liz_int_t> const proband_calls = call_function_indices(proband_blackboard);
+        CHECK_EQUAL(2u, proband_calls.size());
+        CHECK_EQUAL(-static_cast<liz_int_t>(immediate_action_func_index_identity1), proband_calls[0]);
+        CHECK_EQUAL(static_cast<liz_int_t>(immediate_action_func_index_success3), proband_calls[1]);
+    }
+    
+    
+    
+    TEST_FIXTURE(batch_fixture, cancel_actor_with_batch)
+    {
+        push_shape_with_two_cancelling_deciders(*this);
+        create_vms_with_batch_capacity(liz_vm_cancellation_batch_capacity_requirement(shape.spec));
+        set_actor_states_with_two_cancelling_deciders(*this);
+        
+        liz_vm_cancel_actor(expected_result_vm,
+                            monitor_null,
+                            user_data_lookup_context_null,
+                            identity_user_data_lookup_func,
+                            update_time_zero,
+                            &expected_result_actor,
+                            &shape);
+        liz_vm_cancel_actor(proband_vm,
+                            monitor_null,
+                            user_data_lookup_context_null,
+                            identity_user_data_lookup_func,
+                            update_time_zero,
+                            &proband_actor,
+                            &shape);
+        
+        check_equal_cancellation();
+    }
+    
+} // SUITE(liz_vm_cancellation_batch_test)
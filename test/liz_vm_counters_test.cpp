@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Checks per node counters and their collection by vms.
+ */
+
+#include <unittestpp.h>
+
+#include <liz/liz_common.h>
+#include <liz/liz_common_internal.h>
+#include <liz/liz_vm.h>
+#include <liz/liz_vm_counters.h>
+
+#include "liz_test_helpers.h"
+
+
+
+SUITE(liz_vm_counters_test)
+{
+    
+    
+    TEST(create_and_destroy)
+    {
+        counting_allocator allocator;
+        
+        liz_vm_counters_t *counters = liz_vm_counters_create(5, 
+                                                             &allocator, 
+                                                             counting_alloc);
+        CHECK(NULL != counters);
+        CHECK_EQUAL(5, counters->count);
+        
+        for (liz_int_t i = 0; i < counters->count; ++i) {
+            CHECK_EQUAL(0u, counters->nodes[i].enter_count);
+            CHECK_EQUAL(0u, counters->nodes[i].immediate_action_cycles);
+        }
+        
+        liz_vm_counters_destroy(counters, &allocator, counting_dealloc);
+        
+        CHECK(allocator.is_balanced());
+    }
+    
+    
+    
+    TEST(create_with_negative_count)
+    {
+        counting_allocator allocator;
+        
+        CHECK(NULL == liz_vm_counters_create(-1, &allocator, counting_alloc));
+        CHECK(allocator.is_balanced());
+    }
+    
+    
+    
+    TEST(count_traversal_steps)
+    {
+        counting_allocator allocator;
+        liz_vm_counters_t *counters = liz_vm_counters_create(2, 
+                                                             &allocator, 
+                                                             counting_alloc);
+        
+        liz_vm_count_node(counters, 0, liz_vm_monitor_node_flag_enter_from_top);
+        liz_vm_count_node(counters, 0, liz_vm_monitor_node_flag_leave_to_bottom);
+        liz_vm_count_node(counters, 1, liz_vm_monitor_node_flag_enter_from_top);
+        liz_vm_count_node(counters, 1, liz_vm_monitor_node_flag_leave_to_top);
+        liz_vm_count_node(counters, 0, liz_vm_monitor_node_flag_enter_from_bottom);
+        liz_vm_count_node(counters, 0, liz_vm_monitor_node_flag_leave_to_top);
+        liz_vm_count_node(counters, 1, liz_vm_monitor_node_flag_cancel_action | liz_vm_monitor_node_flag_enter_from_top);
+        liz_vm_count_node(counters, 1, liz_vm_monitor_node_flag_cancel_action | liz_vm_monitor_node_flag_leave_to_top);
+        liz_vm_count_node(counters, 1, liz_vm_monitor_node_flag_error);
+        liz_vm_count_immediate_action_cycles(counters, 1, 42);
+        
+        // Counting without counters is ignored.
+        liz_vm_count_node(NULL, 0, liz_vm_monitor_node_flag_enter_from_top);
+        liz_vm_count_immediate_action_cycles(NULL, 0, 42);
+        
+        CHECK_EQUAL(1u, counters->nodes[0].enter_count);
+        CHECK_EQUAL(1u, counters->nodes[0].leave_count);
+        CHECK_EQUAL(1u, counters->nodes[0].guard_count);
+        CHECK_EQUAL(0u, counters->nodes[0].cancel_count);
+        CHECK_EQUAL(0u, counters->nodes[0].error_count);
+        CHECK_EQUAL(0u, counters->nodes[0].immediate_action_cycles);
+        
+        CHECK_EQUAL(1u, counters->nodes[1].enter_count);
+        CHECK_EQUAL(1u, counters->nodes[1].leave_count);
+        CHECK_EQUAL(0u, counters->nodes[1].guard_count);
+        CHECK_EQUAL(1u, counters->nodes[1].cancel_count);
+        CHECK_EQUAL(1u, counters->nodes[1].error_count);
+        CHECK_EQUAL(42u, counters->nodes[1].immediate_action_cycles);
+        
+        liz_vm_counters_clear(counters);
+        
+        CHECK_EQUAL(0u, counters->nodes[1].enter_count);
+        CHECK_EQUAL(0u, counters->nodes[1].immediate_action_cycles);
+        
+        liz_vm_counters_destroy(counters, &allocator, counting_dealloc);
+    }
+    
+    
+    
+    TEST(merge_per_thread_counters)
+    {
+        counting_allocator allocator;
+        liz_vm_counters_t *frame_counters = liz_vm_counters_create(2, 
+                                                                   &allocator, 
+                                                                   counting_alloc);
+        liz_vm_counters_t *thread_counters[2] = {
+            liz_vm_counters_create(2, &allocator, counting_alloc),
+            liz_vm_counters_create(2, &allocator, counting_alloc)
+        };
+        
+        liz_vm_count_node(thread_counters[0], 1, liz_vm_monitor_node_flag_enter_from_top);
+        liz_vm_count_immediate_action_cycles(thread_counters[0], 1, 3);
+        liz_vm_count_node(thread_counters[1], 1, liz_vm_monitor_node_flag_enter_from_top);
+        liz_vm_count_node(thread_counters[1], 0, liz_vm_monitor_node_flag_enter_from_bottom);
+        liz_vm_count_immediate_action_cycles(thread_counters[1], 1, 4);
+        
+        for (int i = 0; i < 2; ++i) {
+            liz_vm_counters_merge(frame_counters, thread_counters[i]);
+            liz_vm_counters_clear(thread_counters[i]);
+        }
+        
+        CHECK_EQUAL(2u, frame_counters->nodes[1].enter_count);
+        CHECK_EQUAL(7u, frame_counters->nodes[1].immediate_action_cycles);
+        CHECK_EQUAL(1u, frame_counters->nodes[0].guard_count);
+        CHECK_EQUAL(0u, thread_counters[1]->nodes[1].enter_count);
+        
+        liz_vm_counters_destroy(thread_counters[1], &allocator, counting_dealloc);
+        liz_vm_counters_destroy(thread_counters[0], &allocator, counting_dealloc);
+        liz_vm_counters_destroy(frame_counters, &allocator, counting_dealloc);
+        
+        CHECK(allocator.is_balanced());
+    }
+    
+    
+    
+    TEST_FIXTURE(liz_vm_test_fixture, count_vm_update)
+    {
+        push_shape_sequence_decider(3);
+        push_shape_immediate_action(immediate_action_func_index_success3);
+        push_shape_immediate_action(immediate_action_func_index_running2);
+        
+        create_expected_result_and_proband_vms_for_shape();
+        
+        counting_allocator allocator;
+        liz_vm_counters_t *counters = liz_vm_counters_create(liz_shape_specification_shape_atom_index_count(shape.spec), 
+                                                             &allocator, 
+                                                             counting_alloc);
+        proband_vm->counters = counters;
+        
+        for (int i = 0; i < 2; ++i) {
+            liz_vm_update_actor(proband_vm,
+                                NULL, // monitor
+                                NULL,
+                                identity_user_data_lookup_func,
+                                0, // time
+                                &proband_actor,
+                                &shape);
+            liz_vm_extract_actor_state(proband_vm, &proband_actor, &shape);
+        }
+        
+        // Counters survive vm resets between updates.
+        CHECK(counters == proband_vm->counters);
+        
+#if defined(LIZ_VM_COUNTERS_ENABLE)
+        CHECK_EQUAL(2u, counters->nodes[0].enter_count);
+        CHECK_EQUAL(2u, counters->nodes[0].leave_count);
+        CHECK_EQUAL(3u, counters->nodes[0].guard_count);
+        // The sequence resumes its running child and skips the succeeded one.
+        CHECK_EQUAL(1u, counters->nodes[1].enter_count);
+        CHECK_EQUAL(1u, counters->nodes[1].leave_count);
+        CHECK_EQUAL(2u, counters->nodes[2].enter_count);
+        CHECK_EQUAL(0u, counters->nodes[2].cancel_count);
+#else
+        CHECK_EQUAL(0u, counters->nodes[0].enter_count);
+        CHECK_EQUAL(0u, counters->nodes[2].enter_count);
+#endif
+        
+        liz_vm_counters_destroy(counters, &allocator, counting_dealloc);
+    }
+    
+} // SUITE(liz_vm_counters_test)
@@ -55,11 +55,11 @@ SUITE(liz_vm_helpers_test)
         liz_int_t const stack_capacity = 0;
         std::size_t const state_alignment = 2;
         
-        uint16_t const expected_states[state_count] = {};
-        uint16_t const expected_state_shape_atom_indices[state_count] = {};
+        liz_index_t const expected_states[state_count] = {};
+        liz_index_t const expected_state_shape_atom_indices[state_count] = {};
         
-        uint16_t states[state_count] = {};
-        uint16_t state_shape_atom_indices[state_count] = {};
+        liz_index_t states[state_count] = {};
+        liz_index_t state_shape_atom_indices[state_count] = {};
         
         liz_vm_decider_guard_t stack_buffer[stack_capacity] = {};
         liz_lookaside_stack_t stack_header = liz_lookaside_stack_make(stack_capacity, 0);
@@ -84,11 +84,11 @@ SUITE(liz_vm_helpers_test)
         liz_int_t const stack_capacity = 0;
         std::size_t const state_alignment = 2;
         
-        uint16_t expected_states[state_count] = {42u};
-        uint16_t expected_state_shape_atom_indices[state_count] = {7u};
+        liz_index_t expected_states[state_count] = {42u};
+        liz_index_t expected_state_shape_atom_indices[state_count] = {7u};
         
-        uint16_t states[state_count] = {42u};
-        uint16_t state_shape_atom_indices[state_count] = {7u};
+        liz_index_t states[state_count] = {42u};
+        liz_index_t state_shape_atom_indices[state_count] = {7u};
         
         liz_vm_decider_guard_t stack_buffer[stack_capacity] = {};
         liz_lookaside_stack_t stack_header = liz_lookaside_stack_make(stack_capacity, 0);
@@ -113,11 +113,11 @@ SUITE(liz_vm_helpers_test)
         liz_int_t const stack_capacity = 1;
         std::size_t const state_alignment = 2;
         
-        uint16_t expected_states[state_count] = {5u, 4u, 3u};
-        uint16_t expected_state_shape_atom_indices[state_count] = {0u, 1u, 2u};
+        liz_index_t expected_states[state_count] = {5u, 4u, 3u};
+        liz_index_t expected_state_shape_atom_indices[state_count] = {0u, 1u, 2u};
         
-        uint16_t states[state_count] = {5u, 4u, 3u};
-        uint16_t state_shape_atom_indices[state_count] = {0u, 1u, 2u};
+        liz_index_t states[state_count] = {5u, 4u, 3u};
+        liz_index_t state_shape_atom_indices[state_count] = {0u, 1u, 2u};
         
         liz_vm_decider_guard_t stack_buffer[stack_capacity] = {};
         liz_lookaside_stack_t stack_header = liz_lookaside_stack_make(stack_capacity, 0);
@@ -142,11 +142,11 @@ SUITE(liz_vm_helpers_test)
         liz_int_t const stack_capacity = 2;
         std::size_t const state_alignment = 2;
         
-        uint16_t expected_states[state_count] = {103u, 102u, 101u};
-        uint16_t expected_state_shape_atom_indices[state_count] = {7u, 23u, 42u};
+        liz_index_t expected_states[state_count] = {103u, 102u, 101u};
+        liz_index_t expected_state_shape_atom_indices[state_count] = {7u, 23u, 42u};
         
-        uint16_t states[state_count] = {101u, 102u, 103u};
-        uint16_t state_shape_atom_indices[state_count] = {42u, 23u, 7u};
+        liz_index_t states[state_count] = {101u, 102u, 103u};
+        liz_index_t state_shape_atom_indices[state_count] = {42u, 23u, 7u};
         
         liz_vm_decider_guard_t stack_buffer[stack_capacity] = {};
         liz_lookaside_stack_t stack_header = liz_lookaside_stack_make(stack_capacity, 0);
@@ -171,11 +171,11 @@ SUITE(liz_vm_helpers_test)
         liz_int_t const stack_capacity = 3;
         std::size_t const state_alignment = 2;
         
-        uint16_t expected_states[state_count] = {105u, 104u, 103u, 102u, 101u, 100u};
-        uint16_t expected_state_shape_atom_indices[state_count] = {1u, 2u, 3u, 4u, 6u, 7u};
+        liz_index_t expected_states[state_count] = {105u, 104u, 103u, 102u, 101u, 100u};
+        liz_index_t expected_state_shape_atom_indices[state_count] = {1u, 2u, 3u, 4u, 6u, 7u};
         
-        uint16_t states[state_count] = {105u, 104u, 102u, 103u, 100u, 101u};
-        uint16_t state_shape_atom_indices[state_count] = {1u, 2u, 4u, 3u, 7u, 6u};
+        liz_index_t states[state_count] = {105u, 104u, 102u, 103u, 100u, 101u};
+        liz_index_t state_shape_atom_indices[state_count] = {1u, 2u, 4u, 3u, 7u, 6u};
         
         liz_vm_decider_guard_t stack_buffer[stack_capacity] = {};
         liz_lookaside_stack_t stack_header = liz_lookaside_stack_make(stack_capacity, 0);
@@ -200,11 +200,11 @@ SUITE(liz_vm_helpers_test)
         liz_int_t const stack_capacity = 3;
         std::size_t const state_alignment = 2;
         
-        uint16_t expected_states[state_count] = {107u, 106u, 105u, 104u, 103u, 102u, 101u, 100u};
-        uint16_t expected_state_shape_atom_indices[state_count] = {0u, 1u, 2u, 3u, 4u, 5u, 6u, 7u};
+        liz_index_t expected_states[state_count] = {107u, 106u, 105u, 104u, 103u, 102u, 101u, 100u};
+        liz_index_t expected_state_shape_atom_indices[state_count] = {0u, 1u, 2u, 3u, 4u, 5u, 6u, 7u};
         
-        uint16_t states[state_count] = {105u, 104u, 106u, 101u, 100u, 102u, 103u, 107u};
-        uint16_t state_shape_atom_indices[state_count] = {2u, 3u, 1u, 6u, 7u, 5u, 4u, 0u};
+        liz_index_t states[state_count] = {105u, 104u, 106u, 101u, 100u, 102u, 103u, 107u};
+        liz_index_t state_shape_atom_indices[state_count] = {2u, 3u, 1u, 6u, 7u, 5u, 4u, 0u};
         
         liz_vm_decider_guard_t stack_buffer[stack_capacity] = {};
         liz_lookaside_stack_t stack_header = liz_lookaside_stack_make(stack_capacity, 0);
@@ -627,7 +627,8 @@ SUITE(liz_vm_helpers_test)
         
         liz_vm_monitor_t monitor = {
             reinterpret_cast<uintptr_t>(&proband_log),
-            monitor_test_func
+            monitor_test_func,
+            NULL
         };
         
         liz_vm_cancel_running_actions_from_current_update(proband_vm,
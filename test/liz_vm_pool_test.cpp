@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Checks size class selection, reuse, and sharing of pooled vms.
+ */
+
+#include <unittestpp.h>
+
+#include <vector>
+
+#include <pthread.h>
+
+#include <liz/liz_common.h>
+#include <liz/liz_allocator.h>
+#include <liz/liz_memory_telemetry.h>
+#include <liz/liz_vm.h>
+#include <liz/liz_vm_pool.h>
+
+#include "liz_test_helpers.h"
+
+
+
+SUITE(liz_vm_pool_test)
+{
+    namespace {
+        
+        liz_shape_specification_t
+        make_spec(liz_index_t const action_request_capacity)
+        {
+            liz_shape_specification_t spec = {};
+            spec.decider_state_capacity = 1;
+            spec.action_request_capacity = action_request_capacity;
+            
+            return spec;
+        }
+        
+        
+        
+        struct pool_worker {
+            liz_vm_pool_t *pool;
+            int index;
+            int failure_count;
+        };
+        
+        
+        // Acquires and releases vms of varying size classes.
+        void*
+        run_pool_worker(void *context)
+        {
+            pool_worker *worker = static_cast<pool_worker *>(context);
+            
+            for (int i = 0; i < 1000; ++i) {
+                liz_shape_specification_t const spec = make_spec(static_cast<liz_index_t>(1 + (i + worker->index) % 40));
+                liz_vm_t *vm = liz_vm_pool_acquire(worker->pool, spec);
+                
+                if (NULL == vm || !liz_vm_fulfills_shape_specification(vm, spec)) {
+                    ++(worker->failure_count);
+                    continue;
+                }
+                
+                liz_vm_pool_release(worker->pool, vm);
+            }
+            
+            return NULL;
+        }
+        
+    } // anonymous namespace
+    
+    
+    
+    TEST(size_classes_cover_all_capacities)
+    {
+        CHECK_EQUAL(0, liz_vm_pool_size_class(make_spec(0)));
+        CHECK_EQUAL(0, liz_vm_pool_size_class(make_spec(LIZ_VM_POOL_MIN_SIZE_CLASS_CAPACITY)));
+        CHECK_EQUAL(1, liz_vm_pool_size_class(make_spec(LIZ_VM_POOL_MIN_SIZE_CLASS_CAPACITY + 1)));
+        CHECK_EQUAL(LIZ_VM_POOL_SIZE_CLASS_COUNT - 1, liz_vm_pool_size_class(make_spec(LIZ_COUNT_MAX)));
+        CHECK_EQUAL(LIZ_VM_POOL_SIZE_CLASS_COUNT - 2, liz_vm_pool_size_class(make_spec(LIZ_COUNT_MAX / 2)));
+        
+        for (liz_int_t size_class = 0; size_class < LIZ_VM_POOL_SIZE_CLASS_COUNT; ++size_class) {
+            liz_shape_specification_t const spec = liz_vm_pool_size_class_specification(size_class);
+            CHECK_EQUAL(size_class, liz_vm_pool_size_class(spec));
+        }
+    }
+    
+    
+    
+    TEST(acquire_smallest_fitting_vm_and_reuse_it)
+    {
+        counting_allocator allocator;
+        liz_memory_telemetry_t telemetry;
+        liz_memory_telemetry_init(&telemetry);
+        liz_tracking_allocator_t tracking_allocator;
+        liz_tracking_allocator_init(&tracking_allocator,
+                                    &telemetry,
+                                    liz_memory_category_vm,
+                                    &allocator,
+                                    counting_alloc,
+                                    counting_dealloc);
+        
+        liz_vm_pool_t *pool = liz_vm_pool_create(1, 
+                                                 &tracking_allocator, 
+                                                 liz_tracking_alloc, 
+                                                 liz_tracking_dealloc);
+        CHECK(NULL != pool);
+        
+        liz_shape_specification_t const small_spec = make_spec(3);
+        liz_shape_specification_t const big_spec = make_spec(100);
+        
+        liz_vm_t *small_vm = liz_vm_pool_acquire(pool, small_spec);
+        liz_vm_t *big_vm = liz_vm_pool_acquire(pool, big_spec);
+        
+        CHECK(NULL != small_vm);
+        CHECK(NULL != big_vm);
+        CHECK(liz_vm_fulfills_shape_specification(small_vm, small_spec));
+        CHECK(liz_vm_fulfills_shape_specification(big_vm, big_spec));
+        CHECK(liz_vm_memory_size(small_vm) < liz_vm_memory_size(big_vm));
+        
+        // The small size class is exhausted and the big vm is in use.
+        CHECK(NULL == liz_vm_pool_acquire(pool, small_spec));
+        
+        // Fall back to the free bigger vm.
+        liz_vm_pool_release(pool, big_vm);
+        CHECK_EQUAL(big_vm, liz_vm_pool_acquire(pool, small_spec));
+        liz_vm_pool_release(pool, big_vm);
+        
+        // Reuse without allocating.
+        uint64_t const allocation_count = liz_memory_telemetry_total(&telemetry).allocation_count;
+        liz_vm_pool_release(pool, small_vm);
+        CHECK_EQUAL(small_vm, liz_vm_pool_acquire(pool, small_spec));
+        CHECK_EQUAL(allocation_count, liz_memory_telemetry_total(&telemetry).allocation_count);
+        liz_vm_pool_release(pool, small_vm);
+        
+        liz_vm_pool_destroy(pool, &tracking_allocator, liz_tracking_dealloc);
+        
+        CHECK(liz_memory_telemetry_is_balanced(&telemetry));
+        CHECK(allocator.is_balanced());
+    }
+    
+    
+    
+    TEST(reserve_vms_up_front)
+    {
+        liz_vm_pool_t *pool = liz_vm_pool_create(2, NULL, liz_default_alloc, liz_default_dealloc);
+        
+        CHECK(liz_vm_pool_reserve(pool, make_spec(20), 2));
+        CHECK(!liz_vm_pool_reserve(pool, make_spec(20), 3));
+        CHECK_EQUAL(2, pool->vm_counts[liz_vm_pool_size_class(make_spec(20))]);
+        CHECK_EQUAL(2, pool->free_counts[liz_vm_pool_size_class(make_spec(20))]);
+        
+        liz_vm_pool_destroy(pool, NULL, liz_default_dealloc);
+    }
+    
+    
+    
+    TEST_FIXTURE(liz_vm_test_fixture, batch_shares_vms_per_size_class)
+    {
+        push_shape_deferred_action(42, // action_id
+                                   7 // resource_id
+                                   );
+        create_expected_result_and_proband_vms_for_shape();
+        
+        liz_vm_pool_t *pool = liz_vm_pool_create(2, NULL, liz_default_alloc, liz_default_dealloc);
+        
+        liz_shape_specification_t const specs[] = {
+            shape.spec,
+            make_spec(100),
+            shape.spec
+        };
+        liz_vm_t *vms[3] = {NULL, NULL, NULL};
+        
+        CHECK(liz_vm_pool_acquire_batch(pool, specs, 3, vms));
+        CHECK_EQUAL(vms[0], vms[2]);
+        CHECK(vms[0] != vms[1]);
+        
+        liz_vm_update_actor(vms[0],
+                            NULL, // monitor
+                            NULL,
+                            identity_user_data_lookup_func,
+                            0, // time
+                            &proband_actor,
+                            &shape);
+        
+        liz_action_request_t requests[4];
+        CHECK_EQUAL(1, liz_vm_extract_action_requests(vms[0], requests, 4, 1));
+        CHECK_EQUAL(42u, requests[0].action_id);
+        
+        liz_vm_pool_release_batch(pool, vms, 3);
+        
+        liz_int_t const size_class = liz_vm_pool_size_class(shape.spec);
+        CHECK_EQUAL(pool->vm_counts[size_class], pool->free_counts[size_class]);
+        
+        liz_vm_pool_destroy(pool, NULL, liz_default_dealloc);
+    }
+    
+    
+    
+    TEST(workers_share_pool)
+    {
+        int const worker_count = 4;
+        liz_vm_pool_t *pool = liz_vm_pool_create(worker_count, 
+                                                 NULL, 
+                                                 liz_default_alloc, 
+                                                 liz_default_dealloc);
+        
+        std::vector<pool_worker> workers(static_cast<std::size_t>(worker_count));
+        std::vector<pthread_t> threads(static_cast<std::size_t>(worker_count));
+        
+        for (std::size_t w = 0; w < workers.size(); ++w) {
+            pool_worker const worker = {pool, static_cast<int>(w), 0};
+            workers[w] = worker;
+            
+            int const error_code = pthread_create(&threads[w], NULL, run_pool_worker, &workers[w]);
+            CHECK_EQUAL(0, error_code);
+        }
+        
+        for (std::size_t w = 0; w < threads.size(); ++w) {
+            pthread_join(threads[w], NULL);
+            CHECK_EQUAL(0, workers[w].failure_count);
+        }
+        
+        for (liz_int_t size_class = 0; size_class < LIZ_VM_POOL_SIZE_CLASS_COUNT; ++size_class) {
+            CHECK(pool->vm_counts[size_class] <= worker_count);
+            CHECK_EQUAL(pool->vm_counts[size_class], pool->free_counts[size_class]);
+        }
+        
+        liz_vm_pool_destroy(pool, NULL, liz_default_dealloc);
+    }
+    
+} // SUITE(liz_vm_pool_test)
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Checks collection and aggregation of vm update statistics.
+ */
+
+#include <unittestpp.h>
+
+#include <liz/liz_common.h>
+#include <liz/liz_vm.h>
+#include <liz/liz_vm_stats.h>
+
+#include "liz_test_helpers.h"
+
+
+
+SUITE(liz_vm_stats_test)
+{
+    namespace {
+        
+        liz_vm_update_stats_t
+        make_update_stats(uint64_t const cycles,
+                          uint32_t const visited_node_count)
+        {
+            liz_vm_update_stats_t stats = {
+                cycles,
+                visited_node_count,
+                1, // immediate_action_count
+                2, // cancelled_action_count
+                3, // launch_request_count
+                4, // cancel_request_count
+                0 // padding
+            };
+            
+            return stats;
+        }
+        
+    } // anonymous namespace
+    
+    
+    
+    TEST(aggregate_update_stats)
+    {
+        liz_vm_stats_t stats;
+        liz_vm_stats_clear(&stats);
+        
+        CHECK_EQUAL(0u, liz_vm_stats_mean_cycles(&stats));
+        
+        liz_vm_update_stats_t const cheap_update = make_update_stats(10, 2);
+        liz_vm_update_stats_t const expensive_update = make_update_stats(50, 6);
+        liz_vm_stats_add_update(&stats, &cheap_update);
+        liz_vm_stats_add_update(&stats, &expensive_update);
+        
+        CHECK_EQUAL(2u, stats.update_count);
+        CHECK_EQUAL(60u, stats.cycles);
+        CHECK_EQUAL(50u, stats.max_cycles);
+        CHECK_EQUAL(30u, liz_vm_stats_mean_cycles(&stats));
+        CHECK_EQUAL(8u, stats.visited_node_count);
+        CHECK_EQUAL(2u, stats.immediate_action_count);
+        CHECK_EQUAL(4u, stats.cancelled_action_count);
+        CHECK_EQUAL(6u, stats.launch_request_count);
+        CHECK_EQUAL(8u, stats.cancel_request_count);
+    }
+    
+    
+    
+    TEST(merge_stats)
+    {
+        liz_vm_stats_t thread_stats[2];
+        liz_vm_stats_clear(&thread_stats[0]);
+        liz_vm_stats_clear(&thread_stats[1]);
+        
+        liz_vm_update_stats_t const cheap_update = make_update_stats(10, 2);
+        liz_vm_update_stats_t const expensive_update = make_update_stats(50, 6);
+        liz_vm_stats_add_update(&thread_stats[0], &expensive_update);
+        liz_vm_stats_add_update(&thread_stats[1], &cheap_update);
+        liz_vm_stats_add_update(&thread_stats[1], &cheap_update);
+        
+        liz_vm_stats_t shape_stats;
+        liz_vm_stats_clear(&shape_stats);
+        liz_vm_stats_merge(&shape_stats, &thread_stats[0]);
+        liz_vm_stats_merge(&shape_stats, &thread_stats[1]);
+        
+        CHECK_EQUAL(3u, shape_stats.update_count);
+        CHECK_EQUAL(70u, shape_stats.cycles);
+        CHECK_EQUAL(50u, shape_stats.max_cycles);
+        CHECK_EQUAL(10u, shape_stats.visited_node_count);
+        CHECK_EQUAL(9u, shape_stats.launch_request_count);
+    }
+    
+    
+    
+    TEST_FIXTURE(liz_vm_test_fixture, collect_update_and_cancel_stats)
+    {
+        push_shape_sequence_decider(4);
+        push_shape_immediate_action(immediate_action_func_index_success3);
+        push_shape_deferred_action(42, // action_id
+                                   7 // resource_id
+                                   );
+        push_shape_immediate_action(immediate_action_func_index_success3);
+        
+        create_expected_result_and_proband_vms_for_shape();
+        
+        liz_vm_update_actor(proband_vm,
+                            NULL, // monitor
+                            NULL,
+                            identity_user_data_lookup_func,
+                            0, // time
+                            &proband_actor,
+                            &shape);
+        
+        liz_vm_update_stats_t stats = liz_vm_update_stats(proband_vm);
+        
+        // The launched deferred action keeps the sequence from reaching the
+        // last child.
+        CHECK_EQUAL(1u, stats.launch_request_count);
+        CHECK_EQUAL(0u, stats.cancel_request_count);
+#if defined(LIZ_VM_STATS_ENABLE)
+        CHECK_EQUAL(3u, stats.visited_node_count);
+        CHECK_EQUAL(1u, stats.immediate_action_count);
+        CHECK_EQUAL(0u, stats.cancelled_action_count);
+#else
+        CHECK_EQUAL(0u, stats.visited_node_count);
+        CHECK_EQUAL(0u, stats.cycles);
+#endif
+        
+        liz_vm_extract_actor_state(proband_vm, &proband_actor, &shape);
+        liz_vm_cancel_actor(proband_vm,
+                            NULL, // monitor
+                            NULL,
+                            identity_user_data_lookup_func,
+                            0, // time
+                            &proband_actor,
+                            &shape);
+        
+        stats = liz_vm_update_stats(proband_vm);
+        
+        CHECK_EQUAL(0u, stats.launch_request_count);
+        CHECK_EQUAL(1u, stats.cancel_request_count);
+#if defined(LIZ_VM_STATS_ENABLE)
+        CHECK_EQUAL(0u, stats.visited_node_count);
+        CHECK_EQUAL(1u, stats.cancelled_action_count);
+#else
+        CHECK_EQUAL(0u, stats.cancelled_action_count);
+#endif
+    }
+    
+} // SUITE(liz_vm_stats_test)
@@ -64,6 +64,8 @@ SUITE(liz_vm_test)
             1,
             0,
             1,
+            0,
+            0,
             0
         };        
         liz_vm_t *vm = liz_vm_create(vm_spec,
@@ -80,6 +82,52 @@ SUITE(liz_vm_test)
     }
     
     
+    TEST(create_cache_line_aligned_vms)
+    {
+        liz_shape_specification_t vm_spec = {
+            2,
+            1,
+            0,
+            1,
+            1,
+            0,
+            1,
+            0,
+            0,
+            0
+        };
+        
+        size_t const vm_size = liz_vm_memory_size_requirement_aligned(vm_spec, LIZ_CACHE_LINE_SIZE);
+        CHECK(liz_vm_memory_size_requirement(vm_spec) <= vm_size);
+        CHECK_EQUAL(0u, vm_size % LIZ_CACHE_LINE_SIZE);
+        
+        // Vms of neighboring workers placed back to back never share a cache
+        // line.
+        char memory[8 * 1024];
+        liz_arena_t arena;
+        liz_arena_init(&arena, memory, sizeof(memory));
+        
+        liz_vm_t *first = liz_vm_create_aligned(vm_spec, LIZ_CACHE_LINE_SIZE, &arena, liz_arena_aligned_alloc);
+        liz_vm_t *second = liz_vm_create_aligned(vm_spec, LIZ_CACHE_LINE_SIZE, &arena, liz_arena_aligned_alloc);
+        
+        CHECK(NULL != first);
+        CHECK(NULL != second);
+        CHECK_EQUAL(0u, liz_allocation_alignment_offset(first, LIZ_CACHE_LINE_SIZE));
+        CHECK_EQUAL(reinterpret_cast<char *>(first) + vm_size, reinterpret_cast<char *>(second));
+        CHECK(liz_vm_fulfills_shape_specification(second, vm_spec));
+        
+        liz_vm_t *vm = liz_vm_create_aligned(vm_spec, 
+                                             LIZ_CACHE_LINE_SIZE, 
+                                             NULL, 
+                                             liz_default_aligned_alloc);
+        CHECK(NULL != vm);
+        CHECK_EQUAL(0u, liz_allocation_alignment_offset(vm, LIZ_CACHE_LINE_SIZE));
+        
+        liz_vm_destroy(vm, NULL, liz_default_aligned_dealloc);
+    }
+    
+    
+    
     TEST(vm_does_not_fulfill_shape_requirements)
     {
         counting_allocator allocator;
@@ -92,6 +140,8 @@ SUITE(liz_vm_test)
             1,
             0,
             1,
+            0,
+            0,
             0
         };
         
@@ -103,7 +153,9 @@ SUITE(liz_vm_test)
             1,
             0,
             1,
-            1
+            1,
+            0,
+            0
         };
         
         liz_vm_t *vm = liz_vm_create(vm_spec,
@@ -131,7 +183,9 @@ SUITE(liz_vm_test)
             2,
             0,
             1,
-            1
+            1,
+            0,
+            0
         };
         
         liz_shape_specification_t lesser_spec = {
@@ -142,7 +196,9 @@ SUITE(liz_vm_test)
             1,
             0,
             1,
-            1
+            1,
+            0,
+            0
         };
         
         liz_vm_t *vm = liz_vm_create(vm_spec,
@@ -168,13 +224,77 @@ SUITE(liz_vm_test)
         
         
         
-        void*
-        idenity_user_data_lookup_func(void *context,
-                                      uintptr_t user_data)
-        {
-            (void)context;
-            return reinterpret_cast<void*>(user_data);
-        }
+        /**
+         * Shape with a concurrent decider calling the same shared subtree 
+         * twice. The shared subtree is a sequence decider with an immediate
+         * action and two deferred actions.
+         *
+         * push_expanded_shape pushes the equivalent shape without subtree 
+         * calls into a vm test fixture.
+         */
+        class shared_subtree_shape {
+        public:
+            
+            shared_subtree_shape(liz_vm_shape_t const& expanded_shape)
+            :   atoms(stream_atom_count)
+            ,   calls(call_count)
+            ,   shape(expanded_shape)
+            {
+                liz_int_t stream_index = 0;
+                liz_shape_atom_stream_add_concurrent_decider(&atoms[0], &stream_index, stream_atom_count, 1 + 2 * subtree_atom_count);
+                liz_shape_atom_stream_add_subtree_call(&atoms[0], &stream_index, stream_atom_count, main_tree_atom_count, subtree_atom_count);
+                liz_shape_atom_stream_add_subtree_call(&atoms[0], &stream_index, stream_atom_count, main_tree_atom_count, subtree_atom_count);
+                assert(main_tree_atom_count == stream_index);
+                liz_shape_atom_stream_add_sequence_decider(&atoms[0], &stream_index, stream_atom_count, subtree_atom_count);
+                liz_shape_atom_stream_add_immediate_action(&atoms[0], &stream_index, stream_atom_count, liz_vm_test_fixture::immediate_action_func_index_success3);
+                liz_shape_atom_stream_add_deferred_action(&atoms[0], &stream_index, stream_atom_count, 42, 7);
+                liz_shape_atom_stream_add_deferred_action(&atoms[0], &stream_index, stream_atom_count, 43, 8);
+                assert(stream_atom_count == stream_index);
+                
+                liz_int_t shape_atom_index_count = 0;
+                liz_int_t const collected_call_count = liz_shape_atom_stream_collect_subtree_calls(&calls[0],
+                                                                                                  call_count,
+                                                                                                  &shape_atom_index_count,
+                                                                                                  &atoms[0],
+                                                                                                  main_tree_atom_count);
+                assert(call_count == collected_call_count);
+                (void)collected_call_count;
+                
+                shape.atoms = &atoms[0];
+                shape.subtree_calls = &calls[0];
+                shape.spec.shape_atom_count = stream_atom_count;
+                shape.spec.subtree_call_count = call_count;
+                shape.spec.shape_atom_index_count = static_cast<liz_index_t>(shape_atom_index_count);
+            }
+            
+            
+            static void push_expanded_shape(liz_vm_test_fixture& fixture)
+            {
+                fixture.push_shape_concurrent_decider(1 + 2 * subtree_atom_count);
+                
+                for (int i = 0; i < call_count; ++i) {
+                    fixture.push_shape_sequence_decider(subtree_atom_count);
+                    fixture.push_shape_immediate_action(liz_vm_test_fixture::immediate_action_func_index_success3);
+                    fixture.push_shape_deferred_action(42, 7);
+                    fixture.push_shape_deferred_action(43, 8);
+                }
+            }
+            
+            
+            static liz_index_t const subtree_atom_count = 6;
+            static liz_index_t const main_tree_atom_count = 5;
+            static liz_index_t const stream_atom_count = main_tree_atom_count + subtree_atom_count;
+            static liz_index_t const call_count = 2;
+            
+            std::vector<liz_shape_atom_t> atoms;
+            std::vector<liz_shape_subtree_call_t> calls;
+            liz_vm_shape_t shape;
+        };
+        
+        liz_index_t const shared_subtree_shape::subtree_atom_count;
+        liz_index_t const shared_subtree_shape::main_tree_atom_count;
+        liz_index_t const shared_subtree_shape::stream_atom_count;
+        liz_index_t const shared_subtree_shape::call_count;
         
         
     } // anonymous namespace
@@ -196,7 +316,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -230,7 +350,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -260,7 +380,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -286,7 +406,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -321,7 +441,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -354,7 +474,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -387,7 +507,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -416,7 +536,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -445,7 +565,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -473,7 +593,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -503,7 +623,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -537,7 +657,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -573,7 +693,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -613,7 +733,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -656,7 +776,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -705,7 +825,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -754,7 +874,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -794,7 +914,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -829,7 +949,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -869,7 +989,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -905,7 +1025,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -951,7 +1071,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -991,7 +1111,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -1031,7 +1151,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -1065,7 +1185,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -1106,7 +1226,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -1147,7 +1267,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -1198,7 +1318,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -1243,7 +1363,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -1274,7 +1394,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -1308,7 +1428,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -1358,7 +1478,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -1402,7 +1522,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -1438,7 +1558,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -1487,7 +1607,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -1530,7 +1650,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -1579,7 +1699,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -1620,7 +1740,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -1665,7 +1785,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -1714,7 +1834,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -1758,7 +1878,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -1802,7 +1922,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -1894,7 +2014,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -1935,7 +2055,7 @@ SUITE(liz_vm_test)
         liz_vm_cancel_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -1963,7 +2083,7 @@ SUITE(liz_vm_test)
         liz_vm_cancel_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -1997,7 +2117,7 @@ SUITE(liz_vm_test)
         liz_vm_cancel_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -2031,7 +2151,7 @@ SUITE(liz_vm_test)
         liz_vm_cancel_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -2079,7 +2199,7 @@ SUITE(liz_vm_test)
         liz_vm_cancel_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -2092,6 +2212,112 @@ SUITE(liz_vm_test)
     }
     
     
+    TEST_FIXTURE(liz_vm_test_fixture, subtree_calls_key_states_and_requests_per_call_site)
+    {
+        shared_subtree_shape::push_expanded_shape(*this);
+        
+        create_expected_result_and_proband_vms_for_shape();
+        
+        shared_subtree_shape const shared(shape);
+        
+        // First update launches the first deferred action of each call site.
+        liz_vm_update_actor(expected_result_vm,
+                            monitor_null,
+                            user_data_lookup_context_null,
+                            identity_user_data_lookup_func,
+                            update_time_zero,
+                            &expected_result_actor,
+                            &shape);
+        liz_vm_update_actor(proband_vm,
+                            monitor_null,
+                            user_data_lookup_context_null,
+                            identity_user_data_lookup_func,
+                            update_time_zero,
+                            &proband_actor,
+                            &shared.shape);
+        
+        CHECK_EQUAL(expected_result_vm_extractable_state_comparator, 
+                    proband_vm_extractable_state_comparator);
+        CHECK_EQUAL(2, liz_vm_action_request_count(proband_vm));
+        CHECK_EQUAL(3, proband_vm->action_requests[0].shape_atom_index);
+        CHECK_EQUAL(9, proband_vm->action_requests[1].shape_atom_index);
+        
+        // Second update resumes both sequences from their decider states, the
+        // first call site's deferred action succeeded in the meantime.
+        push_actor_decider_state(target_select_both,
+                                 1, // shape_atom_index
+                                 3 // reached child shape atom index
+                                 );
+        push_actor_decider_state(target_select_both,
+                                 7, // shape_atom_index
+                                 9 // reached child shape atom index
+                                 );
+        push_actor_action_state(target_select_both,
+                                3, // shape_atom_index
+                                liz_execution_state_success);
+        push_actor_action_state(target_select_both,
+                                9, // shape_atom_index
+                                liz_execution_state_launch);
+        
+        liz_vm_update_actor(expected_result_vm,
+                            monitor_null,
+                            user_data_lookup_context_null,
+                            identity_user_data_lookup_func,
+                            update_time_zero,
+                            &expected_result_actor,
+                            &shape);
+        liz_vm_update_actor(proband_vm,
+                            monitor_null,
+                            user_data_lookup_context_null,
+                            identity_user_data_lookup_func,
+                            update_time_zero,
+                            &proband_actor,
+                            &shared.shape);
+        
+        CHECK_EQUAL(expected_result_vm_extractable_state_comparator, 
+                    proband_vm_extractable_state_comparator);
+        CHECK_EQUAL(1, liz_vm_action_request_count(proband_vm));
+        CHECK_EQUAL(5, proband_vm->action_requests[0].shape_atom_index);
+        CHECK_EQUAL(43u, proband_vm->action_requests[0].action_id);
+    }
+    
+    
+    TEST_FIXTURE(liz_vm_test_fixture, subtree_calls_cancel_actor)
+    {
+        shared_subtree_shape::push_expanded_shape(*this);
+        
+        create_expected_result_and_proband_vms_for_shape();
+        
+        shared_subtree_shape const shared(shape);
+        
+        push_actor_action_state(target_select_both,
+                                5, // shape_atom_index
+                                liz_execution_state_running);
+        push_actor_action_state(target_select_both,
+                                11, // shape_atom_index
+                                liz_execution_state_running);
+        
+        liz_vm_cancel_actor(expected_result_vm,
+                            monitor_null,
+                            user_data_lookup_context_null,
+                            identity_user_data_lookup_func,
+                            update_time_zero,
+                            &expected_result_actor,
+                            &shape);
+        liz_vm_cancel_actor(proband_vm,
+                            monitor_null,
+                            user_data_lookup_context_null,
+                            identity_user_data_lookup_func,
+                            update_time_zero,
+                            &proband_actor,
+                            &shared.shape);
+        
+        CHECK_EQUAL(expected_result_vm_extractable_state_comparator, 
+                    proband_vm_extractable_state_comparator);
+        CHECK_EQUAL(2, liz_vm_action_request_count(proband_vm));
+    }
+    
+    
     TEST_FIXTURE(liz_vm_test_fixture, monitor_deferred_action_traversal)
     {
         push_shape_deferred_action(42, 7);
@@ -2104,7 +2330,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -2128,7 +2354,7 @@ SUITE(liz_vm_test)
         liz_vm_cancel_actor(proband_vm,
                             monitor,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -2149,7 +2375,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -2171,7 +2397,7 @@ SUITE(liz_vm_test)
         liz_vm_cancel_actor(proband_vm,
                             monitor,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -2194,7 +2420,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -2225,7 +2451,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -2257,7 +2483,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -2294,7 +2520,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -2336,7 +2562,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -2360,7 +2586,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -2388,7 +2614,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -2414,7 +2640,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -2446,7 +2672,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -2500,7 +2726,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -2551,7 +2777,7 @@ SUITE(liz_vm_test)
         liz_vm_update_actor(proband_vm,
                             monitor_null,
                             user_data_lookup_context_null,
-                            idenity_user_data_lookup_func,
+                            identity_user_data_lookup_func,
                             update_time_zero,
                             &proband_actor,
                             &shape);
@@ -2595,4 +2821,45 @@ SUITE(liz_vm_test)
         CHECK_EQUAL(expected_result_extract_count, extract_count);
     }
     
+#if defined(LIZ_WIDE_INDEX_ENABLE)
+    
+    TEST_FIXTURE(liz_vm_test_fixture, launch_deferred_action_beyond_16_bit_shape_atom_index)
+    {
+        liz_int_t const immediate_action_count = 70000;
+        
+        push_shape_sequence_decider(static_cast<liz_index_t>(1 + immediate_action_count + 2) // shape atom end offset
+                                    );
+        for (liz_int_t i = 0; i < immediate_action_count; ++i) {
+            push_shape_immediate_action(immediate_action_func_index_success3);
+        }
+        push_shape_deferred_action(42, // action_id
+                                   7 // resource_id
+                                   );
+        
+        CHECK(UINT16_MAX < shape.spec.shape_atom_count);
+        
+        create_expected_result_and_proband_vms_for_shape();
+        
+        liz_vm_update_actor(proband_vm,
+                            monitor_null,
+                            user_data_lookup_context_null,
+                            identity_user_data_lookup_func,
+                            update_time_zero,
+                            &proband_actor,
+                            &shape);
+        
+        CHECK_EQUAL(liz_execution_state_launch, proband_vm->execution_state);
+        
+        liz_action_request_t requests[2] = {};
+        liz_int_t const request_count = liz_vm_extract_action_requests(proband_vm,
+                                                                       requests,
+                                                                       2,
+                                                                       0);
+        CHECK_EQUAL(1, request_count);
+        CHECK_EQUAL(static_cast<uint8_t>(liz_action_request_type_launch), requests[0].type);
+        CHECK_EQUAL(static_cast<liz_index_t>(1 + immediate_action_count), requests[0].shape_atom_index);
+    }
+    
+#endif // defined(LIZ_WIDE_INDEX_ENABLE)
+    
 } // SUITE(liz_vm_test)
@@ -0,0 +1,505 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Checks that lockstep updates of actor groups leave each lane vm like 
+ * liz_vm_update_actor and that lanes taking the same path share wave steps.
+ */
+
+#include <unittestpp.h>
+
+#include <vector>
+
+#include <liz/liz_common.h>
+#include <liz/liz_vm.h>
+#include <liz/liz_vm_wavefront.h>
+
+#include "liz_test_helpers.h"
+
+
+
+SUITE(liz_vm_wavefront_test)
+{
+    namespace {
+        
+        liz_vm_monitor_t *monitor_null = NULL;
+        void* user_data_lookup_context_null = NULL;
+        liz_time_t const update_time_zero = 0;
+        
+        
+        
+        std::vector<liz_immediate_action_func_t> forwarded_functions;
+        std::vector<liz_int_t> batch_call_lane_counts;
+        
+        
+        // Calls the forwarded function per lane in lane_mask and logs the 
+        // number of lanes per call.
+        template<liz_int_t function_index>
+        void
+        forwarding_immediate_action_batch_func(void * const *actor_blackboards,
+                                               liz_random_number_seed_t *rnd_seeds,
+                                               liz_time_t time,
+                                               liz_execution_state_t *execution_states,
+                                               uint64_t lane_mask,
+                                               liz_int_t lane_count)
+        {
+            liz_int_t masked_lane_count = 0;
+            
+            for (liz_int_t lane = 0; lane < lane_count; ++lane) {
+                if (0u != (lane_mask & (UINT64_C(1) << lane))) {
+                    execution_states[lane] = forwarded_functions[function_index](actor_blackboards[lane],
+                                                                                 &rnd_seeds[lane],
+                                                                                 time,
+                                                                                 execution_states[lane]);
+                    ++masked_lane_count;
+                }
+            }
+            
+            batch_call_lane_counts.push_back(masked_lane_count);
+        }
+        
+        
+        
+        class wavefront_fixture : public liz_vm_test_fixture {
+        public:
+            wavefront_fixture()
+            :   liz_vm_test_fixture()
+            ,   wavefront(NULL)
+            ,   lane_actors()
+            ,   batch_functions(shape_immediate_action_function_count, NULL)
+            ,   update_shape(&shape)
+            {
+                forwarded_functions = shape_immediate_action_functions;
+                batch_call_lane_counts.clear();
+                
+                batch_functions[immediate_action_func_index_running2] = forwarding_immediate_action_batch_func<immediate_action_func_index_running2>;
+                batch_functions[immediate_action_func_index_success3] = forwarding_immediate_action_batch_func<immediate_action_func_index_success3>;
+            }
+            
+            
+            ~wavefront_fixture()
+            {
+                if (NULL != wavefront) {
+                    liz_vm_wavefront_destroy(wavefront, &allocator, counting_dealloc);
+                }
+            }
+            
+            
+            // Lanes alternate between the proband and the expected result 
+            // actor unless all lanes use the proband actor.
+            void create_vms_with_lane_count(liz_int_t const lane_count,
+                                            bool const alternate_actors)
+            {
+                create_expected_result_and_proband_vms_for_shape();
+                
+                wavefront = liz_vm_wavefront_create(shape.spec, lane_count, &allocator, counting_alloc);
+                
+                for (liz_int_t i = 0; i < lane_count; ++i) {
+                    bool const proband_lane = !alternate_actors || (0 == i % 2);
+                    lane_actors.push_back(proband_lane ? proband_actor : expected_result_actor);
+                }
+            }
+            
+            
+            // Updates the actors one by one as reference and then in 
+            // lockstep.
+            liz_int_t update_vms(liz_immediate_action_batch_func_t const *functions)
+            {
+                liz_vm_update_actor(expected_result_vm,
+                                    monitor_null,
+                                    user_data_lookup_context_null,
+                                    identity_user_data_lookup_func,
+                                    update_time_zero,
+                                    &expected_result_actor,
+                                    update_shape);
+                
+                liz_vm_update_actor(proband_vm,
+                                    monitor_null,
+                                    user_data_lookup_context_null,
+                                    identity_user_data_lookup_func,
+                                    update_time_zero,
+                                    &proband_actor,
+                                    update_shape);
+                
+                return liz_vm_wavefront_update_actors(wavefront,
+                                                      monitor_null,
+                                                      user_data_lookup_context_null,
+                                                      identity_user_data_lookup_func,
+                                                      update_time_zero,
+                                                      &lane_actors[0],
+                                                      static_cast<liz_int_t>(lane_actors.size()),
+                                                      update_shape,
+                                                      functions);
+            }
+            
+            
+            void check_lanes_equal_single_updates()
+            {
+                for (std::size_t i = 0; i < lane_actors.size(); ++i) {
+                    liz_vm_t const *lane_vm = liz_vm_wavefront_lane_vm(wavefront, static_cast<liz_int_t>(i));
+                    liz_vm_t const *single_vm = (lane_actors[i].header == proband_actor.header) ? proband_vm : expected_result_vm;
+                    
+                    liz_vm_comparator lane_vm_comparator;
+                    lane_vm_comparator.set(lane_vm,
+                                           shape.atoms,
+                                           shape.spec.shape_atom_count);
+                    liz_vm_comparator single_vm_comparator;
+                    single_vm_comparator.set(single_vm,
+                                             shape.atoms,
+                                             shape.spec.shape_atom_count);
+                    
+                    CHECK_EQUAL(single_vm_comparator, lane_vm_comparator);
+                    CHECK_EQUAL(single_vm->execution_state, lane_vm->execution_state);
+                    CHECK_EQUAL(single_vm->actor_random_number_seed, lane_vm->actor_random_number_seed);
+                    
+                    liz_lookaside_double_stack_t const *single_requests = &single_vm->action_request_stack_header;
+                    liz_lookaside_double_stack_t const *lane_requests = &lane_vm->action_request_stack_header;
+                    CHECK_EQUAL(*single_requests, *lane_requests);
+                }
+            }
+            
+            
+            // Steps the proband actor with a vm of its own and returns the 
+            // number of steps.
+            liz_int_t single_proband_step_count()
+            {
+                liz_vm_begin_update_actor(proband_vm, &proband_actor, &shape);
+                
+                return liz_vm_step_update_actor(proband_vm,
+                                                monitor_null,
+                                                proband_blackboard,
+                                                update_time_zero,
+                                                &proband_actor,
+                                                &shape,
+                                                1000);
+            }
+            
+            
+            liz_vm_wavefront_t *wavefront;
+            std::vector<liz_vm_actor_t> lane_actors;
+            std::vector<liz_immediate_action_batch_func_t> batch_functions;
+            
+            // Shape to update with, defaults to the fixture's shape.
+            liz_vm_shape_t const *update_shape;
+        };
+        
+        
+        
+#if defined(LIZ_VM_MONITOR_ENABLE)
+        // Logs the shape atom index of each node entered from the top, 
+        // ignoring cancellations.
+        void
+        enter_from_top_logging_monitor_func(uintptr_t user_data,
+                                            liz_uint_t node_shape_atom_index,
+                                            liz_uint_t traversal_mask,
+                                            liz_vm_t const *vm,
+                                            void const *actor_blackboard,
+                                            liz_time_t time,
+                                            liz_vm_actor_t const *actor,
+                                            liz_vm_shape_t const *shape)
+        {
+            (void)vm;
+            (void)actor_blackboard;
+            (void)time;
+            (void)actor;
+            (void)shape;
+            
+            if (liz_vm_monitor_node_flag_enter_from_top == traversal_mask) {
+                reinterpret_cast<std::vector<liz_uint_t> *>(user_data)->push_back(node_shape_atom_index);
+            }
+        }
+#endif // defined(LIZ_VM_MONITOR_ENABLE)
+        
+    } // anonymous namespace
+    
+    
+    
+    TEST(create_wavefront)
+    {
+        liz_shape_specification_t spec = {};
+        spec.shape_atom_count = 3;
+        spec.action_state_capacity = 2;
+        spec.decider_guard_capacity = 1;
+        
+        counting_allocator allocator;
+        
+        CHECK(NULL == liz_vm_wavefront_create(spec, 0, &allocator, counting_alloc));
+        CHECK(NULL == liz_vm_wavefront_create(spec, LIZ_VM_WAVEFRONT_LANE_CAPACITY + 1, &allocator, counting_alloc));
+        
+        liz_vm_wavefront_t *wavefront = liz_vm_wavefront_create(spec, LIZ_VM_WAVEFRONT_LANE_CAPACITY, &allocator, counting_alloc);
+        CHECK(NULL != wavefront);
+        
+        for (liz_int_t lane = 0; lane < LIZ_VM_WAVEFRONT_LANE_CAPACITY; ++lane) {
+            CHECK(liz_vm_fulfills_shape_specification(liz_vm_wavefront_lane_vm(wavefront, lane), spec));
+        }
+        
+        liz_vm_wavefront_destroy(wavefront, &allocator, counting_dealloc);
+        
+        CHECK(allocator.is_balanced());
+    }
+    
+    
+    
+    TEST_FIXTURE(wavefront_fixture, empty_shape)
+    {
+        create_vms_with_lane_count(3, true);
+        
+        CHECK_EQUAL(0, update_vms(&batch_functions[0]));
+        CHECK_EQUAL(0, liz_vm_wavefront_last_lane_step_count(wavefront));
+    }
+    
+    
+    
+    TEST_FIXTURE(wavefront_fixture, same_path_lanes_step_together)
+    {
+        push_shape_sequence_decider(4); // shape_atom_index 0
+        {
+            push_shape_immediate_action(immediate_action_func_index_success3); // shape_atom_index 1
+            push_shape_immediate_action(immediate_action_func_index_fail4); // shape_atom_index 2
+            push_shape_immediate_action(immediate_action_func_index_running2); // shape_atom_index 3
+        }
+        
+        create_vms_with_lane_count(8, false);
+        
+        liz_int_t const wave_step_count = update_vms(&batch_functions[0]);
+        check_lanes_equal_single_updates();
+        
+        liz_int_t const single_step_count = single_proband_step_count();
+        CHECK_EQUAL(single_step_count, wave_step_count);
+        CHECK_EQUAL(8 * single_step_count, liz_vm_wavefront_last_lane_step_count(wavefront));
+        
+        // The sequence stops at the failing action, which has no batch
+        // function.
+        liz_int_t const expected_lane_counts[] = {8};
+        CHECK_EQUAL(1u, batch_call_lane_counts.size());
+        CHECK_ARRAY_EQUAL(expected_lane_counts, batch_call_lane_counts, 1);
+    }
+    
+    
+    
+    TEST_FIXTURE(wavefront_fixture, diverging_lanes_reconverge)
+    {
+        // The proband actor's persistent action succeeds and skips the 
+        // success action, the expected result actor's fails and runs it.
+        push_shape_concurrent_decider(5); // shape_atom_index 0
+        {
+            push_shape_dynamic_priority_decider(3); // shape_atom_index 1
+            {
+                push_shape_persistent_action(); // shape_atom_index 2
+                push_shape_immediate_action(immediate_action_func_index_success3); // shape_atom_index 3
+            }
+            
+            push_shape_immediate_action(immediate_action_func_index_running2); // shape_atom_index 4
+        }
+        
+        create_vms_with_lane_count(5, true);
+        
+        set_actor_persistent_state(target_select_proband, 0, 2, liz_execution_state_success);
+        set_actor_persistent_state(target_select_expected_result, 0, 2, liz_execution_state_fail);
+        
+        liz_int_t const wave_step_count = update_vms(&batch_functions[0]);
+        check_lanes_equal_single_updates();
+        
+        // Lanes only step alone where they diverge.
+        CHECK(wave_step_count < liz_vm_wavefront_last_lane_step_count(wavefront));
+        
+        // The expected result lanes call the success action alone, then all
+        // lanes share the running action.
+        liz_int_t const expected_lane_counts[] = {2, 5};
+        CHECK_EQUAL(2u, batch_call_lane_counts.size());
+        CHECK_ARRAY_EQUAL(expected_lane_counts, batch_call_lane_counts, 2);
+        
+        // Without batch functions lanes still step in lockstep.
+        batch_call_lane_counts.clear();
+        update_vms(NULL);
+        check_lanes_equal_single_updates();
+        CHECK(batch_call_lane_counts.empty());
+    }
+    
+    
+    
+    TEST_FIXTURE(wavefront_fixture, diverging_lanes_cancel_like_single_updates)
+    {
+        push_shape_concurrent_decider(9); // shape_atom_index 0
+        {
+            push_shape_dynamic_priority_decider(4); // shape_atom_index 1
+            {
+                push_shape_persistent_action(); // shape_atom_index 2
+                push_shape_deferred_action(1, 1); // shape_atom_index 3-4
+            }
+            
+            push_shape_dynamic_priority_decider(4); // shape_atom_index 5
+            {
+                push_shape_persistent_action(); // shape_atom_index 6
+                push_shape_deferred_action(2, 2); // shape_atom_index 7-8
+            }
+        }
+        
+        create_vms_with_lane_count(6, true);
+        
+        // Only the proband actor cancels its running deferred actions.
+        set_actor_persistent_state(target_select_proband, 0, 2, liz_execution_state_success);
+        set_actor_persistent_state(target_select_proband, 1, 6, liz_execution_state_success);
+        set_actor_persistent_state(target_select_expected_result, 0, 2, liz_execution_state_fail);
+        set_actor_persistent_state(target_select_expected_result, 1, 6, liz_execution_state_fail);
+        push_actor_action_state(target_select_both, 3, liz_execution_state_running);
+        push_actor_action_state(target_select_both, 7, liz_execution_state_running);
+        
+        update_vms(&batch_functions[0]);
+        check_lanes_equal_single_updates();
+        
+        CHECK(0 != liz_lookaside_double_stack_count(&liz_vm_wavefront_lane_vm(wavefront, 0)->action_request_stack_header,
+                                                    LIZ_VM_ACTION_REQUEST_STACK_SIDE_CANCEL));
+    }
+    
+    
+    
+    TEST_FIXTURE(wavefront_fixture, walk_enters_nodes_in_shape_order)
+    {
+        push_shape_concurrent_decider(5); // shape_atom_index 0
+        {
+            push_shape_dynamic_priority_decider(3); // shape_atom_index 1
+            {
+                push_shape_persistent_action(); // shape_atom_index 2
+                push_shape_immediate_action(immediate_action_func_index_success3); // shape_atom_index 3
+            }
+            
+            push_shape_immediate_action(immediate_action_func_index_running2); // shape_atom_index 4
+        }
+        
+        create_vms_with_lane_count(5, true);
+        
+        set_actor_persistent_state(target_select_proband, 0, 2, liz_execution_state_success);
+        set_actor_persistent_state(target_select_expected_result, 0, 2, liz_execution_state_fail);
+        
+        std::vector<liz_uint_t> entered_shape_atom_indices;
+        liz_vm_monitor_t monitor = {
+            reinterpret_cast<uintptr_t>(&entered_shape_atom_indices),
+            NULL,
+            NULL
+        };
+#if defined(LIZ_VM_MONITOR_ENABLE)
+        monitor.func = enter_from_top_logging_monitor_func;
+#endif
+        
+        liz_vm_wavefront_update_actors(wavefront,
+                                       &monitor,
+                                       user_data_lookup_context_null,
+                                       identity_user_data_lookup_func,
+                                       update_time_zero,
+                                       &lane_actors[0],
+                                       static_cast<liz_int_t>(lane_actors.size()),
+                                       &shape,
+                                       &batch_functions[0]);
+        
+#if defined(LIZ_VM_MONITOR_ENABLE)
+        // The shape is walked once from front to back, all lanes reaching a 
+        // node enter it in the same wave step.
+        liz_uint_t const expected_shape_atom_indices[] = {
+            0, 0, 0, 0, 0,
+            1, 1, 1, 1, 1,
+            2, 2, 2, 2, 2,
+            3, 3,
+            4, 4, 4, 4, 4
+        };
+        std::size_t const expected_count = sizeof(expected_shape_atom_indices) / sizeof(expected_shape_atom_indices[0]);
+        CHECK_EQUAL(expected_count, entered_shape_atom_indices.size());
+        CHECK_ARRAY_EQUAL(expected_shape_atom_indices, entered_shape_atom_indices, static_cast<int>(expected_count));
+#else
+        CHECK(entered_shape_atom_indices.empty());
+#endif
+    }
+    
+    
+    
+    TEST_FIXTURE(wavefront_fixture, shared_subtrees_like_single_updates)
+    {
+        // Expanded shape to size the vms.
+        liz_index_t const subtree_atom_count = 6;
+        liz_index_t const main_tree_atom_count = 5;
+        liz_index_t const stream_atom_count = main_tree_atom_count + subtree_atom_count;
+        liz_index_t const call_count = 2;
+        
+        push_shape_concurrent_decider(1 + call_count * subtree_atom_count); // shape_atom_index 0
+        for (liz_index_t i = 0; i < call_count; ++i) {
+            push_shape_sequence_decider(subtree_atom_count); // shape_atom_index 1, 7
+            push_shape_immediate_action(immediate_action_func_index_success3); // shape_atom_index 2, 8
+            push_shape_deferred_action(42, 7); // shape_atom_index 3-4, 9-10
+            push_shape_deferred_action(43, 8); // shape_atom_index 5-6, 11-12
+        }
+        
+        create_vms_with_lane_count(6, true);
+        
+        // The proband actor's first call waits for its running action.
+        push_actor_action_state(target_select_proband, 3, liz_execution_state_running);
+        
+        // Same tree with the sequence stored once and called twice.
+        std::vector<liz_shape_atom_t> atoms(stream_atom_count);
+        std::vector<liz_shape_subtree_call_t> calls(call_count);
+        liz_int_t stream_index = 0;
+        liz_shape_atom_stream_add_concurrent_decider(&atoms[0], &stream_index, stream_atom_count, 1 + call_count * subtree_atom_count);
+        liz_shape_atom_stream_add_subtree_call(&atoms[0], &stream_index, stream_atom_count, main_tree_atom_count, subtree_atom_count);
+        liz_shape_atom_stream_add_subtree_call(&atoms[0], &stream_index, stream_atom_count, main_tree_atom_count, subtree_atom_count);
+        liz_shape_atom_stream_add_sequence_decider(&atoms[0], &stream_index, stream_atom_count, subtree_atom_count);
+        liz_shape_atom_stream_add_immediate_action(&atoms[0], &stream_index, stream_atom_count, immediate_action_func_index_success3);
+        liz_shape_atom_stream_add_deferred_action(&atoms[0], &stream_index, stream_atom_count, 42, 7);
+        liz_shape_atom_stream_add_deferred_action(&atoms[0], &stream_index, stream_atom_count, 43, 8);
+        CHECK_EQUAL(stream_atom_count, stream_index);
+        
+        liz_int_t shape_atom_index_count = 0;
+        CHECK_EQUAL(call_count, liz_shape_atom_stream_collect_subtree_calls(&calls[0],
+                                                                            call_count,
+                                                                            &shape_atom_index_count,
+                                                                            &atoms[0],
+                                                                            main_tree_atom_count));
+        
+        liz_vm_shape_t subtree_shape = shape;
+        subtree_shape.atoms = &atoms[0];
+        subtree_shape.subtree_calls = &calls[0];
+        subtree_shape.spec.shape_atom_count = stream_atom_count;
+        subtree_shape.spec.subtree_call_count = call_count;
+        subtree_shape.spec.shape_atom_index_count = static_cast<liz_index_t>(shape_atom_index_count);
+        update_shape = &subtree_shape;
+        
+        update_vms(&batch_functions[0]);
+        check_lanes_equal_single_updates();
+        
+        // The other lanes launch the first deferred action of both calls.
+        CHECK_EQUAL(2, liz_vm_action_request_count(liz_vm_wavefront_lane_vm(wavefront, 1)));
+        
+        update_vms(NULL);
+        check_lanes_equal_single_updates();
+    }
+    
+} // SUITE(liz_vm_wavefront_test)
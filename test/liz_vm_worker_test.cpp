@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Checks placement of a vm, its request buffer, and its scratch arena in one
+ * worker block.
+ */
+
+#include <unittestpp.h>
+
+#include <liz/liz_common.h>
+#include <liz/liz_allocator.h>
+#include <liz/liz_vm.h>
+#include <liz/liz_vm_worker.h>
+
+#include "liz_test_helpers.h"
+
+
+
+SUITE(liz_vm_worker_test)
+{
+    
+    
+    TEST_FIXTURE(liz_vm_test_fixture, place_worker_in_one_block)
+    {
+        push_shape_deferred_action(42, // action_id
+                                   7 // resource_id
+                                   );
+        create_expected_result_and_proband_vms_for_shape();
+        
+        size_t const scratch_size = 100;
+        size_t const block_size = liz_vm_worker_memory_size_requirement(shape.spec, 4, scratch_size);
+        
+        counting_allocator worker_allocator;
+        liz_vm_worker_t *worker = liz_vm_worker_create(shape.spec, 
+                                                       4, 
+                                                       scratch_size, 
+                                                       &worker_allocator, 
+                                                       counting_alloc);
+        CHECK(NULL != worker);
+        
+        char const *block_begin = reinterpret_cast<char const *>(worker);
+        char const *block_end = block_begin + block_size;
+        
+        CHECK(reinterpret_cast<char const *>(worker->vm) < block_end);
+        CHECK(reinterpret_cast<char const *>(worker->requests + worker->request_capacity) <= block_end);
+        CHECK(worker->scratch.memory + worker->scratch.capacity <= block_end);
+        CHECK(scratch_size <= worker->scratch.capacity);
+        CHECK(liz_vm_fulfills_shape_specification(worker->vm, shape.spec));
+        
+        CHECK(NULL != liz_arena_alloc(&worker->scratch, scratch_size));
+        
+        liz_vm_update_actor(worker->vm,
+                            NULL, // monitor
+                            NULL,
+                            identity_user_data_lookup_func,
+                            0, // time
+                            &proband_actor,
+                            &shape);
+        CHECK_EQUAL(1, liz_vm_extract_action_requests(worker->vm, 
+                                                      worker->requests, 
+                                                      worker->request_capacity, 
+                                                      1));
+        CHECK_EQUAL(42u, worker->requests[0].action_id);
+        
+        liz_vm_worker_destroy(worker, &worker_allocator, counting_dealloc);
+        
+        CHECK(worker_allocator.is_balanced());
+    }
+    
+    
+    
+    TEST(create_worker_in_huge_page_block)
+    {
+        liz_shape_specification_t spec = {};
+        spec.action_request_capacity = 8;
+        spec.decider_guard_capacity = 8;
+        
+        liz_vm_worker_t *worker = liz_vm_worker_create(spec, 
+                                                       64, 
+                                                       4 * 1024 * 1024, 
+                                                       NULL, 
+                                                       liz_huge_page_alloc);
+        CHECK(NULL != worker);
+        CHECK(liz_vm_fulfills_shape_specification(worker->vm, spec));
+        
+        liz_vm_worker_destroy(worker, NULL, liz_huge_page_dealloc);
+    }
+    
+} // SUITE(liz_vm_worker_test)
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2011, Bjoern Knafla
+ * http://www.bjoernknafla.com/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Bjoern Knafla nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ *
+ * Checks the segmented wide id table.
+ */
+
+#include <unittestpp.h>
+
+#include <vector>
+
+#include "liz_test_helpers.h"
+
+#include <liz/liz_wide_table.h>
+
+
+
+SUITE(liz_wide_table_test)
+{
+    namespace {
+        
+        bool
+        is_packed_and_consistent(liz_wide_table_t *table)
+        {
+            for (liz_int_t i = 0; i < liz_wide_table_count(table); ++i) {
+                liz_wide_id_t const id = liz_wide_table_data_id(table, i);
+                
+                if (!liz_wide_table_contains(table, id)
+                    || liz_wide_table_lookup(table, id) != liz_wide_table_data(table, i)
+                    || *static_cast<liz_wide_id_t *>(liz_wide_table_data(table, i)) != id) {
+                    
+                    return false;
+                }
+            }
+            
+            return true;
+        }
+        
+        
+        liz_wide_id_t
+        add_storing_id(liz_wide_table_t *table)
+        {
+            liz_wide_id_t const id = liz_wide_table_add(table);
+            *static_cast<liz_wide_id_t *>(liz_wide_table_lookup(table, id)) = id;
+            
+            return id;
+        }
+        
+    } // anonymous namespace
+    
+    
+    
+    TEST(create_rejects_invalid_parameters)
+    {
+        counting_allocator allocator;
+        
+        CHECK(NULL == liz_wide_table_create(3, 4, 8, 8, &allocator, counting_alloc));
+        CHECK(NULL == liz_wide_table_create(0, 4, 8, 8, &allocator, counting_alloc));
+        CHECK(NULL == liz_wide_table_create(4, 4, 6, 4, &allocator, counting_alloc));
+        CHECK(NULL == liz_wide_table_create(1 << 16, 1 << 16, 8, 8, &allocator, counting_alloc));
+        CHECK(allocator.is_balanced());
+    }
+    
+    
+    
+    TEST(grow_without_moving_data)
+    {
+        counting_allocator allocator;
+        liz_wide_table_t *table = liz_wide_table_create(4, 
+                                                        3, 
+                                                        sizeof(liz_wide_id_t), 
+                                                        sizeof(liz_wide_id_t), 
+                                                        &allocator, 
+                                                        counting_alloc);
+        
+        CHECK_EQUAL(0, liz_wide_table_capacity(table));
+        CHECK(liz_wide_table_is_full(table));
+        CHECK(liz_wide_table_reserve(table, 3, &allocator, counting_alloc));
+        CHECK_EQUAL(4, liz_wide_table_capacity(table));
+        
+        std::vector<liz_wide_id_t> ids;
+        std::vector<void *> data_slots;
+        for (int i = 0; i < 4; ++i) {
+            ids.push_back(add_storing_id(table));
+            data_slots.push_back(liz_wide_table_lookup(table, ids.back()));
+        }
+        CHECK(liz_wide_table_is_full(table));
+        
+        CHECK(liz_wide_table_reserve(table, 12, &allocator, counting_alloc));
+        CHECK_EQUAL(12, liz_wide_table_capacity(table));
+        CHECK(!liz_wide_table_reserve(table, 13, &allocator, counting_alloc));
+        
+        for (int i = 0; i < 4; ++i) {
+            CHECK_EQUAL(data_slots[static_cast<std::size_t>(i)], 
+                        liz_wide_table_lookup(table, ids[static_cast<std::size_t>(i)]));
+        }
+        
+        while (!liz_wide_table_is_full(table)) {
+            ids.push_back(add_storing_id(table));
+        }
+        CHECK(is_packed_and_consistent(table));
+        
+        liz_wide_table_destroy(table, &allocator, counting_dealloc);
+        
+        CHECK(allocator.is_balanced());
+    }
+    
+    
+    
+    TEST(remove_packs_across_segments)
+    {
+        counting_allocator allocator;
+        liz_wide_table_t *table = liz_wide_table_create(4, 
+                                                        4, 
+                                                        sizeof(liz_wide_id_t), 
+                                                        sizeof(liz_wide_id_t), 
+                                                        &allocator, 
+                                                        counting_alloc);
+        liz_wide_table_reserve(table, 16, &allocator, counting_alloc);
+        
+        std::vector<liz_wide_id_t> ids;
+        for (int i = 0; i < 10; ++i) {
+            ids.push_back(add_storing_id(table));
+        }
+        
+        liz_wide_table_remove(table, ids[1]);
+        liz_wide_table_remove(table, ids[9]);
+        liz_wide_table_remove(table, ids[4]);
+        
+        CHECK_EQUAL(7, liz_wide_table_count(table));
+        CHECK(!liz_wide_table_contains(table, ids[1]));
+        CHECK(!liz_wide_table_contains(table, ids[4]));
+        CHECK(!liz_wide_table_contains(table, ids[9]));
+        CHECK(liz_wide_table_contains(table, ids[8]));
+        CHECK(is_packed_and_consistent(table));
+        
+        // Freed rooster slots come back in FIFO order with new versions.
+        for (int i = 0; i < 6; ++i) {
+            add_storing_id(table);
+        }
+        liz_wide_id_t const reused_id = add_storing_id(table);
+        CHECK_EQUAL(ids[1] & LIZ_WIDE_TABLE_ID_TO_ROOSTER_INDEX_MASK, 
+                    reused_id & LIZ_WIDE_TABLE_ID_TO_ROOSTER_INDEX_MASK);
+        CHECK(ids[1] != reused_id);
+        CHECK(!liz_wide_table_contains(table, ids[1]));
+        CHECK(is_packed_and_consistent(table));
+        
+        liz_wide_table_destroy(table, &allocator, counting_dealloc);
+        
+        CHECK(allocator.is_balanced());
+    }
+    
+    
+    
+    TEST(capacity_beyond_16_bit_ids)
+    {
+        counting_allocator allocator;
+        liz_int_t const slot_count = 70000;
+        liz_wide_table_t *table = liz_wide_table_create(1 << 14, 
+                                                        8, 
+                                                        sizeof(liz_wide_id_t), 
+                                                        sizeof(liz_wide_id_t), 
+                                                        &allocator, 
+                                                        counting_alloc);
+        CHECK(liz_wide_table_reserve(table, slot_count, &allocator, counting_alloc));
+        
+        std::vector<liz_wide_id_t> ids;
+        for (liz_int_t i = 0; i < slot_count; ++i) {
+            ids.push_back(add_storing_id(table));
+        }
+        
+        for (liz_int_t i = 0; i < slot_count; i += 2) {
+            liz_wide_table_remove(table, ids[static_cast<std::size_t>(i)]);
+        }
+        
+        CHECK_EQUAL(slot_count / 2, liz_wide_table_count(table));
+        CHECK(liz_wide_table_contains(table, ids[static_cast<std::size_t>(slot_count - 1)]));
+        CHECK(!liz_wide_table_contains(table, ids[static_cast<std::size_t>(slot_count - 2)]));
+        CHECK(is_packed_and_consistent(table));
+        
+        liz_wide_table_destroy(table, &allocator, counting_dealloc);
+        
+        CHECK(allocator.is_balanced());
+    }
+    
+} // SUITE(liz_wide_table_test)